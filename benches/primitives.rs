@@ -0,0 +1,193 @@
+//! Throughput and latency percentiles of the crate's public operations, as
+//! measured by `eigen_crypto::benchmark`, compared against a saved baseline.
+//!
+//! ```text
+//! cargo bench --bench primitives -- [--iterations N] [--samples N]
+//!     [--save-baseline NAME] [--baseline NAME] [--fail-on-regression]
+//! ```
+//!
+//! Baselines live in `target/bench-baselines/NAME.tsv`. Results are compared
+//! with `--baseline`, or with the `main` baseline if there is one; save it
+//! from the main branch with `--save-baseline main`.
+
+use std::collections::HashMap;
+use std::env;
+use std::fs;
+use std::path::PathBuf;
+use std::process;
+
+use eigen_crypto::benchmark::{self, Config, Measurement};
+
+const DEFAULT_BASELINE: &str = "main";
+
+/// Changes of the median latency smaller than this are reported as noise.
+/// The median of the samples is compared rather than the mean, which one
+/// descheduled sample can skew.
+const NOISE_THRESHOLD: f64 = 0.05;
+
+const PAYLOAD_SIZES: [usize; 4] = [32, 1024, 16 * 1024, 256 * 1024];
+
+struct Args {
+    iterations: usize,
+    samples: usize,
+    save_baseline: Option<String>,
+    baseline: Option<String>,
+    fail_on_regression: bool,
+}
+
+fn usage() -> ! {
+    eprintln!(
+        "usage: primitives [--iterations N] [--samples N] [--save-baseline NAME] \
+         [--baseline NAME] [--fail-on-regression]"
+    );
+    process::exit(2)
+}
+
+fn parse_args() -> Args {
+    let mut args = Args {
+        iterations: 200,
+        samples: 20,
+        save_baseline: None,
+        baseline: None,
+        fail_on_regression: false,
+    };
+    let mut argv = env::args().skip(1);
+    while let Some(arg) = argv.next() {
+        let mut value = || argv.next().unwrap_or_else(|| usage());
+        match arg.as_str() {
+            // Passed by `cargo bench`.
+            "--bench" => {}
+            "--iterations" => args.iterations = value().parse().unwrap_or_else(|_| usage()),
+            "--samples" => args.samples = value().parse().unwrap_or_else(|_| usage()),
+            "--save-baseline" => args.save_baseline = Some(value()),
+            "--baseline" => args.baseline = Some(value()),
+            "--fail-on-regression" => args.fail_on_regression = true,
+            _ => usage(),
+        }
+    }
+    args
+}
+
+fn baseline_path(name: &str) -> PathBuf {
+    let mut path = PathBuf::from(env!("CARGO_MANIFEST_DIR"));
+    path.push("target");
+    path.push("bench-baselines");
+    path.push(format!("{}.tsv", name));
+    path
+}
+
+/// Identifies a measurement across runs, e.g. `ecies_encrypt/1024`.
+fn key(m: &Measurement) -> String {
+    match m.payload_len {
+        Some(len) => format!("{}/{}", m.name, len),
+        None => m.name.clone(),
+    }
+}
+
+/// One line per measurement: key, mean, p50 and p99 latency in nanoseconds.
+fn save_baseline(name: &str, results: &[Measurement]) {
+    let path = baseline_path(name);
+    let mut tsv = String::new();
+    for m in results {
+        tsv.push_str(&format!(
+            "{}\t{:.1}\t{:.1}\t{:.1}\n",
+            key(m),
+            m.nanos_per_op(),
+            m.percentile(50.0),
+            m.percentile(99.0)
+        ));
+    }
+    fs::create_dir_all(path.parent().unwrap())
+        .and_then(|()| fs::write(&path, tsv))
+        .unwrap_or_else(|e| panic!("writing {}: {}", path.display(), e));
+    println!("saved baseline {} to {}", name, path.display());
+}
+
+/// Returns the median latency of each measurement of the baseline `name`,
+/// or `None` if it was never saved.
+fn load_baseline(name: &str) -> Option<HashMap<String, f64>> {
+    let tsv = fs::read_to_string(baseline_path(name)).ok()?;
+    let baseline = tsv
+        .lines()
+        .filter_map(|line| {
+            let mut fields = line.split('\t');
+            let key = fields.next()?;
+            let median = fields.nth(1)?.parse().ok()?;
+            Some((key.to_string(), median))
+        })
+        .collect();
+    Some(baseline)
+}
+
+fn main() {
+    let args = parse_args();
+    let config = Config {
+        iterations: args.iterations,
+        samples: args.samples,
+        payload_sizes: &PAYLOAD_SIZES,
+    };
+    let results = benchmark::run(&config).unwrap_or_else(|e| panic!("benchmark failed: {:?}", e));
+
+    let baseline_name = args.baseline.as_deref().unwrap_or(DEFAULT_BASELINE);
+    let baseline = load_baseline(baseline_name);
+    if baseline.is_none() && args.baseline.is_some() {
+        eprintln!(
+            "no baseline {} at {}",
+            baseline_name,
+            baseline_path(baseline_name).display()
+        );
+        process::exit(2);
+    }
+
+    println!(
+        "{:<28} {:>12} {:>12} {:>12} {:>12} {:>12} {:>10}  vs {}",
+        "benchmark", "mean ns", "p50 ns", "p90 ns", "p99 ns", "ops/s", "MiB/s", baseline_name
+    );
+    let mut regressions = 0;
+    for m in &results {
+        let throughput = match m.bytes_per_sec() {
+            Some(bytes_per_sec) => format!("{:.1}", bytes_per_sec / (1024.0 * 1024.0)),
+            None => "-".to_string(),
+        };
+        let change = match baseline.as_ref().and_then(|b| b.get(&key(m))) {
+            Some(&old) => {
+                let change = (m.percentile(50.0) - old) / old;
+                let verdict = if change > NOISE_THRESHOLD {
+                    regressions += 1;
+                    " regressed"
+                } else if change < -NOISE_THRESHOLD {
+                    " improved"
+                } else {
+                    ""
+                };
+                format!("{:+.1}%{}", change * 100.0, verdict)
+            }
+            None => "-".to_string(),
+        };
+        println!(
+            "{:<28} {:>12.1} {:>12.1} {:>12.1} {:>12.1} {:>12.1} {:>10}  {}",
+            key(m),
+            m.nanos_per_op(),
+            m.percentile(50.0),
+            m.percentile(90.0),
+            m.percentile(99.0),
+            m.ops_per_sec(),
+            throughput,
+            change
+        );
+    }
+
+    if let Some(name) = &args.save_baseline {
+        save_baseline(name, &results);
+    }
+    if regressions > 0 {
+        println!(
+            "{} benchmarks regressed by more than {:.0}%",
+            regressions,
+            NOISE_THRESHOLD * 100.0
+        );
+        if args.fail_on_regression {
+            process::exit(1);
+        }
+    }
+}
@@ -8,9 +8,16 @@ fn main() {
     println!("cargo:rustc-link-lib=static=Enclave_u");
 
     println!("cargo:rustc-link-search=native={}/lib64", sdk_dir);
+    println!("cargo:rustc-link-lib=static=sgx_uprotected_fs");
     match is_sim.as_ref() {
-        "SW" => println!("cargo:rustc-link-lib=dylib=sgx_urts_sim"),
+        "SIM" | "SW" => println!("cargo:rustc-link-lib=dylib=sgx_urts_sim"),
         "HW" => println!("cargo:rustc-link-lib=dylib=sgx_urts"),
         _ => println!("cargo:rustc-link-lib=dylib=sgx_urts"), // Treat undefined as HW
     }
+    // Labels benchmark reports with the mode the enclave runs in.
+    match is_sim.as_ref() {
+        "SIM" | "SW" => println!("cargo:rustc-env=ENCLAVE_ENVIRONMENT=sgx-sim"),
+        _ => println!("cargo:rustc-env=ENCLAVE_ENVIRONMENT=sgx-hw"),
+    }
+    println!("cargo:rerun-if-env-changed=SGX_MODE");
 }
@@ -0,0 +1,196 @@
+use std::sync::mpsc::{self, Receiver, RecvTimeoutError, Sender};
+use std::sync::Mutex;
+use std::thread::{self, JoinHandle};
+use std::time::{Duration, Instant};
+
+use sgx_types::*;
+
+use crate::batch::{RequestBuilder, ResponseBatch, MAX_PARTS};
+
+extern "C" {
+    fn ecall_crypto_batch(
+        eid: sgx_enclave_id_t,
+        retval: *mut sgx_status_t,
+        requests: *const u8,
+        requests_len: usize,
+        responses: *mut u8,
+        responses_cap: usize,
+    ) -> sgx_status_t;
+}
+
+/// The status and output of one request.
+#[derive(Debug)]
+pub struct Response {
+    pub status: u32,
+    pub data: Vec<u8>,
+}
+
+/// Sends every request in `requests` with a single ECALL.
+pub fn call_batch(eid: sgx_enclave_id_t, requests: RequestBuilder) -> SgxResult<Vec<Response>> {
+    let count = requests.len();
+    let mut responses = vec![0u8; requests.response_capacity()];
+    let requests = requests.finish();
+    let mut retval = sgx_status_t::SGX_SUCCESS;
+    let status = unsafe {
+        ecall_crypto_batch(
+            eid,
+            &mut retval,
+            requests.as_ptr(),
+            requests.len(),
+            responses.as_mut_ptr(),
+            responses.len(),
+        )
+    };
+    if status != sgx_status_t::SGX_SUCCESS {
+        return Err(status);
+    }
+    if retval != sgx_status_t::SGX_SUCCESS {
+        return Err(retval);
+    }
+
+    let responses = ResponseBatch::parse(&responses).ok_or(sgx_status_t::SGX_ERROR_UNEXPECTED)?;
+    if responses.len() != count {
+        return Err(sgx_status_t::SGX_ERROR_UNEXPECTED);
+    }
+    (0..count)
+        .map(|i| {
+            let (status, data) = responses.get(i).ok_or(sgx_status_t::SGX_ERROR_UNEXPECTED)?;
+            Ok(Response {
+                status,
+                data: data.to_vec(),
+            })
+        })
+        .collect()
+}
+
+#[derive(Clone, Copy, Debug)]
+pub struct BatchConfig {
+    /// A batch is sent as soon as it holds this many requests.
+    pub max_batch: usize,
+
+    /// A batch is sent at the latest this long after its first request
+    /// arrived, however few requests it holds.
+    pub max_delay: Duration,
+}
+
+impl Default for BatchConfig {
+    fn default() -> Self {
+        Self {
+            max_batch: 256,
+            max_delay: Duration::from_micros(200),
+        }
+    }
+}
+
+struct Pending {
+    op: u32,
+    key_id: Vec<u8>,
+    parts: Vec<Vec<u8>>,
+    reply: Sender<SgxResult<Response>>,
+}
+
+/// Coalesces requests from any number of threads into batched ECALLs,
+/// Nagle-style: a dispatcher thread waits for a first request, keeps
+/// collecting until the batch holds `max_batch` requests or `max_delay` has
+/// passed, then sends them all with one ECALL. Under load batches fill up
+/// and transitions are amortized; under light load no request waits longer
+/// than `max_delay` before it is sent.
+///
+/// A client can be shared between threads behind an `Arc`.
+pub struct BatchClient {
+    sender: Mutex<Option<Sender<Pending>>>,
+    thread: Option<JoinHandle<()>>,
+}
+
+impl BatchClient {
+    pub fn start(eid: sgx_enclave_id_t, config: BatchConfig) -> BatchClient {
+        let (sender, receiver) = mpsc::channel();
+        let thread = thread::spawn(move || dispatch(eid, config, receiver));
+        BatchClient {
+            sender: Mutex::new(Some(sender)),
+            thread: Some(thread),
+        }
+    }
+
+    /// Queues a request, returning a receiver for its response. A request
+    /// with more than `MAX_PARTS` parts is not queued; its receiver yields
+    /// `SGX_ERROR_INVALID_PARAMETER` right away.
+    pub fn submit(&self, op: u32, key_id: &str, parts: &[&[u8]]) -> Receiver<SgxResult<Response>> {
+        let (reply, receiver) = mpsc::channel();
+        if parts.len() > MAX_PARTS {
+            let _ = reply.send(Err(sgx_status_t::SGX_ERROR_INVALID_PARAMETER));
+            return receiver;
+        }
+        let pending = Pending {
+            op,
+            key_id: key_id.as_bytes().to_vec(),
+            parts: parts.iter().map(|part| part.to_vec()).collect(),
+            reply,
+        };
+        let sender = self.sender.lock().unwrap();
+        if let Err(mpsc::SendError(pending)) = sender.as_ref().unwrap().send(pending) {
+            let _ = pending.reply.send(Err(sgx_status_t::SGX_ERROR_UNEXPECTED));
+        }
+        receiver
+    }
+
+    /// Sends a request and waits for its response.
+    pub fn call(&self, op: u32, key_id: &str, parts: &[&[u8]]) -> SgxResult<Response> {
+        self.submit(op, key_id, parts)
+            .recv()
+            .unwrap_or(Err(sgx_status_t::SGX_ERROR_UNEXPECTED))
+    }
+}
+
+impl Drop for BatchClient {
+    /// Sends whatever is still queued, then stops the dispatcher.
+    fn drop(&mut self) {
+        self.sender.lock().unwrap().take();
+        if let Some(thread) = self.thread.take() {
+            let _ = thread.join();
+        }
+    }
+}
+
+fn dispatch(eid: sgx_enclave_id_t, config: BatchConfig, receiver: Receiver<Pending>) {
+    let max_batch = config.max_batch.max(1);
+    while let Ok(first) = receiver.recv() {
+        let deadline = Instant::now() + config.max_delay;
+        let mut batch = vec![first];
+        while batch.len() < max_batch {
+            let now = Instant::now();
+            let next = if now < deadline {
+                receiver.recv_timeout(deadline - now)
+            } else {
+                // Past the deadline, take only what is already queued.
+                receiver.try_recv().map_err(|_| RecvTimeoutError::Timeout)
+            };
+            match next {
+                Ok(pending) => batch.push(pending),
+                Err(_) => break,
+            }
+        }
+
+        let mut requests = RequestBuilder::new();
+        for pending in &batch {
+            let parts = pending
+                .parts
+                .iter()
+                .map(|part| &part[..])
+                .collect::<Vec<_>>();
+            requests.push(pending.op, &pending.key_id, &parts);
+        }
+        match call_batch(eid, requests) {
+            Ok(responses) => {
+                for (pending, response) in batch.into_iter().zip(responses) {
+                    let _ = pending.reply.send(Ok(response));
+                }
+            }
+            Err(e) => {
+                for pending in batch {
+                    let _ = pending.reply.send(Err(e));
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,70 @@
+use std::fs;
+use std::path::Path;
+
+use sgx_types::*;
+
+extern "C" {
+    fn ecall_run_benchmarks(
+        eid: sgx_enclave_id_t,
+        retval: *mut sgx_status_t,
+        iterations: u32,
+        payload_sizes: *const u32,
+        payload_sizes_len: usize,
+        environment: *const u8,
+        environment_len: usize,
+        report: *mut u8,
+        report_cap: usize,
+        report_len: *mut usize,
+    ) -> sgx_status_t;
+}
+
+pub const ITERATIONS: u32 = 200;
+pub const PAYLOAD_SIZES: [u32; 4] = [32, 1024, 16 * 1024, 256 * 1024];
+
+/// Where the enclave runs, "sgx-sim" or "sgx-hw", as set by `SGX_MODE` at
+/// build time.
+pub const ENVIRONMENT: &str = env!("ENCLAVE_ENVIRONMENT");
+
+/// Runs the primitive benchmarks in the enclave, returning the JSON report.
+pub fn run(eid: sgx_enclave_id_t, iterations: u32, payload_sizes: &[u32]) -> SgxResult<String> {
+    let mut report = vec![0u8; 16 * 1024];
+    loop {
+        let mut retval = sgx_status_t::SGX_SUCCESS;
+        let mut report_len = 0;
+        let status = unsafe {
+            ecall_run_benchmarks(
+                eid,
+                &mut retval,
+                iterations,
+                payload_sizes.as_ptr(),
+                payload_sizes.len(),
+                ENVIRONMENT.as_ptr(),
+                ENVIRONMENT.len(),
+                report.as_mut_ptr(),
+                report.len(),
+                &mut report_len,
+            )
+        };
+        if status != sgx_status_t::SGX_SUCCESS {
+            return Err(status);
+        }
+        match retval {
+            sgx_status_t::SGX_SUCCESS => {
+                report.truncate(report_len);
+                return String::from_utf8(report).map_err(|_| sgx_status_t::SGX_ERROR_UNEXPECTED);
+            }
+            // Too small; run again with room for the report.
+            sgx_status_t::SGX_ERROR_INVALID_PARAMETER if report_len > report.len() => {
+                report.resize(report_len, 0);
+            }
+            e => return Err(e),
+        }
+    }
+}
+
+/// Runs the benchmarks with the default configuration and writes the report
+/// to `path`.
+pub fn write_report(eid: sgx_enclave_id_t, path: &Path) -> SgxResult<()> {
+    let report = run(eid, ITERATIONS, &PAYLOAD_SIZES)?;
+    fs::write(path, report + "\n").map_err(|_| sgx_status_t::SGX_ERROR_FILE_BAD_STATUS)
+}
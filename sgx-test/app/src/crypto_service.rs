@@ -0,0 +1,492 @@
+use std::fs;
+use std::mem::size_of;
+use std::path::Path;
+use std::sync::atomic::spin_loop_hint;
+use std::sync::Arc;
+use std::thread::{self, JoinHandle};
+use std::time::Instant;
+
+use sgx_types::*;
+
+use crate::batch_client::{BatchClient, BatchConfig};
+use crate::switchless::{
+    Channel, HeapUsage, Slot, OPS, OP_ECIES_DECRYPT, OP_ECIES_ENCRYPT, OP_SIGN, OP_VERIFY,
+    RING_LEN, STATUS_OK,
+};
+
+extern "C" {
+    fn ecall_crypto_generate_key(
+        eid: sgx_enclave_id_t,
+        retval: *mut sgx_status_t,
+        handle: *const u8,
+        handle_len: usize,
+        public_key: *mut u8,
+        public_key_cap: usize,
+        public_key_len: *mut usize,
+    ) -> sgx_status_t;
+    fn ecall_crypto_unseal_key(
+        eid: sgx_enclave_id_t,
+        retval: *mut sgx_status_t,
+        handle: *const u8,
+        handle_len: usize,
+    ) -> sgx_status_t;
+    fn ecall_crypto_evict_key(
+        eid: sgx_enclave_id_t,
+        retval: *mut sgx_status_t,
+        handle: *const u8,
+        handle_len: usize,
+    ) -> sgx_status_t;
+    fn ecall_crypto_delete_key(
+        eid: sgx_enclave_id_t,
+        retval: *mut sgx_status_t,
+        handle: *const u8,
+        handle_len: usize,
+    ) -> sgx_status_t;
+    fn ecall_crypto_call(
+        eid: sgx_enclave_id_t,
+        retval: *mut sgx_status_t,
+        request: *const u8,
+        response: *mut u8,
+        slot_len: usize,
+    ) -> sgx_status_t;
+    fn ecall_crypto_worker(
+        eid: sgx_enclave_id_t,
+        retval: *mut sgx_status_t,
+        channel: *const u8,
+    ) -> sgx_status_t;
+    fn ecall_crypto_heap_report(
+        eid: sgx_enclave_id_t,
+        retval: *mut sgx_status_t,
+        report: *mut u8,
+        report_len: usize,
+    ) -> sgx_status_t;
+    fn ecall_crypto_metrics(
+        eid: sgx_enclave_id_t,
+        retval: *mut sgx_status_t,
+        report: *mut u8,
+        report_cap: usize,
+        report_len: *mut usize,
+    ) -> sgx_status_t;
+}
+
+fn check(status: sgx_status_t, retval: sgx_status_t) -> SgxResult<()> {
+    match (status, retval) {
+        (sgx_status_t::SGX_SUCCESS, sgx_status_t::SGX_SUCCESS) => Ok(()),
+        (sgx_status_t::SGX_SUCCESS, e) | (e, _) => Err(e),
+    }
+}
+
+/// Generates and seals a P-256 key in the enclave under `handle`, returning
+/// its public key.
+pub fn generate_key(eid: sgx_enclave_id_t, handle: &str) -> SgxResult<Vec<u8>> {
+    let mut retval = sgx_status_t::SGX_SUCCESS;
+    let mut public_key = vec![0u8; 97];
+    let mut public_key_len = 0;
+    let status = unsafe {
+        ecall_crypto_generate_key(
+            eid,
+            &mut retval,
+            handle.as_ptr(),
+            handle.len(),
+            public_key.as_mut_ptr(),
+            public_key.len(),
+            &mut public_key_len,
+        )
+    };
+    check(status, retval)?;
+    public_key.truncate(public_key_len);
+    Ok(public_key)
+}
+
+type HandleEcall =
+    unsafe extern "C" fn(sgx_enclave_id_t, *mut sgx_status_t, *const u8, usize) -> sgx_status_t;
+
+fn handle_ecall(ecall: HandleEcall, eid: sgx_enclave_id_t, handle: &str) -> SgxResult<()> {
+    let mut retval = sgx_status_t::SGX_SUCCESS;
+    let status = unsafe { ecall(eid, &mut retval, handle.as_ptr(), handle.len()) };
+    check(status, retval)
+}
+
+/// Loads the sealed key `handle` in the enclave.
+pub fn unseal_key(eid: sgx_enclave_id_t, handle: &str) -> SgxResult<()> {
+    handle_ecall(ecall_crypto_unseal_key, eid, handle)
+}
+
+/// Unloads `handle` in the enclave, keeping its sealed file.
+pub fn evict_key(eid: sgx_enclave_id_t, handle: &str) -> SgxResult<()> {
+    handle_ecall(ecall_crypto_evict_key, eid, handle)
+}
+
+/// Unloads `handle` in the enclave and removes its sealed file.
+pub fn delete_key(eid: sgx_enclave_id_t, handle: &str) -> SgxResult<()> {
+    handle_ecall(ecall_crypto_delete_key, eid, handle)
+}
+
+/// Prints the peak memory use of each op served so far, if the enclave was
+/// built with the `heap_stats` feature.
+pub fn print_heap_report(eid: sgx_enclave_id_t) -> SgxResult<()> {
+    let mut report = [HeapUsage::default(); OPS.len()];
+    let mut retval = sgx_status_t::SGX_SUCCESS;
+    let status = unsafe {
+        ecall_crypto_heap_report(
+            eid,
+            &mut retval,
+            report.as_mut_ptr() as *mut u8,
+            size_of::<[HeapUsage; OPS.len()]>(),
+        )
+    };
+    match check(status, retval) {
+        Err(sgx_status_t::SGX_ERROR_FEATURE_NOT_SUPPORTED) => return Ok(()),
+        result => result?,
+    }
+    let names = ["sign", "verify", "ecies encrypt", "ecies decrypt"];
+    for (name, usage) in names.iter().zip(report.iter()) {
+        println!(
+            "[+] {}: {} calls, peak {} bytes of heap and {} bytes of scratch per request",
+            name, usage.calls, usage.peak_heap, usage.peak_scratch
+        );
+    }
+    Ok(())
+}
+
+/// Prints the enclave's `eigen_crypto::metrics` snapshot, if it was built
+/// with the `metrics` feature.
+pub fn print_metrics(eid: sgx_enclave_id_t) -> SgxResult<()> {
+    let mut report = vec![0u8; 4096];
+    let report_len = loop {
+        let mut retval = sgx_status_t::SGX_SUCCESS;
+        let mut report_len = 0;
+        let status = unsafe {
+            ecall_crypto_metrics(
+                eid,
+                &mut retval,
+                report.as_mut_ptr(),
+                report.len(),
+                &mut report_len,
+            )
+        };
+        match check(status, retval) {
+            Ok(()) => break report_len,
+            Err(sgx_status_t::SGX_ERROR_FEATURE_NOT_SUPPORTED) => return Ok(()),
+            // Too small; ask again with room for the report.
+            Err(sgx_status_t::SGX_ERROR_INVALID_PARAMETER) if report_len > report.len() => {
+                report.resize(report_len, 0);
+            }
+            Err(e) => return Err(e),
+        }
+    };
+    report.truncate(report_len);
+    println!("[+] crypto metrics {}", String::from_utf8_lossy(&report));
+    Ok(())
+}
+
+/// Unseals every `*.sealed` key in `dir`, spreading them over `threads`
+/// threads so that they are decrypted and parsed on as many TCSs in
+/// parallel. Returns the number of keys loaded.
+pub fn unseal_all(eid: sgx_enclave_id_t, dir: &Path, threads: usize) -> SgxResult<usize> {
+    let mut handles = fs::read_dir(dir)
+        .map_err(|_| sgx_status_t::SGX_ERROR_FILE_BAD_STATUS)?
+        .filter_map(|entry| {
+            let name = entry.ok()?.file_name().into_string().ok()?;
+            let handle = name.strip_suffix(".sealed")?;
+            Some(handle.to_string())
+        })
+        .collect::<Vec<_>>();
+    handles.sort();
+
+    let count = handles.len();
+    let chunk_len = (count + threads.max(1) - 1) / threads.max(1);
+    let threads = handles
+        .chunks(chunk_len.max(1))
+        .map(|chunk| {
+            let chunk = chunk.to_vec();
+            thread::spawn(move || chunk.iter().try_for_each(|handle| unseal_key(eid, handle)))
+        })
+        .collect::<Vec<_>>();
+    for thread in threads {
+        thread
+            .join()
+            .unwrap_or(Err(sgx_status_t::SGX_ERROR_UNEXPECTED))?;
+    }
+    Ok(count)
+}
+
+/// Sends one request with its own ECALL.
+pub fn call(eid: sgx_enclave_id_t, request: &Slot) -> SgxResult<Slot> {
+    let mut retval = sgx_status_t::SGX_SUCCESS;
+    let mut response = Slot::EMPTY;
+    let status = unsafe {
+        ecall_crypto_call(
+            eid,
+            &mut retval,
+            request as *const Slot as *const u8,
+            &mut response as *mut Slot as *mut u8,
+            size_of::<Slot>(),
+        )
+    };
+    check(status, retval)?;
+    Ok(response)
+}
+
+/// One channel and the enclave worker serving it. Only the thread owning
+/// the `Worker` may push requests or pop responses.
+pub struct Worker {
+    channel: Arc<Channel>,
+    thread: Option<JoinHandle<SgxResult<()>>>,
+}
+
+impl Worker {
+    /// Starts a thread that enters the enclave once and serves the new
+    /// channel from there. Each worker occupies a TCS until it is stopped.
+    pub fn start(eid: sgx_enclave_id_t) -> Worker {
+        let channel = Arc::new(Channel::new());
+        // Raw pointers aren't `Send`; the address is, and the `Arc` keeps the
+        // channel alive until the thread is joined.
+        let address = &*channel as *const Channel as usize;
+        let thread = thread::spawn(move || {
+            let mut retval = sgx_status_t::SGX_SUCCESS;
+            let status = unsafe { ecall_crypto_worker(eid, &mut retval, address as *const u8) };
+            check(status, retval)
+        });
+        Worker {
+            channel,
+            thread: Some(thread),
+        }
+    }
+
+    /// Queues `request`, returning `false` if the ring is full.
+    pub fn submit(&self, request: &Slot) -> bool {
+        self.channel.requests.push(request)
+    }
+
+    pub fn poll(&self) -> Option<Slot> {
+        self.channel.responses.pop()
+    }
+
+    /// Sends `request` and waits for its response.
+    pub fn call(&self, request: &Slot) -> Slot {
+        while !self.submit(request) {
+            spin_loop_hint();
+        }
+        loop {
+            match self.poll() {
+                Some(response) => return response,
+                None => spin_loop_hint(),
+            }
+        }
+    }
+
+    pub fn stop(mut self) -> SgxResult<()> {
+        self.shutdown()
+    }
+
+    fn shutdown(&mut self) -> SgxResult<()> {
+        self.channel.stop();
+        match self.thread.take() {
+            Some(thread) => thread
+                .join()
+                .unwrap_or(Err(sgx_status_t::SGX_ERROR_UNEXPECTED)),
+            None => Ok(()),
+        }
+    }
+}
+
+impl Drop for Worker {
+    fn drop(&mut self) {
+        let _ = self.shutdown();
+    }
+}
+
+fn request(tag: u64, op: u32, key_id: &str, parts: &[&[u8]]) -> Slot {
+    Slot::request(tag, op, key_id.as_bytes(), parts).unwrap()
+}
+
+/// Runs sign, verify and an ECIES round trip through the rings, the
+/// per-operation ECALL and the batching client.
+pub fn self_test(eid: sgx_enclave_id_t) -> SgxResult<()> {
+    let key_id = "self-test";
+    // Left behind if an earlier run failed.
+    let _ = delete_key(eid, key_id);
+    let public_key = generate_key(eid, key_id)?;
+    let msg = b"hello, come on, go get it";
+
+    let worker = Worker::start(eid);
+    let client = BatchClient::start(eid, BatchConfig::default());
+    for path in 0..3 {
+        let send = |op: u32, key_id: &str, parts: &[&[u8]]| -> SgxResult<(u32, Vec<u8>)> {
+            let tag = op as u64;
+            let response = match path {
+                0 => worker.call(&request(tag, op, key_id, parts)),
+                1 => call(eid, &request(tag, op, key_id, parts))?,
+                _ => {
+                    let response = client.call(op, key_id, parts)?;
+                    return Ok((response.status, response.data));
+                }
+            };
+            assert_eq!(response.tag, tag);
+            Ok((response.status, response.parts().unwrap()[0].to_vec()))
+        };
+
+        let (status, sig) = send(OP_SIGN, key_id, &[msg])?;
+        assert_eq!(status, STATUS_OK);
+
+        let (status, _) = send(OP_VERIFY, "", &[&public_key, msg, &sig])?;
+        assert_eq!(status, STATUS_OK);
+        let (status, _) = send(OP_VERIFY, "", &[&public_key, b"other", &sig])?;
+        assert_ne!(status, STATUS_OK);
+
+        let (status, cipher) = send(OP_ECIES_ENCRYPT, "", &[&public_key, msg])?;
+        assert_eq!(status, STATUS_OK);
+        let (status, plain) = send(OP_ECIES_DECRYPT, key_id, &[&cipher])?;
+        assert_eq!(status, STATUS_OK);
+        assert_eq!(plain, &msg[..]);
+
+        let (status, _) = send(OP_SIGN, "missing", &[msg])?;
+        assert_ne!(status, STATUS_OK);
+    }
+
+    // Requests submitted together come back in a single batch.
+    let receivers = (0..8)
+        .map(|_| client.submit(OP_VERIFY, "", &[&public_key, b"other", &[]]))
+        .collect::<Vec<_>>();
+    for receiver in receivers {
+        let response = receiver.recv().unwrap()?;
+        assert_ne!(response.status, STATUS_OK);
+    }
+
+    // An evicted key can't be used until it is unsealed again.
+    evict_key(eid, key_id)?;
+    assert_ne!(
+        worker.call(&request(7, OP_SIGN, key_id, &[msg])).status,
+        STATUS_OK
+    );
+    unseal_key(eid, key_id)?;
+    let response = worker.call(&request(8, OP_SIGN, key_id, &[msg]));
+    assert_eq!(response.status, STATUS_OK);
+    let sig = response.parts().unwrap()[0].to_vec();
+    let response = worker.call(&request(9, OP_VERIFY, "", &[&public_key, msg, &sig]));
+    assert_eq!(response.status, STATUS_OK);
+    assert!(generate_key(eid, key_id).is_err());
+
+    delete_key(eid, key_id)?;
+    assert!(unseal_key(eid, key_id).is_err());
+    worker.stop()
+}
+
+/// Compares ops/sec of the rings and of batched ECALLs against one ECALL
+/// per operation, for signing and for verification, and prints the results.
+///
+/// `workers` rings are driven by one app thread each, keeping every ring as
+/// full as it goes. The batching client is fed by as many threads with the
+/// same number of requests in flight. In `SGX_MODE=SIM` enclave transitions are only emulated,
+/// so the gap is smaller than on hardware.
+pub fn bench(eid: sgx_enclave_id_t, ops: usize, workers: usize) -> SgxResult<()> {
+    let key_id = "bench";
+    let _ = delete_key(eid, key_id);
+    let public_key = generate_key(eid, key_id)?;
+    let msg = [0x5au8; 32];
+    let sig = call(eid, &request(0, OP_SIGN, key_id, &[&msg]))?;
+    let sig = sig.parts().unwrap()[0].to_vec();
+
+    let cases = [
+        ("sign", request(0, OP_SIGN, key_id, &[&msg])),
+        (
+            "verify",
+            request(0, OP_VERIFY, "", &[&public_key, &msg, &sig]),
+        ),
+    ];
+    for (name, slot) in cases.iter() {
+        let per_thread = ops / workers;
+
+        let start = Instant::now();
+        let threads = (0..workers)
+            .map(|_| {
+                let slot = *slot;
+                thread::spawn(move || -> SgxResult<()> {
+                    for _ in 0..per_thread {
+                        let response = call(eid, &slot)?;
+                        assert_eq!(response.status, STATUS_OK);
+                    }
+                    Ok(())
+                })
+            })
+            .collect::<Vec<_>>();
+        for thread in threads {
+            thread.join().unwrap()?;
+        }
+        let ecall_rate = (per_thread * workers) as f64 / start.elapsed().as_secs_f64();
+
+        let start = Instant::now();
+        let threads = (0..workers)
+            .map(|_| {
+                let slot = *slot;
+                thread::spawn(move || -> SgxResult<()> {
+                    let worker = Worker::start(eid);
+                    let (mut sent, mut received) = (0, 0);
+                    while received < per_thread {
+                        while sent < per_thread
+                            && sent - received < RING_LEN
+                            && worker.submit(&slot)
+                        {
+                            sent += 1;
+                        }
+                        match worker.poll() {
+                            Some(response) => {
+                                assert_eq!(response.status, STATUS_OK);
+                                received += 1;
+                            }
+                            None => spin_loop_hint(),
+                        }
+                    }
+                    worker.stop()
+                })
+            })
+            .collect::<Vec<_>>();
+        for thread in threads {
+            thread.join().unwrap()?;
+        }
+        let ring_rate = (per_thread * workers) as f64 / start.elapsed().as_secs_f64();
+
+        let client = Arc::new(BatchClient::start(eid, BatchConfig::default()));
+        let start = Instant::now();
+        let threads = (0..workers)
+            .map(|_| {
+                let (slot, client) = (*slot, client.clone());
+                thread::spawn(move || -> SgxResult<()> {
+                    let key_id = std::str::from_utf8(slot.key_id().unwrap()).unwrap();
+                    let parts = slot.parts().unwrap();
+                    let mut received = 0;
+                    while received < per_thread {
+                        let in_flight = RING_LEN.min(per_thread - received);
+                        let receivers = (0..in_flight)
+                            .map(|_| client.submit(slot.op, key_id, &parts))
+                            .collect::<Vec<_>>();
+                        for receiver in receivers {
+                            let response = receiver.recv().unwrap()?;
+                            assert_eq!(response.status, STATUS_OK);
+                        }
+                        received += in_flight;
+                    }
+                    Ok(())
+                })
+            })
+            .collect::<Vec<_>>();
+        for thread in threads {
+            thread.join().unwrap()?;
+        }
+        let batch_rate = (per_thread * workers) as f64 / start.elapsed().as_secs_f64();
+
+        println!(
+            "[+] {} x{}: {:.0} ops/s with one ECALL per op, {:.0} ops/s switchless ({:.2}x), \
+             {:.0} ops/s batched ({:.2}x)",
+            name,
+            workers,
+            ecall_rate,
+            ring_rate,
+            ring_rate / ecall_rate,
+            batch_rate,
+            batch_rate / ecall_rate
+        );
+    }
+    delete_key(eid, key_id)
+}
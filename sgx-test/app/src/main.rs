@@ -1,6 +1,14 @@
 use sgx_types::*;
 use sgx_urts::SgxEnclave;
 
+#[path = "../../common/batch.rs"]
+mod batch;
+mod batch_client;
+mod benchmarks;
+mod crypto_service;
+#[path = "../../common/switchless.rs"]
+mod switchless;
+
 const ENCLAVE_FILE: &str = "enclave.signed.so";
 
 extern "C" {
@@ -45,5 +53,45 @@ fn main() {
         return;
     }
 
+    match crypto_service::unseal_all(enclave.geteid(), std::path::Path::new("."), 4) {
+        Ok(n) => println!("[+] unsealed {} keys", n),
+        Err(x) => {
+            println!("[-] unsealing keys failed {}!", x.as_str());
+            return;
+        }
+    }
+
+    if let Err(x) = crypto_service::self_test(enclave.geteid()) {
+        println!("[-] crypto service self test failed {}!", x.as_str());
+        return;
+    }
+    println!("[+] crypto service self test passed");
+
+    if std::env::args().any(|arg| arg == "--bench") {
+        if let Err(x) = crypto_service::bench(enclave.geteid(), 20000, 2) {
+            println!("[-] crypto service bench failed {}!", x.as_str());
+            return;
+        }
+    }
+
+    if std::env::args().any(|arg| arg == "--bench-report") {
+        let path = std::path::Path::new("bench-report.json");
+        if let Err(x) = benchmarks::write_report(enclave.geteid(), path) {
+            println!("[-] benchmarks failed {}!", x.as_str());
+            return;
+        }
+        println!("[+] wrote {}", path.display());
+    }
+
+    if let Err(x) = crypto_service::print_heap_report(enclave.geteid()) {
+        println!("[-] crypto service heap report failed {}!", x.as_str());
+        return;
+    }
+
+    if let Err(x) = crypto_service::print_metrics(enclave.geteid()) {
+        println!("[-] crypto metrics failed {}!", x.as_str());
+        return;
+    }
+
     enclave.destroy();
 }
@@ -0,0 +1,247 @@
+//! Packed request and response arrays for `ecall_crypto_batch`.
+//!
+//! Like `switchless.rs`, this file is compiled into both the app and the
+//! enclave. All integers are little-endian `u32`s. A request batch is
+//!
+//! ```text
+//! count
+//! count x { op, key_id_offset, key_id_len, (part_offset, part_len) x 3 }
+//! data
+//! ```
+//!
+//! and a response batch, which always has one entry per request, is
+//!
+//! ```text
+//! count
+//! count x { status, offset, len }
+//! data
+//! ```
+//!
+//! where offsets are relative to the start of `data`. Ops and statuses are
+//! the ones of the switchless rings.
+
+use std::prelude::v1::*;
+
+use crate::switchless::{OP_ECIES_DECRYPT, OP_ECIES_ENCRYPT, OP_SIGN, OP_VERIFY};
+
+/// The most parts a request can carry.
+pub const MAX_PARTS: usize = 3;
+
+const REQUEST_ENTRY_LEN: usize = 4 * (3 + 2 * MAX_PARTS);
+const RESPONSE_ENTRY_LEN: usize = 4 * 3;
+
+/// An upper bound on the size of a signature produced by the service.
+const SIGNATURE_MAX_LEN: usize = 105;
+
+/// What ECIES adds to a plaintext: the ephemeral public key, the AES-GCM
+/// nonce and tag, and the HMAC-SHA256 tag.
+const ECIES_OVERHEAD: usize = 65 + 12 + 16 + 32;
+
+fn read_u32(input: &[u8], at: usize) -> Option<u32> {
+    let bytes = input.get(at..at.checked_add(4)?)?;
+    Some(u32::from_le_bytes([bytes[0], bytes[1], bytes[2], bytes[3]]))
+}
+
+fn write_u32(output: &mut [u8], at: usize, value: u32) {
+    output[at..at + 4].copy_from_slice(&value.to_le_bytes());
+}
+
+fn get(data: &[u8], offset: u32, len: u32) -> Option<&[u8]> {
+    let offset = offset as usize;
+    data.get(offset..offset.checked_add(len as usize)?)
+}
+
+/// The largest output `op` can produce for inputs of the given lengths, used
+/// by the app to size the response buffer.
+pub fn max_output_len(op: u32, part_lens: &[usize]) -> usize {
+    let part = |i: usize| part_lens.get(i).cloned().unwrap_or(0);
+    match op {
+        OP_SIGN => SIGNATURE_MAX_LEN,
+        OP_VERIFY => 0,
+        OP_ECIES_ENCRYPT => part(1) + ECIES_OVERHEAD,
+        OP_ECIES_DECRYPT => part(0),
+        _ => 0,
+    }
+}
+
+/// Builds a request batch.
+#[derive(Default)]
+pub struct RequestBuilder {
+    entries: Vec<u8>,
+    data: Vec<u8>,
+    count: usize,
+    response_data_len: usize,
+}
+
+impl RequestBuilder {
+    pub fn new() -> Self {
+        Self::default()
+    }
+
+    /// Appends a request. Panics if `parts` has more than `MAX_PARTS`
+    /// entries; callers check that before queueing a request.
+    pub fn push(&mut self, op: u32, key_id: &[u8], parts: &[&[u8]]) {
+        assert!(parts.len() <= MAX_PARTS);
+        let mut entry = [0u8; REQUEST_ENTRY_LEN];
+        write_u32(&mut entry, 0, op);
+        write_u32(&mut entry, 4, self.data.len() as u32);
+        write_u32(&mut entry, 8, key_id.len() as u32);
+        self.data.extend_from_slice(key_id);
+        let mut part_lens = [0; MAX_PARTS];
+        for (i, part) in parts.iter().enumerate() {
+            write_u32(&mut entry, 12 + 8 * i, self.data.len() as u32);
+            write_u32(&mut entry, 16 + 8 * i, part.len() as u32);
+            self.data.extend_from_slice(part);
+            part_lens[i] = part.len();
+        }
+        self.entries.extend_from_slice(&entry);
+        self.count += 1;
+        self.response_data_len += max_output_len(op, &part_lens);
+    }
+
+    pub fn len(&self) -> usize {
+        self.count
+    }
+
+    pub fn is_empty(&self) -> bool {
+        self.count == 0
+    }
+
+    /// The size of a response buffer that can hold every response.
+    pub fn response_capacity(&self) -> usize {
+        4 + self.count * RESPONSE_ENTRY_LEN + self.response_data_len
+    }
+
+    pub fn finish(self) -> Vec<u8> {
+        let mut out = Vec::with_capacity(4 + self.entries.len() + self.data.len());
+        out.extend_from_slice(&(self.count as u32).to_le_bytes());
+        out.extend_from_slice(&self.entries);
+        out.extend_from_slice(&self.data);
+        out
+    }
+}
+
+/// One request of a parsed batch.
+pub struct Request<'a> {
+    pub op: u32,
+    pub key_id: &'a [u8],
+    pub parts: [&'a [u8]; MAX_PARTS],
+}
+
+/// A parsed request batch. Entries are validated as they are read.
+pub struct RequestBatch<'a> {
+    entries: &'a [u8],
+    data: &'a [u8],
+}
+
+impl<'a> RequestBatch<'a> {
+    /// Returns `None` if `input` is too short for the count it declares.
+    pub fn parse(input: &'a [u8]) -> Option<Self> {
+        let count = read_u32(input, 0)? as usize;
+        let entries_len = count.checked_mul(REQUEST_ENTRY_LEN)?;
+        let entries = input.get(4..4usize.checked_add(entries_len)?)?;
+        let data = &input[4 + entries_len..];
+        Some(Self { entries, data })
+    }
+
+    pub fn len(&self) -> usize {
+        self.entries.len() / REQUEST_ENTRY_LEN
+    }
+
+    /// Returns `None` if the `i`th entry points outside the data area.
+    pub fn get(&self, i: usize) -> Option<Request<'a>> {
+        let entry = self
+            .entries
+            .get(i * REQUEST_ENTRY_LEN..(i + 1) * REQUEST_ENTRY_LEN)?;
+        let key_id = get(self.data, read_u32(entry, 4)?, read_u32(entry, 8)?)?;
+        let mut parts: [&[u8]; MAX_PARTS] = [&[]; MAX_PARTS];
+        for (j, part) in parts.iter_mut().enumerate() {
+            *part = get(
+                self.data,
+                read_u32(entry, 12 + 8 * j)?,
+                read_u32(entry, 16 + 8 * j)?,
+            )?;
+        }
+        Some(Request {
+            op: read_u32(entry, 0)?,
+            key_id,
+            parts,
+        })
+    }
+}
+
+/// Writes a response batch of `count` entries into a caller-provided buffer.
+pub struct ResponseWriter<'a> {
+    output: &'a mut [u8],
+    count: usize,
+    written: usize,
+    data_len: usize,
+}
+
+impl<'a> ResponseWriter<'a> {
+    /// Returns `None` if `output` can't even hold the entries.
+    pub fn new(output: &'a mut [u8], count: usize) -> Option<Self> {
+        let header_len = count.checked_mul(RESPONSE_ENTRY_LEN)?.checked_add(4)?;
+        if output.len() < header_len {
+            return None;
+        }
+        write_u32(output, 0, count as u32);
+        Some(Self {
+            output,
+            count,
+            written: 0,
+            data_len: 0,
+        })
+    }
+
+    /// Appends the next response, returning `false`, and recording no data,
+    /// if `data` doesn't fit.
+    pub fn push(&mut self, status: u32, data: &[u8]) -> bool {
+        assert!(self.written < self.count);
+        let data_start = 4 + self.count * RESPONSE_ENTRY_LEN;
+        let entry = 4 + self.written * RESPONSE_ENTRY_LEN;
+        self.written += 1;
+        let at = data_start + self.data_len;
+        if self.output.len() - at < data.len() {
+            write_u32(self.output, entry, crate::switchless::STATUS_NO_SPACE);
+            write_u32(self.output, entry + 4, self.data_len as u32);
+            write_u32(self.output, entry + 8, 0);
+            return false;
+        }
+        self.output[at..at + data.len()].copy_from_slice(data);
+        write_u32(self.output, entry, status);
+        write_u32(self.output, entry + 4, self.data_len as u32);
+        write_u32(self.output, entry + 8, data.len() as u32);
+        self.data_len += data.len();
+        true
+    }
+}
+
+/// A parsed response batch.
+pub struct ResponseBatch<'a> {
+    entries: &'a [u8],
+    data: &'a [u8],
+}
+
+impl<'a> ResponseBatch<'a> {
+    pub fn parse(input: &'a [u8]) -> Option<Self> {
+        let count = read_u32(input, 0)? as usize;
+        let entries_len = count.checked_mul(RESPONSE_ENTRY_LEN)?;
+        let entries = input.get(4..4usize.checked_add(entries_len)?)?;
+        let data = &input[4 + entries_len..];
+        Some(Self { entries, data })
+    }
+
+    pub fn len(&self) -> usize {
+        self.entries.len() / RESPONSE_ENTRY_LEN
+    }
+
+    /// Returns the status and output of the `i`th response.
+    pub fn get(&self, i: usize) -> Option<(u32, &'a [u8])> {
+        let entry = self
+            .entries
+            .get(i * RESPONSE_ENTRY_LEN..(i + 1) * RESPONSE_ENTRY_LEN)?;
+        let data = get(self.data, read_u32(entry, 4)?, read_u32(entry, 8)?)?;
+        Some((read_u32(entry, 0)?, data))
+    }
+}
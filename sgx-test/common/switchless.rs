@@ -0,0 +1,240 @@
+//! Shared-memory request rings for the switchless crypto service.
+//!
+//! This file is compiled into both the untrusted app and the enclave, so the
+//! two sides agree on the layout of `Channel`. A channel lives in untrusted
+//! memory and is owned by one app thread and one enclave worker, which makes
+//! each of its rings single-producer/single-consumer: the app pushes requests
+//! and pops responses, the worker pops requests and pushes responses.
+//!
+//! The enclave must treat everything in a channel as attacker-controlled.
+//! `SpscRing::pop()` copies the slot out before returning it, and slot indices
+//! are always masked, so a hostile host can at worst feed the worker garbage
+//! requests, which it rejects like any other malformed input.
+
+use std::cell::UnsafeCell;
+use std::sync::atomic::{AtomicU32, AtomicUsize, Ordering};
+
+/// Number of slots in each ring. Must be a power of two.
+pub const RING_LEN: usize = 64;
+
+/// Capacity of a slot's payload, which holds a request's inputs or a
+/// response's output.
+pub const SLOT_DATA_LEN: usize = 1024;
+
+pub const KEY_ID_MAX_LEN: usize = 32;
+
+/// Signs `parts[0]` with the key `key_id`. Responds with the signature.
+pub const OP_SIGN: u32 = 1;
+
+/// Verifies that `parts[2]` is a P-256/SHA-256 ASN.1 signature of `parts[1]`
+/// by the public key `parts[0]`. Responds with no data.
+pub const OP_VERIFY: u32 = 2;
+
+/// Encrypts `parts[1]` to the P-256 public key `parts[0]` with ECIES.
+/// Responds with the ciphertext.
+pub const OP_ECIES_ENCRYPT: u32 = 3;
+
+/// Decrypts the ECIES ciphertext `parts[0]` with the key `key_id`. Responds
+/// with the plaintext.
+pub const OP_ECIES_DECRYPT: u32 = 4;
+
+/// Every op, in the order `ecall_crypto_heap_report` reports them.
+pub const OPS: [u32; 4] = [OP_SIGN, OP_VERIFY, OP_ECIES_ENCRYPT, OP_ECIES_DECRYPT];
+
+pub const STATUS_OK: u32 = 0;
+
+/// The request was malformed: an unknown op, an unknown key, or lengths that
+/// don't fit the slot.
+pub const STATUS_INVALID_REQUEST: u32 = 1;
+
+/// The operation itself failed, e.g. a signature did not verify.
+pub const STATUS_FAILED: u32 = 2;
+
+/// The operation succeeded but its output didn't fit the response.
+pub const STATUS_NO_SPACE: u32 = 3;
+
+const MAX_PARTS: usize = 3;
+
+/// A request or a response. The payload is `data`, split into consecutive
+/// parts whose lengths are `part_lens`; unused parts have length zero.
+#[repr(C)]
+#[derive(Clone, Copy)]
+pub struct Slot {
+    /// Chosen by the app and echoed in the response.
+    pub tag: u64,
+    pub op: u32,
+    pub status: u32,
+    pub key_id_len: u32,
+    pub part_lens: [u32; MAX_PARTS],
+    pub key_id: [u8; KEY_ID_MAX_LEN],
+    pub data: [u8; SLOT_DATA_LEN],
+}
+
+impl Slot {
+    pub const EMPTY: Slot = Slot {
+        tag: 0,
+        op: 0,
+        status: STATUS_OK,
+        key_id_len: 0,
+        part_lens: [0; MAX_PARTS],
+        key_id: [0; KEY_ID_MAX_LEN],
+        data: [0; SLOT_DATA_LEN],
+    };
+
+    /// Builds a request, returning `None` if `key_id` or `parts` don't fit.
+    pub fn request(tag: u64, op: u32, key_id: &[u8], parts: &[&[u8]]) -> Option<Slot> {
+        if key_id.len() > KEY_ID_MAX_LEN || parts.len() > MAX_PARTS {
+            return None;
+        }
+        let mut slot = Slot::EMPTY;
+        slot.tag = tag;
+        slot.op = op;
+        slot.key_id_len = key_id.len() as u32;
+        slot.key_id[..key_id.len()].copy_from_slice(key_id);
+        let mut offset = 0;
+        for (i, part) in parts.iter().enumerate() {
+            let end = offset + part.len();
+            if end > SLOT_DATA_LEN {
+                return None;
+            }
+            slot.data[offset..end].copy_from_slice(part);
+            slot.part_lens[i] = part.len() as u32;
+            offset = end;
+        }
+        Some(slot)
+    }
+
+    /// Builds the response to the request tagged `tag`.
+    pub fn response(tag: u64, status: u32, data: &[u8]) -> Slot {
+        let mut slot = Slot::EMPTY;
+        slot.tag = tag;
+        slot.status = status;
+        if data.len() > SLOT_DATA_LEN {
+            slot.status = STATUS_NO_SPACE;
+        } else {
+            slot.data[..data.len()].copy_from_slice(data);
+            slot.part_lens[0] = data.len() as u32;
+        }
+        slot
+    }
+
+    /// Returns `None` if `key_id_len` is out of range.
+    pub fn key_id(&self) -> Option<&[u8]> {
+        self.key_id.get(..self.key_id_len as usize)
+    }
+
+    /// Returns the payload's parts, or `None` if their lengths run past the
+    /// end of `data`.
+    pub fn parts(&self) -> Option<[&[u8]; MAX_PARTS]> {
+        let mut parts: [&[u8]; MAX_PARTS] = [&[]; MAX_PARTS];
+        let mut offset: usize = 0;
+        for (part, &len) in parts.iter_mut().zip(self.part_lens.iter()) {
+            let end = offset.checked_add(len as usize)?;
+            *part = self.data.get(offset..end)?;
+            offset = end;
+        }
+        Some(parts)
+    }
+}
+
+/// The memory used by one op, over every request the enclave has served.
+/// Peaks are the most any single request needed on top of what its thread
+/// already held.
+#[repr(C)]
+#[derive(Clone, Copy, Debug, Default)]
+pub struct HeapUsage {
+    pub calls: u64,
+    pub peak_heap: u64,
+    pub peak_scratch: u64,
+}
+
+/// Keeps the producer's and the consumer's index on separate cache lines.
+#[repr(C, align(64))]
+struct CachePadded<T>(T);
+
+/// A bounded lock-free single-producer/single-consumer queue of `Slot`s.
+///
+/// `head` and `tail` count pushes and pops since creation; the slot for
+/// index `i` is `i % RING_LEN`. Only the producer stores `head` and only the
+/// consumer stores `tail`.
+#[repr(C)]
+pub struct SpscRing {
+    head: CachePadded<AtomicUsize>,
+    tail: CachePadded<AtomicUsize>,
+    slots: UnsafeCell<[Slot; RING_LEN]>,
+}
+
+// Safe because a slot is only written by the producer before it publishes it
+// through `head`, and only read by the consumer before it releases it
+// through `tail`.
+unsafe impl Sync for SpscRing {}
+
+impl SpscRing {
+    pub fn new() -> Self {
+        Self {
+            head: CachePadded(AtomicUsize::new(0)),
+            tail: CachePadded(AtomicUsize::new(0)),
+            slots: UnsafeCell::new([Slot::EMPTY; RING_LEN]),
+        }
+    }
+
+    /// Appends a copy of `slot`, returning `false` if the ring is full. Must
+    /// only be called by the producer.
+    pub fn push(&self, slot: &Slot) -> bool {
+        let head = self.head.0.load(Ordering::Relaxed);
+        let tail = self.tail.0.load(Ordering::Acquire);
+        if head.wrapping_sub(tail) >= RING_LEN {
+            return false;
+        }
+        unsafe {
+            (*self.slots.get())[head % RING_LEN] = *slot;
+        }
+        self.head.0.store(head.wrapping_add(1), Ordering::Release);
+        true
+    }
+
+    /// Removes and returns a copy of the oldest slot, if any. Must only be
+    /// called by the consumer.
+    pub fn pop(&self) -> Option<Slot> {
+        let tail = self.tail.0.load(Ordering::Relaxed);
+        let head = self.head.0.load(Ordering::Acquire);
+        if head == tail {
+            return None;
+        }
+        let slot = unsafe { (*self.slots.get())[tail % RING_LEN] };
+        self.tail.0.store(tail.wrapping_add(1), Ordering::Release);
+        Some(slot)
+    }
+
+    pub fn is_empty(&self) -> bool {
+        self.head.0.load(Ordering::Acquire) == self.tail.0.load(Ordering::Acquire)
+    }
+}
+
+/// The pair of rings shared between one app thread and one enclave worker.
+#[repr(C)]
+pub struct Channel {
+    pub requests: SpscRing,
+    pub responses: SpscRing,
+    stop: AtomicU32,
+}
+
+impl Channel {
+    pub fn new() -> Self {
+        Self {
+            requests: SpscRing::new(),
+            responses: SpscRing::new(),
+            stop: AtomicU32::new(0),
+        }
+    }
+
+    /// Asks the worker serving this channel to return from its ECALL once it
+    /// has answered the requests already queued.
+    pub fn stop(&self) {
+        self.stop.store(1, Ordering::Release);
+    }
+
+    pub fn is_stopped(&self) -> bool {
+        self.stop.load(Ordering::Acquire) != 0
+    }
+}
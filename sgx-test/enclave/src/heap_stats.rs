@@ -0,0 +1,142 @@
+//! Per-op memory instrumentation, for sizing batches and worker counts so
+//! that the service fits in the enclave heap and in the EPC.
+//!
+//! With the `heap_stats` feature, a counting global allocator tracks the
+//! bytes each thread has live, and `measure()` records, per op, the peak
+//! heap and scratch arena use of the request it wraps. Without it,
+//! `measure()` just runs the request and `report()` returns `None`.
+
+use std::prelude::v1::*;
+
+use crate::switchless::{HeapUsage, OPS};
+
+#[cfg(feature = "heap_stats")]
+mod counting {
+    use std::alloc::{GlobalAlloc, Layout, System};
+    use std::cell::Cell;
+    use std::sync::atomic::{AtomicU64, Ordering::Relaxed};
+
+    use crate::switchless::{HeapUsage, OPS};
+
+    // Plain thread locals: the allocator can't use `thread_local!`, whose
+    // lazy initialization may itself allocate.
+    #[thread_local]
+    static LIVE: Cell<usize> = Cell::new(0);
+    #[thread_local]
+    static PEAK: Cell<usize> = Cell::new(0);
+
+    fn grow(len: usize) {
+        let live = LIVE.get() + len;
+        LIVE.set(live);
+        if live > PEAK.get() {
+            PEAK.set(live);
+        }
+    }
+
+    // Memory may be freed on another thread than the one that allocated it.
+    fn shrink(len: usize) {
+        LIVE.set(LIVE.get().saturating_sub(len));
+    }
+
+    struct Counting;
+
+    unsafe impl GlobalAlloc for Counting {
+        unsafe fn alloc(&self, layout: Layout) -> *mut u8 {
+            let ptr = System.alloc(layout);
+            if !ptr.is_null() {
+                grow(layout.size());
+            }
+            ptr
+        }
+
+        unsafe fn alloc_zeroed(&self, layout: Layout) -> *mut u8 {
+            let ptr = System.alloc_zeroed(layout);
+            if !ptr.is_null() {
+                grow(layout.size());
+            }
+            ptr
+        }
+
+        unsafe fn dealloc(&self, ptr: *mut u8, layout: Layout) {
+            System.dealloc(ptr, layout);
+            shrink(layout.size());
+        }
+
+        unsafe fn realloc(&self, ptr: *mut u8, layout: Layout, new_size: usize) -> *mut u8 {
+            let new_ptr = System.realloc(ptr, layout, new_size);
+            if !new_ptr.is_null() {
+                shrink(layout.size());
+                grow(new_size);
+            }
+            new_ptr
+        }
+    }
+
+    #[global_allocator]
+    static ALLOCATOR: Counting = Counting;
+
+    struct OpStats {
+        calls: AtomicU64,
+        peak_heap: AtomicU64,
+        peak_scratch: AtomicU64,
+    }
+
+    const NEW_OP_STATS: OpStats = OpStats {
+        calls: AtomicU64::new(0),
+        peak_heap: AtomicU64::new(0),
+        peak_scratch: AtomicU64::new(0),
+    };
+
+    static STATS: [OpStats; OPS.len()] = [NEW_OP_STATS; OPS.len()];
+
+    pub fn measure<R>(op: u32, f: impl FnOnce() -> R) -> R {
+        let stats = match OPS.iter().position(|&o| o == op) {
+            Some(i) => &STATS[i],
+            None => return f(),
+        };
+        let base = LIVE.get();
+        PEAK.set(base);
+        eigen_crypto::arena::reset_scratch_peak();
+        let scratch_base = eigen_crypto::arena::scratch_peak();
+
+        let result = f();
+
+        let heap = PEAK.get() - base;
+        let scratch = eigen_crypto::arena::scratch_peak() - scratch_base;
+        stats.calls.fetch_add(1, Relaxed);
+        stats.peak_heap.fetch_max(heap as u64, Relaxed);
+        stats.peak_scratch.fetch_max(scratch as u64, Relaxed);
+        result
+    }
+
+    pub fn report() -> [HeapUsage; OPS.len()] {
+        let mut report = [HeapUsage::default(); OPS.len()];
+        for (usage, stats) in report.iter_mut().zip(STATS.iter()) {
+            usage.calls = stats.calls.load(Relaxed);
+            usage.peak_heap = stats.peak_heap.load(Relaxed);
+            usage.peak_scratch = stats.peak_scratch.load(Relaxed);
+        }
+        report
+    }
+}
+
+/// Runs the request `f` for `op`, recording its memory use.
+#[inline(always)]
+pub fn measure<R>(op: u32, f: impl FnOnce() -> R) -> R {
+    #[cfg(feature = "heap_stats")]
+    return counting::measure(op, f);
+    #[cfg(not(feature = "heap_stats"))]
+    {
+        let _ = op;
+        f()
+    }
+}
+
+/// The memory use of each op in `OPS`, or `None` if the enclave was built
+/// without the `heap_stats` feature.
+pub fn report() -> Option<[HeapUsage; OPS.len()]> {
+    #[cfg(feature = "heap_stats")]
+    return Some(counting::report());
+    #[cfg(not(feature = "heap_stats"))]
+    None
+}
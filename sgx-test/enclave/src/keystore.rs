@@ -0,0 +1,106 @@
+//! The enclave-resident key store behind the crypto service.
+//!
+//! Keys live in memory in a `KeyRegistry`, keyed by handle, so requests only
+//! ever name a key; private keys never cross the enclave boundary. Each key
+//! is also persisted as a PKCS#8 document in a protected file,
+//! `<handle>.sealed`, which the SGX protected file system encrypts with a key
+//! derived from the enclave signer. Unsealing reads that file back; after
+//! that, lookups are a hash map probe.
+
+use std::prelude::v1::*;
+
+use std::io::{Read, Write};
+use std::sgxfs::{self, SgxFile};
+use std::sync::{SgxRwLock, SgxRwLockReadGuard};
+
+use sgx_types::*;
+
+use eigen_crypto::ec::PKCS8_V2_DOCUMENT_MAX_LEN;
+use eigen_crypto::sign::ecdsa::{EcdsaKeyPair, KeyPair, ECDSA_P256_SHA256_ASN1_SIGNING};
+use eigen_crypto::sign::registry::KeyRegistry;
+
+use crate::switchless::KEY_ID_MAX_LEN;
+
+lazy_static! {
+    static ref KEYS: SgxRwLock<KeyRegistry> = SgxRwLock::new(KeyRegistry::new());
+}
+
+/// The loaded keys. Holding the guard blocks generating, unsealing and
+/// evicting keys, not other readers.
+pub fn keys() -> SgxRwLockReadGuard<'static, KeyRegistry> {
+    KEYS.read().unwrap()
+}
+
+/// Handles double as file names, so they are restricted to a safe alphabet.
+fn sealed_path(handle: &str) -> SgxResult<String> {
+    let valid = !handle.is_empty()
+        && handle.len() <= KEY_ID_MAX_LEN
+        && handle
+            .bytes()
+            .all(|b| b.is_ascii_alphanumeric() || b == b'-' || b == b'_');
+    if !valid {
+        return Err(sgx_status_t::SGX_ERROR_INVALID_PARAMETER);
+    }
+    Ok(format!("{}.sealed", handle))
+}
+
+/// Generates a P-256 key, seals it and loads it under `handle`, returning
+/// its public key. Fails if `handle` is loaded or already has a sealed file.
+pub fn generate(handle: &str) -> SgxResult<Vec<u8>> {
+    let path = sealed_path(handle)?;
+    let alg = &ECDSA_P256_SHA256_ASN1_SIGNING;
+    let pkcs8 =
+        EcdsaKeyPair::generate_pkcs8(alg).map_err(|_| sgx_status_t::SGX_ERROR_UNEXPECTED)?;
+    let key_pair = EcdsaKeyPair::from_pkcs8(alg, pkcs8.as_ref())
+        .map_err(|_| sgx_status_t::SGX_ERROR_UNEXPECTED)?;
+    let public_key = key_pair.public_key().as_ref().to_vec();
+
+    let mut keys = KEYS.write().unwrap();
+    if keys.get(handle).is_some() || SgxFile::open(&path).is_ok() {
+        return Err(sgx_status_t::SGX_ERROR_INVALID_PARAMETER);
+    }
+    SgxFile::create(&path)
+        .and_then(|mut file| file.write_all(pkcs8.as_ref()))
+        .map_err(|_| sgx_status_t::SGX_ERROR_UNEXPECTED)?;
+    keys.insert(handle, key_pair);
+    Ok(public_key)
+}
+
+/// Loads the sealed key `handle`, if it isn't loaded already.
+///
+/// The file is read and parsed without holding the registry lock, so
+/// several TCS threads can unseal different keys at the same time.
+pub fn unseal(handle: &str) -> SgxResult<()> {
+    let path = sealed_path(handle)?;
+    if keys().get(handle).is_some() {
+        return Ok(());
+    }
+
+    let mut pkcs8 = Vec::with_capacity(PKCS8_V2_DOCUMENT_MAX_LEN);
+    SgxFile::open(&path)
+        .and_then(|mut file| file.read_to_end(&mut pkcs8))
+        .map_err(|_| sgx_status_t::SGX_ERROR_FILE_BAD_STATUS)?;
+    let key_pair = EcdsaKeyPair::from_pkcs8(&ECDSA_P256_SHA256_ASN1_SIGNING, &pkcs8)
+        .map_err(|_| sgx_status_t::SGX_ERROR_INVALID_PARAMETER)?;
+
+    let mut keys = KEYS.write().unwrap();
+    if keys.get(handle).is_none() {
+        keys.insert(handle, key_pair);
+    }
+    Ok(())
+}
+
+/// Unloads `handle`, keeping its sealed file.
+pub fn evict(handle: &str) -> SgxResult<()> {
+    sealed_path(handle)?;
+    KEYS.write().unwrap().remove(handle);
+    Ok(())
+}
+
+/// Unloads `handle` and removes its sealed file.
+pub fn delete(handle: &str) -> SgxResult<()> {
+    let path = sealed_path(handle)?;
+    let mut keys = KEYS.write().unwrap();
+    keys.remove(handle);
+    sgxfs::remove(&path).map_err(|_| sgx_status_t::SGX_ERROR_FILE_BAD_STATUS)
+}
@@ -1,6 +1,7 @@
 #![cfg_attr(all(feature = "mesalock_sgx",
                 not(target_env = "sgx")), no_std)]
 #![cfg_attr(all(target_env = "sgx", target_vendor = "mesalock"), feature(rustc_private))]
+#![cfg_attr(feature = "heap_stats", feature(thread_local))]
 
 #[cfg(all(feature = "mesalock_sgx", not(target_env = "sgx")))]
 #[macro_use]
@@ -11,8 +12,27 @@ use std::prelude::v1::*;
 extern crate sgx_types;
 use sgx_types::*;
 
+extern crate sgx_trts;
+use sgx_trts::trts::rsgx_raw_is_outside_enclave;
+
+#[macro_use]
+extern crate lazy_static;
+
+use std::mem::size_of;
+use std::slice;
+
 use eigen_crypto::sign::ecdsa::KeyPair;
 
+#[path = "../../common/batch.rs"]
+mod batch;
+mod heap_stats;
+mod keystore;
+mod service;
+#[path = "../../common/switchless.rs"]
+mod switchless;
+
+use switchless::{Channel, HeapUsage, Slot};
+
 #[no_mangle]
 pub extern "C" fn ecall_run_tests() -> sgx_status_t {
     test_eigen_crypto();
@@ -21,6 +41,196 @@ pub extern "C" fn ecall_run_tests() -> sgx_status_t {
     sgx_status_t::SGX_SUCCESS
 }
 
+fn handle_arg<'a>(handle: *const u8, handle_len: usize) -> SgxResult<&'a str> {
+    let handle = unsafe { slice::from_raw_parts(handle, handle_len) };
+    std::str::from_utf8(handle).map_err(|_| sgx_status_t::SGX_ERROR_INVALID_PARAMETER)
+}
+
+fn status(result: SgxResult<()>) -> sgx_status_t {
+    match result {
+        Ok(()) => sgx_status_t::SGX_SUCCESS,
+        Err(e) => e,
+    }
+}
+
+/// Generates a P-256 key inside the enclave, seals it and loads it under
+/// `handle` for the crypto service, returning its public key.
+#[no_mangle]
+pub extern "C" fn ecall_crypto_generate_key(
+    handle: *const u8,
+    handle_len: usize,
+    public_key: *mut u8,
+    public_key_cap: usize,
+    public_key_len: *mut usize,
+) -> sgx_status_t {
+    status(handle_arg(handle, handle_len).and_then(keystore::generate).and_then(|bytes| {
+        if bytes.len() > public_key_cap {
+            return Err(sgx_status_t::SGX_ERROR_INVALID_PARAMETER);
+        }
+        unsafe {
+            slice::from_raw_parts_mut(public_key, bytes.len()).copy_from_slice(&bytes);
+            *public_key_len = bytes.len();
+        }
+        Ok(())
+    }))
+}
+
+/// Loads the sealed key `handle` into the key store. The app unseals keys in
+/// bulk by calling this from several threads, one TCS each.
+#[no_mangle]
+pub extern "C" fn ecall_crypto_unseal_key(handle: *const u8, handle_len: usize) -> sgx_status_t {
+    status(handle_arg(handle, handle_len).and_then(keystore::unseal))
+}
+
+/// Unloads `handle` from the key store, keeping its sealed file.
+#[no_mangle]
+pub extern "C" fn ecall_crypto_evict_key(handle: *const u8, handle_len: usize) -> sgx_status_t {
+    status(handle_arg(handle, handle_len).and_then(keystore::evict))
+}
+
+/// Unloads `handle` and removes its sealed file.
+#[no_mangle]
+pub extern "C" fn ecall_crypto_delete_key(handle: *const u8, handle_len: usize) -> sgx_status_t {
+    status(handle_arg(handle, handle_len).and_then(keystore::delete))
+}
+
+/// Answers a single crypto service request; the baseline that pays one
+/// enclave transition per operation.
+#[no_mangle]
+pub extern "C" fn ecall_crypto_call(
+    request: *const u8,
+    response: *mut u8,
+    slot_len: usize,
+) -> sgx_status_t {
+    if slot_len != size_of::<Slot>() {
+        return sgx_status_t::SGX_ERROR_INVALID_PARAMETER;
+    }
+    // Both buffers were copied into the enclave by the edge routines, which
+    // don't guarantee any alignment.
+    let request = unsafe { (request as *const Slot).read_unaligned() };
+    let response_slot = service::handle(&request);
+    unsafe { (response as *mut Slot).write_unaligned(response_slot) };
+    sgx_status_t::SGX_SUCCESS
+}
+
+/// Answers a packed batch of crypto service requests (see `batch.rs`), so
+/// that one enclave transition is amortized over the whole batch.
+#[no_mangle]
+pub extern "C" fn ecall_crypto_batch(
+    requests: *const u8,
+    requests_len: usize,
+    responses: *mut u8,
+    responses_cap: usize,
+) -> sgx_status_t {
+    let requests = unsafe { slice::from_raw_parts(requests, requests_len) };
+    let responses = unsafe { slice::from_raw_parts_mut(responses, responses_cap) };
+    match service::handle_batch(requests, responses) {
+        Some(()) => sgx_status_t::SGX_SUCCESS,
+        None => sgx_status_t::SGX_ERROR_INVALID_PARAMETER,
+    }
+}
+
+/// Copies the per-op memory use recorded so far, one `HeapUsage` per op in
+/// `switchless::OPS`, to `report`. Fails with
+/// `SGX_ERROR_FEATURE_NOT_SUPPORTED` unless the enclave was built with the
+/// `heap_stats` feature.
+#[no_mangle]
+pub extern "C" fn ecall_crypto_heap_report(report: *mut u8, report_len: usize) -> sgx_status_t {
+    let usage = match heap_stats::report() {
+        Some(usage) => usage,
+        None => return sgx_status_t::SGX_ERROR_FEATURE_NOT_SUPPORTED,
+    };
+    if report_len != size_of::<[HeapUsage; switchless::OPS.len()]>() {
+        return sgx_status_t::SGX_ERROR_INVALID_PARAMETER;
+    }
+    unsafe { (report as *mut [HeapUsage; switchless::OPS.len()]).write_unaligned(usage) };
+    sgx_status_t::SGX_SUCCESS
+}
+
+/// Times the crate's primitives inside the enclave with
+/// `eigen_crypto::benchmark`, `iterations` calls each, ECIES and the hashes
+/// at each of `payload_sizes`, and writes the JSON report, labelled with
+/// `environment`, to `report`. If it doesn't fit, only `report_len` is set
+/// and `SGX_ERROR_INVALID_PARAMETER` returned.
+#[no_mangle]
+pub extern "C" fn ecall_run_benchmarks(
+    iterations: u32,
+    payload_sizes: *const u32,
+    payload_sizes_len: usize,
+    environment: *const u8,
+    environment_len: usize,
+    report: *mut u8,
+    report_cap: usize,
+    report_len: *mut usize,
+) -> sgx_status_t {
+    let environment = match handle_arg(environment, environment_len) {
+        Ok(environment) => environment,
+        Err(e) => return e,
+    };
+    let payload_sizes = unsafe { slice::from_raw_parts(payload_sizes, payload_sizes_len) }
+        .iter()
+        .map(|&len| len as usize)
+        .collect::<Vec<_>>();
+    let config = eigen_crypto::benchmark::Config {
+        iterations: iterations as usize,
+        payload_sizes: &payload_sizes,
+        ..Default::default()
+    };
+    let json = match eigen_crypto::benchmark::run(&config) {
+        Ok(results) => eigen_crypto::benchmark::to_json(environment, &results),
+        Err(_) => return sgx_status_t::SGX_ERROR_UNEXPECTED,
+    };
+    copy_report(&json, report, report_cap, report_len)
+}
+
+/// Writes the `eigen_crypto::metrics` counters and latency histograms
+/// recorded so far, as JSON, to `report`. If it doesn't fit, only
+/// `report_len` is set and `SGX_ERROR_INVALID_PARAMETER` returned. Fails with
+/// `SGX_ERROR_FEATURE_NOT_SUPPORTED` unless the enclave was built with the
+/// `metrics` feature.
+#[no_mangle]
+pub extern "C" fn ecall_crypto_metrics(
+    report: *mut u8,
+    report_cap: usize,
+    report_len: *mut usize,
+) -> sgx_status_t {
+    if !eigen_crypto::metrics::ENABLED {
+        return sgx_status_t::SGX_ERROR_FEATURE_NOT_SUPPORTED;
+    }
+    let json = eigen_crypto::metrics::snapshot().to_json();
+    copy_report(&json, report, report_cap, report_len)
+}
+
+fn copy_report(
+    json: &str,
+    report: *mut u8,
+    report_cap: usize,
+    report_len: *mut usize,
+) -> sgx_status_t {
+    unsafe { *report_len = json.len() };
+    if json.len() > report_cap {
+        return sgx_status_t::SGX_ERROR_INVALID_PARAMETER;
+    }
+    let report = unsafe { slice::from_raw_parts_mut(report, json.len()) };
+    report.copy_from_slice(json.as_bytes());
+    sgx_status_t::SGX_SUCCESS
+}
+
+/// Serves the crypto service on the shared `Channel` at `channel` until the
+/// app stops it. The app runs one of these per worker thread, each on its
+/// own TCS and its own channel.
+#[no_mangle]
+pub extern "C" fn ecall_crypto_worker(channel: *const u8) -> sgx_status_t {
+    if channel.is_null()
+        || channel as usize % std::mem::align_of::<Channel>() != 0
+        || !rsgx_raw_is_outside_enclave(channel, size_of::<Channel>())
+    {
+        return sgx_status_t::SGX_ERROR_INVALID_PARAMETER;
+    }
+    service::serve(unsafe { &*(channel as *const Channel) });
+    sgx_status_t::SGX_SUCCESS
+}
+
 fn test_eigen_crypto() {
     test_ecies();
 }
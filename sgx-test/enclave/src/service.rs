@@ -0,0 +1,108 @@
+use std::prelude::v1::*;
+
+use std::sync::atomic::spin_loop_hint;
+
+use eigen_crypto::ec::suite_b::ecies;
+use eigen_crypto::errors::Error;
+use eigen_crypto::sign::ecdsa::{UnparsedPublicKey, ECDSA_P256_SHA256_ASN1};
+use eigen_crypto::sign::registry::KeyRegistry;
+
+use crate::batch::{RequestBatch, ResponseWriter};
+use crate::heap_stats;
+use crate::keystore;
+use crate::switchless::{
+    Channel, Slot, OP_ECIES_DECRYPT, OP_ECIES_ENCRYPT, OP_SIGN, OP_VERIFY, STATUS_FAILED,
+    STATUS_INVALID_REQUEST, STATUS_OK,
+};
+
+/// Runs one operation against `keys`, returning its status and output.
+fn execute(keys: &KeyRegistry, op: u32, key_id: &[u8], parts: [&[u8]; 3]) -> (u32, Vec<u8>) {
+    heap_stats::measure(op, || run(keys, op, key_id, parts))
+}
+
+fn run(keys: &KeyRegistry, op: u32, key_id: &[u8], parts: [&[u8]; 3]) -> (u32, Vec<u8>) {
+    let key_id = match std::str::from_utf8(key_id) {
+        Ok(key_id) => key_id,
+        Err(_) => return (STATUS_INVALID_REQUEST, Vec::new()),
+    };
+    let result = match op {
+        OP_SIGN => match keys.get(key_id) {
+            Some(key_pair) => key_pair.sign(parts[0]).map(|sig| sig.as_ref().to_vec()),
+            None => return (STATUS_INVALID_REQUEST, Vec::new()),
+        },
+        OP_VERIFY => UnparsedPublicKey::new(&ECDSA_P256_SHA256_ASN1, parts[0])
+            .verify(parts[1], parts[2])
+            .map(|()| Vec::new())
+            .map_err(Error::from),
+        OP_ECIES_ENCRYPT => {
+            let public_key = UnparsedPublicKey::new(&ECDSA_P256_SHA256_ASN1, parts[0]);
+            ecies::encrypt(&public_key, &[], &[], parts[1])
+        }
+        OP_ECIES_DECRYPT => match keys.get(key_id) {
+            Some(key_pair) => ecies::decrypt(key_pair, parts[0], &[], &[]),
+            None => return (STATUS_INVALID_REQUEST, Vec::new()),
+        },
+        _ => return (STATUS_INVALID_REQUEST, Vec::new()),
+    };
+    match result {
+        Ok(data) => (STATUS_OK, data),
+        Err(_) => (STATUS_FAILED, Vec::new()),
+    }
+}
+
+/// Answers one request. The same code serves both the rings and the
+/// one-ECALL-per-operation entry point, so the two only differ in how the
+/// request crosses the enclave boundary.
+pub fn handle(request: &Slot) -> Slot {
+    let (key_id, parts) = match (request.key_id(), request.parts()) {
+        (Some(key_id), Some(parts)) => (key_id, parts),
+        _ => return Slot::response(request.tag, STATUS_INVALID_REQUEST, &[]),
+    };
+    let (status, data) = execute(&keystore::keys(), request.op, key_id, parts);
+    Slot::response(request.tag, status, &data)
+}
+
+/// Answers a packed batch of requests, writing one response per request to
+/// `responses`. The key store is locked once for the whole batch.
+pub fn handle_batch(requests: &[u8], responses: &mut [u8]) -> Option<()> {
+    let requests = RequestBatch::parse(requests)?;
+    let mut writer = ResponseWriter::new(responses, requests.len())?;
+    let keys = keystore::keys();
+    for i in 0..requests.len() {
+        let (status, data) = match requests.get(i) {
+            Some(request) => execute(&keys, request.op, request.key_id, request.parts),
+            None => (STATUS_INVALID_REQUEST, Vec::new()),
+        };
+        writer.push(status, &data);
+    }
+    Some(())
+}
+
+/// Serves `channel` until the app stops it. Runs on the TCS of the ECALL
+/// that called it, polling instead of sleeping so that requests never wait
+/// for an enclave transition.
+pub fn serve(channel: &Channel) {
+    loop {
+        match channel.requests.pop() {
+            Some(request) => {
+                let response = handle(&request);
+                while !channel.responses.push(&response) {
+                    // The app stopped draining responses; nobody is left to
+                    // read this one.
+                    if channel.is_stopped() {
+                        return;
+                    }
+                    spin_loop_hint();
+                }
+            }
+            None => {
+                // Re-check after seeing the stop flag, which is set after
+                // the app's last push.
+                if channel.is_stopped() && channel.requests.is_empty() {
+                    return;
+                }
+                spin_loop_hint();
+            }
+        }
+    }
+}
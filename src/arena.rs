@@ -0,0 +1,333 @@
+//! Per-thread scratch memory for temporaries on the crypto hot paths.
+//!
+//! An `Arena` hands out slices by bumping an offset into chunks it keeps for
+//! the life of the thread. Memory is only reclaimed by leaving a scope: every
+//! slice allocated inside `Arena::scope()` is released when the closure
+//! returns, so an operation's scratch is reset as soon as the operation is
+//! done, and after warming up a thread serves its temporaries without
+//! touching the heap. That matters most in an enclave, whose heap is small and
+//! whose pages are expensive to fault in.
+//!
+//! Slices can't outlive their scope: the closure gets a `Scope` with a fresh
+//! lifetime that its result can't mention. Nor can they overlap: while a
+//! nested scope is open, only the innermost `Scope` may allocate, since
+//! leaving the nested scope releases everything past its start. Allocating
+//! from an outer `Scope` meanwhile panics.
+
+use std::prelude::v1::*;
+use std::alloc::{alloc, dealloc, Layout};
+use std::cell::{Cell, UnsafeCell};
+use std::marker::PhantomData;
+use std::mem;
+use std::ptr;
+
+/// Size of a regular chunk. Larger requests get a chunk of their own.
+const CHUNK_LEN: usize = 16 * 1024;
+
+/// Alignment of every chunk, and the largest alignment `Scope::alloc()`
+/// supports.
+const CHUNK_ALIGN: usize = 64;
+
+struct Chunk {
+    ptr: *mut u8,
+    len: usize,
+}
+
+impl Chunk {
+    fn new(len: usize) -> Self {
+        let layout = Layout::from_size_align(len, CHUNK_ALIGN).unwrap();
+        let ptr = unsafe { alloc(layout) };
+        if ptr.is_null() {
+            std::alloc::handle_alloc_error(layout);
+        }
+        Self { ptr, len }
+    }
+}
+
+impl Drop for Chunk {
+    fn drop(&mut self) {
+        let layout = unsafe { Layout::from_size_align_unchecked(self.len, CHUNK_ALIGN) };
+        unsafe { dealloc(self.ptr, layout) }
+    }
+}
+
+/// Where the next allocation goes: a chunk index and an offset into it, plus
+/// the number of bytes handed out so far.
+#[derive(Clone, Copy)]
+struct Mark {
+    chunk: usize,
+    offset: usize,
+    in_use: usize,
+}
+
+/// A bump allocator for scratch slices. See the module documentation.
+pub struct Arena {
+    // Chunks are only ever added or reordered, never freed or moved, while
+    // the arena is alive, so slices into them stay valid.
+    chunks: UnsafeCell<Vec<Chunk>>,
+    mark: Cell<Mark>,
+    peak: Cell<usize>,
+    /// The number of open scopes; only a `Scope` at this depth may allocate.
+    depth: Cell<usize>,
+}
+
+impl Default for Arena {
+    fn default() -> Self {
+        Self::new()
+    }
+}
+
+impl Arena {
+    pub const fn new() -> Self {
+        Self {
+            chunks: UnsafeCell::new(Vec::new()),
+            mark: Cell::new(Mark {
+                chunk: 0,
+                offset: 0,
+                in_use: 0,
+            }),
+            peak: Cell::new(0),
+            depth: Cell::new(0),
+        }
+    }
+
+    /// Runs `f` with a scope to allocate from, then releases everything
+    /// allocated in it. Scopes nest, but only the innermost open one can
+    /// allocate; see the module documentation.
+    pub fn scope<R, F>(&self, f: F) -> R
+    where
+        F: for<'s> FnOnce(&'s Scope<'s>) -> R,
+    {
+        struct Restore<'a>(&'a Arena, Mark, usize);
+        impl Drop for Restore<'_> {
+            fn drop(&mut self) {
+                self.0.mark.set(self.1);
+                self.0.depth.set(self.2);
+            }
+        }
+
+        let depth = self.depth.get();
+        let _restore = Restore(self, self.mark.get(), depth);
+        self.depth.set(depth + 1);
+        f(&Scope {
+            arena: self,
+            depth: depth + 1,
+            _lifetime: PhantomData,
+        })
+    }
+
+    /// Total bytes held in chunks, in use or not.
+    pub fn capacity(&self) -> usize {
+        unsafe { &*self.chunks.get() }.iter().map(|c| c.len).sum()
+    }
+
+    /// The most bytes in use at once since the arena was created or
+    /// `reset_peak()` was last called.
+    pub fn peak(&self) -> usize {
+        self.peak.get()
+    }
+
+    pub fn reset_peak(&self) {
+        self.peak.set(self.mark.get().in_use);
+    }
+
+    fn alloc_bytes(&self, depth: usize, len: usize, align: usize) -> *mut u8 {
+        assert!(
+            depth == self.depth.get(),
+            "allocating from an arena scope while a nested scope is open"
+        );
+        assert!(align <= CHUNK_ALIGN);
+        let chunks = unsafe { &mut *self.chunks.get() };
+        let mut mark = self.mark.get();
+
+        let fits = |chunk: &Chunk, offset: usize| {
+            let start = (offset + align - 1) & !(align - 1);
+            match start.checked_add(len) {
+                Some(end) if end <= chunk.len => Some(start),
+                _ => None,
+            }
+        };
+        let start = match chunks.get(mark.chunk).and_then(|c| fits(c, mark.offset)) {
+            Some(start) => start,
+            None => {
+                // Move on to the next chunk, making room for one that's big
+                // enough if it isn't. Chunks past the mark are all free.
+                let next = if chunks.is_empty() { 0 } else { mark.chunk + 1 };
+                if chunks.get(next).and_then(|c| fits(c, 0)).is_none() {
+                    chunks.insert(next, Chunk::new(len.max(CHUNK_LEN)));
+                }
+                mark.chunk = next;
+                0
+            }
+        };
+
+        mark.offset = start + len;
+        mark.in_use += len;
+        self.mark.set(mark);
+        if mark.in_use > self.peak.get() {
+            self.peak.set(mark.in_use);
+        }
+        unsafe { chunks[mark.chunk].ptr.add(start) }
+    }
+}
+
+/// A handle to allocate from an `Arena` for the duration of one
+/// `Arena::scope()` call.
+pub struct Scope<'s> {
+    arena: &'s Arena,
+    depth: usize,
+    // Invariant, so that `'s` can't be shortened or lengthened.
+    _lifetime: PhantomData<fn(&'s ()) -> &'s ()>,
+}
+
+impl<'s> Scope<'s> {
+    /// Allocates `len` copies of `value`.
+    pub fn alloc<T: Copy>(&self, len: usize, value: T) -> &'s mut [T] {
+        let bytes = mem::size_of::<T>().checked_mul(len).unwrap();
+        let ptr = self
+            .arena
+            .alloc_bytes(self.depth, bytes, mem::align_of::<T>()) as *mut T;
+        unsafe {
+            for i in 0..len {
+                ptr::write(ptr.add(i), value);
+            }
+            std::slice::from_raw_parts_mut(ptr, len)
+        }
+    }
+
+    /// Allocates a copy of `values`.
+    pub fn alloc_copy<T: Copy>(&self, values: &[T]) -> &'s mut [T] {
+        let bytes = mem::size_of::<T>().checked_mul(values.len()).unwrap();
+        let ptr = self
+            .arena
+            .alloc_bytes(self.depth, bytes, mem::align_of::<T>()) as *mut T;
+        unsafe {
+            ptr::copy_nonoverlapping(values.as_ptr(), ptr, values.len());
+            std::slice::from_raw_parts_mut(ptr, values.len())
+        }
+    }
+}
+
+thread_local! {
+    static SCRATCH: Arena = Arena::new();
+}
+
+/// Runs `f` with a scope of the calling thread's scratch arena.
+pub fn with_scratch<R, F>(f: F) -> R
+where
+    F: for<'s> FnOnce(&'s Scope<'s>) -> R,
+{
+    SCRATCH.with(|arena| arena.scope(f))
+}
+
+/// The calling thread's scratch arena peak, see `Arena::peak()`.
+pub fn scratch_peak() -> usize {
+    SCRATCH.with(|arena| arena.peak())
+}
+
+pub fn reset_scratch_peak() {
+    SCRATCH.with(|arena| arena.reset_peak())
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_arena_scopes() {
+        let arena = Arena::new();
+        let capacity = arena.scope(|s| {
+            let a = s.alloc(100, 1u8);
+            let b = s.alloc_copy(&[7u64, 8, 9]);
+            assert_eq!(b.as_ptr() as usize % mem::align_of::<u64>(), 0);
+
+            // A nested scope allocates past, and releases back to, the outer
+            // scope's allocations.
+            let inner = arena.scope(|s| {
+                let c = s.alloc(10, 0xffu8);
+                c.as_ptr() as usize
+            });
+            assert!(inner >= b.as_ptr() as usize + 24);
+            let c = s.alloc(10, 2u8);
+            assert_eq!(c.as_ptr() as usize, inner);
+
+            assert!(a.iter().all(|&x| x == 1));
+            assert_eq!(b, &[7, 8, 9]);
+            assert_eq!(arena.peak(), 100 + 24 + 10);
+            arena.capacity()
+        });
+        assert_eq!(capacity, CHUNK_LEN);
+
+        // Everything was released, and the chunk is reused.
+        arena.reset_peak();
+        assert_eq!(arena.peak(), 0);
+        arena.scope(|s| {
+            s.alloc(CHUNK_LEN, 0u8);
+        });
+        assert_eq!(arena.capacity(), CHUNK_LEN);
+    }
+
+    #[test]
+    fn test_arena_large_and_overflowing() {
+        let arena = Arena::new();
+        arena.scope(|s| {
+            let small = s.alloc(CHUNK_LEN - 8, 1u8);
+            // Doesn't fit in the first chunk, nor in a regular one.
+            let large = s.alloc(3 * CHUNK_LEN, 2u8);
+            let more = s.alloc(16, 3u8);
+            assert!(small.iter().all(|&x| x == 1));
+            assert!(large.iter().all(|&x| x == 2));
+            assert!(more.iter().all(|&x| x == 3));
+        });
+        let capacity = arena.capacity();
+        assert_eq!(capacity, CHUNK_LEN + 3 * CHUNK_LEN + CHUNK_LEN);
+
+        // The same sequence again reuses the chunks.
+        arena.scope(|s| {
+            s.alloc(CHUNK_LEN - 8, 1u8);
+            s.alloc(3 * CHUNK_LEN, 2u8);
+            s.alloc(16, 3u8);
+        });
+        assert_eq!(arena.capacity(), capacity);
+    }
+
+    #[test]
+    #[should_panic(expected = "while a nested scope is open")]
+    fn test_arena_outer_scope_cant_allocate_in_nested_scope() {
+        // Otherwise `x` would be released when the nested scope is left, and
+        // handed out again as `y`.
+        let arena = Arena::new();
+        arena.scope(|outer| {
+            let x = arena.scope(|_inner| outer.alloc(8, 1u8));
+            let y = outer.alloc(8, 2u8);
+            assert_ne!(x.as_ptr(), y.as_ptr());
+        });
+    }
+
+    #[test]
+    fn test_arena_nested_scope_panic_restores() {
+        let arena = Arena::new();
+        arena.scope(|outer| {
+            let a = outer.alloc(8, 1u8);
+            let result = std::panic::catch_unwind(std::panic::AssertUnwindSafe(|| {
+                arena.scope(|_inner| outer.alloc(8, 2u8).len())
+            }));
+            assert!(result.is_err());
+            // The outer scope allocates again once the nested one is gone.
+            let b = outer.alloc(8, 3u8);
+            assert_eq!(b.as_ptr() as usize, a.as_ptr() as usize + 8);
+            assert_eq!(a, &[1; 8]);
+        });
+    }
+
+    #[test]
+    fn test_scratch_is_per_thread() {
+        with_scratch(|s| {
+            s.alloc(1000, 0u8);
+        });
+        assert!(scratch_peak() >= 1000);
+        std::thread::spawn(|| assert_eq!(scratch_peak(), 0))
+            .join()
+            .unwrap();
+    }
+}
@@ -19,3 +19,4 @@ pub mod constant;
 pub mod bigint;
 
 pub mod montgomery;
+pub mod safegcd;
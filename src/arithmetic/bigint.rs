@@ -1124,6 +1124,295 @@ pub fn elem_verify_equal_consttime<M, E>(a: &Elem<M, E>, b: &Elem<M, E>) -> Resu
     }
 }
 
+/// The number of limbs in a fixed-width modulus of the given size. These are
+/// the usual choices for the `N` parameter of `FixedModulus` and `FixedElem`.
+pub const LIMBS_256: usize = 256 / LIMB_BITS;
+pub const LIMBS_384: usize = 384 / LIMB_BITS;
+pub const LIMBS_2048: usize = 2048 / LIMB_BITS;
+pub const LIMBS_3072: usize = 3072 / LIMB_BITS;
+pub const LIMBS_4096: usize = 4096 / LIMB_BITS;
+
+/// A modulus whose width of `N` limbs is known at compile time, e.g. a 2048,
+/// 3072 or 4096-bit RSA modulus or a 256 or 384-bit group order.
+///
+/// The modulus and its elements are plain arrays, so unlike with `Modulus`
+/// none of the arithmetic below touches the heap. `Modulus` remains the type
+/// to use when the width is only known at runtime.
+pub struct FixedModulus<M, const N: usize> {
+    limbs: [Limb; N],
+    n0: N0,
+    oneRR: [Limb; N],
+    m: PhantomData<M>,
+}
+
+impl<M, const N: usize> FixedModulus<M, N> {
+    /// Copies `m` along with its precomputed Montgomery constants. Fails if
+    /// `m` isn't exactly `N` limbs wide.
+    pub fn from_modulus(m: &Modulus<M>) -> Result<Self> {
+        if m.limbs.len() != N {
+            return Err(Error::from(ErrorKind::CryptoError));
+        }
+        let mut limbs = [0; N];
+        limbs.copy_from_slice(&m.limbs);
+        let mut oneRR = [0; N];
+        oneRR.copy_from_slice(&m.oneRR.0.limbs);
+        Ok(Self {
+            limbs,
+            n0: m.n0.clone(),
+            oneRR,
+            m: PhantomData,
+        })
+    }
+
+    pub fn from_be_bytes_with_bit_length(
+        input: untrusted::Input,
+    ) -> Result<(Self, bits::BitLength)> {
+        let (m, bits) = Modulus::from_be_bytes_with_bit_length(input)?;
+        Ok((Self::from_modulus(&m)?, bits))
+    }
+
+    fn zero<E>(&self) -> FixedElem<M, E, N> {
+        FixedElem {
+            limbs: [0; N],
+            encoding: PhantomData,
+        }
+    }
+
+    pub fn oneRR(&self) -> FixedElem<M, RR, N> {
+        FixedElem {
+            limbs: self.oneRR,
+            encoding: PhantomData,
+        }
+    }
+}
+
+/// Elements of ℤ/mℤ for a `FixedModulus<M, N>`; see `Elem`.
+pub struct FixedElem<M, E, const N: usize> {
+    limbs: [Limb; N],
+
+    /// The modulus *m* and the number of Montgomery factors that need to be
+    /// canceled out from `value` to get the actual value.
+    encoding: PhantomData<(M, E)>,
+}
+
+impl<M, E, const N: usize> Clone for FixedElem<M, E, N> {
+    fn clone(&self) -> Self {
+        *self
+    }
+}
+
+impl<M, E, const N: usize> Copy for FixedElem<M, E, N> {}
+
+impl<M, E, const N: usize> FixedElem<M, E, N> {
+    /// Copies a boxed element of the same modulus. Fails if `a` isn't
+    /// exactly `N` limbs wide.
+    pub fn from_elem(a: &Elem<M, E>) -> Result<Self> {
+        if a.limbs.len() != N {
+            return Err(Error::from(ErrorKind::CryptoError));
+        }
+        let mut limbs = [0; N];
+        limbs.copy_from_slice(&a.limbs);
+        Ok(Self {
+            limbs,
+            encoding: PhantomData,
+        })
+    }
+
+    #[inline]
+    pub fn is_zero(&self) -> bool {
+        limb::limbs_are_zero_constant_time(&self.limbs) == LimbMask::True
+    }
+}
+
+impl<M, E: ReductionEncoding, const N: usize> FixedElem<M, E, N> {
+    fn decode_once(
+        mut self,
+        m: &FixedModulus<M, N>,
+    ) -> FixedElem<M, <E as ReductionEncoding>::Output, N> {
+        // See `Elem::decode_once`.
+        let mut one = [0; N];
+        one[0] = 1;
+        limbs_mont_mul(&mut self.limbs, &one, &m.limbs, &m.n0);
+        FixedElem {
+            limbs: self.limbs,
+            encoding: PhantomData,
+        }
+    }
+}
+
+impl<M, const N: usize> FixedElem<M, R, N> {
+    #[inline]
+    pub fn into_unencoded(self, m: &FixedModulus<M, N>) -> FixedElem<M, Unencoded, N> {
+        self.decode_once(m)
+    }
+}
+
+impl<M, const N: usize> FixedElem<M, Unencoded, N> {
+    pub fn from_be_bytes_padded(input: untrusted::Input, m: &FixedModulus<M, N>) -> Result<Self> {
+        let mut r = m.zero();
+        limb::parse_big_endian_and_pad_consttime(input, &mut r.limbs)?;
+        if limb::limbs_less_than_limbs_consttime(&r.limbs, &m.limbs) != LimbMask::True {
+            return Err(Error::from(ErrorKind::CryptoError));
+        }
+        Ok(r)
+    }
+
+    #[inline]
+    pub fn fill_be_bytes(&self, out: &mut [u8]) {
+        limb::big_endian_from_limbs(&self.limbs, out)
+    }
+
+    fn is_one(&self) -> bool {
+        limb::limbs_equal_limb_constant_time(&self.limbs, 1) == LimbMask::True
+    }
+}
+
+pub fn fixed_elem_mul<M, AF, BF, const N: usize>(
+    a: &FixedElem<M, AF, N>,
+    mut b: FixedElem<M, BF, N>,
+    m: &FixedModulus<M, N>,
+) -> FixedElem<M, <(AF, BF) as ProductEncoding>::Output, N>
+where
+    (AF, BF): ProductEncoding,
+{
+    limbs_mont_mul(&mut b.limbs, &a.limbs, &m.limbs, &m.n0);
+    FixedElem {
+        limbs: b.limbs,
+        encoding: PhantomData,
+    }
+}
+
+pub fn fixed_elem_squared<M, E, const N: usize>(
+    mut a: FixedElem<M, E, N>,
+    m: &FixedModulus<M, N>,
+) -> FixedElem<M, <(E, E) as ProductEncoding>::Output, N>
+where
+    (E, E): ProductEncoding,
+{
+    limbs_mont_square(&mut a.limbs, &m.limbs, &m.n0);
+    FixedElem {
+        limbs: a.limbs,
+        encoding: PhantomData,
+    }
+}
+
+/// Calculates base**exponent (mod m); see `elem_exp_vartime`.
+pub fn fixed_elem_exp_vartime<M, const N: usize>(
+    base: FixedElem<M, Unencoded, N>,
+    PublicExponent(exponent): PublicExponent,
+    m: &FixedModulus<M, N>,
+) -> FixedElem<M, R, N> {
+    let base = fixed_elem_mul(&m.oneRR(), base, m);
+    assert!(exponent >= 1);
+    assert!(exponent <= PUBLIC_EXPONENT_MAX_VALUE);
+    let mut acc = base;
+    let mut bit = 1 << (64 - 1 - exponent.leading_zeros());
+    debug_assert!((exponent & bit) != 0);
+    while bit > 1 {
+        bit >>= 1;
+        acc = fixed_elem_squared(acc, m);
+        if (exponent & bit) != 0 {
+            acc = fixed_elem_mul(&base, acc, m);
+        }
+    }
+    acc
+}
+
+/// Calculates base**exponent (mod m) in constant time, using the same 5-bit
+/// fixed windows as `elem_exp_consttime`. The window table lives on the
+/// stack: 32 * `N` limbs, i.e. 16KiB for a 4096-bit modulus.
+pub fn fixed_elem_exp_consttime<M, const N: usize>(
+    base: FixedElem<M, R, N>,
+    exponent: &PrivateExponent<M>,
+    m: &FixedModulus<M, N>,
+) -> Result<FixedElem<M, Unencoded, N>> {
+    use crate::limb::Window;
+
+    const WINDOW_BITS: usize = 5;
+    const TABLE_ENTRIES: usize = 1 << WINDOW_BITS;
+
+    if exponent.limbs.len() != N {
+        return Err(Error::from(ErrorKind::CryptoError));
+    }
+
+    // Reads every entry so that the memory access pattern doesn't depend on
+    // the window.
+    fn gather<const N: usize>(table: &[[Limb; N]; TABLE_ENTRIES], i: Window) -> [Limb; N] {
+        let mut r = [0; N];
+        for (j, entry) in table.iter().enumerate() {
+            let mask = limb_is_zero_mask((j as Window) ^ i);
+            for (r, e) in r.iter_mut().zip(entry.iter()) {
+                *r |= e & mask;
+            }
+        }
+        r
+    }
+
+    let mut table = [[0; N]; TABLE_ENTRIES];
+    table[0][0] = 1;
+    limbs_mont_mul(&mut table[0], &m.oneRR, &m.limbs, &m.n0);
+    table[1] = base.limbs;
+    for i in 2..TABLE_ENTRIES {
+        let (src1, src2) = if i % 2 == 0 {
+            (i / 2, i / 2)
+        } else {
+            (i - 1, 1)
+        };
+        let mut t = table[src1];
+        limbs_mont_mul(&mut t, &table[src2], &m.limbs, &m.n0);
+        table[i] = t;
+    }
+
+    let acc = limb::fold_5_bit_windows(
+        &exponent.limbs,
+        |initial_window| gather(&table, initial_window),
+        |mut acc, window| {
+            for _ in 0..WINDOW_BITS {
+                limbs_mont_square(&mut acc, &m.limbs, &m.n0);
+            }
+            limbs_mont_mul(&mut acc, &gather(&table, window), &m.limbs, &m.n0);
+            acc
+        },
+    );
+
+    let r: FixedElem<M, R, N> = FixedElem {
+        limbs: acc,
+        encoding: PhantomData,
+    };
+    Ok(r.into_unencoded(m))
+}
+
+/// Returns all ones if `a == 0` and zero otherwise, without branching.
+#[inline]
+fn limb_is_zero_mask(a: Limb) -> Limb {
+    ((!a & a.wrapping_sub(1)) >> (LIMB_BITS - 1)).wrapping_neg()
+}
+
+/// Verified a == b**-1 (mod m); see `verify_inverses_consttime`.
+pub fn fixed_verify_inverses_consttime<M, const N: usize>(
+    a: &FixedElem<M, R, N>,
+    b: FixedElem<M, Unencoded, N>,
+    m: &FixedModulus<M, N>,
+) -> Result<()> {
+    if fixed_elem_mul(a, b, m).is_one() {
+        Ok(())
+    } else {
+        return Err(Error::from(ErrorKind::CryptoError));
+    }
+}
+
+#[inline]
+pub fn fixed_elem_verify_equal_consttime<M, E, const N: usize>(
+    a: &FixedElem<M, E, N>,
+    b: &FixedElem<M, E, N>,
+) -> Result<()> {
+    if limb::limbs_equal_limbs_consttime(&a.limbs, &b.limbs) == LimbMask::True {
+        Ok(())
+    } else {
+        return Err(Error::from(ErrorKind::CryptoError));
+    }
+}
+
 /// Nonnegative integers.
 pub struct Nonnegative {
     limbs: Vec<Limb>,
@@ -1419,6 +1708,141 @@ mod tests {
         assert_eq!("PublicExponent(65537)", format!("{:?}", exponent));
     }
 
+    // Calls `$f::<N>` when `$num_limbs` is one of the fixed widths below and
+    // skips the test vector otherwise.
+    macro_rules! with_fixed_width {
+        ( $num_limbs:expr, $f:ident ( $( $arg:expr ),* ) ) => {
+            match $num_limbs {
+                n if n == LIMBS_256 => $f::<LIMBS_256>($( $arg ),*),
+                n if n == LIMBS_384 => $f::<LIMBS_384>($( $arg ),*),
+                n if n == 512 / LIMB_BITS => $f::<{ 512 / LIMB_BITS }>($( $arg ),*),
+                n if n == 1024 / LIMB_BITS => $f::<{ 1024 / LIMB_BITS }>($( $arg ),*),
+                n if n == LIMBS_2048 => $f::<LIMBS_2048>($( $arg ),*),
+                n if n == LIMBS_3072 => $f::<LIMBS_3072>($( $arg ),*),
+                n if n == LIMBS_4096 => $f::<LIMBS_4096>($( $arg ),*),
+                _ => (),
+            }
+        };
+    }
+
+    fn fixed<M, E, const N: usize>(a: &Elem<M, E>) -> FixedElem<M, E, N> {
+        FixedElem::from_elem(a).unwrap()
+    }
+
+    fn assert_fixed_elem_eq<M, E, const N: usize>(a: &FixedElem<M, E, N>, b: &Elem<M, E>) {
+        fixed_elem_verify_equal_consttime(a, &fixed(b)).unwrap()
+    }
+
+    #[test]
+    fn test_fixed_elem_exp_consttime() {
+        fn check<const N: usize>(
+            m: &Modulus<M>,
+            base: &Elem<M, R>,
+            e: &PrivateExponent<M>,
+            expected: &Elem<M, Unencoded>,
+        ) {
+            let fm = FixedModulus::<M, N>::from_modulus(m).unwrap();
+            let actual = fixed_elem_exp_consttime(fixed(base), e, &fm).unwrap();
+            assert_fixed_elem_eq(&actual, expected);
+        }
+
+        test::run(
+            test_file!("bigint_elem_exp_consttime_tests.txt"),
+            |section, test_case| {
+                assert_eq!(section, "");
+
+                let m = consume_modulus::<M>(test_case, "M");
+                let expected_result = consume_elem(test_case, "ModExp", &m);
+                let base = consume_elem(test_case, "A", &m);
+                let e = {
+                    let bytes = test_case.consume_bytes("E");
+                    PrivateExponent::from_be_bytes_padded(untrusted::Input::from(&bytes), &m)
+                        .expect("valid exponent")
+                };
+                let base = into_encoded(base, &m);
+                with_fixed_width!(m.limbs.len(), check(&m, &base, &e, &expected_result));
+
+                Ok(())
+            },
+        )
+    }
+
+    #[test]
+    fn test_fixed_elem_mul() {
+        fn check<const N: usize>(
+            m: &Modulus<M>,
+            a: &Elem<M, R>,
+            b: &Elem<M, R>,
+            expected: &Elem<M, Unencoded>,
+        ) {
+            let fm = FixedModulus::<M, N>::from_modulus(m).unwrap();
+            let actual = fixed_elem_mul(&fixed(a), fixed(b), &fm).into_unencoded(&fm);
+            assert_fixed_elem_eq(&actual, expected);
+        }
+
+        test::run(
+            test_file!("bigint_elem_mul_tests.txt"),
+            |section, test_case| {
+                assert_eq!(section, "");
+
+                let m = consume_modulus::<M>(test_case, "M");
+                let expected_result = consume_elem(test_case, "ModMul", &m);
+                let a = consume_elem(test_case, "A", &m);
+                let b = consume_elem(test_case, "B", &m);
+
+                let a = into_encoded(a, &m);
+                let b = into_encoded(b, &m);
+                with_fixed_width!(m.limbs.len(), check(&m, &a, &b, &expected_result));
+
+                Ok(())
+            },
+        )
+    }
+
+    #[test]
+    fn test_fixed_elem_squared_and_exp_vartime() {
+        fn check<const N: usize>(
+            m: &Modulus<M>,
+            a: &Elem<M, Unencoded>,
+            expected: &Elem<M, Unencoded>,
+        ) {
+            let fm = FixedModulus::<M, N>::from_modulus(m).unwrap();
+            let fa = fixed(a);
+            let actual = fixed_elem_squared(fixed_elem_mul(&fm.oneRR(), fa, &fm), &fm);
+            assert_fixed_elem_eq(&actual.into_unencoded(&fm), expected);
+
+            // There are no fixed-width vectors for `elem_exp_vartime`, so
+            // compare against the boxed implementation.
+            let e = PublicExponent::from_be_bytes(untrusted::Input::from(&[0x1, 0x00, 0x01]), 3)
+                .unwrap();
+            let boxed = elem_exp_vartime(a.clone(), e, m).into_unencoded(m);
+            let actual = fixed_elem_exp_vartime(fa, e, &fm).into_unencoded(&fm);
+            assert_fixed_elem_eq(&actual, &boxed);
+        }
+
+        test::run(
+            test_file!("bigint_elem_squared_tests.txt"),
+            |section, test_case| {
+                assert_eq!(section, "");
+
+                let m = consume_modulus::<M>(test_case, "M");
+                let expected_result = consume_elem(test_case, "ModSquare", &m);
+                let a = consume_elem(test_case, "A", &m);
+                with_fixed_width!(m.limbs.len(), check(&m, &a, &expected_result));
+
+                Ok(())
+            },
+        )
+    }
+
+    #[test]
+    fn test_fixed_modulus_width() {
+        let bytes = vec![0xff; LIMB_BYTES * LIMBS_256];
+        let input = untrusted::Input::from(&bytes);
+        assert!(FixedModulus::<M, LIMBS_256>::from_be_bytes_with_bit_length(input).is_ok());
+        assert!(FixedModulus::<M, LIMBS_384>::from_be_bytes_with_bit_length(input).is_err());
+    }
+
     fn consume_elem<M>(
         test_case: &mut test::TestCase,
         name: &str,
@@ -1467,3 +1891,78 @@ mod tests {
         elem_mul(m.oneRR().as_ref(), a, m)
     }
 }
+
+#[cfg(feature = "internal_benches")]
+mod internal_benches {
+    use super::*;
+    extern crate test;
+
+    struct M {}
+
+    // The timings don't depend on the values beyond their widths, as long as
+    // the modulus is odd and the private exponent is odd and less than it.
+    fn setup<const N: usize>() -> (Modulus<M>, FixedModulus<M, N>, PrivateExponent<M>) {
+        let (m, _) = Modulus::from_be_bytes_with_bit_length(untrusted::Input::from(
+            &vec![0xff; N * LIMB_BYTES],
+        ))
+        .unwrap();
+        let fm = FixedModulus::from_modulus(&m).unwrap();
+        let mut e = vec![0xa5; N * LIMB_BYTES];
+        e[0] = 0x7f;
+        let e = PrivateExponent::from_be_bytes_padded(untrusted::Input::from(&e), &m).unwrap();
+        (m, fm, e)
+    }
+
+    fn base<const N: usize>(m: &Modulus<M>) -> Elem<M, Unencoded> {
+        Elem::from_be_bytes_padded(untrusted::Input::from(&vec![0x5a; N * LIMB_BYTES]), m)
+            .unwrap()
+    }
+
+    fn e_65537() -> PublicExponent {
+        PublicExponent::from_be_bytes(untrusted::Input::from(&[0x1, 0x00, 0x01]), 3).unwrap()
+    }
+
+    macro_rules! bench_width {
+        ( $name:ident, $n:expr ) => {
+            mod $name {
+                use super::*;
+
+                #[bench]
+                fn boxed_exp_consttime(bench: &mut test::Bencher) {
+                    let (m, _, e) = setup::<{ $n }>();
+                    let a = elem_mul(m.oneRR().as_ref(), base::<{ $n }>(&m), &m);
+                    bench.iter(|| elem_exp_consttime(a.clone(), &e, &m).unwrap());
+                }
+
+                #[bench]
+                fn fixed_exp_consttime(bench: &mut test::Bencher) {
+                    let (m, fm, e) = setup::<{ $n }>();
+                    let a = elem_mul(m.oneRR().as_ref(), base::<{ $n }>(&m), &m);
+                    let a: FixedElem<M, R, { $n }> = FixedElem::from_elem(&a).unwrap();
+                    bench.iter(|| fixed_elem_exp_consttime(a, &e, &fm).unwrap());
+                }
+
+                #[bench]
+                fn boxed_exp_vartime_65537(bench: &mut test::Bencher) {
+                    let (m, _, _) = setup::<{ $n }>();
+                    let a = base::<{ $n }>(&m);
+                    bench.iter(|| elem_exp_vartime(a.clone(), e_65537(), &m));
+                }
+
+                #[bench]
+                fn fixed_exp_vartime_65537(bench: &mut test::Bencher) {
+                    let (m, fm, _) = setup::<{ $n }>();
+                    let a: FixedElem<M, Unencoded, { $n }> =
+                        FixedElem::from_elem(&base::<{ $n }>(&m)).unwrap();
+                    bench.iter(|| fixed_elem_exp_vartime(a, e_65537(), &fm));
+                }
+            }
+        };
+    }
+
+    bench_width!(w256, LIMBS_256);
+    bench_width!(w384, LIMBS_384);
+    bench_width!(w2048, LIMBS_2048);
+    bench_width!(w3072, LIMBS_3072);
+    bench_width!(w4096, LIMBS_4096);
+}
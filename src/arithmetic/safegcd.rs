@@ -0,0 +1,439 @@
+//! Constant-time modular inversion using the "safegcd" divstep algorithm of
+//! Bernstein and Yang, "Fast constant-time gcd computation and modular
+//! inversion" (https://eprint.iacr.org/2019/266).
+//!
+//! Divsteps are applied in batches of 62 to the low 64 bits of *f* and *g*,
+//! and each batch's 2x2 transition matrix is then applied to the full-width
+//! values, the same way libsecp256k1's `modinv64` works. Numbers are kept in
+//! a signed radix-2**62 representation so that the matrix products fit in
+//! `i128`. The number of batches only depends on the bit length of the
+//! modulus, so the running time doesn't depend on the input.
+
+use crate::limb::{Limb, LIMB_BITS};
+
+const M62: u64 = u64::max_value() >> 2;
+
+/// Sets `r` to `a`**-1 (mod `m`), in constant time. `m` must be odd, `a` must
+/// be less than `m`, and all three must have the same number of limbs. The
+/// inverse of zero is zero, like it is when computed with Fermat's little
+/// theorem.
+///
+/// Only 256-bit and 384-bit moduli are supported.
+pub fn limbs_inverse_consttime(r: &mut [Limb], a: &[Limb], m: &[Limb]) {
+    assert_eq!(r.len(), m.len());
+    assert_eq!(a.len(), m.len());
+    assert_eq!(m[0] & 1, 1);
+    match m.len() * LIMB_BITS {
+        256 => inverse::<Limb, 5>(r, a, m),
+        384 => inverse::<Limb, 7>(r, a, m),
+        bits => panic!("unsupported modulus size: {} bits", bits),
+    }
+}
+
+/// A limb of the input and output. `inverse` is generic over it so that the
+/// 32-bit conversions are tested on 64-bit targets too.
+trait Word: Copy {
+    const BITS: usize;
+    fn to_u128(self) -> u128;
+    fn from_u128(x: u128) -> Self;
+}
+
+impl Word for u32 {
+    const BITS: usize = 32;
+    fn to_u128(self) -> u128 {
+        u128::from(self)
+    }
+    fn from_u128(x: u128) -> Self {
+        x as u32
+    }
+}
+
+impl Word for u64 {
+    const BITS: usize = 64;
+    fn to_u128(self) -> u128 {
+        u128::from(self)
+    }
+    fn from_u128(x: u128) -> Self {
+        x as u64
+    }
+}
+
+/// A number in signed radix 2**62: every limb but the last is in [0, 2**62)
+/// once normalized, and the last one carries the sign. `L * 62` must leave
+/// room for two more bits than the modulus has.
+#[derive(Clone, Copy)]
+struct Signed62<const L: usize>([i64; L]);
+
+impl<const L: usize> Signed62<L> {
+    fn from_limbs<W: Word>(a: &[W]) -> Self {
+        let mut r = [0i64; L];
+        let mut acc: u128 = 0;
+        let mut acc_bits = 0;
+        let mut i = 0;
+        for &limb in a {
+            acc |= limb.to_u128() << acc_bits;
+            acc_bits += W::BITS;
+            while acc_bits >= 62 {
+                r[i] = (acc as u64 & M62) as i64;
+                i += 1;
+                acc >>= 62;
+                acc_bits -= 62;
+            }
+        }
+        if acc_bits > 0 {
+            r[i] = acc as i64;
+        }
+        Signed62(r)
+    }
+
+    // `self` must be normalized and non-negative.
+    fn fill_limbs<W: Word>(&self, r: &mut [W]) {
+        let mut acc: u128 = 0;
+        let mut acc_bits = 0;
+        let mut limbs = self.0.iter();
+        for r in r.iter_mut() {
+            while acc_bits < W::BITS {
+                let limb = limbs.next().map_or(0, |&limb| limb as u64);
+                acc |= u128::from(limb) << acc_bits;
+                acc_bits += 62;
+            }
+            *r = W::from_u128(acc);
+            acc >>= W::BITS;
+            acc_bits -= W::BITS;
+        }
+    }
+}
+
+/// The 2x2 matrix [[u, v], [q, r]] that a batch of 62 divsteps applies to
+/// [f, g], scaled by 2**62.
+struct Transition {
+    u: i64,
+    v: i64,
+    q: i64,
+    r: i64,
+}
+
+/// Applies 62 divsteps to the low bits `f` and `g` of *f* and *g*, starting
+/// at `eta` == -delta. Returns the new `eta` and the transition matrix.
+fn divsteps_62(mut eta: i64, mut f: u64, mut g: u64) -> (i64, Transition) {
+    // Each step keeps f * 2**i == u*f0 + v*g0 and g * 2**i == q*f0 + r*g0.
+    let (mut u, mut v, mut q, mut r) = (1u64, 0u64, 0u64, 1u64);
+    for _ in 0..62 {
+        // c1 is all ones if delta > 0, and c2 is all ones if g is odd.
+        let c1 = (eta >> 63) as u64;
+        let c2 = (g & 1).wrapping_neg();
+
+        // If g is odd, add f to g, or subtract it if delta > 0.
+        let x = (f ^ c1).wrapping_sub(c1);
+        let y = (u ^ c1).wrapping_sub(c1);
+        let z = (v ^ c1).wrapping_sub(c1);
+        g = g.wrapping_add(x & c2);
+        q = q.wrapping_add(y & c2);
+        r = r.wrapping_add(z & c2);
+
+        // If both, swap: delta = 1 - delta and f = g (g - f was just computed
+        // above, so adding it to f yields the old g). Otherwise delta += 1.
+        let c1 = c1 & c2;
+        eta = (eta ^ c1 as i64).wrapping_sub(c1 as i64 + 1);
+        f = f.wrapping_add(g & c1);
+        u = u.wrapping_add(q & c1);
+        v = v.wrapping_add(r & c1);
+
+        g >>= 1;
+        u <<= 1;
+        v <<= 1;
+    }
+    (
+        eta,
+        Transition {
+            u: u as i64,
+            v: v as i64,
+            q: q as i64,
+            r: r as i64,
+        },
+    )
+}
+
+/// Replaces `f` and `g` with `t` * [f, g] / 2**62. The division is exact.
+fn update_fg<const L: usize>(f: &mut Signed62<L>, g: &mut Signed62<L>, t: &Transition) {
+    let (u, v, q, r) = (
+        i128::from(t.u),
+        i128::from(t.v),
+        i128::from(t.q),
+        i128::from(t.r),
+    );
+    let mut cf = u * i128::from(f.0[0]) + v * i128::from(g.0[0]);
+    let mut cg = q * i128::from(f.0[0]) + r * i128::from(g.0[0]);
+    debug_assert_eq!(cf as u64 & M62, 0);
+    debug_assert_eq!(cg as u64 & M62, 0);
+    cf >>= 62;
+    cg >>= 62;
+    for i in 1..L {
+        cf += u * i128::from(f.0[i]) + v * i128::from(g.0[i]);
+        cg += q * i128::from(f.0[i]) + r * i128::from(g.0[i]);
+        f.0[i - 1] = (cf as u64 & M62) as i64;
+        g.0[i - 1] = (cg as u64 & M62) as i64;
+        cf >>= 62;
+        cg >>= 62;
+    }
+    f.0[L - 1] = cf as i64;
+    g.0[L - 1] = cg as i64;
+}
+
+/// Replaces `d` and `e` with `t` * [d, e] / 2**62 (mod `m`), adding the
+/// multiples of `m` that make the division exact. Both stay in (-2m, m).
+fn update_de<const L: usize>(
+    d: &mut Signed62<L>,
+    e: &mut Signed62<L>,
+    t: &Transition,
+    m: &Signed62<L>,
+    m_inv62: u64,
+) {
+    // Start with [u, q] if d is negative plus [v, r] if e is negative, which
+    // keeps the results within range.
+    let sd = d.0[L - 1] >> 63;
+    let se = e.0[L - 1] >> 63;
+    let mut md = (t.u & sd) + (t.v & se);
+    let mut me = (t.q & sd) + (t.r & se);
+
+    let (u, v, q, r) = (
+        i128::from(t.u),
+        i128::from(t.v),
+        i128::from(t.q),
+        i128::from(t.r),
+    );
+    let mut cd = u * i128::from(d.0[0]) + v * i128::from(e.0[0]);
+    let mut ce = q * i128::from(d.0[0]) + r * i128::from(e.0[0]);
+
+    // Choose md and me so the bottom 62 bits of t*[d, e] + m*[md, me] are zero.
+    md -= (m_inv62.wrapping_mul(cd as u64).wrapping_add(md as u64) & M62) as i64;
+    me -= (m_inv62.wrapping_mul(ce as u64).wrapping_add(me as u64) & M62) as i64;
+    let (md, me) = (i128::from(md), i128::from(me));
+
+    cd += i128::from(m.0[0]) * md;
+    ce += i128::from(m.0[0]) * me;
+    debug_assert_eq!(cd as u64 & M62, 0);
+    debug_assert_eq!(ce as u64 & M62, 0);
+    cd >>= 62;
+    ce >>= 62;
+    for i in 1..L {
+        cd += u * i128::from(d.0[i]) + v * i128::from(e.0[i]) + i128::from(m.0[i]) * md;
+        ce += q * i128::from(d.0[i]) + r * i128::from(e.0[i]) + i128::from(m.0[i]) * me;
+        d.0[i - 1] = (cd as u64 & M62) as i64;
+        e.0[i - 1] = (ce as u64 & M62) as i64;
+        cd >>= 62;
+        ce >>= 62;
+    }
+    d.0[L - 1] = cd as i64;
+    e.0[L - 1] = ce as i64;
+}
+
+/// Maps `a` in (-2m, m) to `a` * sign(`sign`) in [0, m).
+fn normalize<const L: usize>(a: &mut Signed62<L>, sign: i64, m: &Signed62<L>) {
+    fn add_if<const L: usize>(a: &mut Signed62<L>, m: &Signed62<L>) {
+        let mask = a.0[L - 1] >> 63;
+        for i in 0..L {
+            a.0[i] += m.0[i] & mask;
+        }
+    }
+
+    fn carry<const L: usize>(a: &mut Signed62<L>) {
+        for i in 0..(L - 1) {
+            a.0[i + 1] += a.0[i] >> 62;
+            a.0[i] &= M62 as i64;
+        }
+    }
+
+    // (-2m, m) -> (-m, m), then negate if requested.
+    add_if(a, m);
+    let negate = sign >> 63;
+    for limb in a.0.iter_mut() {
+        *limb = (*limb ^ negate) - negate;
+    }
+    carry(a);
+
+    // (-m, m) -> [0, m).
+    add_if(a, m);
+    carry(a);
+}
+
+fn inverse<W: Word, const L: usize>(r: &mut [W], a: &[W], m: &[W]) {
+    debug_assert!(L * 62 >= m.len() * W::BITS + 2);
+
+    let modulus = Signed62::<L>::from_limbs(m);
+
+    // m**-1 (mod 2**62) by Newton's method; any odd m is its own inverse
+    // modulo 8, and every iteration doubles the number of correct bits. The
+    // low 62 bits come from `modulus`, as `m[0]` may only have 32.
+    let m0 = modulus.0[0] as u64;
+    let mut m_inv = m0;
+    for _ in 0..5 {
+        m_inv = m_inv.wrapping_mul(2u64.wrapping_sub(m0.wrapping_mul(m_inv)));
+    }
+    let m_inv62 = m_inv & M62;
+
+    // Bernstein and Yang's bound on the number of divsteps needed for inputs
+    // of `bits` bits (Theorem 11.2), rounded up to a multiple of 62.
+    let bits = m.len() * W::BITS;
+    let divsteps = (49 * bits + 57) / 17;
+    let batches = (divsteps + 61) / 62;
+
+    // Invariants: d*a == f and e*a == g (mod m), starting from f = m, g = a.
+    let mut d = Signed62::<L>([0; L]);
+    let mut e = Signed62::<L>([0; L]);
+    e.0[0] = 1;
+    let mut f = modulus;
+    let mut g = Signed62::<L>::from_limbs(a);
+    let mut eta = -1; // delta == 1.
+    for _ in 0..batches {
+        let (new_eta, t) = divsteps_62(eta, f.0[0] as u64, g.0[0] as u64);
+        eta = new_eta;
+        update_de(&mut d, &mut e, &t, &modulus, m_inv62);
+        update_fg(&mut f, &mut g, &t);
+    }
+
+    // Now g == 0 and f == ±gcd(m, a) == ±1, so ±d is the inverse.
+    normalize(&mut d, f.0[L - 1], &modulus);
+    d.fill_limbs(r);
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    // 2**(bits - 1) - c, e.g. the primes 2**255 - 19 and 2**383 - 187.
+    fn prime(bits: usize, c: Limb) -> [Limb; 384 / LIMB_BITS] {
+        let mut m = [Limb::max_value(); 384 / LIMB_BITS];
+        let num_limbs = bits / LIMB_BITS;
+        m[num_limbs - 1] >>= 1;
+        m[0] -= c - 1;
+        for limb in m[num_limbs..].iter_mut() {
+            *limb = 0;
+        }
+        m
+    }
+
+    // (a * b) mod m, by shifting and adding.
+    fn mul_mod(a: &[Limb], b: &[Limb], m: &[Limb]) -> [Limb; 384 / LIMB_BITS] {
+        let mut r = [0; 384 / LIMB_BITS];
+        let r = &mut r[..m.len()];
+        let add_mod = |r: &mut [Limb], x: &[Limb]| {
+            let mut carry = false;
+            for (r, &x) in r.iter_mut().zip(x) {
+                let (s, c1) = r.overflowing_add(x);
+                let (s, c2) = s.overflowing_add(carry as Limb);
+                *r = s;
+                carry = c1 || c2;
+            }
+            // Both were less than m < 2**(bits - 1), so no carry out.
+            assert!(!carry);
+            let ge = r.iter().rev().zip(m.iter().rev()).find(|(r, m)| r != m);
+            if ge.map_or(true, |(r, m)| r > m) {
+                let mut borrow = false;
+                for (r, &m) in r.iter_mut().zip(m) {
+                    let (s, b1) = r.overflowing_sub(m);
+                    let (s, b2) = s.overflowing_sub(borrow as Limb);
+                    *r = s;
+                    borrow = b1 || b2;
+                }
+            }
+        };
+        for i in (0..(m.len() * LIMB_BITS)).rev() {
+            let doubled = r.to_vec();
+            add_mod(r, &doubled);
+            if (b[i / LIMB_BITS] >> (i % LIMB_BITS)) & 1 == 1 {
+                add_mod(r, a);
+            }
+        }
+        let mut out = [0; 384 / LIMB_BITS];
+        out[..m.len()].copy_from_slice(r);
+        out
+    }
+
+    #[test]
+    fn test_limbs_inverse_consttime() {
+        for &(bits, c) in &[(256, 19), (384, 187)] {
+            let m = prime(bits, c);
+            let m = &m[..(bits / LIMB_BITS)];
+
+            let mut a = [0; 384 / LIMB_BITS];
+            let a = &mut a[..m.len()];
+            let mut inv = [0; 384 / LIMB_BITS];
+            let inv = &mut inv[..m.len()];
+
+            limbs_inverse_consttime(inv, a, m);
+            assert!(inv.iter().all(|&limb| limb == 0));
+
+            // Small values, m - 1, and a pseudo-random sequence.
+            let mut x: u64 = 1;
+            for i in 0..64 {
+                for (j, limb) in a.iter_mut().enumerate() {
+                    *limb = match i {
+                        0..=3 => (j == 0) as Limb * (i as Limb + 1),
+                        4 => m[j] - (j == 0) as Limb,
+                        _ => {
+                            x = x
+                                .wrapping_mul(6364136223846793005)
+                                .wrapping_add(1442695040888963407);
+                            (x >> 16) as Limb
+                        }
+                    };
+                }
+                let top = m.len() - 1;
+                a[top] &= m[top] >> 1;
+
+                limbs_inverse_consttime(inv, a, m);
+                let product = mul_mod(a, inv, m);
+                assert_eq!(product[0], 1);
+                assert!(product[1..m.len()].iter().all(|&limb| limb == 0));
+            }
+        }
+    }
+
+    // The same inverses through 32-bit limbs, as on 32-bit targets, where
+    // the low limb of the modulus doesn't hold the 62 bits Newton's method
+    // needs.
+    #[test]
+    fn test_inverse_32_bit_limbs() {
+        fn words(a: &[Limb]) -> Vec<u32> {
+            a.iter()
+                .flat_map(|&limb| (0..(LIMB_BITS / 32)).map(move |k| (limb >> (32 * k)) as u32))
+                .collect()
+        }
+
+        for &(bits, c) in &[(256, 19), (384, 187)] {
+            let m = prime(bits, c);
+            let m = &m[..(bits / LIMB_BITS)];
+            let mut x: Limb = 0x5a5a;
+            for _ in 0..16 {
+                let mut a = [0; 384 / LIMB_BITS];
+                let a = &mut a[..m.len()];
+                for limb in a.iter_mut() {
+                    x = x.wrapping_mul(0x9e37_79b9).wrapping_add(1);
+                    *limb = x;
+                }
+                let top = m.len() - 1;
+                a[top] &= m[top] >> 1;
+
+                let mut expected = [0; 384 / LIMB_BITS];
+                let expected = &mut expected[..m.len()];
+                limbs_inverse_consttime(expected, a, m);
+
+                let mut actual = vec![0u32; bits / 32];
+                match bits {
+                    256 => inverse::<u32, 5>(&mut actual, &words(a), &words(m)),
+                    _ => inverse::<u32, 7>(&mut actual, &words(a), &words(m)),
+                }
+                assert_eq!(actual, words(expected));
+            }
+        }
+    }
+
+    #[test]
+    #[should_panic(expected = "unsupported modulus size")]
+    fn test_limbs_inverse_consttime_unsupported_size() {
+        let m = [1; 512 / LIMB_BITS];
+        let mut r = [0; 512 / LIMB_BITS];
+        limbs_inverse_consttime(&mut r, &[0; 512 / LIMB_BITS], &m);
+    }
+}
@@ -0,0 +1,416 @@
+//! Timings of the crate's primitives, for tracking the cost of running them
+//! in an enclave.
+//!
+//! `run()` is meant to be called both from an enclave, which is how
+//! `sgx-test` exposes it, and from a native build, so that the two reports
+//! differ only in where the code ran. Each primitive is called once to warm
+//! up, then `Config::iterations` times under the clock. Inside an enclave the
+//! clock is the untrusted one, which is fine for timing, and is read only
+//! twice per primitive.
+//!
+//! Only built with the `benchmarks` feature, which also turns on `sgx_tstd`'s
+//! `untrusted_time`.
+
+use std::prelude::v1::*;
+
+use std::fmt::Write;
+use std::mem;
+use std::ptr;
+use std::time::{Duration, Instant};
+#[cfg(any(feature = "mesalock_sgx", target_env = "sgx"))]
+use std::untrusted::time::InstantEx;
+
+use crate::ec::suite_b::ops::{p256, p384, PrivateKeyOps, PublicKeyOps, ScalarOps};
+use crate::ec::suite_b::{ecies, ops, public_key};
+use crate::errors::{Error, ErrorKind, Result};
+use crate::hash::{hash, keccak};
+use crate::hdwallet::{rand as mnemonic, Language};
+use crate::limb::{AllowZero, LIMB_BYTES};
+use crate::sign::cache::VerificationCache;
+use crate::sign::ecdsa::{
+    EcdsaKeyPair, EcdsaSigningAlgorithm, EcdsaVerificationAlgorithm, KeyPair, UnparsedPublicKey,
+    ECDSA_P256_SHA256_ASN1, ECDSA_P256_SHA256_ASN1_SIGNING, ECDSA_P384_SHA384_ASN1,
+    ECDSA_P384_SHA384_ASN1_SIGNING,
+};
+
+pub struct Config<'a> {
+    /// Timed calls of each primitive.
+    pub iterations: usize,
+
+    /// The timed calls are split into this many samples, each timed on its
+    /// own. Latency percentiles are taken over the samples' mean latencies,
+    /// so that the clock is read twice per sample rather than per call.
+    pub samples: usize,
+
+    /// Payload sizes, in bytes, at which ECIES and the hashes are timed.
+    pub payload_sizes: &'a [usize],
+}
+
+impl<'a> Default for Config<'a> {
+    fn default() -> Self {
+        Self {
+            iterations: 100,
+            samples: 10,
+            payload_sizes: &[32, 1024, 16 * 1024],
+        }
+    }
+}
+
+/// The timing of one primitive, at one payload size if it takes a payload.
+#[derive(Clone, Debug)]
+pub struct Measurement {
+    pub name: String,
+    pub payload_len: Option<usize>,
+    pub iterations: usize,
+    pub elapsed: Duration,
+
+    /// The mean latency of a call in each sample, in nanoseconds, sorted.
+    pub sample_nanos: Vec<f64>,
+}
+
+impl Measurement {
+    pub fn nanos_per_op(&self) -> f64 {
+        self.elapsed.as_nanos() as f64 / self.iterations.max(1) as f64
+    }
+
+    pub fn ops_per_sec(&self) -> f64 {
+        self.iterations as f64 * 1e9 / self.elapsed.as_nanos().max(1) as f64
+    }
+
+    /// Payload bytes processed per second, for primitives that take one.
+    pub fn bytes_per_sec(&self) -> Option<f64> {
+        self.payload_len.map(|len| len as f64 * self.ops_per_sec())
+    }
+
+    /// The `p`th percentile (0 to 100) of the sample latencies, by nearest
+    /// rank, in nanoseconds.
+    pub fn percentile(&self, p: f64) -> f64 {
+        let n = self.sample_nanos.len();
+        if n == 0 {
+            return 0.0;
+        }
+        let rank = (p / 100.0 * n as f64).ceil() as usize;
+        self.sample_nanos[rank.max(1).min(n) - 1]
+    }
+}
+
+/// Keeps the optimizer from discarding a result that is never used.
+fn black_box<T>(value: T) -> T {
+    unsafe {
+        let result = ptr::read_volatile(&value);
+        mem::forget(value);
+        result
+    }
+}
+
+struct Bench<'c, 'a> {
+    config: &'c Config<'a>,
+    results: Vec<Measurement>,
+}
+
+impl Bench<'_, '_> {
+    fn measure<R>(
+        &mut self,
+        name: &str,
+        payload_len: Option<usize>,
+        mut f: impl FnMut() -> Result<R>,
+    ) -> Result<()> {
+        black_box(f()?);
+        let iterations = self.config.iterations;
+        let samples = self.config.samples.max(1).min(iterations.max(1));
+        let mut elapsed = Duration::default();
+        let mut sample_nanos = Vec::with_capacity(samples);
+        for i in 0..samples {
+            let calls = iterations / samples + if i < iterations % samples { 1 } else { 0 };
+            let start = Instant::now();
+            for _ in 0..calls {
+                black_box(f()?);
+            }
+            let sample = start.elapsed();
+            elapsed += sample;
+            sample_nanos.push(sample.as_nanos() as f64 / calls.max(1) as f64);
+        }
+        sample_nanos.sort_by(|a, b| a.partial_cmp(b).unwrap());
+        self.results.push(Measurement {
+            name: name.to_string(),
+            payload_len,
+            iterations,
+            elapsed,
+            sample_nanos,
+        });
+        Ok(())
+    }
+}
+
+struct Curve {
+    name: &'static str,
+    signing: &'static EcdsaSigningAlgorithm,
+    verification: &'static EcdsaVerificationAlgorithm,
+    private_key_ops: &'static PrivateKeyOps,
+    public_key_ops: &'static PublicKeyOps,
+    scalar_ops: &'static ScalarOps,
+}
+
+static CURVES: [Curve; 2] = [
+    Curve {
+        name: "p256",
+        signing: &ECDSA_P256_SHA256_ASN1_SIGNING,
+        verification: &ECDSA_P256_SHA256_ASN1,
+        private_key_ops: &p256::PRIVATE_KEY_OPS,
+        public_key_ops: &p256::PUBLIC_KEY_OPS,
+        scalar_ops: &p256::SCALAR_OPS,
+    },
+    Curve {
+        name: "p384",
+        signing: &ECDSA_P384_SHA384_ASN1_SIGNING,
+        verification: &ECDSA_P384_SHA384_ASN1,
+        private_key_ops: &p384::PRIVATE_KEY_OPS,
+        public_key_ops: &p384::PUBLIC_KEY_OPS,
+        scalar_ops: &p384::SCALAR_OPS,
+    },
+];
+
+fn bench_curve(b: &mut Bench, curve: &Curve) -> Result<()> {
+    let name = |op| format!("ecdsa_{}_{}", curve.name, op);
+    let alg = curve.signing;
+    b.measure(&name("keygen"), None, || {
+        let pkcs8 = EcdsaKeyPair::generate_pkcs8(alg)?;
+        EcdsaKeyPair::from_pkcs8(alg, pkcs8.as_ref())
+    })?;
+
+    let key_pair = EcdsaKeyPair::from_pkcs8(alg, EcdsaKeyPair::generate_pkcs8(alg)?.as_ref())?;
+    let public_key = UnparsedPublicKey::new(curve.verification, key_pair.public_key());
+    let msg = [0x5au8; 32];
+    let sig = key_pair.sign(&msg)?;
+    b.measure(&name("sign"), None, || key_pair.sign(&msg))?;
+    b.measure(&name("verify"), None, || {
+        public_key.verify(&msg, sig.as_ref()).map_err(Error::from)
+    })?;
+    // A flood of forgeries: each is well-formed, so it is only rejected
+    // after the whole verification.
+    let forged = key_pair.sign(&[0xa5u8; 32])?;
+    b.measure(&name("verify_invalid"), None, || {
+        match public_key.verify(&msg, forged.as_ref()) {
+            Ok(()) => Err(Error::from(ErrorKind::Unknown)),
+            Err(kind) => Ok(kind),
+        }
+    })?;
+    // Verifying again through a cache, which the warm-up call fills.
+    let cache = VerificationCache::new(1);
+    let public_key = key_pair.public_key().as_ref();
+    b.measure(&name("verify_cached"), None, || {
+        cache
+            .verify(curve.verification, public_key, &msg, sig.as_ref())
+            .map_err(Error::from)
+    })?;
+
+    // The group operations under the signatures, on an arbitrary scalar and
+    // the key pair's public point.
+    let name = |op| format!("{}_{}", curve.name, op);
+    let ops = curve.private_key_ops;
+    let scalar_bytes = [0x5au8; 48];
+    let scalar = ops::scalar_parse_big_endian_variable(
+        ops.common,
+        AllowZero::No,
+        untrusted::Input::from(&scalar_bytes[..ops.common.num_limbs * LIMB_BYTES]),
+    )?;
+    let point = public_key::parse_uncompressed_point(
+        curve.public_key_ops,
+        untrusted::Input::from(key_pair.public_key().as_ref()),
+    )?;
+    b.measure(&name("point_mul"), None, || {
+        Ok(ops.point_mul(&scalar, &point))
+    })?;
+    b.measure(&name("point_mul_base"), None, || {
+        Ok(ops.point_mul_base(&scalar))
+    })?;
+    b.measure(&name("scalar_inv"), None, || {
+        Ok(curve.scalar_ops.scalar_inv_to_mont(&scalar))
+    })
+}
+
+/// Times every primitive, in the order they appear in the report.
+pub fn run(config: &Config) -> Result<Vec<Measurement>> {
+    let mut b = Bench {
+        config,
+        results: Vec::new(),
+    };
+    for curve in CURVES.iter() {
+        bench_curve(&mut b, curve)?;
+    }
+
+    let alg = &ECDSA_P256_SHA256_ASN1_SIGNING;
+    let key_pair = EcdsaKeyPair::from_pkcs8(alg, EcdsaKeyPair::generate_pkcs8(alg)?.as_ref())?;
+    let public_key = UnparsedPublicKey::new(&ECDSA_P256_SHA256_ASN1, key_pair.public_key());
+    for &len in config.payload_sizes {
+        let payload = vec![0x5au8; len];
+        let ciphertext = ecies::encrypt(&public_key, &[], &[], &payload)?;
+        b.measure("ecies_encrypt", Some(len), || {
+            ecies::encrypt(&public_key, &[], &[], &payload)
+        })?;
+        b.measure("ecies_decrypt", Some(len), || {
+            ecies::decrypt(&key_pair, &ciphertext, &[], &[])
+        })?;
+    }
+
+    let entropy = [0x5au8; 16];
+    b.measure("mnemonic_generate", None, || {
+        mnemonic::generate_mnemonic(&entropy, Language::English)
+    })?;
+    let phrase = mnemonic::generate_mnemonic(&entropy, Language::English)?;
+    let password = String::new();
+    b.measure("mnemonic_to_seed", None, || {
+        mnemonic::generate_seed_with_error_check(&phrase, &password, 64, Language::English)
+    })?;
+
+    for &len in config.payload_sizes {
+        let payload = vec![0x5au8; len];
+        b.measure("sha256", Some(len), || Ok(hash::sha256_array(&payload)))?;
+        b.measure("double_sha256", Some(len), || {
+            Ok(hash::double_sha256_array(&payload))
+        })?;
+        b.measure("keccak256", Some(len), || Ok(keccak::keccak256(&payload)))?;
+    }
+
+    Ok(b.results)
+}
+
+/// Renders `measurements` as a JSON object. `environment` says where they
+/// were taken, e.g. "native", "sgx-sim" or "sgx-hw".
+pub fn to_json(environment: &str, measurements: &[Measurement]) -> String {
+    let mut json = String::new();
+    write!(json, "{{\"environment\":\"").unwrap();
+    for c in environment.chars() {
+        match c {
+            '"' | '\\' => write!(json, "\\{}", c).unwrap(),
+            c if (c as u32) < 0x20 => write!(json, "\\u{:04x}", c as u32).unwrap(),
+            c => json.push(c),
+        }
+    }
+    write!(json, "\",\"results\":[").unwrap();
+    for (i, m) in measurements.iter().enumerate() {
+        if i > 0 {
+            json.push(',');
+        }
+        write!(json, "{{\"name\":\"{}\",\"payload_len\":", m.name).unwrap();
+        match m.payload_len {
+            Some(len) => write!(json, "{}", len).unwrap(),
+            None => json.push_str("null"),
+        }
+        write!(
+            json,
+            ",\"iterations\":{},\"ns_per_op\":{:.1},\"ops_per_sec\":{:.1}",
+            m.iterations,
+            m.nanos_per_op(),
+            m.ops_per_sec()
+        )
+        .unwrap();
+        if let Some(bytes_per_sec) = m.bytes_per_sec() {
+            write!(json, ",\"bytes_per_sec\":{:.1}", bytes_per_sec).unwrap();
+        }
+        write!(
+            json,
+            ",\"p50_ns\":{:.1},\"p90_ns\":{:.1},\"p99_ns\":{:.1}}}",
+            m.percentile(50.0),
+            m.percentile(90.0),
+            m.percentile(99.0)
+        )
+        .unwrap();
+    }
+    json.push_str("]}");
+    json
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_run_and_report() {
+        let config = Config {
+            iterations: 3,
+            samples: 2,
+            payload_sizes: &[16, 100],
+        };
+        let results = run(&config).unwrap();
+        let names = results
+            .iter()
+            .map(|m| (&m.name[..], m.payload_len))
+            .collect::<Vec<_>>();
+        assert_eq!(
+            names,
+            vec![
+                ("ecdsa_p256_keygen", None),
+                ("ecdsa_p256_sign", None),
+                ("ecdsa_p256_verify", None),
+                ("ecdsa_p256_verify_invalid", None),
+                ("ecdsa_p256_verify_cached", None),
+                ("p256_point_mul", None),
+                ("p256_point_mul_base", None),
+                ("p256_scalar_inv", None),
+                ("ecdsa_p384_keygen", None),
+                ("ecdsa_p384_sign", None),
+                ("ecdsa_p384_verify", None),
+                ("ecdsa_p384_verify_invalid", None),
+                ("ecdsa_p384_verify_cached", None),
+                ("p384_point_mul", None),
+                ("p384_point_mul_base", None),
+                ("p384_scalar_inv", None),
+                ("ecies_encrypt", Some(16)),
+                ("ecies_decrypt", Some(16)),
+                ("ecies_encrypt", Some(100)),
+                ("ecies_decrypt", Some(100)),
+                ("mnemonic_generate", None),
+                ("mnemonic_to_seed", None),
+                ("sha256", Some(16)),
+                ("double_sha256", Some(16)),
+                ("keccak256", Some(16)),
+                ("sha256", Some(100)),
+                ("double_sha256", Some(100)),
+                ("keccak256", Some(100)),
+            ]
+        );
+        for m in &results {
+            assert_eq!(m.iterations, 3);
+            assert_eq!(m.sample_nanos.len(), 2);
+            assert!(m.sample_nanos[0] <= m.sample_nanos[1]);
+        }
+
+        let json = to_json("native \"test\"", &results[..2]);
+        assert!(json.starts_with(
+            "{\"environment\":\"native \\\"test\\\"\",\"results\":[\
+             {\"name\":\"ecdsa_p256_keygen\",\"payload_len\":null,\"iterations\":3,\"ns_per_op\":"
+        ));
+        assert!(json.contains(",\"p50_ns\":"));
+        assert!(json.contains("},{\"name\":\"ecdsa_p256_sign\","));
+        assert!(json.ends_with("}]}"));
+        assert!(to_json("", &results[16..17]).contains(",\"bytes_per_sec\":"));
+    }
+
+    #[test]
+    fn test_percentile() {
+        let m = Measurement {
+            name: "test".to_string(),
+            payload_len: Some(1000),
+            iterations: 10,
+            elapsed: Duration::from_micros(10),
+            sample_nanos: (1..=10).map(|i| i as f64 * 100.0).collect(),
+        };
+        assert_eq!(m.percentile(0.0), 100.0);
+        assert_eq!(m.percentile(50.0), 500.0);
+        assert_eq!(m.percentile(90.0), 900.0);
+        assert_eq!(m.percentile(99.0), 1000.0);
+        assert_eq!(m.percentile(100.0), 1000.0);
+        assert_eq!(m.ops_per_sec(), 1e6);
+        assert_eq!(m.bytes_per_sec(), Some(1e9));
+    }
+
+    /// Prints the native report, to compare with the enclave's:
+    /// `cargo test --release --features benchmarks native_report -- --ignored
+    /// --nocapture`.
+    #[test]
+    #[ignore]
+    fn native_report() {
+        println!("{}", to_json("native", &run(&Config::default()).unwrap()));
+    }
+}
@@ -56,5 +56,10 @@ const SEED_MAX_BYTES: usize = ELEM_MAX_BYTES;
 /// longer.
 pub const PKCS8_DOCUMENT_MAX_LEN: usize = 40 + SCALAR_MAX_BYTES + keys::PUBLIC_KEY_MAX_LEN;
 
+/// The maximum length of a PKCS#8 v2 document generated for ECC keys. It adds
+/// the `publicKey` field, three bytes of header plus the key, and the outer
+/// `SEQUENCE` needs one more length byte.
+pub const PKCS8_V2_DOCUMENT_MAX_LEN: usize = PKCS8_DOCUMENT_MAX_LEN + 4 + keys::PUBLIC_KEY_MAX_LEN;
+
 mod keys;
 pub mod suite_b;
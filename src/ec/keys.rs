@@ -14,6 +14,12 @@ impl KeyPair {
         Ok(Self { seed, public_key })
     }
 
+    /// Pairs `seed` with a public key that the caller has already validated,
+    /// instead of recomputing it from the seed.
+    pub(crate) fn from_parts(seed: Seed, public_key: PublicKey) -> Self {
+        Self { seed, public_key }
+    }
+
     pub fn public_key(&self) -> &PublicKey {
         &self.public_key
     }
@@ -71,6 +77,22 @@ pub struct PublicKey {
     len: usize,
 }
 
+impl PublicKey {
+    /// Copies an encoded public key for `curve`; the caller is responsible
+    /// for validating it.
+    pub(crate) fn from_bytes_unchecked(curve: &'static Curve, bytes: &[u8]) -> Result<Self> {
+        if bytes.len() != curve.public_key_len {
+            return Err(Error::from(ErrorKind::CryptoError));
+        }
+        let mut r = Self {
+            bytes: [0u8; PUBLIC_KEY_MAX_LEN],
+            len: bytes.len(),
+        };
+        r.bytes[..r.len].copy_from_slice(bytes);
+        Ok(r)
+    }
+}
+
 impl AsRef<[u8]> for PublicKey {
     fn as_ref(&self) -> &[u8] {
         &self.bytes[..self.len]
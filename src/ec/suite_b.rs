@@ -18,8 +18,11 @@ use std::prelude::v1::*;
 use self::ops::*;
 use crate::{
     arithmetic::montgomery::*,
+    ec,
     errors::{Error, ErrorKind, Result},
+    io::der,
     limb::LimbMask,
+    pkcs8,
 };
 
 // NIST SP 800-56A Step 3: "If q is an odd prime p, verify that
@@ -155,12 +158,122 @@ fn verify_affine_point_is_on_the_curve_scaled(
     Ok(())
 }
 
+/// id-ecPublicKey, 1.2.840.10045.2.1.
+pub(crate) const EC_PUBLIC_KEY_OID: &[u8] = &[0x2a, 0x86, 0x48, 0xce, 0x3d, 0x02, 0x01];
+
+/// secp256r1, 1.2.840.10045.3.1.7.
+pub(crate) const P256_OID: &[u8] = &[0x2a, 0x86, 0x48, 0xce, 0x3d, 0x03, 0x01, 0x07];
+
+/// secp384r1, 1.3.132.0.34.
+pub(crate) const P384_OID: &[u8] = &[0x2b, 0x81, 0x04, 0x00, 0x22];
+
+/// Parses an id-ecPublicKey PKCS#8 document for the named curve `curve_oid`.
+///
+/// The public key must be present, either in the `ECPrivateKey` or in the
+/// `publicKey` field of a v2 document; if both are present they must match.
+/// See `key_pair_from_bytes` for how the key pair is validated.
+pub(crate) fn key_pair_from_pkcs8(
+    curve: &'static ec::Curve,
+    curve_oid: &[u8],
+    version: pkcs8::Version,
+    input: untrusted::Input,
+) -> Result<ec::KeyPair> {
+    let (ec_private_key, outer_public_key) =
+        pkcs8::unwrap_key(EC_PUBLIC_KEY_OID, curve_oid, version, input)?;
+    let (private_key, public_key) =
+        ec_private_key.read_all(Error::from(ErrorKind::CryptoError), |input| {
+            der::nested(
+                input,
+                der::Tag::Sequence,
+                Error::from(ErrorKind::CryptoError),
+                |input| key_pair_from_pkcs8_(curve_oid, input),
+            )
+        })?;
+    let public_key = match (public_key, outer_public_key) {
+        (Some(inner), Some(outer)) if inner.as_slice_less_safe() != outer.as_slice_less_safe() => {
+            return Err(Error::from(ErrorKind::KeyParamNotMatchError));
+        }
+        (Some(public_key), _) | (None, Some(public_key)) => public_key,
+        (None, None) => return Err(Error::from(ErrorKind::CryptoError)),
+    };
+    key_pair_from_bytes(curve, private_key, public_key)
+}
+
+// Parses the contents of an `ECPrivateKey` ([RFC 5915]), returning the private
+// key and the public key, if present.
+//
+// [RFC 5915]: https://tools.ietf.org/html/rfc5915
+fn key_pair_from_pkcs8_<'a>(
+    curve_oid: &[u8],
+    input: &mut untrusted::Reader<'a>,
+) -> Result<(untrusted::Input<'a>, Option<untrusted::Input<'a>>)> {
+    let version = der::small_nonnegative_integer(input)?;
+    if version != 1 {
+        return Err(Error::from(ErrorKind::CryptoError));
+    }
+
+    let private_key = der::expect_tag_and_get_value(input, der::Tag::OctetString)?;
+
+    // [0] parameters (optional), which must name the same curve as the
+    // PKCS#8 algorithm identifier.
+    if input.peek(u8::from(der::Tag::ContextSpecificConstructed0)) {
+        let actual_curve_oid = der::nested(
+            input,
+            der::Tag::ContextSpecificConstructed0,
+            Error::from(ErrorKind::CryptoError),
+            |input| der::expect_tag_and_get_value(input, der::Tag::OID),
+        )?;
+        if actual_curve_oid.as_slice_less_safe() != curve_oid {
+            return Err(Error::from(ErrorKind::NotExactTheSameCurveInputError));
+        }
+    }
+
+    // [1] publicKey. RFC 5915 makes it optional, but it may instead be in
+    // the `publicKey` field of a PKCS#8 v2 document.
+    let public_key = if input.peek(u8::from(der::Tag::ContextSpecificConstructed1)) {
+        Some(der::nested(
+            input,
+            der::Tag::ContextSpecificConstructed1,
+            Error::from(ErrorKind::CryptoError),
+            der::bit_string_with_no_unused_bits,
+        )?)
+    } else {
+        None
+    };
+
+    Ok((private_key, public_key))
+}
+
+/// Constructs a key pair from a private key and its encoded public key.
+///
+/// The private key is range-checked and the public key is checked to be a
+/// point on the curve, but the public key is *not* recomputed from the
+/// private key: that is a full base point multiplication, which is what makes
+/// loading through `ec::KeyPair::derive` expensive. A stored key whose halves
+/// do not belong together therefore loads, and its signatures fail to verify
+/// under the stored public key.
+pub(crate) fn key_pair_from_bytes(
+    curve: &'static ec::Curve,
+    private_key: untrusted::Input,
+    public_key: untrusted::Input,
+) -> Result<ec::KeyPair> {
+    let seed = ec::Seed::from_bytes(curve, private_key)?;
+    let public_key_ops = match curve.id {
+        ec::CurveID::P256 => &ops::p256::PUBLIC_KEY_OPS,
+        ec::CurveID::P384 => &ops::p384::PUBLIC_KEY_OPS,
+        ec::CurveID::Curve25519 => return Err(Error::from(ErrorKind::ErrCryptographyNotSupported)),
+    };
+    let _ = public_key::parse_uncompressed_point(public_key_ops, public_key)?;
+    let public_key = ec::PublicKey::from_bytes_unchecked(curve, public_key.as_slice_less_safe())?;
+    Ok(ec::KeyPair::from_parts(seed, public_key))
+}
+
 #[macro_use]
-mod ops;
+pub mod ops;
 
 pub mod curve;
 pub mod ecdsa;
 pub mod ecies;
 
 mod private_key;
-mod public_key;
+pub(crate) mod public_key;
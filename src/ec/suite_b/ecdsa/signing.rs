@@ -13,8 +13,8 @@
 // CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
 
 //! ECDSA Signatures using the P-256 and P-384 curves.
-use std::prelude::v1::*;
 
+use std::prelude::v1::*;
 use super::digest_scalar::digest_scalar;
 use crate::{
     arithmetic::montgomery::*,
@@ -23,9 +23,12 @@ use crate::{
         suite_b::{ops::*, private_key},
     },
     errors::{Error, ErrorKind, Result},
-    io::der,
+    io::der_slice,
     limb,
+    metrics::{self, Op},
+    pkcs8,
 };
+use rand::Rng;
 use ring::digest;
 
 /// An ECDSA signing algorithm.
@@ -35,12 +38,16 @@ pub struct EcdsaSigningAlgorithm {
     private_key_ops: &'static PrivateKeyOps,
     digest_alg: &'static digest::Algorithm,
     format_rs: fn(ops: &'static ScalarOps, r: &Scalar, s: &Scalar, out: &mut [u8]) -> usize,
+    curve_oid: &'static [u8],
     id: AlgorithmID,
 }
 
 #[derive(Debug, Eq, PartialEq)]
 enum AlgorithmID {
     ECDSA_P256_SHA256_ASN1_SIGNING,
+    ECDSA_P256_SHA256_FIXED_SIGNING,
+    ECDSA_P384_SHA384_ASN1_SIGNING,
+    ECDSA_P384_SHA384_FIXED_SIGNING,
 }
 
 derive_debug_via_id!(EcdsaSigningAlgorithm);
@@ -75,45 +82,44 @@ impl EcdsaKeyPair {
     ///
     /// [RFC 5915]: https://tools.ietf.org/html/rfc5915
     /// [RFC 5958 Section 2]: https://tools.ietf.org/html/rfc5958#section-2
-    /*
-    pub fn generate_pkcs8(
-        alg: &'static EcdsaSigningAlgorithm,
-        rng: &dyn rand::SecureRandom,
-    ) -> Result<pkcs8::Document> {
-        let private_key = ec::Seed::generate(alg.curve, rng, cpu::features())?;
+    pub fn generate_pkcs8(alg: &'static EcdsaSigningAlgorithm) -> Result<pkcs8::Document> {
+        let mut rng = [0u8; ec::SCALAR_MAX_BYTES];
+        rand::thread_rng().fill(&mut rng[..]);
+        let private_key = ec::Seed::generate(alg.curve, &rng)?;
         let public_key = private_key.compute_public_key()?;
-        Ok(pkcs8::wrap_key(
-            &alg.pkcs8_template,
-            private_key.bytes_less_safe(),
-            public_key.as_ref(),
-        ))
+        pkcs8::Document::new(|out| {
+            der_slice::write_pkcs8(
+                ec::suite_b::EC_PUBLIC_KEY_OID,
+                alg.curve_oid,
+                private_key.bytes_less_safe(),
+                public_key.as_ref(),
+                false,
+                out,
+            )
+        })
     }
-    */
 
-    /// Constructs an ECDSA key pair by parsing an unencrypted PKCS#8 v1
+    /// Constructs an ECDSA key pair by parsing an unencrypted PKCS#8 v1 or v2
     /// id-ecPublicKey `ECPrivateKey` key.
     ///
-    /// The input must be in PKCS#8 v1 format. It must contain the public key in
-    /// the `ECPrivateKey` structure; `from_pkcs8()` will verify that the public
-    /// key and the private key are consistent with each other. The algorithm
+    /// The public key must be present, in the `ECPrivateKey` structure or in
+    /// the `publicKey` field of a v2 document; if both are present they must
+    /// be equal. The public key is checked to be on the curve but is not
+    /// recomputed from the private key, which keeps loading cheap; use
+    /// `from_seed_unchecked()` to derive it instead. The algorithm
     /// identifier must identify the curve by name; it must not use an
     /// "explicit" encoding of the curve. The `parameters` field of the
     /// `ECPrivateKey`, if present, must be the same named curve that is in the
     /// algorithm identifier in the PKCS#8 header.
-    /*
-    pub fn from_pkcs8(
-        alg: &'static EcdsaSigningAlgorithm,
-        pkcs8: &[u8],
-    ) -> Result<Self, error::KeyRejected> {
+    pub fn from_pkcs8(alg: &'static EcdsaSigningAlgorithm, pkcs8: &[u8]) -> Result<Self> {
         let key_pair = ec::suite_b::key_pair_from_pkcs8(
             alg.curve,
-            alg.pkcs8_template,
+            alg.curve_oid,
+            pkcs8::Version::V1OrV2,
             untrusted::Input::from(pkcs8),
-            cpu::features(),
         )?;
         Ok(Self::new(alg, key_pair))
     }
-    */
 
     pub fn from_seed_unchecked(
         alg: &'static EcdsaSigningAlgorithm,
@@ -144,12 +150,60 @@ impl EcdsaKeyPair {
         self.seed.to_owned().into()
     }
 
+    /// Like `seed_as_bytes()`, without the copy.
+    pub(crate) fn seed_less_safe(&self) -> &[u8] {
+        &self.seed
+    }
+
+    /// Writes the key pair into `out` as a PKCS#8 v1 document in the same
+    /// layout as `generate_pkcs8()`, returning the number of bytes written.
+    /// At most `ec::PKCS8_DOCUMENT_MAX_LEN` bytes are needed.
+    pub fn write_pkcs8(&self, out: &mut [u8]) -> Result<usize> {
+        der_slice::write_pkcs8(
+            ec::suite_b::EC_PUBLIC_KEY_OID,
+            self.alg.curve_oid,
+            &self.seed,
+            self.public_key.as_ref(),
+            false,
+            out,
+        )
+    }
+
+    /// Like `write_pkcs8()`, but writes a PKCS#8 v2 document, which also
+    /// carries the public key in its `publicKey` field. At most
+    /// `ec::PKCS8_V2_DOCUMENT_MAX_LEN` bytes are needed.
+    pub fn write_pkcs8_v2(&self, out: &mut [u8]) -> Result<usize> {
+        der_slice::write_pkcs8(
+            ec::suite_b::EC_PUBLIC_KEY_OID,
+            self.alg.curve_oid,
+            &self.seed,
+            self.public_key.as_ref(),
+            true,
+            out,
+        )
+    }
+
+    /// Writes the key pair into `out` as a SEC1 `ECPrivateKey` that names its
+    /// curve in `parameters`, returning the number of bytes written.
+    pub fn write_ec_private_key(&self, out: &mut [u8]) -> Result<usize> {
+        let mut output = der_slice::Writer::new(out);
+        der_slice::write_ec_private_key(
+            &mut output,
+            &self.seed,
+            Some(self.alg.curve_oid),
+            self.public_key.as_ref(),
+        )?;
+        Ok(output.len())
+    }
+
     /// Returns the signature of the `message` using a random nonce
     /// generated by `rng`.
     pub fn sign(&self, message: &[u8]) -> Result<crate::sign::ecdsa::Signature> {
-        // Step 4 (out of order).
-        let h = digest::digest(self.alg.digest_alg, message);
-        self.sign_(h)
+        metrics::observe(Op::EcdsaSign, || {
+            // Step 4 (out of order).
+            let h = digest::digest(self.alg.digest_alg, message);
+            self.sign_(h)
+        })
     }
 
     /// Returns the signature of message digest `h` using a "random" nonce
@@ -179,52 +233,64 @@ impl EcdsaKeyPair {
         // `EcdsaKeyPair` ensure that #3 and #4 are met subject to the caveats
         // in SP800-89 Section 6.
 
-        let ops = self.alg.private_scalar_ops;
-        let scalar_ops = ops.scalar_ops;
-        let cops = scalar_ops.common;
-        let private_key_ops = self.alg.private_key_ops;
-
         for _ in 0..100 {
             // XXX: iteration conut?
             // Step 1.
             let k = private_key::random_scalar(self.alg.private_key_ops)?;
-            let k_inv = scalar_ops.scalar_inv_to_mont(&k);
+            if let Some(signature) = self.sign_with_nonce(&h, &k)? {
+                return Ok(signature);
+            }
+        }
 
-            // Step 2.
-            let r = private_key_ops.point_mul_base(&k);
+        Err(Error::from(ErrorKind::CryptoError))
+    }
 
-            // Step 3.
-            let r = {
-                let (x, _) = private_key::affine_from_jacobian(private_key_ops, &r)?;
-                let x = cops.elem_unencoded(&x);
-                elem_reduced_to_scalar(cops, &x)
-            };
-            if cops.is_zero(&r) {
-                continue;
-            }
+    /// Steps 2 through 7 of signing with the nonce `k`, returning `None` when
+    /// `k` yields a zero `r` or `s` and another nonce must be tried.
+    fn sign_with_nonce(
+        &self,
+        h: &digest::Digest,
+        k: &Scalar,
+    ) -> Result<Option<crate::sign::ecdsa::Signature>> {
+        let ops = self.alg.private_scalar_ops;
+        let scalar_ops = ops.scalar_ops;
+        let cops = scalar_ops.common;
+        let private_key_ops = self.alg.private_key_ops;
 
-            // Step 4 is done by the caller.
+        let k_inv = scalar_ops.scalar_inv_to_mont(k);
 
-            // Step 5.
-            let e = digest_scalar(scalar_ops, h);
+        // Step 2.
+        let r = private_key_ops.point_mul_base(k);
 
-            // Step 6.
-            let s = {
-                let dr = scalar_ops.scalar_product(&self.d, &r);
-                let e_plus_dr = scalar_sum(cops, &e, &dr);
-                scalar_ops.scalar_product(&k_inv, &e_plus_dr)
-            };
-            if cops.is_zero(&s) {
-                continue;
-            }
+        // Step 3.
+        let r = {
+            let (x, _) = private_key::affine_from_jacobian(private_key_ops, &r)?;
+            let x = cops.elem_unencoded(&x);
+            elem_reduced_to_scalar(cops, &x)
+        };
+        if cops.is_zero(&r) {
+            return Ok(None);
+        }
+
+        // Step 4 is done by the caller.
 
-            // Step 7 with encoding.
-            return Ok(crate::sign::ecdsa::Signature::new(|sig_bytes| {
-                (self.alg.format_rs)(scalar_ops, &r, &s, sig_bytes)
-            }));
+        // Step 5.
+        let e = digest_scalar(scalar_ops, *h);
+
+        // Step 6.
+        let s = {
+            let dr = scalar_ops.scalar_product(&self.d, &r);
+            let e_plus_dr = scalar_sum(cops, &e, &dr);
+            scalar_ops.scalar_product(&k_inv, &e_plus_dr)
+        };
+        if cops.is_zero(&s) {
+            return Ok(None);
         }
 
-        Err(Error::from(ErrorKind::CryptoError))
+        // Step 7 with encoding.
+        Ok(Some(crate::sign::ecdsa::Signature::new(|sig_bytes| {
+            (self.alg.format_rs)(scalar_ops, &r, &s, sig_bytes)
+        })))
     }
 }
 
@@ -247,6 +313,30 @@ impl AsRef<[u8]> for PublicKey {
     }
 }
 
+/// Signing of ECDSA signatures using the P-256 curve and SHA-256, with the
+/// signature encoded as the fixed-length big-endian `r || s`.
+pub static ECDSA_P256_SHA256_FIXED_SIGNING: EcdsaSigningAlgorithm = EcdsaSigningAlgorithm {
+    curve: &ec::suite_b::curve::P256,
+    private_scalar_ops: &p256::PRIVATE_SCALAR_OPS,
+    private_key_ops: &p256::PRIVATE_KEY_OPS,
+    digest_alg: &digest::SHA256,
+    format_rs: format_rs_fixed,
+    curve_oid: ec::suite_b::P256_OID,
+    id: AlgorithmID::ECDSA_P256_SHA256_FIXED_SIGNING,
+};
+
+/// Signing of ECDSA signatures using the P-384 curve and SHA-384, with the
+/// signature encoded as the fixed-length big-endian `r || s`.
+pub static ECDSA_P384_SHA384_FIXED_SIGNING: EcdsaSigningAlgorithm = EcdsaSigningAlgorithm {
+    curve: &ec::suite_b::curve::P384,
+    private_scalar_ops: &p384::PRIVATE_SCALAR_OPS,
+    private_key_ops: &p384::PRIVATE_KEY_OPS,
+    digest_alg: &digest::SHA384,
+    format_rs: format_rs_fixed,
+    curve_oid: ec::suite_b::P384_OID,
+    id: AlgorithmID::ECDSA_P384_SHA384_FIXED_SIGNING,
+};
+
 /// Signing of ASN.1 DER-encoded ECDSA signatures using the P-256 curve and
 /// SHA-256.
 ///
@@ -258,51 +348,322 @@ pub static ECDSA_P256_SHA256_ASN1_SIGNING: EcdsaSigningAlgorithm = EcdsaSigningA
     private_key_ops: &p256::PRIVATE_KEY_OPS,
     digest_alg: &digest::SHA256,
     format_rs: format_rs_asn1,
+    curve_oid: ec::suite_b::P256_OID,
     id: AlgorithmID::ECDSA_P256_SHA256_ASN1_SIGNING,
 };
 
+/// Signing of ASN.1 DER-encoded ECDSA signatures using the P-384 curve and
+/// SHA-384.
+pub static ECDSA_P384_SHA384_ASN1_SIGNING: EcdsaSigningAlgorithm = EcdsaSigningAlgorithm {
+    curve: &ec::suite_b::curve::P384,
+    private_scalar_ops: &p384::PRIVATE_SCALAR_OPS,
+    private_key_ops: &p384::PRIVATE_KEY_OPS,
+    digest_alg: &digest::SHA384,
+    format_rs: format_rs_asn1,
+    curve_oid: ec::suite_b::P384_OID,
+    id: AlgorithmID::ECDSA_P384_SHA384_ASN1_SIGNING,
+};
+
+fn format_rs_fixed(ops: &'static ScalarOps, r: &Scalar, s: &Scalar, out: &mut [u8]) -> usize {
+    let scalar_len = ops.scalar_bytes_len();
+
+    let (r_out, rest) = out.split_at_mut(scalar_len);
+    limb::big_endian_from_limbs(&r.limbs[..ops.common.num_limbs], r_out);
+
+    let (s_out, _) = rest.split_at_mut(scalar_len);
+    limb::big_endian_from_limbs(&s.limbs[..ops.common.num_limbs], s_out);
+
+    2 * scalar_len
+}
+
 fn format_rs_asn1(ops: &'static ScalarOps, r: &Scalar, s: &Scalar, out: &mut [u8]) -> usize {
-    // This assumes `a` is not zero since neither `r` or `s` is allowed to be
-    // zero.
-    fn format_integer_tlv(ops: &ScalarOps, a: &Scalar, out: &mut [u8]) -> usize {
-        let mut fixed = [0u8; ec::SCALAR_MAX_BYTES + 1];
-        let fixed = &mut fixed[..(ops.scalar_bytes_len() + 1)];
-        limb::big_endian_from_limbs(&a.limbs[..ops.common.num_limbs], &mut fixed[1..]);
-
-        // Since `a_fixed_out` is an extra byte long, it is guaranteed to start
-        // with a zero.
-        debug_assert_eq!(fixed[0], 0);
-
-        // There must be at least one non-zero byte since `a` isn't zero.
-        let first_index = fixed.iter().position(|b| *b != 0).unwrap();
-
-        // If the first byte has its high bit set, it needs to be prefixed with 0x00.
-        let first_index = if fixed[first_index] & 0x80 != 0 {
-            first_index - 1
-        } else {
-            first_index
-        };
-        let value = &fixed[first_index..];
+    let scalar_len = ops.scalar_bytes_len();
+    let mut fixed = [0u8; 2 * ec::SCALAR_MAX_BYTES];
+    let fixed_len = format_rs_fixed(ops, r, s, &mut fixed);
+    let (r, s) = fixed[..fixed_len].split_at(scalar_len);
+
+    // `Signature` is sized for the longest encoding of the largest scalars,
+    // so this can only fail if `out` is not a `Signature` buffer.
+    der_slice::write_ecdsa_sig(r, s, out).unwrap()
+}
 
-        out[0] = der::Tag::Integer as u8;
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::{
+        sign::ecdsa::{
+            KeyPair, UnparsedPublicKey, VerificationAlgorithm, ECDSA_P256_SHA256_ASN1,
+            ECDSA_P256_SHA256_FIXED, ECDSA_P384_SHA384_ASN1, ECDSA_P384_SHA384_FIXED,
+        },
+        test, test_file,
+    };
+
+    fn test_signing(
+        test_file: test::File,
+        algs: &[(
+            &str,
+            &'static EcdsaSigningAlgorithm,
+            &'static dyn VerificationAlgorithm,
+        )],
+    ) {
+        test::run(test_file, |section, test_case| {
+            assert_eq!(section, "");
+
+            let curve_name = test_case.consume_string("Curve");
+            let digest_name = test_case.consume_string("Digest");
+            let (sign_alg, verify_alg) = match algs
+                .iter()
+                .find(|(name, ..)| *name == format!("{}+{}", curve_name, digest_name))
+            {
+                Some(&(_, sign_alg, verify_alg)) => (sign_alg, verify_alg),
+                None => panic!("Unsupported curve+digest: {}+{}", curve_name, digest_name),
+            };
 
-        // Lengths less than 128 are encoded in one byte.
-        assert!(value.len() < 128);
-        out[1] = value.len() as u8;
+            let msg = test_case.consume_bytes("Msg");
+            let d = test_case.consume_bytes("d");
+            let q = test_case.consume_bytes("Q");
+            let k = test_case.consume_bytes("k");
+            let expected = test_case.consume_bytes("Sig");
+
+            let key_pair =
+                EcdsaKeyPair::from_seed_unchecked(sign_alg, untrusted::Input::from(&d)).unwrap();
+            assert_eq!(key_pair.public_key().as_ref(), &q[..]);
+
+            let h = digest::digest(sign_alg.digest_alg, &msg);
+            let k =
+                private_key::scalar_from_big_endian_bytes(sign_alg.private_key_ops, &k).unwrap();
+            let actual = key_pair.sign_with_nonce(&h, &k).unwrap().unwrap();
+            assert_eq!(actual.as_ref(), &expected[..]);
+
+            let public_key = UnparsedPublicKey::new(verify_alg, &q);
+            assert!(public_key.verify(&msg, actual.as_ref()).is_ok());
+            let mut corrupted = msg.clone();
+            corrupted.push(0);
+            assert!(public_key.verify(&corrupted, actual.as_ref()).is_err());
+
+            Ok(())
+        });
+    }
 
-        out[2..][..value.len()].copy_from_slice(&value);
+    #[test]
+    fn signing_asn1_test() {
+        test_signing(
+            test_file!("ecdsa_sign_asn1_tests.txt"),
+            &[
+                (
+                    "P-256+SHA256",
+                    &ECDSA_P256_SHA256_ASN1_SIGNING,
+                    &ECDSA_P256_SHA256_ASN1,
+                ),
+                (
+                    "P-384+SHA384",
+                    &ECDSA_P384_SHA384_ASN1_SIGNING,
+                    &ECDSA_P384_SHA384_ASN1,
+                ),
+            ],
+        );
+    }
 
-        2 + value.len()
+    #[test]
+    fn signing_fixed_test() {
+        test_signing(
+            test_file!("ecdsa_sign_fixed_tests.txt"),
+            &[
+                (
+                    "P-256+SHA256",
+                    &ECDSA_P256_SHA256_FIXED_SIGNING,
+                    &ECDSA_P256_SHA256_FIXED,
+                ),
+                (
+                    "P-384+SHA384",
+                    &ECDSA_P384_SHA384_FIXED_SIGNING,
+                    &ECDSA_P384_SHA384_FIXED,
+                ),
+            ],
+        );
     }
 
-    out[0] = der::Tag::Sequence as u8;
-    let r_tlv_len = format_integer_tlv(ops, r, &mut out[2..]);
-    let s_tlv_len = format_integer_tlv(ops, s, &mut out[2..][r_tlv_len..]);
+    #[test]
+    fn signing_p384_round_trip_test() {
+        let seed = [0x5au8; 48];
+        for &(sign_alg, verify_alg, other_alg) in &[
+            (
+                &ECDSA_P384_SHA384_ASN1_SIGNING,
+                &ECDSA_P384_SHA384_ASN1,
+                &ECDSA_P384_SHA384_FIXED,
+            ),
+            (
+                &ECDSA_P384_SHA384_FIXED_SIGNING,
+                &ECDSA_P384_SHA384_FIXED,
+                &ECDSA_P384_SHA384_ASN1,
+            ),
+        ] {
+            let key_pair =
+                EcdsaKeyPair::from_seed_unchecked(sign_alg, untrusted::Input::from(&seed)).unwrap();
+            let msg = b"fixed buffers";
+            let sig = key_pair.sign(msg).unwrap();
+            let public_key = UnparsedPublicKey::new(verify_alg, key_pair.public_key());
+            assert!(public_key.verify(msg, sig.as_ref()).is_ok());
+            let public_key = UnparsedPublicKey::new(other_alg, key_pair.public_key());
+            assert!(public_key.verify(msg, sig.as_ref()).is_err());
+        }
+    }
 
-    // Lengths less than 128 are encoded in one byte.
-    let value_len = r_tlv_len + s_tlv_len;
-    assert!(value_len < 128);
-    out[1] = value_len as u8;
+    #[test]
+    fn write_pkcs8_test() {
+        for &(alg, template) in &[
+            (
+                &ECDSA_P256_SHA256_ASN1_SIGNING,
+                &include_bytes!("ecPublicKey_p256_pkcs8_v1_template.der")[..],
+            ),
+            (
+                &ECDSA_P384_SHA384_ASN1_SIGNING,
+                &include_bytes!("ecPublicKey_p384_pkcs8_v1_template.der")[..],
+            ),
+        ] {
+            let seed = vec![0x33u8; alg.curve.elem_scalar_seed_len];
+            let key_pair =
+                EcdsaKeyPair::from_seed_unchecked(alg, untrusted::Input::from(&seed)).unwrap();
+
+            // The template is the document with the private key removed from
+            // before its last five bytes and the public key from its end.
+            let (prefix, middle) = template.split_at(template.len() - 5);
+            let mut expected = prefix.to_vec();
+            expected.extend_from_slice(&seed);
+            expected.extend_from_slice(middle);
+            expected.extend_from_slice(key_pair.public_key().as_ref());
+
+            let mut out = [0u8; ec::PKCS8_DOCUMENT_MAX_LEN];
+            let len = key_pair.write_pkcs8(&mut out).unwrap();
+            assert_eq!(&out[..len], &expected[..]);
+            assert!(key_pair.write_pkcs8(&mut out[..len - 1]).is_err());
+
+            let len = key_pair.write_ec_private_key(&mut out).unwrap();
+            assert_eq!(
+                len,
+                der_slice::ec_private_key_len(
+                    &seed,
+                    Some(alg.curve_oid),
+                    key_pair.public_key().as_ref()
+                )
+            );
+        }
+    }
 
-    2 + value_len
+    #[test]
+    fn from_pkcs8_test() {
+        test::run(
+            test_file!("ecdsa_from_pkcs8_tests.txt"),
+            |section, test_case| {
+                assert_eq!(section, "");
+
+                let curve_name = test_case.consume_string("Curve");
+                let (alg, verify_alg): (_, &'static dyn VerificationAlgorithm) =
+                    match curve_name.as_str() {
+                        "P-256" => (&ECDSA_P256_SHA256_ASN1_SIGNING, &ECDSA_P256_SHA256_ASN1),
+                        "P-384" => (&ECDSA_P384_SHA384_ASN1_SIGNING, &ECDSA_P384_SHA384_ASN1),
+                        _ => panic!("Unsupported curve: {}", curve_name),
+                    };
+                let input = test_case.consume_bytes("Input");
+                let error = test_case.consume_optional_string("Error");
+
+                let key_pair = match (EcdsaKeyPair::from_pkcs8(alg, &input), error) {
+                    (Ok(key_pair), None) => key_pair,
+                    (Err(actual), Some(expected)) => {
+                        assert_eq!(format!("{:?}", actual.kind()), expected);
+                        return Ok(());
+                    }
+                    (Ok(_), Some(expected)) => panic!("Expected {}", expected),
+                    (Err(actual), None) => panic!("Unexpected {:?}", actual),
+                };
+
+                // The stored public key is trusted rather than recomputed;
+                // check that it is in fact the one derived from the seed.
+                let derived =
+                    EcdsaKeyPair::from_seed_unchecked(alg, untrusted::Input::from(&key_pair.seed))
+                        .unwrap();
+                assert_eq!(
+                    key_pair.public_key().as_ref(),
+                    derived.public_key().as_ref()
+                );
+
+                let msg = b"from_pkcs8";
+                let sig = key_pair.sign(msg).unwrap();
+                assert!(UnparsedPublicKey::new(verify_alg, key_pair.public_key())
+                    .verify(msg, sig.as_ref())
+                    .is_ok());
+
+                // Both versions written back parse to the same key.
+                let mut out = [0u8; ec::PKCS8_V2_DOCUMENT_MAX_LEN];
+                for &v2 in &[false, true] {
+                    let len = if v2 {
+                        key_pair.write_pkcs8_v2(&mut out).unwrap()
+                    } else {
+                        key_pair.write_pkcs8(&mut out).unwrap()
+                    };
+                    let reparsed = EcdsaKeyPair::from_pkcs8(alg, &out[..len]).unwrap();
+                    assert_eq!(reparsed.seed, key_pair.seed);
+                    assert_eq!(
+                        reparsed.public_key().as_ref(),
+                        key_pair.public_key().as_ref()
+                    );
+                }
+
+                Ok(())
+            },
+        );
+    }
+
+    #[test]
+    fn generate_pkcs8_test() {
+        for &alg in &[
+            &ECDSA_P256_SHA256_ASN1_SIGNING,
+            &ECDSA_P384_SHA384_ASN1_SIGNING,
+        ] {
+            let doc = EcdsaKeyPair::generate_pkcs8(alg).unwrap();
+            assert!(doc.as_ref().len() <= ec::PKCS8_DOCUMENT_MAX_LEN);
+            let key_pair = EcdsaKeyPair::from_pkcs8(alg, doc.as_ref()).unwrap();
+
+            let mut out = [0u8; ec::PKCS8_DOCUMENT_MAX_LEN];
+            let len = key_pair.write_pkcs8(&mut out).unwrap();
+            assert_eq!(&out[..len], doc.as_ref());
+
+            let mut out = [0u8; ec::PKCS8_V2_DOCUMENT_MAX_LEN];
+            let len = key_pair.write_pkcs8_v2(&mut out).unwrap();
+            assert!(key_pair.write_pkcs8_v2(&mut out[..len - 1]).is_err());
+            assert!(crate::pkcs8::unwrap_key(
+                ec::suite_b::EC_PUBLIC_KEY_OID,
+                alg.curve_oid,
+                pkcs8::Version::V1Only,
+                untrusted::Input::from(&out[..len])
+            )
+            .is_err());
+        }
+    }
+}
+
+#[cfg(feature = "internal_benches")]
+mod internal_benches {
+    use super::*;
+    extern crate test;
+
+    #[bench]
+    fn from_pkcs8_bench(bench: &mut test::Bencher) {
+        let doc = EcdsaKeyPair::generate_pkcs8(&ECDSA_P256_SHA256_ASN1_SIGNING).unwrap();
+        bench.iter(|| {
+            EcdsaKeyPair::from_pkcs8(&ECDSA_P256_SHA256_ASN1_SIGNING, doc.as_ref()).unwrap()
+        });
+    }
+
+    #[bench]
+    fn from_seed_unchecked_bench(bench: &mut test::Bencher) {
+        let seed = [0x5au8; 32];
+        bench.iter(|| {
+            EcdsaKeyPair::from_seed_unchecked(
+                &ECDSA_P256_SHA256_ASN1_SIGNING,
+                untrusted::Input::from(&seed),
+            )
+            .unwrap()
+        });
+    }
 }
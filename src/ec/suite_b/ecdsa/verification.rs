@@ -23,7 +23,7 @@ use crate::{
     arithmetic::montgomery::*,
     ec::suite_b::{ops::*, public_key::*, verify_jacobian_point_is_on_the_curve},
     errors::*,
-    io::der,
+    io::der_slice,
     limb,
 };
 use untrusted;
@@ -35,13 +35,16 @@ pub struct EcdsaVerificationAlgorithm {
     split_rs: for<'a> fn(
         ops: &'static ScalarOps,
         input: &mut untrusted::Reader<'a>,
-    ) -> Result<(untrusted::Input<'a>, untrusted::Input<'a>)>,
+    ) -> SimpleResult<(untrusted::Input<'a>, untrusted::Input<'a>)>,
     id: AlgorithmID,
 }
 
-#[derive(Debug)]
+#[derive(Clone, Copy, Debug)]
 enum AlgorithmID {
     ECDSA_P256_SHA256_ASN1,
+    ECDSA_P256_SHA256_FIXED,
+    ECDSA_P384_SHA384_ASN1,
+    ECDSA_P384_SHA384_FIXED,
 }
 
 derive_debug_via_id!(EcdsaVerificationAlgorithm);
@@ -52,7 +55,13 @@ impl crate::sign::ecdsa::VerificationAlgorithm for EcdsaVerificationAlgorithm {
         public_key: untrusted::Input,
         msg: untrusted::Input,
         signature: untrusted::Input,
-    ) -> Result<()> {
+    ) -> SimpleResult<()> {
+        // Garbage is turned away before hashing the message.
+        self.precheck(
+            public_key.as_slice_less_safe(),
+            signature.as_slice_less_safe(),
+        )?;
+
         let e = {
             // NSA Guide Step 2: "Use the selected hash function to compute H =
             // Hash(M)."
@@ -68,13 +77,68 @@ impl crate::sign::ecdsa::VerificationAlgorithm for EcdsaVerificationAlgorithm {
 }
 
 impl EcdsaVerificationAlgorithm {
+    /// Checks the structure of `public_key` and `signature` without any
+    /// curve arithmetic: the public key must be an uncompressed point with
+    /// coordinates in range, and the signature must have the algorithm's
+    /// length and, for the ASN.1 algorithms, DER shape, with `r` and `s` in
+    /// [1, n-1]. A pair that fails can't verify; one that passes still may
+    /// not. See `crate::precheck` to check many at once.
+    pub fn precheck(&self, public_key: &[u8], signature: &[u8]) -> SimpleResult<()> {
+        let common = self.ops.public_key_ops.common;
+        precheck_uncompressed_point(common, public_key)?;
+
+        let scalar_len = self.ops.scalar_ops.scalar_bytes_len();
+        let (r, s) = match self.id {
+            AlgorithmID::ECDSA_P256_SHA256_FIXED | AlgorithmID::ECDSA_P384_SHA384_FIXED => {
+                if signature.len() != 2 * scalar_len {
+                    return Err(ErrorKind::CryptoError);
+                }
+                signature.split_at(scalar_len)
+            }
+            AlgorithmID::ECDSA_P256_SHA256_ASN1 | AlgorithmID::ECDSA_P384_SHA384_ASN1 => {
+                // Two INTEGERs, each at most a zero byte longer than a scalar.
+                let max_len = der_slice::tlv_len(2 * der_slice::tlv_len(scalar_len + 1));
+                if signature.len() > max_len {
+                    return Err(ErrorKind::CryptoError);
+                }
+                der_slice::read_ecdsa_sig(signature)?
+            }
+        };
+        scalar_parse_big_endian_variable(common, limb::AllowZero::No, untrusted::Input::from(r))?;
+        scalar_parse_big_endian_variable(common, limb::AllowZero::No, untrusted::Input::from(s))?;
+        Ok(())
+    }
+
+    /// Identifies the algorithm among the `ECDSA_*` verification algorithms.
+    pub(crate) fn id(&self) -> u8 {
+        self.id as u8
+    }
+
+    /// Hashes `msg` as `verify()` does before any arithmetic.
+    pub(crate) fn digest(&self, msg: &[u8]) -> digest::Digest {
+        digest::digest(self.digest_alg, msg)
+    }
+
+    /// `verify()`, for a message already hashed with `digest()`.
+    pub(crate) fn verify_hash(
+        &self,
+        public_key: untrusted::Input,
+        h: digest::Digest,
+        signature: untrusted::Input,
+    ) -> SimpleResult<()> {
+        self.verify_digest(public_key, digest_scalar(self.ops.scalar_ops, h), signature)
+    }
+
     /// This is intentionally not public.
+    ///
+    /// Every rejection is a bare `ErrorKind`, so that a flood of bad
+    /// signatures costs no allocation and no more than the arithmetic.
     fn verify_digest(
         &self,
         public_key: untrusted::Input,
         e: Scalar,
         signature: untrusted::Input,
-    ) -> Result<()> {
+    ) -> SimpleResult<()> {
         // NSA Suite B Implementer's Guide to ECDSA Section 3.4.2.
 
         let public_key_ops = self.ops.public_key_ops;
@@ -99,7 +163,7 @@ impl EcdsaVerificationAlgorithm {
         // handled by `parse_uncompressed_point`.
         let peer_pub_key = parse_uncompressed_point(public_key_ops, public_key)?;
 
-        let (r, s) = signature.read_all(Error::from(ErrorKind::CryptoError), |input| {
+        let (r, s) = signature.read_all(ErrorKind::CryptoError, |input| {
             (self.split_rs)(scalar_ops, input)
         })?;
 
@@ -160,7 +224,7 @@ impl EcdsaVerificationAlgorithm {
             }
         }
 
-        Err(Error::from(ErrorKind::CryptoError))
+        Err(ErrorKind::CryptoError)
     }
 }
 
@@ -188,18 +252,146 @@ pub static ECDSA_P256_SHA256_ASN1: EcdsaVerificationAlgorithm = EcdsaVerificatio
     id: AlgorithmID::ECDSA_P256_SHA256_ASN1,
 };
 
+/// Verification of fixed-length (PKCS#11 style) ECDSA signatures using the
+/// P-256 curve and SHA-256.
+pub static ECDSA_P256_SHA256_FIXED: EcdsaVerificationAlgorithm = EcdsaVerificationAlgorithm {
+    ops: &p256::PUBLIC_SCALAR_OPS,
+    digest_alg: &ring::digest::SHA256,
+    split_rs: split_rs_fixed,
+    id: AlgorithmID::ECDSA_P256_SHA256_FIXED,
+};
+
+/// Verification of ASN.1 DER-encoded ECDSA signatures using the P-384 curve
+/// and SHA-384.
+pub static ECDSA_P384_SHA384_ASN1: EcdsaVerificationAlgorithm = EcdsaVerificationAlgorithm {
+    ops: &p384::PUBLIC_SCALAR_OPS,
+    digest_alg: &ring::digest::SHA384,
+    split_rs: split_rs_asn1,
+    id: AlgorithmID::ECDSA_P384_SHA384_ASN1,
+};
+
+/// Verification of fixed-length (PKCS#11 style) ECDSA signatures using the
+/// P-384 curve and SHA-384.
+pub static ECDSA_P384_SHA384_FIXED: EcdsaVerificationAlgorithm = EcdsaVerificationAlgorithm {
+    ops: &p384::PUBLIC_SCALAR_OPS,
+    digest_alg: &ring::digest::SHA384,
+    split_rs: split_rs_fixed,
+    id: AlgorithmID::ECDSA_P384_SHA384_FIXED,
+};
+
+fn split_rs_fixed<'a>(
+    ops: &'static ScalarOps,
+    input: &mut untrusted::Reader<'a>,
+) -> SimpleResult<(untrusted::Input<'a>, untrusted::Input<'a>)> {
+    let scalar_len = ops.scalar_bytes_len();
+    let r = input
+        .read_bytes(scalar_len)
+        .map_err(|_| ErrorKind::CryptoError)?;
+    let s = input
+        .read_bytes(scalar_len)
+        .map_err(|_| ErrorKind::CryptoError)?;
+    Ok((r, s))
+}
+
 fn split_rs_asn1<'a>(
     _ops: &'static ScalarOps,
     input: &mut untrusted::Reader<'a>,
-) -> Result<(untrusted::Input<'a>, untrusted::Input<'a>)> {
-    der::nested(
-        input,
-        der::Tag::Sequence,
-        Error::from(ErrorKind::CryptoError),
-        |input| {
-            let r = der::positive_integer(input)?.big_endian_without_leading_zero_as_input();
-            let s = der::positive_integer(input)?.big_endian_without_leading_zero_as_input();
-            Ok((r, s))
+) -> SimpleResult<(untrusted::Input<'a>, untrusted::Input<'a>)> {
+    let (r, s) = der_slice::read_ecdsa_sig(input.read_bytes_to_end().as_slice_less_safe())?;
+    Ok((untrusted::Input::from(r), untrusted::Input::from(s)))
+}
+
+#[cfg(feature = "internal_benches")]
+mod internal_benches {
+    use super::*;
+    use crate::{
+        io::der,
+        sign::ecdsa::{
+            EcdsaKeyPair, EcdsaSigningAlgorithm, KeyPair, VerificationAlgorithm,
+            ECDSA_P256_SHA256_ASN1_SIGNING, ECDSA_P256_SHA256_FIXED_SIGNING,
         },
-    )
+    };
+    extern crate test;
+
+    const MSG: &[u8] = b"parse and verify";
+
+    fn signed(alg: &'static EcdsaSigningAlgorithm) -> (EcdsaKeyPair, Vec<u8>) {
+        let seed = [0x5au8; 32];
+        let key_pair =
+            EcdsaKeyPair::from_seed_unchecked(alg, untrusted::Input::from(&seed)).unwrap();
+        let sig = key_pair.sign(MSG).unwrap().as_ref().to_vec();
+        (key_pair, sig)
+    }
+
+    // The closure-based parser that `split_rs_asn1` used before `der_slice`.
+    fn split_rs_asn1_nested<'a>(
+        input: &mut untrusted::Reader<'a>,
+    ) -> Result<(untrusted::Input<'a>, untrusted::Input<'a>)> {
+        der::nested(
+            input,
+            der::Tag::Sequence,
+            Error::from(ErrorKind::CryptoError),
+            |input| {
+                let r = der::positive_integer(input)?.big_endian_without_leading_zero_as_input();
+                let s = der::positive_integer(input)?.big_endian_without_leading_zero_as_input();
+                Ok((r, s))
+            },
+        )
+    }
+
+    #[bench]
+    fn split_rs_asn1_bench(bench: &mut test::Bencher) {
+        let (_, sig) = signed(&ECDSA_P256_SHA256_ASN1_SIGNING);
+        bench.iter(|| {
+            let sig = untrusted::Input::from(test::black_box(&sig[..]));
+            let _ = sig.read_all(ErrorKind::CryptoError, |input| {
+                split_rs_asn1(&p256::SCALAR_OPS, input)
+            });
+        });
+    }
+
+    #[bench]
+    fn split_rs_asn1_nested_bench(bench: &mut test::Bencher) {
+        let (_, sig) = signed(&ECDSA_P256_SHA256_ASN1_SIGNING);
+        bench.iter(|| {
+            let sig = untrusted::Input::from(test::black_box(&sig[..]));
+            let _ = sig.read_all(Error::from(ErrorKind::CryptoError), split_rs_asn1_nested);
+        });
+    }
+
+    fn bench_verify(
+        bench: &mut test::Bencher,
+        sign_alg: &'static EcdsaSigningAlgorithm,
+        verify_alg: &'static EcdsaVerificationAlgorithm,
+    ) {
+        let (key_pair, sig) = signed(sign_alg);
+        let public_key = key_pair.public_key().as_ref();
+        bench.iter(|| {
+            verify_alg
+                .verify(
+                    untrusted::Input::from(public_key),
+                    untrusted::Input::from(MSG),
+                    untrusted::Input::from(test::black_box(&sig[..])),
+                )
+                .unwrap();
+        });
+    }
+
+    #[bench]
+    fn verify_p256_asn1_bench(bench: &mut test::Bencher) {
+        bench_verify(
+            bench,
+            &ECDSA_P256_SHA256_ASN1_SIGNING,
+            &ECDSA_P256_SHA256_ASN1,
+        );
+    }
+
+    #[bench]
+    fn verify_p256_fixed_bench(bench: &mut test::Bencher) {
+        bench_verify(
+            bench,
+            &ECDSA_P256_SHA256_FIXED_SIGNING,
+            &ECDSA_P256_SHA256_FIXED,
+        );
+    }
 }
@@ -6,6 +6,7 @@ use std::prelude::v1::*;
 
 use crate::errors::Result;
 use crate::errors::*;
+use crate::metrics::{self, EciesFailure, Op};
 use crate::ring::aead::BoundKey;
 use crate::ring::digest;
 use bytes::{BufMut, BytesMut};
@@ -21,19 +22,48 @@ const INITIAL_SALT: [u8; 20] = [
 ];
 const LABEL: &[u8] = b"eigen-crypto";
 
-#[allow(non_snake_case)]
+// The AES-GCM nonce and tag prepended to the ciphertext.
+const AES_OVERHEAD: usize = 12 + 16;
+// HMAC-SHA256
+const TAG_LEN: usize = 32;
+
+/// The shortest ciphertext `decrypt()` accepts: R, then the AES-GCM nonce,
+/// tag and at least one byte of ciphertext, then the HMAC tag.
+pub const MIN_CIPHERTEXT_LEN: usize = 65 + AES_OVERHEAD + 1 + TAG_LEN;
+
+/// Checks the structure of the ciphertext `c` without any curve arithmetic:
+/// its length, and that R is an uncompressed encoding of a P-256 point with
+/// coordinates in range. A ciphertext that fails can't be decrypted; one
+/// that passes still may not. See `crate::precheck` to check many at once.
+pub fn precheck(c: &[u8]) -> SimpleResult<()> {
+    if c.len() < MIN_CIPHERTEXT_LEN {
+        return Err(ErrorKind::CryptoError);
+    }
+    super::public_key::precheck_uncompressed_point(&super::ops::p256::COMMON_OPS, &c[..65])
+}
+
 pub fn encrypt<B: AsRef<[u8]>>(
     public_key: &crate::sign::ecdsa::UnparsedPublicKey<B>,
     s1: &[u8],
     s2: &[u8],
     msg: &[u8],
+) -> Result<Vec<u8>> {
+    metrics::observe(Op::EciesEncrypt, || encrypt_(public_key, s1, s2, msg))
+}
+
+#[allow(non_snake_case)]
+fn encrypt_<B: AsRef<[u8]>>(
+    public_key: &crate::sign::ecdsa::UnparsedPublicKey<B>,
+    s1: &[u8],
+    s2: &[u8],
+    msg: &[u8],
 ) -> Result<Vec<u8>> {
     let public_key_ops = &super::ops::p256::PUBLIC_KEY_OPS;
     let private_key_ops = &super::ops::p256::PRIVATE_KEY_OPS;
     let common_ops = &super::ops::p256::COMMON_OPS;
 
     // generate random r
-    let mut r = vec![0u8; 32];
+    let mut r = [0u8; 32];
     rand::thread_rng().fill(&mut r[..]);
     let sk = crate::sign::ecdsa::EcdsaKeyPair::from_seed_unchecked(
         &crate::sign::ecdsa::ECDSA_P256_SHA256_ASN1_SIGNING,
@@ -50,108 +80,124 @@ pub fn encrypt<B: AsRef<[u8]>>(
     let d = super::scalar_parse_big_endian_variable(
         common_ops,
         crate::limb::AllowZero::No,
-        untrusted::Input::from(&sk.seed_as_bytes()),
+        untrusted::Input::from(sk.seed_less_safe()),
     )?;
     // P = r * K_b
     let P = private_key_ops.point_mul(&d, &K_b);
 
-    let mut actual_result = vec![4u8; 1 + (2 * (common_ops.num_limbs * crate::limb::LIMB_BYTES))];
-    let (x, y) = actual_result[1..].split_at_mut(common_ops.num_limbs * crate::limb::LIMB_BYTES);
+    let elem_len = common_ops.num_limbs * crate::limb::LIMB_BYTES;
+    // On the stack rather than in the thread's scratch arena, which outlives
+    // the call and would keep the shared point around.
+    let mut actual_result = [4u8; 1 + 2 * crate::ec::ELEM_MAX_BYTES];
+    let (x, y) = actual_result[1..(1 + 2 * elem_len)].split_at_mut(elem_len);
     super::private_key::big_endian_affine_from_jacobian(private_key_ops, Some(x), Some(y), &P)?;
     // k_e, k_m = KDF(S || S_1)
     let (k_e, k_m) = deriveKeys(&x, &s1)?;
 
-    let c = aes_encrypt_less_safe(&k_e, msg)?;
-    let d = message_tag(&k_m, &c, s2)?;
-
-    //R || c || d
-    let mut res = vec![0u8; 65];
-    res.copy_from_slice(R.as_ref());
-    res.extend_from_slice(&c);
-    res.extend_from_slice(&d);
+    //R || c || d, with c encrypted and tagged in place
+    let c_len = AES_OVERHEAD + msg.len();
+    let mut res = vec![0u8; 65 + c_len + TAG_LEN];
+    res[..65].copy_from_slice(R.as_ref());
+    aes_encrypt_less_safe_into(&k_e, msg, &mut res[65..(65 + c_len)]);
+    let d = message_tag(&k_m, &res[65..(65 + c_len)], s2);
+    res[(65 + c_len)..].copy_from_slice(d.as_ref());
     Ok(res)
 }
 
-#[allow(non_snake_case)]
 pub fn decrypt(sk: &EcdsaKeyPair, c: &[u8], s1: &[u8], s2: &[u8]) -> Result<Vec<u8>> {
+    metrics::observe(Op::EciesDecrypt, || decrypt_(sk, c, s1, s2))
+}
+
+#[allow(non_snake_case)]
+fn decrypt_(sk: &EcdsaKeyPair, c: &[u8], s1: &[u8], s2: &[u8]) -> Result<Vec<u8>> {
     let public_key_ops = &super::ops::p256::PUBLIC_KEY_OPS;
     let private_key_ops = &super::ops::p256::PRIVATE_KEY_OPS;
     let common_ops = &super::ops::p256::COMMON_OPS;
+    precheck(c).map_err(|kind| {
+        metrics::ecies_failure(EciesFailure::Malformed);
+        kind
+    })?;
     let R = &c[0..65];
-    let R =
-        super::public_key::parse_uncompressed_point(&public_key_ops, untrusted::Input::from(R))?;
+    let R = super::public_key::parse_uncompressed_point(&public_key_ops, untrusted::Input::from(R))
+        .map_err(|e| {
+            metrics::ecies_failure(EciesFailure::InvalidPoint);
+            e
+        })?;
     // S = P_x, P = (P_x, P_y) = k_B * R
     let k_B = super::scalar_parse_big_endian_variable(
         common_ops,
         crate::limb::AllowZero::No,
-        // seed_as_bytes returns the real key !!!!!
-        untrusted::Input::from(&sk.seed_as_bytes()),
+        untrusted::Input::from(sk.seed_less_safe()),
     )?;
 
     let P = private_key_ops.point_mul(&k_B, &R);
 
-    let mut actual_result = vec![4u8; 1 + (2 * (common_ops.num_limbs * crate::limb::LIMB_BYTES))];
-    let (x, y) = actual_result[1..].split_at_mut(common_ops.num_limbs * crate::limb::LIMB_BYTES);
+    let elem_len = common_ops.num_limbs * crate::limb::LIMB_BYTES;
+    let mut actual_result = [4u8; 1 + 2 * crate::ec::ELEM_MAX_BYTES];
+    let (x, y) = actual_result[1..(1 + 2 * elem_len)].split_at_mut(elem_len);
     super::private_key::big_endian_affine_from_jacobian(private_key_ops, Some(x), Some(y), &P)?;
-
     // k_e, k_m = KDF(S || S_1)
     let (k_e, k_m) = deriveKeys(&x, &s1)?;
 
-    let cc = &c[65..(c.len() - 32)];
-    let d = message_tag(&k_m, cc, s2)?;
-    let dd = &c[(c.len() - 32)..];
+    let cc = &c[65..(c.len() - TAG_LEN)];
+    let d = message_tag(&k_m, cc, s2);
+    let dd = &c[(c.len() - TAG_LEN)..];
     // compare k_m and  d
-    if d != dd {
-        return Err(Error::from(ErrorKind::CryptoError));
-    }
-
-    let m = aes_decrypt_less_safe(&k_e, cc)?;
+    ring::constant_time::verify_slices_are_equal(d.as_ref(), dd).map_err(|_| {
+        metrics::ecies_failure(EciesFailure::TagMismatch);
+        Error::from(ErrorKind::CryptoError)
+    })?;
+
+    let m = aes_decrypt_less_safe(&k_e, cc).map_err(|e| {
+        metrics::ecies_failure(EciesFailure::Decryption);
+        e
+    })?;
     return Ok(m);
 }
 
 //TODO: https://github.com/ethereum/go-ethereum/blob/master/crypto/ecies/ecies.go#L146
-fn deriveKeys(key: &[u8], s1: &[u8]) -> Result<(Vec<u8>, Vec<u8>)> {
-    let mut concat_key = vec![];
-    concat_key.extend_from_slice(&key);
-    concat_key.extend_from_slice(&s1);
-    let secret = digest::digest(&digest::SHA512, &concat_key)
-        .as_ref()
-        .to_vec();
-    let (k_e, k_m) = secret.split_at(secret.len() / 2);
-    Ok((k_e.to_vec(), k_m.to_vec()))
+fn deriveKeys(key: &[u8], s1: &[u8]) -> Result<([u8; 32], [u8; 32])> {
+    let mut ctx = digest::Context::new(&digest::SHA512);
+    ctx.update(key);
+    ctx.update(s1);
+    let secret = ctx.finish();
+    let (e, m) = secret.as_ref().split_at(32);
+    let mut k_e = [0u8; 32];
+    let mut k_m = [0u8; 32];
+    k_e.copy_from_slice(e);
+    k_m.copy_from_slice(m);
+    Ok((k_e, k_m))
 }
 
-fn message_tag(k_m: &[u8], c: &[u8], s2: &[u8]) -> Result<Vec<u8>> {
-    let mut msg = vec![];
-    msg.extend_from_slice(c);
-    msg.extend_from_slice(s2);
+fn message_tag(k_m: &[u8], c: &[u8], s2: &[u8]) -> ring::hmac::Tag {
     let s_key = ring::hmac::Key::new(ring::hmac::HMAC_SHA256, &k_m);
-    let signature = ring::hmac::sign(&s_key, &msg);
-    Ok(signature.as_ref().to_vec())
+    let mut ctx = ring::hmac::Context::with_key(&s_key);
+    ctx.update(c);
+    ctx.update(s2);
+    ctx.sign()
 }
 
 // we set IV equal to nonce, less safer compared to aes_encrypt
 pub fn aes_encrypt_less_safe(key: &[u8], msg: &[u8]) -> Result<Vec<u8>> {
+    let mut result = vec![0u8; AES_OVERHEAD + msg.len()];
+    aes_encrypt_less_safe_into(key, msg, &mut result);
+    Ok(result)
+}
+
+// Writes nonce || tag || ciphertext into `out`, which must be exactly
+// `AES_OVERHEAD` bytes longer than `msg`.
+fn aes_encrypt_less_safe_into(key: &[u8], msg: &[u8], out: &mut [u8]) {
     let add = [0u8; 0];
-    let mut nonce = [0u8; 12];
+    let (nonce, rest) = out.split_at_mut(12);
+    let (tag, output) = rest.split_at_mut(16);
     rand::thread_rng().fill(&mut nonce[..]);
     let mut cipher = AesGcm::new(
         KeySize::KeySize256,
-        key,    //32
-        &nonce, //12
+        key,   //32
+        nonce, //12
         &add,
     ); //0
-    let mut output = vec![0u8; msg.len()];
-
-    let mut tag = [0u8; 16];
-
-    cipher.encrypt(msg, &mut output, &mut tag);
-
-    let mut result = BytesMut::with_capacity(output.len() + nonce.len() + tag.len());
-    result.put_slice(&nonce);
-    result.put_slice(&tag);
-    result.put_slice(&output);
-    Ok(result.to_vec())
+    cipher.encrypt(msg, output, tag);
 }
 
 pub fn aes_decrypt_less_safe(key: &[u8], c: &[u8]) -> Result<Vec<u8>> {
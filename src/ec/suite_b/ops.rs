@@ -14,10 +14,11 @@
 
 use std::prelude::v1::*;
 use crate::{
-    arithmetic::montgomery::*,
+    arithmetic::{montgomery::*, safegcd::limbs_inverse_consttime},
     c,
     errors::{Error, ErrorKind, Result},
     limb::*,
+    metrics,
 };
 
 use core::marker::PhantomData;
@@ -41,6 +42,9 @@ pub type Scalar<E = Unencoded> = elem::Elem<N, E>;
 #[derive(Clone, Copy)]
 pub enum N {}
 
+// `repr(transparent)` lets `select_consttime` treat a table of points as a
+// table of limb arrays.
+#[repr(transparent)]
 pub struct Point {
     // The coordinates are stored in a contiguous array, where the first
     // `ops.num_limbs` elements are the X coordinate, the next
@@ -56,6 +60,21 @@ impl Point {
             xyz: [0; 3 * MAX_LIMBS],
         }
     }
+
+    /// Returns a copy of `table[index]`, or the point at infinity if `index`
+    /// is out of range, without leaking `index` through the memory access
+    /// pattern or timing. See `limbs_select_consttime`.
+    pub fn select_consttime(table: &[Point], index: usize) -> Point {
+        let table = unsafe {
+            core::slice::from_raw_parts(
+                table.as_ptr() as *const [Limb; 3 * MAX_LIMBS],
+                table.len(),
+            )
+        };
+        Point {
+            xyz: limbs_select_consttime(table, index),
+        }
+    }
 }
 
 static ONE: Elem<Unencoded> = Elem {
@@ -64,6 +83,12 @@ static ONE: Elem<Unencoded> = Elem {
     encoding: PhantomData,
 };
 
+static SCALAR_ONE: Scalar<Unencoded> = Scalar {
+    limbs: limbs![1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0],
+    m: PhantomData,
+    encoding: PhantomData,
+};
+
 /// Operations and values needed by all curve operations.
 pub struct CommonOps {
     pub num_limbs: usize,
@@ -189,8 +214,19 @@ impl PrivateKeyOps {
         (self.point_mul_base_impl)(a)
     }
 
+    /// Sets `out[i]` = `scalars[i]` * G, for batches of keys or nonces
+    /// generated at once. `scalars` and `out` must be equally long.
+    #[inline]
+    pub fn point_mul_base_batch(&self, scalars: &[Scalar], out: &mut [Point]) {
+        assert_eq!(scalars.len(), out.len());
+        for (scalar, out) in scalars.iter().zip(out.iter_mut()) {
+            *out = self.point_mul_base(scalar);
+        }
+    }
+
     #[inline(always)]
     pub fn point_mul(&self, p_scalar: &Scalar, (p_x, p_y): &(Elem<R>, Elem<R>)) -> Point {
+        let timer = metrics::Timer::start(metrics::Op::PointMul);
         let mut r = Point::new_at_infinity();
         unsafe {
             (self.point_mul_impl)(
@@ -200,6 +236,7 @@ impl PrivateKeyOps {
                 p_y.limbs.as_ptr(),
             );
         }
+        timer.finish(true);
         r
     }
 
@@ -353,6 +390,106 @@ pub fn scalar_sum(ops: &CommonOps, a: &Scalar, b: &Scalar) -> Scalar {
     r
 }
 
+/// Returns a**-2 (mod q) like `PrivateKeyOps::elem_inverse_squared`, using
+/// the constant-time safegcd inverter instead of an addition chain.
+pub fn elem_inv_squared_safegcd(ops: &CommonOps, a: &Elem<R>) -> Elem<R> {
+    let num_limbs = ops.num_limbs;
+
+    // Inverting a*R gives a**-1 * R**-1; each multiplication by R**2 (mod q)
+    // adds one R factor back.
+    let mut a_inv: Elem<RInverse> = Elem::zero();
+    limbs_inverse_consttime(
+        &mut a_inv.limbs[..num_limbs],
+        &a.limbs[..num_limbs],
+        &ops.q.p[..num_limbs],
+    );
+    let rr: Elem<RR> = Elem {
+        limbs: ops.q.rr,
+        m: PhantomData,
+        encoding: PhantomData,
+    };
+    let a_inv: Elem<Unencoded> = ops.elem_product(&rr, &a_inv);
+    let a_inv: Elem<R> = ops.elem_product(&rr, &a_inv);
+    ops.elem_squared(&a_inv)
+}
+
+/// Returns a**-1 (mod n) like `ScalarOps::scalar_inv_to_mont`, using the
+/// constant-time safegcd inverter instead of an addition chain. `n_rr` is
+/// R**2 (mod n).
+pub fn scalar_inv_to_mont_safegcd(ops: &ScalarOps, n_rr: &Scalar<RR>, a: &Scalar) -> Scalar<R> {
+    let num_limbs = ops.common.num_limbs;
+    let mut a_inv: Scalar<Unencoded> = Scalar::zero();
+    limbs_inverse_consttime(
+        &mut a_inv.limbs[..num_limbs],
+        &a.limbs[..num_limbs],
+        &ops.common.n.limbs[..num_limbs],
+    );
+    ops.scalar_product(n_rr, &a_inv)
+}
+
+/// Replaces each of `elems` with its inverse using Montgomery's trick, so that
+/// inverting n elements costs one inversion and 3(n - 1) multiplications
+/// instead of n inversions. This is the building block for converting many
+/// Jacobian points to affine coordinates at once, and for batch verification
+/// and key derivation.
+///
+/// The inputs and the results are Montgomery-encoded. If any element is zero
+/// then `elems` is left unchanged and an error is returned, without revealing
+/// which element it was.
+pub fn batch_invert(ops: &PrivateKeyOps, elems: &mut [Elem<R>]) -> Result<()> {
+    let cops = ops.common;
+    batch_invert_(cops, cops.elem_mul_mont, elems, |a| {
+        // a**-1 == a * a**-2.
+        cops.elem_product(a, &ops.elem_inverse_squared(a))
+    })
+}
+
+/// Like `batch_invert`, for scalars, i.e. modulo the group order *n*.
+pub fn batch_invert_scalars(ops: &ScalarOps, scalars: &mut [Scalar<R>]) -> Result<()> {
+    batch_invert_(ops.common, ops.scalar_mul_mont, scalars, |a| {
+        // `scalar_inv_to_mont` takes an unencoded scalar; decoding `a` first
+        // keeps its result Montgomery-encoded.
+        ops.scalar_inv_to_mont(&ops.scalar_product(a, &SCALAR_ONE))
+    })
+}
+
+fn batch_invert_<M: Copy + 'static>(
+    ops: &CommonOps,
+    elem_mul_mont: unsafe extern "C" fn(r: *mut Limb, a: *const Limb, b: *const Limb),
+    elems: &mut [elem::Elem<M, R>],
+    inv: impl FnOnce(&elem::Elem<M, R>) -> elem::Elem<M, R>,
+) -> Result<()> {
+    let len = elems.len();
+    if len == 0 {
+        return Ok(());
+    }
+
+    crate::arena::with_scratch(|scratch| {
+        // products[i] = elems[0] * ... * elems[i].
+        let products = scratch.alloc(len, elems[0]);
+        for i in 1..len {
+            products[i] = mul_mont(elem_mul_mont, &products[i - 1], &elems[i]);
+        }
+
+        if ops.is_zero(&products[len - 1]) {
+            return Err(Error::from(ErrorKind::CryptoError));
+        }
+
+        // Walk back down, peeling one factor off the inverted product at a
+        // time: with acc == (elems[0] * ... * elems[i])**-1, elems[i]**-1 is
+        // acc * products[i - 1], and acc * elems[i] is the next acc.
+        let mut acc = inv(&products[len - 1]);
+        for i in (1..len).rev() {
+            let a = elems[i];
+            elems[i] = mul_mont(elem_mul_mont, &acc, &products[i - 1]);
+            acc = mul_mont(elem_mul_mont, &acc, &a);
+        }
+        elems[0] = acc;
+
+        Ok(())
+    })
+}
+
 // Returns (`a` squared `squarings` times) * `b`.
 fn elem_sqr_mul(ops: &CommonOps, a: &Elem<R>, squarings: usize, b: &Elem<R>) -> Elem<R> {
     debug_assert!(squarings >= 1);
@@ -773,6 +910,213 @@ mod tests {
         let _ = p384::SCALAR_OPS.scalar_inv_to_mont(&ZERO_SCALAR);
     }
 
+    #[cfg(feature = "p256_backends")]
+    #[test]
+    fn p256_dispatch_test() {
+        use super::dispatch::{self, Backend, BackendGuard};
+
+        let _guard = BackendGuard::new();
+        for &b in &[Backend::Portable, Backend::Adx, Backend::Avx2] {
+            if dispatch::set_backend(b).is_err() {
+                continue;
+            }
+            elem_mul_test(&p256::COMMON_OPS, test_file!("ops/p256_elem_mul_tests.txt"));
+            scalar_mul_test(
+                &p256::SCALAR_OPS,
+                test_file!("ops/p256_scalar_mul_tests.txt"),
+            );
+
+            // Every product of the vectors, four at a time.
+            let cops = &p256::COMMON_OPS;
+            let mut a = [Elem::zero(); 4];
+            let mut b = [Elem::zero(); 4];
+            let mut expected = [Elem::zero(); 4];
+            let mut i = 0;
+            test::run(test_file!("ops/p256_elem_mul_tests.txt"), |section, test_case| {
+                assert_eq!(section, "");
+                a[i % 4] = consume_elem(cops, test_case, "a");
+                b[i % 4] = consume_elem(cops, test_case, "b");
+                expected[i % 4] = consume_elem(cops, test_case, "r");
+                i += 1;
+                if i % 4 == 0 {
+                    let actual = p256::elem_product_x4(&a, &b);
+                    for (actual, expected) in actual.iter().zip(expected.iter()) {
+                        assert_limbs_are_equal(cops, &actual.limbs, &expected.limbs);
+                    }
+                }
+                Ok(())
+            });
+        }
+    }
+
+    #[test]
+    fn point_select_consttime_test() {
+        let table: Vec<Point> = (0..5)
+            .map(|i| {
+                let mut p = Point::new_at_infinity();
+                for (j, limb) in p.xyz.iter_mut().enumerate() {
+                    *limb = ((i as Limb) << 8) | (j as Limb);
+                }
+                p
+            })
+            .collect();
+        for (i, expected) in table.iter().enumerate() {
+            assert_eq!(&Point::select_consttime(&table, i).xyz[..], &expected.xyz[..]);
+        }
+        let infinity = Point::new_at_infinity();
+        assert_eq!(&Point::select_consttime(&table, 5).xyz[..], &infinity.xyz[..]);
+    }
+
+    #[test]
+    fn p256_point_mul_base_batch_test() {
+        point_mul_base_batch_test(
+            &p256::PRIVATE_KEY_OPS,
+            test_file!("ops/p256_point_mul_base_tests.txt"),
+        );
+    }
+
+    #[test]
+    fn p384_point_mul_base_batch_test() {
+        point_mul_base_batch_test(
+            &p384::PRIVATE_KEY_OPS,
+            test_file!("ops/p384_point_mul_base_tests.txt"),
+        );
+    }
+
+    // Multiplies all of the vectors' scalars in one batch, and also the
+    // first 13.
+    fn point_mul_base_batch_test(ops: &PrivateKeyOps, test_file: test::File) {
+        let mut scalars = Vec::new();
+        let mut expected = Vec::new();
+        test::run(test_file, |section, test_case| {
+            assert_eq!(section, "");
+            scalars.push(consume_scalar(ops.common, test_case, "g_scalar"));
+            expected.push(consume_point(ops, test_case, "r"));
+            Ok(())
+        });
+
+        for &len in &[scalars.len(), 13] {
+            let mut actual: Vec<Point> = (0..len).map(|_| Point::new_at_infinity()).collect();
+            ops.point_mul_base_batch(&scalars[..len], &mut actual);
+            for (actual, expected) in actual.iter().zip(expected.iter()) {
+                assert_point_actual_equals_expected(ops, actual, expected);
+            }
+        }
+    }
+
+    #[test]
+    fn p256_inverse_safegcd_test() {
+        inverse_safegcd_test(
+            &p256::PRIVATE_SCALAR_OPS,
+            p256::p256_elem_inv_squared,
+            p256::p256_scalar_inv_to_mont,
+            test_file!("ops/p256_elem_mul_tests.txt"),
+            test_file!("ops/p256_scalar_mul_tests.txt"),
+        );
+    }
+
+    #[test]
+    fn p384_inverse_safegcd_test() {
+        inverse_safegcd_test(
+            &p384::PRIVATE_SCALAR_OPS,
+            p384::p384_elem_inv_squared,
+            p384::p384_scalar_inv_to_mont,
+            test_file!("ops/p384_elem_mul_tests.txt"),
+            test_file!("ops/p384_scalar_mul_tests.txt"),
+        );
+    }
+
+    // Checks the safegcd inverses against the Fermat addition chains, for
+    // every input and output of the multiplication test vectors.
+    fn inverse_safegcd_test(
+        ops: &PrivateScalarOps,
+        elem_inv_squared_fermat: fn(&Elem<R>) -> Elem<R>,
+        scalar_inv_to_mont_fermat: fn(&Scalar) -> Scalar<R>,
+        elem_test_file: test::File,
+        scalar_test_file: test::File,
+    ) {
+        let cops = ops.scalar_ops.common;
+
+        test::run(elem_test_file, |section, test_case| {
+            assert_eq!(section, "");
+            for name in &["a", "b", "r"] {
+                let a = consume_elem(cops, test_case, name);
+                let actual = elem_inv_squared_safegcd(cops, &a);
+                let expected = elem_inv_squared_fermat(&a);
+                assert_limbs_are_equal(cops, &actual.limbs, &expected.limbs);
+            }
+            Ok(())
+        });
+
+        test::run(scalar_test_file, |section, test_case| {
+            assert_eq!(section, "");
+            let a = consume_scalar(cops, test_case, "a");
+            let b = consume_scalar(cops, test_case, "b");
+            let r = consume_scalar(cops, test_case, "r");
+            for a in &[a, b, r] {
+                let actual = scalar_inv_to_mont_safegcd(ops.scalar_ops, &ops.oneRR_mod_n, a);
+                let expected = scalar_inv_to_mont_fermat(a);
+                assert_limbs_are_equal(cops, &actual.limbs, &expected.limbs);
+            }
+            Ok(())
+        });
+    }
+
+    #[test]
+    fn p256_batch_invert_test() {
+        batch_invert_test(&p256::PRIVATE_KEY_OPS, &p256::SCALAR_OPS);
+    }
+
+    #[test]
+    fn p384_batch_invert_test() {
+        batch_invert_test(&p384::PRIVATE_KEY_OPS, &p384::SCALAR_OPS);
+    }
+
+    fn batch_invert_test(ops: &PrivateKeyOps, scalar_ops: &ScalarOps) {
+        let cops = ops.common;
+
+        // Distinct non-zero values below both q and n.
+        fn value<M: Copy>(i: usize) -> elem::Elem<M, R> {
+            let mut r = elem::Elem::zero();
+            r.limbs[0] = (i as Limb).wrapping_mul(0x9e37_79b9) | 1;
+            r.limbs[1] = i as Limb;
+            r
+        }
+
+        for &len in &[0, 1, 2, 3, 8, 17] {
+            let originals: Vec<Elem<R>> = (0..len).map(value).collect();
+            let mut elems = originals.clone();
+            batch_invert(ops, &mut elems).unwrap();
+            for (a, a_inv) in originals.iter().zip(elems.iter()) {
+                let expected = cops.elem_product(a, &ops.elem_inverse_squared(a));
+                assert_elems_are_equal(cops, a_inv, &expected);
+                let one = cops.elem_unencoded(&cops.elem_product(a, a_inv));
+                assert_limbs_are_equal(cops, &one.limbs, &ONE.limbs);
+            }
+
+            let originals: Vec<Scalar<R>> = (0..len).map(value).collect();
+            let mut scalars = originals.clone();
+            batch_invert_scalars(scalar_ops, &mut scalars).unwrap();
+            for (a, a_inv) in originals.iter().zip(scalars.iter()) {
+                let one =
+                    scalar_ops.scalar_product(&scalar_ops.scalar_product(a, a_inv), &SCALAR_ONE);
+                assert_limbs_are_equal(cops, &one.limbs, &SCALAR_ONE.limbs);
+            }
+        }
+
+        // A zero element fails the whole batch and leaves it unchanged.
+        let mut elems: Vec<Elem<R>> = (0..5).map(value).collect();
+        elems[3] = Elem::zero();
+        let before = elems.clone();
+        assert!(batch_invert(ops, &mut elems).is_err());
+        for (a, b) in elems.iter().zip(before.iter()) {
+            assert_limbs_are_equal(cops, &a.limbs, &b.limbs);
+        }
+        let mut scalars: Vec<Scalar<R>> = (0..5).map(value).collect();
+        scalars[0] = Scalar::zero();
+        assert!(batch_invert_scalars(scalar_ops, &mut scalars).is_err());
+    }
+
     #[test]
     fn p256_point_sum_test() {
         point_sum_test(
@@ -1207,7 +1551,7 @@ mod internal_benches {
 
 #[cfg(feature = "internal_benches")]
 macro_rules! bench_curve {
-    ( $vectors:expr ) => {
+    ( $elem_inv_squared_fermat:ident, $scalar_inv_to_mont_fermat:ident, $vectors:expr ) => {
         use super::super::{Elem, Scalar};
         extern crate test;
 
@@ -1223,6 +1567,15 @@ macro_rules! bench_curve {
             });
         }
 
+        #[bench]
+        fn elem_inverse_squared_fermat_bench(bench: &mut test::Bencher) {
+            let mut a = Elem::zero();
+            a.limbs[0] = 1;
+            bench.iter(|| {
+                let _ = $elem_inv_squared_fermat(&a);
+            });
+        }
+
         #[bench]
         fn elem_product_bench(bench: &mut test::Bencher) {
             // This benchmark assumes that the multiplication is constant-time
@@ -1244,6 +1597,33 @@ macro_rules! bench_curve {
             });
         }
 
+        #[bench]
+        fn batch_invert_16_bench(bench: &mut test::Bencher) {
+            // Like `elem_inverse_squared_bench()`, this assumes that the cost
+            // doesn't depend on the values.
+            let mut a = Elem::zero();
+            a.limbs[0] = 1;
+            let mut elems = [a; 16];
+            bench.iter(|| {
+                super::super::batch_invert(&PRIVATE_KEY_OPS, &mut elems).unwrap();
+            });
+        }
+
+        #[bench]
+        fn point_mul_base_bench(bench: &mut test::Bencher) {
+            const VECTORS: &[Scalar] = $vectors;
+            let vectors_len = VECTORS.len();
+            let mut i = 0;
+            bench.iter(|| {
+                let _ = PRIVATE_KEY_OPS.point_mul_base(&VECTORS[i]);
+
+                i += 1;
+                if i == vectors_len {
+                    i = 0;
+                }
+            });
+        }
+
         #[bench]
         fn scalar_inv_to_mont_bench(bench: &mut test::Bencher) {
             const VECTORS: &[Scalar] = $vectors;
@@ -1258,9 +1638,26 @@ macro_rules! bench_curve {
                 }
             });
         }
+
+        #[bench]
+        fn scalar_inv_to_mont_fermat_bench(bench: &mut test::Bencher) {
+            const VECTORS: &[Scalar] = $vectors;
+            let vectors_len = VECTORS.len();
+            let mut i = 0;
+            bench.iter(|| {
+                let _ = $scalar_inv_to_mont_fermat(&VECTORS[i]);
+
+                i += 1;
+                if i == vectors_len {
+                    i = 0;
+                }
+            });
+        }
     };
 }
 
+#[cfg(feature = "p256_backends")]
+pub mod dispatch;
 mod elem;
 pub mod p256;
 pub mod p384;
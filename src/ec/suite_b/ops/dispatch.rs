@@ -0,0 +1,375 @@
+// Runtime selection of the 256-bit Montgomery multiplication kernels.
+//
+// Only built with the `p256_backends` feature. The P-256 field and scalar
+// multiplications behind `CommonOps` and `ScalarOps` then go through the
+// entry points in this module, which forward to one of:
+//
+//   * `Avx2`:     the `Adx` kernels, plus four independent multiplications
+//                 per call in 256-bit registers for `mul_mont_x4`,
+//   * `Adx`:      Rust kernels built on MULX/ADCX/ADOX,
+//   * `Portable`: the `GFp_*` C/assembly entry points.
+//
+// `Portable` is the default everywhere: on x86_64 the `GFp_*` entry points
+// already switch to their own MULX/ADX assembly, which beats the Rust
+// kernels: about 31ns vs. 39ns per dependent multiplication, and 43ns per
+// product for `Avx2`, which has to normalize its 32-bit limbs after every
+// row. Without the feature `CommonOps` and `ScalarOps` bind the `GFp_*`
+// entry points directly, so the default build pays neither the atomic load
+// nor the match per multiplication. The other backends are opt-in through
+// `set_backend`, which checks CPUID; inside SGX CPUID is not available (and
+// not trustworthy), so those builds are pinned to `Portable`.
+
+use crate::limb::{Limb, LIMB_BITS};
+use core::sync::atomic::{AtomicU8, Ordering};
+
+#[derive(Clone, Copy, Debug, PartialEq, Eq)]
+pub enum Backend {
+    Portable = 1,
+    Adx = 2,
+    Avx2 = 3,
+}
+
+impl Backend {
+    /// Number of multiplications `mul_mont_x4` computes side by side.
+    pub fn lanes(self) -> usize {
+        match self {
+            Backend::Portable | Backend::Adx => 1,
+            Backend::Avx2 => 4,
+        }
+    }
+
+    fn from_u8(v: u8) -> Option<Backend> {
+        match v {
+            1 => Some(Backend::Portable),
+            2 => Some(Backend::Adx),
+            3 => Some(Backend::Avx2),
+            _ => None,
+        }
+    }
+
+    fn is_supported(self) -> bool {
+        match self {
+            Backend::Portable => true,
+            #[cfg(all(
+                target_arch = "x86_64",
+                not(any(feature = "mesalock_sgx", target_env = "sgx"))
+            ))]
+            Backend::Adx => is_x86_feature_detected!("bmi2") && is_x86_feature_detected!("adx"),
+            #[cfg(all(
+                target_arch = "x86_64",
+                not(any(feature = "mesalock_sgx", target_env = "sgx"))
+            ))]
+            Backend::Avx2 => Backend::Adx.is_supported() && is_x86_feature_detected!("avx2"),
+            #[allow(unreachable_patterns)]
+            _ => false,
+        }
+    }
+}
+
+static BACKEND: AtomicU8 = AtomicU8::new(0);
+
+fn detect() -> Backend {
+    // See the module comment for why this doesn't prefer `Adx` or `Avx2`.
+    Backend::Portable
+}
+
+/// The backend the P-256 multiplications dispatch to on this machine.
+pub fn backend() -> Backend {
+    if let Some(b) = Backend::from_u8(BACKEND.load(Ordering::Relaxed)) {
+        return b;
+    }
+    let b = detect();
+    BACKEND.store(b as u8, Ordering::Relaxed);
+    b
+}
+
+/// Overrides the detected backend, e.g. to compare implementations or to
+/// pin the portable path. Fails if the CPU does not support `b`, and for
+/// anything but `Portable` in SGX builds.
+pub fn set_backend(b: Backend) -> crate::errors::Result<()> {
+    if !b.is_supported() {
+        return Err(crate::errors::Error::from(
+            crate::errors::ErrorKind::ErrCryptographyNotSupported,
+        ));
+    }
+    BACKEND.store(b as u8, Ordering::Relaxed);
+    Ok(())
+}
+
+#[cfg(test)]
+lazy_static! {
+    static ref BACKEND_LOCK: std::sync::Mutex<()> = std::sync::Mutex::new(());
+}
+
+/// Held by a test or bench that switches the backend: it serializes such
+/// tests and restores the backend they found when dropped, so that a
+/// non-default kernel doesn't leak into the rest of the test binary.
+#[cfg(test)]
+pub(crate) struct BackendGuard {
+    previous: Backend,
+    _lock: std::sync::MutexGuard<'static, ()>,
+}
+
+#[cfg(test)]
+impl BackendGuard {
+    pub(crate) fn new() -> Self {
+        // A failed test poisons the lock, but has restored the backend.
+        let lock = BACKEND_LOCK.lock().unwrap_or_else(|e| e.into_inner());
+        Self {
+            previous: backend(),
+            _lock: lock,
+        }
+    }
+}
+
+#[cfg(test)]
+impl Drop for BackendGuard {
+    fn drop(&mut self) {
+        BACKEND.store(self.previous as u8, Ordering::Relaxed);
+    }
+}
+
+/// The number of limbs of a 256-bit value.
+pub const LIMBS_256: usize = 256 / LIMB_BITS;
+
+/// A 256-bit odd modulus, with `n0` == -m**-1 (mod 2**64).
+pub(super) struct Modulus256 {
+    pub m: [u64; 4],
+    pub n0: u64,
+}
+
+/// Sets `r` = `a` * `b` / 2**256 (mod `m`), through `backend`. `portable` is
+/// the `GFp_*` entry point for `m`.
+#[inline]
+#[cfg_attr(not(target_arch = "x86_64"), allow(unused_variables))]
+pub(super) unsafe fn mul_mont(
+    backend: Backend,
+    portable: unsafe extern "C" fn(r: *mut Limb, a: *const Limb, b: *const Limb),
+    m: &Modulus256,
+    r: *mut Limb,
+    a: *const Limb,
+    b: *const Limb,
+) {
+    match backend {
+        #[cfg(all(
+            target_arch = "x86_64",
+            not(any(feature = "mesalock_sgx", target_env = "sgx"))
+        ))]
+        Backend::Adx | Backend::Avx2 => {
+            let a = &*(a as *const [u64; 4]);
+            let b = &*(b as *const [u64; 4]);
+            let product = x86_64::mul_mont_adx(a, b, m);
+            *(r as *mut [u64; 4]) = product;
+        }
+        _ => portable(r, a, b),
+    }
+}
+
+/// Sets `r` = `a`**2 / 2**256 (mod `m`), through `backend`. `portable` is
+/// the `GFp_*` squaring entry point for `m`, which is faster than
+/// multiplying `a` by itself.
+#[inline]
+#[cfg_attr(not(target_arch = "x86_64"), allow(unused_variables))]
+pub(super) unsafe fn sqr_mont(
+    backend: Backend,
+    portable: unsafe extern "C" fn(r: *mut Limb, a: *const Limb),
+    m: &Modulus256,
+    r: *mut Limb,
+    a: *const Limb,
+) {
+    match backend {
+        #[cfg(all(
+            target_arch = "x86_64",
+            not(any(feature = "mesalock_sgx", target_env = "sgx"))
+        ))]
+        Backend::Adx | Backend::Avx2 => {
+            let a = &*(a as *const [u64; 4]);
+            let square = x86_64::mul_mont_adx(a, a, m);
+            *(r as *mut [u64; 4]) = square;
+        }
+        _ => portable(r, a),
+    }
+}
+
+/// Sets `r[i]` = `a[i]` * `b[i]` / 2**256 (mod `m`) for four independent
+/// products, through `backend`.
+pub(super) fn mul_mont_x4(
+    backend: Backend,
+    portable: unsafe extern "C" fn(r: *mut Limb, a: *const Limb, b: *const Limb),
+    m: &Modulus256,
+    r: &mut [[Limb; LIMBS_256]; 4],
+    a: &[[Limb; LIMBS_256]; 4],
+    b: &[[Limb; LIMBS_256]; 4],
+) {
+    match backend {
+        #[cfg(all(
+            target_arch = "x86_64",
+            not(any(feature = "mesalock_sgx", target_env = "sgx"))
+        ))]
+        Backend::Avx2 => unsafe { x86_64::mul_mont_x4_avx2(r, a, b, m) },
+        _ => {
+            for i in 0..4 {
+                unsafe {
+                    mul_mont(
+                        backend,
+                        portable,
+                        m,
+                        r[i].as_mut_ptr(),
+                        a[i].as_ptr(),
+                        b[i].as_ptr(),
+                    )
+                }
+            }
+        }
+    }
+}
+
+#[cfg(all(
+    target_arch = "x86_64",
+    not(any(feature = "mesalock_sgx", target_env = "sgx"))
+))]
+mod x86_64 {
+    use super::Modulus256;
+    use core::arch::x86_64::*;
+
+    // Returns `t` - `m` if `t` (with `t_hi` as bit 256) is at least `m`, and
+    // `t` otherwise, without branching on the values. `t` < 2m.
+    #[inline(always)]
+    fn reduce_once(t: [u64; 4], t_hi: u64, m: &[u64; 4]) -> [u64; 4] {
+        let mut r = [0u64; 4];
+        let mut borrow = 0u64;
+        for j in 0..4 {
+            let (d, b1) = t[j].overflowing_sub(m[j]);
+            let (d, b2) = d.overflowing_sub(borrow);
+            r[j] = d;
+            borrow = (b1 | b2) as u64;
+        }
+        // Keep `t` iff the subtraction borrowed out of bit 256 as well.
+        let keep_t = 0u64.wrapping_sub(t_hi.overflowing_sub(borrow).1 as u64);
+        for j in 0..4 {
+            r[j] = (t[j] & keep_t) | (r[j] & !keep_t);
+        }
+        r
+    }
+
+    // Coarsely integrated operand scanning: each round adds a * b[i] and
+    // then the multiple of `m` that clears the low word, which is dropped.
+    // The additions of the low and high halves of the products run as two
+    // independent carry chains, which is what ADCX/ADOX are for.
+    #[target_feature(enable = "bmi2,adx")]
+    pub(super) unsafe fn mul_mont_adx(a: &[u64; 4], b: &[u64; 4], m: &Modulus256) -> [u64; 4] {
+        let mut t = [0u64; 6];
+        for i in 0..4 {
+            let mut lo = [0u64; 4];
+            let mut hi = [0u64; 4];
+            for j in 0..4 {
+                lo[j] = _mulx_u64(a[j], b[i], &mut hi[j]);
+            }
+            let mut c1 = _addcarryx_u64(0, t[0], lo[0], &mut t[0]);
+            let mut c2 = 0;
+            for j in 1..4 {
+                c1 = _addcarryx_u64(c1, t[j], lo[j], &mut t[j]);
+                c2 = _addcarryx_u64(c2, t[j], hi[j - 1], &mut t[j]);
+            }
+            c1 = _addcarryx_u64(c1, t[4], 0, &mut t[4]);
+            c2 = _addcarryx_u64(c2, t[4], hi[3], &mut t[4]);
+            t[5] = u64::from(c1) + u64::from(c2);
+
+            let k = t[0].wrapping_mul(m.n0);
+            for j in 0..4 {
+                lo[j] = _mulx_u64(k, m.m[j], &mut hi[j]);
+            }
+            let mut discarded = 0;
+            let mut c1 = _addcarryx_u64(0, t[0], lo[0], &mut discarded);
+            let mut c2 = 0;
+            for j in 1..4 {
+                c1 = _addcarryx_u64(c1, t[j], lo[j], &mut t[j - 1]);
+                c2 = _addcarryx_u64(c2, t[j - 1], hi[j - 1], &mut t[j - 1]);
+            }
+            c1 = _addcarryx_u64(c1, t[4], 0, &mut t[3]);
+            c2 = _addcarryx_u64(c2, t[3], hi[3], &mut t[3]);
+            t[4] = t[5] + u64::from(c1) + u64::from(c2);
+        }
+        reduce_once([t[0], t[1], t[2], t[3]], t[4], &m.m)
+    }
+
+    // Four independent multiplications, one per 64-bit lane, on 32-bit
+    // limbs: VPMULUDQ multiplies the low 32 bits of each lane into a 64-bit
+    // product, so every round normalizes the limbs back to 32 bits before
+    // the next product is added.
+    #[target_feature(enable = "avx2")]
+    pub(super) unsafe fn mul_mont_x4_avx2(
+        r: &mut [[u64; 4]; 4],
+        a: &[[u64; 4]; 4],
+        b: &[[u64; 4]; 4],
+        m: &Modulus256,
+    ) {
+        // Limb `j` (of 32 bits) of the four values `x`.
+        #[inline(always)]
+        unsafe fn limb(x: &[[u64; 4]; 4], j: usize) -> __m256i {
+            let shift = 32 * (j % 2);
+            let w = j / 2;
+            _mm256_set_epi64x(
+                (x[3][w] >> shift) as u32 as i64,
+                (x[2][w] >> shift) as u32 as i64,
+                (x[1][w] >> shift) as u32 as i64,
+                (x[0][w] >> shift) as u32 as i64,
+            )
+        }
+
+        #[inline(always)]
+        unsafe fn normalize(t: &mut [__m256i; 9], mask: __m256i) {
+            for j in 0..8 {
+                t[j + 1] = _mm256_add_epi64(t[j + 1], _mm256_srli_epi64(t[j], 32));
+                t[j] = _mm256_and_si256(t[j], mask);
+            }
+        }
+
+        let mask = _mm256_set1_epi64x(0xffff_ffff);
+        let n0 = _mm256_set1_epi64x((m.n0 as u32) as i64);
+        let mut av = [_mm256_setzero_si256(); 8];
+        let mut bv = [_mm256_setzero_si256(); 8];
+        let mut mv = [_mm256_setzero_si256(); 8];
+        for j in 0..8 {
+            av[j] = limb(a, j);
+            bv[j] = limb(b, j);
+            mv[j] = _mm256_set1_epi64x((m.m[j / 2] >> (32 * (j % 2))) as u32 as i64);
+        }
+
+        let mut t = [_mm256_setzero_si256(); 9];
+        for i in 0..8 {
+            for j in 0..8 {
+                t[j] = _mm256_add_epi64(t[j], _mm256_mul_epu32(av[j], bv[i]));
+            }
+            normalize(&mut t, mask);
+
+            // The low 32 bits of n0 are -m**-1 (mod 2**32).
+            let k = _mm256_mul_epu32(t[0], n0);
+            for j in 0..8 {
+                t[j] = _mm256_add_epi64(t[j], _mm256_mul_epu32(k, mv[j]));
+            }
+
+            // The low limb is now zero; shift it out while normalizing.
+            let mut carry = _mm256_srli_epi64(t[0], 32);
+            for j in 0..8 {
+                let next = _mm256_add_epi64(t[j + 1], carry);
+                carry = _mm256_srli_epi64(next, 32);
+                t[j] = _mm256_and_si256(next, mask);
+            }
+            t[8] = carry;
+        }
+
+        // Transpose back to four sets of 32-bit limbs; limb 8 is bit 256.
+        let mut limbs = [[0u64; 4]; 9];
+        for j in 0..9 {
+            _mm256_storeu_si256(limbs[j].as_mut_ptr() as *mut __m256i, t[j]);
+        }
+        for lane in 0..4 {
+            let mut words = [0u64; 4];
+            for w in 0..4 {
+                words[w] = limbs[2 * w][lane] | (limbs[2 * w + 1][lane] << 32);
+            }
+            r[lane] = reduce_once(words, limbs[8][lane], &m.m);
+        }
+    }
+}
@@ -17,6 +17,8 @@ use super::{
     elem::{binary_op, binary_op_assign},
     elem_sqr_mul, elem_sqr_mul_acc, Modulus, *,
 };
+#[cfg(feature = "p256_backends")]
+use super::dispatch::{self, Modulus256};
 use core::marker::PhantomData;
 
 macro_rules! p256_limbs {
@@ -66,20 +68,98 @@ pub static COMMON_OPS: CommonOps = CommonOps {
     },
 
     elem_add_impl: GFp_nistz256_add,
+    #[cfg(not(feature = "p256_backends"))]
     elem_mul_mont: GFp_nistz256_mul_mont,
+    #[cfg(not(feature = "p256_backends"))]
     elem_sqr_mont: GFp_nistz256_sqr_mont,
+    #[cfg(feature = "p256_backends")]
+    elem_mul_mont: p256_elem_mul_mont,
+    #[cfg(feature = "p256_backends")]
+    elem_sqr_mont: p256_elem_sqr_mont,
 
     point_add_jacobian_impl: GFp_nistz256_point_add,
 };
 
+// q and n as 64-bit words, for the `dispatch` kernels.
+#[cfg(feature = "p256_backends")]
+static Q_256: Modulus256 = Modulus256 {
+    m: [
+        0xffffffff_ffffffff,
+        0x00000000_ffffffff,
+        0x00000000_00000000,
+        0xffffffff_00000001,
+    ],
+    n0: 1,
+};
+
+#[cfg(feature = "p256_backends")]
+static N_256: Modulus256 = Modulus256 {
+    m: [
+        0xf3b9cac2_fc632551,
+        0xbce6faad_a7179e84,
+        0xffffffff_ffffffff,
+        0xffffffff_00000000,
+    ],
+    n0: 0xccd1c8aa_ee00bc4f,
+};
+
+#[cfg(feature = "p256_backends")]
+unsafe extern "C" fn p256_elem_mul_mont(r: *mut Limb, a: *const Limb, b: *const Limb) {
+    dispatch::mul_mont(dispatch::backend(), GFp_nistz256_mul_mont, &Q_256, r, a, b)
+}
+
+#[cfg(feature = "p256_backends")]
+unsafe extern "C" fn p256_elem_sqr_mont(r: *mut Limb, a: *const Limb) {
+    dispatch::sqr_mont(dispatch::backend(), GFp_nistz256_sqr_mont, &Q_256, r, a)
+}
+
+#[cfg(feature = "p256_backends")]
+unsafe extern "C" fn p256_scalar_mul_mont(r: *mut Limb, a: *const Limb, b: *const Limb) {
+    dispatch::mul_mont(dispatch::backend(), GFp_p256_scalar_mul_mont, &N_256, r, a, b)
+}
+
+/// Computes the four independent products `a[i]` * `b[i]`, side by side when
+/// the backend allows it (see `dispatch::Backend::lanes`).
+#[cfg(feature = "p256_backends")]
+pub fn elem_product_x4(a: &[Elem<R>; 4], b: &[Elem<R>; 4]) -> [Elem<R>; 4] {
+    use dispatch::LIMBS_256;
+
+    let mut a_limbs = [[0; LIMBS_256]; 4];
+    let mut b_limbs = [[0; LIMBS_256]; 4];
+    let mut r_limbs = [[0; LIMBS_256]; 4];
+    for i in 0..4 {
+        a_limbs[i].copy_from_slice(&a[i].limbs[..LIMBS_256]);
+        b_limbs[i].copy_from_slice(&b[i].limbs[..LIMBS_256]);
+    }
+    dispatch::mul_mont_x4(
+        dispatch::backend(),
+        GFp_nistz256_mul_mont,
+        &Q_256,
+        &mut r_limbs,
+        &a_limbs,
+        &b_limbs,
+    );
+    let mut r = [Elem::zero(); 4];
+    for i in 0..4 {
+        r[i].limbs[..LIMBS_256].copy_from_slice(&r_limbs[i]);
+    }
+    r
+}
+
 pub static PRIVATE_KEY_OPS: PrivateKeyOps = PrivateKeyOps {
     common: &COMMON_OPS,
-    elem_inv_squared: p256_elem_inv_squared,
+    elem_inv_squared: p256_elem_inv_squared_safegcd,
     point_mul_base_impl: p256_point_mul_base_impl,
     point_mul_impl: GFp_nistz256_point_mul,
 };
 
-fn p256_elem_inv_squared(a: &Elem<R>) -> Elem<R> {
+fn p256_elem_inv_squared_safegcd(a: &Elem<R>) -> Elem<R> {
+    elem_inv_squared_safegcd(&COMMON_OPS, a)
+}
+
+/// Returns a**-2 (mod q) using an addition chain. `PRIVATE_KEY_OPS` uses the
+/// faster safegcd inverter instead.
+pub fn p256_elem_inv_squared(a: &Elem<R>) -> Elem<R> {
     // Calculate a**-2 (mod q) == a**(q - 3) (mod q)
     //
     // The exponent (q - 3) is:
@@ -138,8 +218,11 @@ pub static PUBLIC_KEY_OPS: PublicKeyOps = PublicKeyOps {
 
 pub static SCALAR_OPS: ScalarOps = ScalarOps {
     common: &COMMON_OPS,
-    scalar_inv_to_mont_impl: p256_scalar_inv_to_mont,
+    scalar_inv_to_mont_impl: p256_scalar_inv_to_mont_safegcd,
+    #[cfg(not(feature = "p256_backends"))]
     scalar_mul_mont: GFp_p256_scalar_mul_mont,
+    #[cfg(feature = "p256_backends")]
+    scalar_mul_mont: p256_scalar_mul_mont,
 };
 
 pub static PUBLIC_SCALAR_OPS: PublicScalarOps = PublicScalarOps {
@@ -167,7 +250,13 @@ pub static PRIVATE_SCALAR_OPS: PrivateScalarOps = PrivateScalarOps {
     },
 };
 
-fn p256_scalar_inv_to_mont(a: &Scalar<Unencoded>) -> Scalar<R> {
+fn p256_scalar_inv_to_mont_safegcd(a: &Scalar<Unencoded>) -> Scalar<R> {
+    scalar_inv_to_mont_safegcd(&SCALAR_OPS, &PRIVATE_SCALAR_OPS.oneRR_mod_n, a)
+}
+
+/// Returns a**-1 (mod n), Montgomery-encoded, using an addition chain.
+/// `SCALAR_OPS` uses the faster safegcd inverter instead.
+pub fn p256_scalar_inv_to_mont(a: &Scalar<Unencoded>) -> Scalar<R> {
     // Calculate the modular inverse of scalar |a| using Fermat's Little
     // Theorem:
     //
@@ -344,7 +433,7 @@ extern "C" {
 mod internal_benches {
     use super::{super::internal_benches::*, *};
 
-    bench_curve!(&[
+    bench_curve!(p256_elem_inv_squared, p256_scalar_inv_to_mont, &[
         Scalar {
             limbs: LIMBS_1,
             m: PhantomData,
@@ -371,4 +460,16 @@ mod internal_benches {
             encoding: PhantomData,
         },
     ]);
+
+    #[cfg(feature = "p256_backends")]
+    #[bench]
+    fn elem_product_x4_bench(bench: &mut test::Bencher) {
+        // Like `elem_product_bench()`, this assumes that the multiplication
+        // is constant-time.
+        let a: [Elem<R>; 4] = [Elem::zero(); 4];
+        let b: [Elem<R>; 4] = [Elem::zero(); 4];
+        bench.iter(|| {
+            let _ = elem_product_x4(&a, &b);
+        });
+    }
 }
@@ -70,12 +70,18 @@ pub static COMMON_OPS: CommonOps = CommonOps {
 
 pub static PRIVATE_KEY_OPS: PrivateKeyOps = PrivateKeyOps {
     common: &COMMON_OPS,
-    elem_inv_squared: p384_elem_inv_squared,
+    elem_inv_squared: p384_elem_inv_squared_safegcd,
     point_mul_base_impl: p384_point_mul_base_impl,
     point_mul_impl: GFp_nistz384_point_mul,
 };
 
-fn p384_elem_inv_squared(a: &Elem<R>) -> Elem<R> {
+fn p384_elem_inv_squared_safegcd(a: &Elem<R>) -> Elem<R> {
+    elem_inv_squared_safegcd(&COMMON_OPS, a)
+}
+
+/// Returns a**-2 (mod q) using an addition chain. `PRIVATE_KEY_OPS` uses the
+/// faster safegcd inverter instead.
+pub fn p384_elem_inv_squared(a: &Elem<R>) -> Elem<R> {
     // Calculate a**-2 (mod q) == a**(q - 3) (mod q)
     //
     // The exponent (q - 3) is:
@@ -131,28 +137,187 @@ fn p384_elem_inv_squared(a: &Elem<R>) -> Elem<R> {
     acc
 }
 
-fn p384_point_mul_base_impl(a: &Scalar) -> Point {
-    // XXX: Not efficient. TODO: Precompute multiples of the generator.
-    static P384_GENERATOR: (Elem<R>, Elem<R>) = (
-        Elem {
-            limbs: p384_limbs![
-                0x49c0b528, 0x3dd07566, 0xa0d6ce38, 0x20e378e2, 0x541b4d6e, 0x879c3afc, 0x59a30eff,
-                0x64548684, 0x614ede2b, 0x812ff723, 0x299e1513, 0x4d3aadc2
-            ],
-            m: PhantomData,
-            encoding: PhantomData,
-        },
-        Elem {
-            limbs: p384_limbs![
-                0x4b03a4fe, 0x23043dad, 0x7bb4a9ac, 0xa1bfa8bf, 0x2e83b050, 0x8bade756, 0x68f4ffd9,
-                0xc6c35219, 0x3969a840, 0xdd800226, 0x5a15c5e9, 0x2b78abc2
-            ],
-            m: PhantomData,
-            encoding: PhantomData,
-        },
-    );
+static P384_GENERATOR: (Elem<R>, Elem<R>) = (
+    Elem {
+        limbs: p384_limbs![
+            0x49c0b528, 0x3dd07566, 0xa0d6ce38, 0x20e378e2, 0x541b4d6e, 0x879c3afc, 0x59a30eff,
+            0x64548684, 0x614ede2b, 0x812ff723, 0x299e1513, 0x4d3aadc2
+        ],
+        m: PhantomData,
+        encoding: PhantomData,
+    },
+    Elem {
+        limbs: p384_limbs![
+            0x4b03a4fe, 0x23043dad, 0x7bb4a9ac, 0xa1bfa8bf, 0x2e83b050, 0x8bade756, 0x68f4ffd9,
+            0xc6c35219, 0x3969a840, 0xdd800226, 0x5a15c5e9, 0x2b78abc2
+        ],
+        m: PhantomData,
+        encoding: PhantomData,
+    },
+);
+
+// 1 * R (mod q).
+const ONE_R_LIMBS: [Limb; MAX_LIMBS] =
+    p384_limbs![1, 0xffffffff, 0xffffffff, 0, 1, 0, 0, 0, 0, 0, 0, 0];
+
+// `p384_point_mul_base_impl` uses a table of multiples of the generator,
+// like `GFp_nistz256_point_mul_base` does for P-256: for every window i of
+// `BASE_WINDOW_BITS` bits, j * 2**(BASE_WINDOW_BITS * i) * G for
+// j = 1..=2**(BASE_WINDOW_BITS - 1), in affine coordinates. With the scalar
+// in signed (Booth) digits, a multiplication is one table lookup and one
+// addition per window, and no doublings.
+//
+// The table is built on first use. Its window is 5 bits, or whichever of
+// the `p384_base_window_{4,6,7}` features is enabled (the largest one, if
+// several are). Each extra bit roughly doubles the table, and the time to
+// build it, for fewer additions per multiplication:
+//
+//   window  entries  table size  additions
+//      4       776      73 KiB         96
+//      5      1232     116 KiB         76
+//      6      2080     195 KiB         64
+//      7      3520     330 KiB         54
+const BASE_WINDOW_BITS: usize = if cfg!(feature = "p384_base_window_7") {
+    7
+} else if cfg!(feature = "p384_base_window_6") {
+    6
+} else if cfg!(feature = "p384_base_window_4") {
+    4
+} else {
+    5
+};
+
+const BASE_WINDOWS: usize = (384 / BASE_WINDOW_BITS) + 1;
+const BASE_TABLE_ENTRIES: usize = 1 << (BASE_WINDOW_BITS - 1);
+const NUM_LIMBS: usize = 384 / LIMB_BITS;
 
-    PRIVATE_KEY_OPS.point_mul(a, &P384_GENERATOR)
+type AffinePoint = [Limb; 2 * NUM_LIMBS];
+
+lazy_static! {
+    static ref BASE_TABLE: Vec<AffinePoint> = base_table();
+}
+
+fn base_table() -> Vec<AffinePoint> {
+    let mut points: Vec<Point> = Vec::with_capacity(BASE_WINDOWS * BASE_TABLE_ENTRIES);
+    let mut base = Point::new_at_infinity();
+    base.xyz[..NUM_LIMBS].copy_from_slice(&P384_GENERATOR.0.limbs[..NUM_LIMBS]);
+    base.xyz[NUM_LIMBS..(2 * NUM_LIMBS)].copy_from_slice(&P384_GENERATOR.1.limbs[..NUM_LIMBS]);
+    base.xyz[(2 * NUM_LIMBS)..(3 * NUM_LIMBS)].copy_from_slice(&ONE_R_LIMBS[..NUM_LIMBS]);
+
+    for _ in 0..BASE_WINDOWS {
+        points.push(Point { xyz: base.xyz });
+        for _ in 1..BASE_TABLE_ENTRIES {
+            let next = COMMON_OPS.point_sum(&points[points.len() - 1], &base);
+            points.push(next);
+        }
+        // 2**BASE_WINDOW_BITS * base == 2 * (BASE_TABLE_ENTRIES * base).
+        unsafe {
+            GFp_nistz384_point_double(base.xyz.as_mut_ptr(), points[points.len() - 1].xyz.as_ptr());
+        }
+    }
+
+    // None of the multiples is the point at infinity, so none of the Z
+    // coordinates is zero.
+    let mut z_inv: Vec<Elem<R>> = points.iter().map(|p| COMMON_OPS.point_z(p)).collect();
+    batch_invert(&PRIVATE_KEY_OPS, &mut z_inv).unwrap();
+
+    points
+        .iter()
+        .zip(z_inv.iter())
+        .map(|(p, z_inv)| {
+            let zz_inv = COMMON_OPS.elem_squared(z_inv);
+            let x = COMMON_OPS.elem_product(&COMMON_OPS.point_x(p), &zz_inv);
+            let zzz_inv = COMMON_OPS.elem_product(&zz_inv, z_inv);
+            let y = COMMON_OPS.elem_product(&COMMON_OPS.point_y(p), &zzz_inv);
+            let mut r = [0; 2 * NUM_LIMBS];
+            r[..NUM_LIMBS].copy_from_slice(&x.limbs[..NUM_LIMBS]);
+            r[NUM_LIMBS..].copy_from_slice(&y.limbs[..NUM_LIMBS]);
+            r
+        })
+        .collect()
+}
+
+// All ones if `a` == `b`, and zero otherwise, in constant time.
+#[inline]
+fn limb_eq_mask(a: Limb, b: Limb) -> Limb {
+    let x = a ^ b;
+    ((x | x.wrapping_neg()) >> (LIMB_BITS - 1)).wrapping_sub(1)
+}
+
+// Returns the `BASE_WINDOW_BITS + 1` bits of `a` starting at bit `bit`,
+// which may be -1 (for the bit below the scalar, which is zero).
+#[inline]
+fn scalar_bits(a: &Scalar, bit: isize) -> Limb {
+    const MASK: Limb = (1 << (BASE_WINDOW_BITS + 1)) - 1;
+    if bit < 0 {
+        return (a.limbs[0] << 1) & MASK;
+    }
+    let bit = bit as usize;
+    let (i, shift) = (bit / LIMB_BITS, bit % LIMB_BITS);
+    if i >= NUM_LIMBS {
+        return 0;
+    }
+    let mut v = a.limbs[i] >> shift;
+    if shift + BASE_WINDOW_BITS + 1 > LIMB_BITS && i + 1 < NUM_LIMBS {
+        v |= a.limbs[i + 1] << (LIMB_BITS - shift);
+    }
+    v & MASK
+}
+
+// Converts a window of `BASE_WINDOW_BITS + 1` bits (including the top bit
+// of the window below) into a digit in
+// [-2**(BASE_WINDOW_BITS - 1), 2**(BASE_WINDOW_BITS - 1)], returned as its
+// absolute value and a mask that is all ones if it's negative.
+#[inline]
+fn booth_recode(window: Limb) -> (Limb, Limb) {
+    let neg = !((window >> BASE_WINDOW_BITS).wrapping_sub(1));
+    let d = ((1 << (BASE_WINDOW_BITS + 1)) - window - 1) & neg | (window & !neg);
+    ((d >> 1) + (d & 1), neg)
+}
+
+// Sets `r` to the table entry `digit` of window `i` (its negation if `neg`)
+// in Jacobian coordinates, or to the point at infinity if `digit` is zero,
+// without leaking `digit`.
+fn select_base_point(r: &mut Point, i: usize, digit: Limb, neg: Limb) {
+    let window = &BASE_TABLE[(i * BASE_TABLE_ENTRIES)..((i + 1) * BASE_TABLE_ENTRIES)];
+    // Digit zero wraps around to an index past the end, which selects zeros.
+    let mut xy = limbs_select_consttime(window, (digit as usize).wrapping_sub(1));
+
+    let mut neg_y = [0; NUM_LIMBS];
+    unsafe {
+        GFp_p384_elem_neg(neg_y.as_mut_ptr(), xy[NUM_LIMBS..].as_ptr());
+    }
+    for (y, neg_y) in xy[NUM_LIMBS..].iter_mut().zip(neg_y.iter()) {
+        *y = (neg_y & neg) | (*y & !neg);
+    }
+
+    let not_zero = !limb_eq_mask(digit, 0);
+    r.xyz[..(2 * NUM_LIMBS)].copy_from_slice(&xy);
+    for (z, one) in r.xyz[(2 * NUM_LIMBS)..(3 * NUM_LIMBS)]
+        .iter_mut()
+        .zip(ONE_R_LIMBS.iter())
+    {
+        *z = one & not_zero;
+    }
+}
+
+fn p384_point_mul_base_impl(a: &Scalar) -> Point {
+    // The additions below only see equal points for a negligible set of
+    // scalars; `GFp_nistz384_point_add` handles that case correctly, though
+    // not in constant time, just like the nistz256 comb.
+    let mut acc = Point::new_at_infinity();
+    let mut p = Point::new_at_infinity();
+    for i in 0..BASE_WINDOWS {
+        let bit = (i * BASE_WINDOW_BITS) as isize - 1;
+        let (digit, neg) = booth_recode(scalar_bits(a, bit));
+        if i == 0 {
+            select_base_point(&mut acc, i, digit, neg);
+        } else {
+            select_base_point(&mut p, i, digit, neg);
+            acc = COMMON_OPS.point_sum(&acc, &p);
+        }
+    }
+    acc
 }
 
 pub static PUBLIC_KEY_OPS: PublicKeyOps = PublicKeyOps {
@@ -161,7 +326,7 @@ pub static PUBLIC_KEY_OPS: PublicKeyOps = PublicKeyOps {
 
 pub static SCALAR_OPS: ScalarOps = ScalarOps {
     common: &COMMON_OPS,
-    scalar_inv_to_mont_impl: p384_scalar_inv_to_mont,
+    scalar_inv_to_mont_impl: p384_scalar_inv_to_mont_safegcd,
     scalar_mul_mont: GFp_p384_scalar_mul_mont,
 };
 
@@ -191,7 +356,13 @@ pub static PRIVATE_SCALAR_OPS: PrivateScalarOps = PrivateScalarOps {
     },
 };
 
-fn p384_scalar_inv_to_mont(a: &Scalar<Unencoded>) -> Scalar<R> {
+fn p384_scalar_inv_to_mont_safegcd(a: &Scalar<Unencoded>) -> Scalar<R> {
+    scalar_inv_to_mont_safegcd(&SCALAR_OPS, &PRIVATE_SCALAR_OPS.oneRR_mod_n, a)
+}
+
+/// Returns a**-1 (mod n), Montgomery-encoded, using an addition chain.
+/// `SCALAR_OPS` uses the faster safegcd inverter instead.
+pub fn p384_scalar_inv_to_mont(a: &Scalar<Unencoded>) -> Scalar<R> {
     // Calculate the modular inverse of scalar |a| using Fermat's Little
     // Theorem:
     //
@@ -351,11 +522,20 @@ extern "C" {
         b: *const Limb, // [COMMON_OPS.num_limbs]
     );
 
+    fn GFp_p384_elem_neg(
+        r: *mut Limb,   // [COMMON_OPS.num_limbs]
+        a: *const Limb, // [COMMON_OPS.num_limbs]
+    );
+
     fn GFp_nistz384_point_add(
         r: *mut Limb,   // [3][COMMON_OPS.num_limbs]
         a: *const Limb, // [3][COMMON_OPS.num_limbs]
         b: *const Limb, // [3][COMMON_OPS.num_limbs]
     );
+    fn GFp_nistz384_point_double(
+        r: *mut Limb,   // [3][COMMON_OPS.num_limbs]
+        a: *const Limb, // [3][COMMON_OPS.num_limbs]
+    );
     fn GFp_nistz384_point_mul(
         r: *mut Limb,          // [3][COMMON_OPS.num_limbs]
         p_scalar: *const Limb, // [COMMON_OPS.num_limbs]
@@ -374,7 +554,7 @@ extern "C" {
 mod internal_benches {
     use super::{super::internal_benches::*, *};
 
-    bench_curve!(&[
+    bench_curve!(p384_elem_inv_squared, p384_scalar_inv_to_mont, &[
         Scalar {
             limbs: LIMBS_1,
             encoding: PhantomData,
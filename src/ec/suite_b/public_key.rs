@@ -72,6 +72,22 @@ pub fn parse_uncompressed_point(
     Ok((x, y))
 }
 
+/// Checks that `input` is the uncompressed encoding of a pair of field
+/// elements, without checking that they're a point on the curve: only the
+/// first two steps of `parse_uncompressed_point()`, and no arithmetic.
+pub fn precheck_uncompressed_point(ops: &CommonOps, input: &[u8]) -> SimpleResult<()> {
+    let elem_len = ops.num_limbs * crate::limb::LIMB_BYTES;
+    match input.split_first() {
+        Some((4, xy)) if xy.len() == 2 * elem_len => {
+            let (x, y) = xy.split_at(elem_len);
+            elem_parse_big_endian_fixed_consttime(ops, untrusted::Input::from(x))?;
+            elem_parse_big_endian_fixed_consttime(ops, untrusted::Input::from(y))?;
+            Ok(())
+        }
+        _ => Err(ErrorKind::CryptoError),
+    }
+}
+
 #[cfg(test)]
 mod tests {
     use super::{super::ops, *};
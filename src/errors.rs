@@ -4,6 +4,11 @@ use std::fmt;
 
 pub type Result<T> = std::result::Result<T, Error>;
 
+/// A result whose error is just an `ErrorKind`: one byte, `Copy`, and never
+/// allocated. Hot paths whose failures are expected, such as rejecting
+/// signatures, return this; `?` turns it into a `Result` for free.
+pub type SimpleResult<T> = std::result::Result<T, ErrorKind>;
+
 #[cfg(any(feature = "mesalock_sgx", target_env = "sgx"))]
 #[derive(serde_derive::Serialize, serde_derive::Deserialize)]
 #[serde(crate = "serde_sgx")]
@@ -79,6 +84,8 @@ pub enum ErrorKind {
     ErrCryptographyNotSupported,
     LimbUnspecifiedError,
     InvalidBigNumError,
+    InvalidInputError,
+    InvalidChecksumError,
     Unknown,
 }
 
@@ -113,6 +120,8 @@ pub enum ErrorKind {
     ErrCryptographyNotSupported,
     LimbUnspecifiedError,
     InvalidBigNumError,
+    InvalidInputError,
+    InvalidChecksumError,
     Unknown,
 }
 
@@ -147,11 +156,28 @@ impl ErrorKind {
 	    ErrorKind::ErrCryptographyNotSupported => "unsupported cryptography system",
 	    ErrorKind::LimbUnspecifiedError => "call limb error",
 	    ErrorKind::InvalidBigNumError => "can not parsed as bignum",
+            ErrorKind::InvalidInputError => "invalid input",
+            ErrorKind::InvalidChecksumError => "checksum mismatch",
             ErrorKind::Unknown => "unknown error",
         }
     }
 }
 
+impl fmt::Display for ErrorKind {
+    fn fmt(&self, fmt: &mut fmt::Formatter) -> fmt::Result {
+        fmt.write_str(self.as_str())
+    }
+}
+
+impl std::error::Error for ErrorKind {}
+
+impl From<Error> for ErrorKind {
+    #[inline]
+    fn from(err: Error) -> ErrorKind {
+        err.kind()
+    }
+}
+
 impl From<ErrorKind> for Error {
     #[inline]
     fn from(kind: ErrorKind) -> Error {
@@ -182,6 +208,8 @@ impl From<u32> for Error {
             0x0000_0015 => ErrorKind::ErrCryptographyNotSupported,
             0x0000_0016 => ErrorKind::LimbUnspecifiedError,
             0x0000_0017 => ErrorKind::InvalidBigNumError,
+            0x0000_0018 => ErrorKind::InvalidInputError,
+            0x0000_0019 => ErrorKind::InvalidChecksumError,
             _ => ErrorKind::Unknown,
         };
 
@@ -226,6 +254,8 @@ impl Into<u32> for Error {
             ErrorKind::ErrCryptographyNotSupported => 0x0000_0015,
             ErrorKind::LimbUnspecifiedError => 0x0000_0016,
             ErrorKind::InvalidBigNumError => 0x0000_0017,
+            ErrorKind::InvalidInputError => 0x0000_0018,
+            ErrorKind::InvalidChecksumError => 0x0000_0019,
             ErrorKind::Unknown => 0xffff_ffff,
         }
     }
@@ -311,3 +341,87 @@ impl std::error::Error for Error {
         }
     }
 }
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::ec::suite_b::ecies;
+    use crate::sign::ecdsa::{
+        EcdsaKeyPair, KeyPair, UnparsedPublicKey, ECDSA_P256_SHA256_ASN1,
+        ECDSA_P256_SHA256_ASN1_SIGNING,
+    };
+    use std::alloc::{GlobalAlloc, Layout, System};
+    use std::cell::Cell;
+
+    // Counts the allocations of each thread, so that tests running in
+    // parallel don't see each other's.
+    struct CountingAlloc;
+
+    thread_local! {
+        static ALLOCATIONS: Cell<usize> = Cell::new(0);
+    }
+
+    unsafe impl GlobalAlloc for CountingAlloc {
+        unsafe fn alloc(&self, layout: Layout) -> *mut u8 {
+            let _ = ALLOCATIONS.try_with(|n| n.set(n.get() + 1));
+            System.alloc(layout)
+        }
+
+        unsafe fn dealloc(&self, ptr: *mut u8, layout: Layout) {
+            System.dealloc(ptr, layout)
+        }
+    }
+
+    #[global_allocator]
+    static ALLOC: CountingAlloc = CountingAlloc;
+
+    fn allocations<R>(f: impl FnOnce() -> R) -> usize {
+        let before = ALLOCATIONS.with(|n| n.get());
+        f();
+        ALLOCATIONS.with(|n| n.get()) - before
+    }
+
+    #[test]
+    fn test_simple_result_is_compact() {
+        assert_eq!(std::mem::size_of::<SimpleResult<()>>(), 1);
+        let kind = ErrorKind::CryptoError;
+        let copy = kind;
+        assert_eq!(Error::from(kind).kind(), copy);
+        assert_eq!(ErrorKind::from(Error::from(copy)), kind);
+        assert_eq!(kind.to_string(), "crypto error");
+    }
+
+    #[test]
+    fn test_rejections_do_not_allocate() {
+        let key_pair = EcdsaKeyPair::from_seed_unchecked(
+            &ECDSA_P256_SHA256_ASN1_SIGNING,
+            untrusted::Input::from(&[3u8; 32]),
+        )
+        .unwrap();
+        let public_key = UnparsedPublicKey::new(&ECDSA_P256_SHA256_ASN1, key_pair.public_key());
+        let msg = b"rejected";
+        let sig = key_pair.sign(msg).unwrap();
+        let mut ciphertext = ecies::encrypt(&public_key, &[], &[], msg).unwrap();
+        let last = ciphertext.len() - 1;
+        ciphertext[last] ^= 1;
+
+        // Warm up the thread's scratch arena and lazily built tables.
+        assert!(public_key.verify(b"forged", sig.as_ref()).is_err());
+        assert!(ecies::decrypt(&key_pair, &ciphertext, &[], &[]).is_err());
+
+        let mut truncated = sig.as_ref().to_vec();
+        truncated.pop();
+        let n = allocations(|| {
+            for _ in 0..10 {
+                assert!(public_key.verify(b"forged", sig.as_ref()).is_err());
+                assert!(public_key.verify(msg, &truncated).is_err());
+                assert!(public_key.verify(msg, &[]).is_err());
+                assert!(ecies::decrypt(&key_pair, &ciphertext, &[], &[]).is_err());
+            }
+        });
+        assert_eq!(n, 0);
+        // Whereas a successful decryption allocates its plaintext.
+        let ciphertext = ecies::encrypt(&public_key, &[], &[], msg).unwrap();
+        assert!(allocations(|| ecies::decrypt(&key_pair, &ciphertext, &[], &[])) > 0);
+    }
+}
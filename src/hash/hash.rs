@@ -1,14 +1,100 @@
 use std::prelude::v1::*;
 use ring::digest;
 
+pub use super::multibuffer::sha256_many;
+
+/// Length in bytes of a SHA-256 output.
+pub const SHA256_OUTPUT_LEN: usize = 32;
+
 pub fn double_sha256(data: &[u8]) -> Vec<u8> {
-    let res = digest::digest(&digest::SHA256, data);
-    digest::digest(&digest::SHA256, res.as_ref())
-        .as_ref()
-        .to_vec()
+    double_sha256_array(data).to_vec()
 }
 
 pub fn sha256(data: &[u8]) -> Vec<u8> {
-    let res = digest::digest(&digest::SHA256, data);
-    res.as_ref().to_vec()
+    sha256_array(data).to_vec()
+}
+
+/// SHA-256 of `data` as a fixed-size array, without heap allocation.
+pub fn sha256_array(data: &[u8]) -> [u8; SHA256_OUTPUT_LEN] {
+    let mut ctx = Sha256Context::new();
+    ctx.update(data);
+    ctx.finish()
+}
+
+/// SHA-256(SHA-256(`data`)) as a fixed-size array, without heap allocation.
+pub fn double_sha256_array(data: &[u8]) -> [u8; SHA256_OUTPUT_LEN] {
+    let mut ctx = Sha256Context::new();
+    ctx.update(data);
+    ctx.finish_double()
+}
+
+/// Incremental SHA-256.
+///
+/// The context is `Clone`, so a common prefix can be absorbed once and the
+/// resulting midstate reused for many messages that share it.
+#[derive(Clone)]
+pub struct Sha256Context(digest::Context);
+
+impl Sha256Context {
+    pub fn new() -> Self {
+        Sha256Context(digest::Context::new(&digest::SHA256))
+    }
+
+    pub fn update(&mut self, data: &[u8]) {
+        self.0.update(data)
+    }
+
+    /// Finalizes the hash, returning SHA-256 of everything absorbed so far.
+    pub fn finish(self) -> [u8; SHA256_OUTPUT_LEN] {
+        let mut out = [0u8; SHA256_OUTPUT_LEN];
+        out.copy_from_slice(self.0.finish().as_ref());
+        out
+    }
+
+    /// Finalizes the hash and hashes the result once more, i.e. the Bitcoin
+    /// style double SHA-256 of everything absorbed so far.
+    pub fn finish_double(self) -> [u8; SHA256_OUTPUT_LEN] {
+        sha256_array(&self.finish())
+    }
+}
+
+impl Default for Sha256Context {
+    fn default() -> Self {
+        Self::new()
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_sha256_array() {
+        assert_eq!(
+            hex::encode(sha256_array(b"abc")),
+            "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad"
+        );
+        assert_eq!(
+            hex::encode(double_sha256_array(b"abc")),
+            "4f8b42c22dd3729b519ba6f68d2da7cc5b2d606d05daed5ad5128cc03e6c6358"
+        );
+        assert_eq!(sha256(b"abc"), sha256_array(b"abc").to_vec());
+        assert_eq!(double_sha256(b"abc"), double_sha256_array(b"abc").to_vec());
+    }
+
+    #[test]
+    fn test_sha256_context_midstate() {
+        let mut prefix = Sha256Context::new();
+        prefix.update(b"eigen-crypto");
+
+        for msg in [&b""[..], b"a", b"abc", &[0x5au8; 200][..]].iter() {
+            let mut ctx = prefix.clone();
+            ctx.update(msg);
+
+            let mut data = b"eigen-crypto".to_vec();
+            data.extend_from_slice(msg);
+            assert_eq!(ctx.clone().finish(), sha256_array(&data));
+            assert_eq!(ctx.finish_double(), double_sha256_array(&data));
+        }
+    }
 }
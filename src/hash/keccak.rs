@@ -0,0 +1,412 @@
+// Keccak-256 (as used by Ethereum) and SHA3-256 (FIPS 202).
+//
+// The two differ only in the domain padding byte. `keccak256_many` runs four
+// independent sponges through one interleaved permutation, which the
+// compiler turns into 256-bit vector code when AVX2 is available, and into
+// four independent dependency chains otherwise.
+
+use std::prelude::v1::*;
+
+use core::ops::{BitAnd, BitXor, Not};
+use core::sync::atomic::{AtomicU8, Ordering};
+
+pub const KECCAK256_OUTPUT_LEN: usize = 32;
+
+// Rate in bytes of the 256-bit-output instances (capacity 512 bits).
+const RATE: usize = 136;
+
+const KECCAK_PAD: u8 = 0x01;
+const SHA3_PAD: u8 = 0x06;
+
+const RC: [u64; 24] = [
+    0x0000000000000001, 0x0000000000008082, 0x800000000000808a, 0x8000000080008000,
+    0x000000000000808b, 0x0000000080000001, 0x8000000080008081, 0x8000000000008009,
+    0x000000000000008a, 0x0000000000000088, 0x0000000080008009, 0x000000008000000a,
+    0x000000008000808b, 0x800000000000008b, 0x8000000000008089, 0x8000000000008003,
+    0x8000000000008002, 0x8000000000000080, 0x000000000000800a, 0x800000008000000a,
+    0x8000000080008081, 0x8000000000008080, 0x0000000080000001, 0x8000000080008008,
+];
+
+// Rotation offsets and lane positions of the combined rho and pi steps,
+// walking the lanes in the order pi visits them starting from lane 1.
+const RHO: [u32; 24] = [
+    1, 3, 6, 10, 15, 21, 28, 36, 45, 55, 2, 14, 27, 41, 56, 8, 25, 43, 62, 18, 39, 61, 20, 44,
+];
+const PI: [usize; 24] = [
+    10, 7, 11, 17, 18, 3, 5, 16, 8, 21, 24, 4, 15, 23, 19, 13, 12, 2, 20, 14, 22, 9, 6, 1,
+];
+
+/// A 64-bit Keccak lane, or several lanes of independent states processed
+/// in lockstep.
+trait Lane: Copy + BitXor<Output = Self> + BitAnd<Output = Self> + Not<Output = Self> {
+    fn rotl(self, n: u32) -> Self;
+    fn xor_const(self, c: u64) -> Self;
+}
+
+impl Lane for u64 {
+    #[inline(always)]
+    fn rotl(self, n: u32) -> Self {
+        self.rotate_left(n)
+    }
+
+    #[inline(always)]
+    fn xor_const(self, c: u64) -> Self {
+        self ^ c
+    }
+}
+
+#[derive(Clone, Copy)]
+struct X4([u64; 4]);
+
+macro_rules! x4_binop {
+    ( $tr:ident, $f:ident, $op:tt ) => {
+        impl $tr for X4 {
+            type Output = X4;
+            #[inline(always)]
+            fn $f(self, o: X4) -> X4 {
+                let mut r = [0u64; 4];
+                for i in 0..4 {
+                    r[i] = self.0[i] $op o.0[i];
+                }
+                X4(r)
+            }
+        }
+    };
+}
+
+x4_binop!(BitXor, bitxor, ^);
+x4_binop!(BitAnd, bitand, &);
+
+impl Not for X4 {
+    type Output = X4;
+    #[inline(always)]
+    fn not(self) -> X4 {
+        let mut r = [0u64; 4];
+        for i in 0..4 {
+            r[i] = !self.0[i];
+        }
+        X4(r)
+    }
+}
+
+impl Lane for X4 {
+    #[inline(always)]
+    fn rotl(self, n: u32) -> Self {
+        let mut r = [0u64; 4];
+        for i in 0..4 {
+            r[i] = (self.0[i] << n) | (self.0[i] >> (64 - n));
+        }
+        X4(r)
+    }
+
+    #[inline(always)]
+    fn xor_const(self, c: u64) -> Self {
+        let mut r = self.0;
+        for i in 0..4 {
+            r[i] ^= c;
+        }
+        X4(r)
+    }
+}
+
+#[inline(always)]
+fn keccak_f<L: Lane>(a: &mut [L; 25]) {
+    for rc in RC.iter() {
+        // theta
+        let mut c = [a[0]; 5];
+        for x in 0..5 {
+            c[x] = a[x] ^ a[x + 5] ^ a[x + 10] ^ a[x + 15] ^ a[x + 20];
+        }
+        for x in 0..5 {
+            let d = c[(x + 4) % 5] ^ c[(x + 1) % 5].rotl(1);
+            for y in 0..5 {
+                a[x + 5 * y] = a[x + 5 * y] ^ d;
+            }
+        }
+        // rho and pi, unrolled so that lane positions and rotation counts
+        // become constants.
+        let mut last = a[1];
+        macro_rules! rho_pi {
+            ( $( $i:expr ),* ) => {
+                $(
+                    let tmp = a[PI[$i]];
+                    a[PI[$i]] = last.rotl(RHO[$i]);
+                    last = tmp;
+                )*
+            };
+        }
+        rho_pi!(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 18, 19, 20, 21, 22, 23);
+        let _ = last;
+        // chi
+        for y in 0..5 {
+            let mut row = [a[5 * y]; 5];
+            row.copy_from_slice(&a[(5 * y)..(5 * y + 5)]);
+            for x in 0..5 {
+                a[5 * y + x] = row[x] ^ (!row[(x + 1) % 5] & row[(x + 2) % 5]);
+            }
+        }
+        // iota
+        a[0] = a[0].xor_const(*rc);
+    }
+}
+
+/// The Keccak-f[1600] permutation.
+pub fn keccak_f1600(state: &mut [u64; 25]) {
+    keccak_f(state)
+}
+
+fn keccak_f1600_x4(states: &mut [X4; 25]) {
+    #[cfg(all(
+        any(target_arch = "x86", target_arch = "x86_64"),
+        not(any(feature = "mesalock_sgx", target_env = "sgx"))
+    ))]
+    {
+        if have_avx2() {
+            #[target_feature(enable = "avx2")]
+            unsafe fn keccak_f_avx2(states: &mut [X4; 25]) {
+                keccak_f(states)
+            }
+            return unsafe { keccak_f_avx2(states) };
+        }
+    }
+    keccak_f(states)
+}
+
+#[cfg(all(
+    any(target_arch = "x86", target_arch = "x86_64"),
+    not(any(feature = "mesalock_sgx", target_env = "sgx"))
+))]
+fn have_avx2() -> bool {
+    static AVX2: AtomicU8 = AtomicU8::new(0);
+    match AVX2.load(Ordering::Relaxed) {
+        1 => false,
+        2 => true,
+        _ => {
+            let have = is_x86_feature_detected!("avx2");
+            AVX2.store(if have { 2 } else { 1 }, Ordering::Relaxed);
+            have
+        }
+    }
+}
+
+/// Incremental Keccak sponge with a 256-bit output.
+#[derive(Clone)]
+pub struct Keccak256 {
+    state: [u64; 25],
+    buf: [u8; RATE],
+    buf_len: usize,
+    pad: u8,
+}
+
+impl Keccak256 {
+    /// Keccak-256 as used by Ethereum (original Keccak padding).
+    pub fn new() -> Self {
+        Self::with_pad(KECCAK_PAD)
+    }
+
+    /// SHA3-256 (FIPS 202 padding).
+    pub fn new_sha3() -> Self {
+        Self::with_pad(SHA3_PAD)
+    }
+
+    fn with_pad(pad: u8) -> Self {
+        Keccak256 {
+            state: [0u64; 25],
+            buf: [0u8; RATE],
+            buf_len: 0,
+            pad,
+        }
+    }
+
+    pub fn update(&mut self, mut data: &[u8]) {
+        if self.buf_len > 0 {
+            let n = core::cmp::min(RATE - self.buf_len, data.len());
+            self.buf[self.buf_len..(self.buf_len + n)].copy_from_slice(&data[..n]);
+            self.buf_len += n;
+            data = &data[n..];
+            if self.buf_len < RATE {
+                return;
+            }
+            let block = self.buf;
+            absorb(&mut self.state, &block);
+            self.buf_len = 0;
+        }
+        while data.len() >= RATE {
+            absorb(&mut self.state, &data[..RATE]);
+            data = &data[RATE..];
+        }
+        self.buf[..data.len()].copy_from_slice(data);
+        self.buf_len = data.len();
+    }
+
+    pub fn finish(mut self) -> [u8; KECCAK256_OUTPUT_LEN] {
+        for b in self.buf[self.buf_len..].iter_mut() {
+            *b = 0;
+        }
+        self.buf[self.buf_len] ^= self.pad;
+        self.buf[RATE - 1] ^= 0x80;
+        let block = self.buf;
+        absorb(&mut self.state, &block);
+        squeeze(&self.state)
+    }
+}
+
+impl Default for Keccak256 {
+    fn default() -> Self {
+        Self::new()
+    }
+}
+
+fn xor_block(state: &mut [u64; 25], block: &[u8]) {
+    for (s, w) in state.iter_mut().zip(block.chunks(8)) {
+        let mut b = [0u8; 8];
+        b.copy_from_slice(w);
+        *s ^= u64::from_le_bytes(b);
+    }
+}
+
+fn absorb(state: &mut [u64; 25], block: &[u8]) {
+    xor_block(state, block);
+    keccak_f1600(state);
+}
+
+fn squeeze(state: &[u64; 25]) -> [u8; KECCAK256_OUTPUT_LEN] {
+    let mut out = [0u8; KECCAK256_OUTPUT_LEN];
+    for (o, s) in out.chunks_mut(8).zip(state.iter()) {
+        o.copy_from_slice(&s.to_le_bytes());
+    }
+    out
+}
+
+pub fn keccak256(data: &[u8]) -> [u8; KECCAK256_OUTPUT_LEN] {
+    let mut ctx = Keccak256::new();
+    ctx.update(data);
+    ctx.finish()
+}
+
+pub fn sha3_256(data: &[u8]) -> [u8; KECCAK256_OUTPUT_LEN] {
+    let mut ctx = Keccak256::new_sha3();
+    ctx.update(data);
+    ctx.finish()
+}
+
+/// Number of rate-sized blocks of a message of `len` bytes after padding.
+fn num_blocks(len: usize) -> usize {
+    len / RATE + 1
+}
+
+/// Writes block `idx` of the padded form of `msg` into `block`.
+fn padded_block(msg: &[u8], idx: usize, pad: u8, block: &mut [u8; RATE]) {
+    let start = idx * RATE;
+    *block = [0u8; RATE];
+    if start < msg.len() {
+        let n = core::cmp::min(RATE, msg.len() - start);
+        block[..n].copy_from_slice(&msg[start..(start + n)]);
+    }
+    if idx + 1 == num_blocks(msg.len()) {
+        block[msg.len() - start] ^= pad;
+        block[RATE - 1] ^= 0x80;
+    }
+}
+
+fn many(pad: u8, inputs: &[&[u8]], outputs: &mut [[u8; KECCAK256_OUTPUT_LEN]]) {
+    assert_eq!(inputs.len(), outputs.len());
+    let mut block = [0u8; RATE];
+    for (ins, outs) in inputs.chunks(4).zip(outputs.chunks_mut(4)) {
+        let mut states = [X4([0u64; 4]); 25];
+        let mut blocks = [0usize; 4];
+        let mut max_blocks = 0;
+        for (lane, input) in ins.iter().enumerate() {
+            blocks[lane] = num_blocks(input.len());
+            max_blocks = core::cmp::max(max_blocks, blocks[lane]);
+        }
+        for i in 0..max_blocks {
+            for (lane, input) in ins.iter().enumerate() {
+                if i >= blocks[lane] {
+                    continue;
+                }
+                padded_block(input, i, pad, &mut block);
+                for (s, w) in states.iter_mut().zip(block.chunks(8)) {
+                    let mut b = [0u8; 8];
+                    b.copy_from_slice(w);
+                    s.0[lane] ^= u64::from_le_bytes(b);
+                }
+            }
+            keccak_f1600_x4(&mut states);
+            for (lane, out) in outs.iter_mut().enumerate() {
+                if i + 1 == blocks[lane] {
+                    for (o, s) in out.chunks_mut(8).zip(states.iter()) {
+                        o.copy_from_slice(&s.0[lane].to_le_bytes());
+                    }
+                }
+            }
+        }
+    }
+}
+
+/// Computes `outputs[i] = Keccak-256(inputs[i])`, four messages at a time.
+/// Panics if the slices do not have the same length.
+pub fn keccak256_many(inputs: &[&[u8]], outputs: &mut [[u8; KECCAK256_OUTPUT_LEN]]) {
+    many(KECCAK_PAD, inputs, outputs)
+}
+
+/// Computes `outputs[i] = SHA3-256(inputs[i])`, four messages at a time.
+/// Panics if the slices do not have the same length.
+pub fn sha3_256_many(inputs: &[&[u8]], outputs: &mut [[u8; KECCAK256_OUTPUT_LEN]]) {
+    many(SHA3_PAD, inputs, outputs)
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_keccak256() {
+        assert_eq!(
+            hex::encode(keccak256(b"")),
+            "c5d2460186f7233c927e7db2dcc703c0e500b653ca82273b7bfad8045d85a470"
+        );
+        assert_eq!(
+            hex::encode(keccak256(b"abc")),
+            "4e03657aea45a94fc7d47ba826c8d667c0d1e6e33a64a036ec44f58fa12d6c45"
+        );
+    }
+
+    #[test]
+    fn test_sha3_256() {
+        assert_eq!(
+            hex::encode(sha3_256(b"")),
+            "a7ffc6f8bf1ed76651c14756a061d662f580ff4de43b49fa82d80a4b80f8434a"
+        );
+        assert_eq!(
+            hex::encode(sha3_256(b"abc")),
+            "3a985da74fe225b2045c172d6bd390bd855f086e3e9d525b46bfe24511431532"
+        );
+        let million_a = vec![b'a'; 1_000_000];
+        assert_eq!(
+            hex::encode(sha3_256(&million_a)),
+            "5c8875ae474a3634ba4fd55ec85bffd661f32aca75c6d699d0cdcb6c115891c1"
+        );
+    }
+
+    #[test]
+    fn test_streaming_and_many() {
+        let data: Vec<u8> = (0..700u32).map(|i| (i * 13 + 1) as u8).collect();
+        let lens = [0usize, 1, 64, 134, 135, 136, 137, 271, 272, 273, 700];
+        let inputs: Vec<&[u8]> = lens.iter().map(|l| &data[..*l]).collect();
+        let mut k = vec![[0u8; 32]; inputs.len()];
+        let mut s = vec![[0u8; 32]; inputs.len()];
+        keccak256_many(&inputs, &mut k);
+        sha3_256_many(&inputs, &mut s);
+        for (i, input) in inputs.iter().enumerate() {
+            assert_eq!(k[i], keccak256(input));
+            assert_eq!(s[i], sha3_256(input));
+
+            let mut ctx = Keccak256::new();
+            for chunk in input.chunks(7) {
+                ctx.update(chunk);
+            }
+            assert_eq!(ctx.finish(), k[i]);
+        }
+    }
+}
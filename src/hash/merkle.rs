@@ -0,0 +1,442 @@
+// Merkle trees over SHA-256 / double SHA-256.
+//
+// Trees follow the Bitcoin construction: an interior node is
+// H(left || right), and a level with an odd number of nodes pairs its last
+// node with itself. With `MerkleHash::DoubleSha256` the roots are identical
+// to Bitcoin block Merkle roots (over txids in internal byte order).
+//
+// Note that the duplication rule makes a list and the same list with its
+// last element repeated produce the same root (CVE-2012-2459); callers that
+// need leaf counts to be authenticated must commit to the count separately.
+//
+// `MerkleTree` keeps every level in one flat array (`nodes`), leaves first,
+// so building a tree costs a constant number of allocations per level and
+// none per node. Each level is hashed in one `sha256_many` call, which runs
+// the independent node hashes side by side in SIMD lanes.
+
+use std::prelude::v1::*;
+
+use super::hash::{sha256_array, SHA256_OUTPUT_LEN};
+use super::multibuffer::sha256_many;
+use crate::errors::{Error, ErrorKind, Result};
+
+pub type Node = [u8; SHA256_OUTPUT_LEN];
+
+#[derive(Clone, Copy, Debug, PartialEq, Eq)]
+pub enum MerkleHash {
+    Sha256,
+    DoubleSha256,
+}
+
+impl MerkleHash {
+    /// H(left || right).
+    pub fn node(self, left: &Node, right: &Node) -> Node {
+        let mut buf = [0u8; 2 * SHA256_OUTPUT_LEN];
+        buf[..SHA256_OUTPUT_LEN].copy_from_slice(left);
+        buf[SHA256_OUTPUT_LEN..].copy_from_slice(right);
+        let h = sha256_array(&buf);
+        match self {
+            MerkleHash::Sha256 => h,
+            MerkleHash::DoubleSha256 => sha256_array(&h),
+        }
+    }
+
+    /// Hashes `pairs[i]` (a left || right concatenation) into `out[i]`.
+    fn nodes(self, pairs: &[&[u8]], out: &mut [Node]) {
+        sha256_many(pairs, out);
+        if self == MerkleHash::DoubleSha256 {
+            let first = out.to_vec();
+            let inputs: Vec<&[u8]> = first.iter().map(|h| &h[..]).collect();
+            sha256_many(&inputs, out);
+        }
+    }
+}
+
+/// Views a slice of nodes as the bytes of the nodes laid out back to back.
+fn as_bytes(nodes: &[Node]) -> &[u8] {
+    // A `[[u8; 32]]` is `32 * len` contiguous bytes without padding.
+    unsafe { core::slice::from_raw_parts(nodes.as_ptr() as *const u8, nodes.len() * 32) }
+}
+
+/// Hashes one level of `len` nodes (`level`) into `parents`, which must hold
+/// `(len + 1) / 2` nodes.
+fn hash_level(alg: MerkleHash, level: &[Node], parents: &mut [Node]) {
+    let bytes = as_bytes(level);
+    let full = level.len() / 2;
+    let mut last = [0u8; 2 * SHA256_OUTPUT_LEN];
+    let mut pairs: Vec<&[u8]> = bytes.chunks(2 * SHA256_OUTPUT_LEN).take(full).collect();
+    if level.len() % 2 == 1 {
+        let odd = &level[level.len() - 1];
+        last[..SHA256_OUTPUT_LEN].copy_from_slice(odd);
+        last[SHA256_OUTPUT_LEN..].copy_from_slice(odd);
+        pairs.push(&last[..]);
+    }
+    alg.nodes(&pairs, parents);
+}
+
+/// Computes the Merkle root of `leaves` without keeping the interior
+/// levels. Fails if `leaves` is empty.
+pub fn merkle_root(alg: MerkleHash, leaves: &[Node]) -> Result<Node> {
+    if leaves.is_empty() {
+        return Err(Error::from(ErrorKind::InvalidInputError));
+    }
+    if leaves.len() == 1 {
+        return Ok(leaves[0]);
+    }
+    let mut current = vec![[0u8; SHA256_OUTPUT_LEN]; (leaves.len() + 1) / 2];
+    hash_level(alg, leaves, &mut current);
+    let mut next = vec![[0u8; SHA256_OUTPUT_LEN]; (current.len() + 1) / 2];
+    let mut len = current.len();
+    while len > 1 {
+        let parents = (len + 1) / 2;
+        hash_level(alg, &current[..len], &mut next[..parents]);
+        core::mem::swap(&mut current, &mut next);
+        len = parents;
+    }
+    Ok(current[0])
+}
+
+/// A complete tree with all levels stored in one flat array.
+#[derive(Clone, Debug)]
+pub struct MerkleTree {
+    alg: MerkleHash,
+    nodes: Vec<Node>,
+    // (offset into `nodes`, number of nodes) per level, leaves first.
+    levels: Vec<(usize, usize)>,
+}
+
+impl MerkleTree {
+    pub fn new(alg: MerkleHash, leaves: &[Node]) -> Result<Self> {
+        if leaves.is_empty() {
+            return Err(Error::from(ErrorKind::InvalidInputError));
+        }
+        let mut levels = vec![(0, leaves.len())];
+        let mut total = leaves.len();
+        let mut len = leaves.len();
+        while len > 1 {
+            len = (len + 1) / 2;
+            levels.push((total, len));
+            total += len;
+        }
+
+        let mut nodes = vec![[0u8; SHA256_OUTPUT_LEN]; total];
+        nodes[..leaves.len()].copy_from_slice(leaves);
+        for l in 1..levels.len() {
+            let (offset, len) = levels[l];
+            let (below, above) = nodes.split_at_mut(offset);
+            let (child_offset, child_len) = levels[l - 1];
+            hash_level(
+                alg,
+                &below[child_offset..(child_offset + child_len)],
+                &mut above[..len],
+            );
+        }
+
+        Ok(MerkleTree { alg, nodes, levels })
+    }
+
+    pub fn root(&self) -> Node {
+        self.nodes[self.nodes.len() - 1]
+    }
+
+    pub fn leaf_count(&self) -> usize {
+        self.levels[0].1
+    }
+
+    fn level(&self, l: usize) -> &[Node] {
+        let (offset, len) = self.levels[l];
+        &self.nodes[offset..(offset + len)]
+    }
+
+    /// Builds one proof for all of `indices` (in any order, duplicates
+    /// allowed). Sibling hashes that can be recomputed from the proven
+    /// leaves themselves are omitted, so the proof is never larger than the
+    /// sum of the individual proofs and usually much smaller.
+    pub fn multi_proof(&self, indices: &[usize]) -> Result<MultiProof> {
+        let mut known = indices.to_vec();
+        known.sort();
+        known.dedup();
+        if known.is_empty() || known[known.len() - 1] >= self.leaf_count() {
+            return Err(Error::from(ErrorKind::InvalidInputError));
+        }
+        let proven = known.clone();
+
+        let mut hashes = vec![];
+        for l in 0..(self.levels.len() - 1) {
+            let level = self.level(l);
+            let mut i = 0;
+            while i < known.len() {
+                let idx = known[i];
+                let sibling = idx ^ 1;
+                if idx & 1 == 0 && i + 1 < known.len() && known[i + 1] == sibling {
+                    i += 1;
+                } else if sibling < level.len() {
+                    hashes.push(level[sibling]);
+                }
+                i += 1;
+            }
+            for k in known.iter_mut() {
+                *k >>= 1;
+            }
+            known.dedup();
+        }
+
+        Ok(MultiProof {
+            leaf_count: self.leaf_count(),
+            indices: proven,
+            hashes,
+        })
+    }
+}
+
+/// An inclusion proof for several leaves of the same tree.
+#[derive(Clone, Debug, PartialEq, Eq)]
+pub struct MultiProof {
+    pub leaf_count: usize,
+    /// Proven leaf indices, strictly increasing.
+    pub indices: Vec<usize>,
+    /// Sibling hashes, level by level from the leaves up, left to right.
+    pub hashes: Vec<Node>,
+}
+
+impl MultiProof {
+    /// Checks that `leaves[i]` is the leaf at `self.indices[i]` of a tree
+    /// with root `root`. All node hashes of a level are computed in one
+    /// batch.
+    pub fn verify(&self, alg: MerkleHash, root: &Node, leaves: &[Node]) -> Result<()> {
+        if self.indices.is_empty()
+            || leaves.len() != self.indices.len()
+            || self.indices.windows(2).any(|w| w[0] >= w[1])
+            || self.indices[self.indices.len() - 1] >= self.leaf_count
+        {
+            return Err(Error::from(ErrorKind::InvalidInputError));
+        }
+
+        let mut known: Vec<(usize, Node)> = self
+            .indices
+            .iter()
+            .cloned()
+            .zip(leaves.iter().cloned())
+            .collect();
+        let mut proof = self.hashes.iter();
+        let mut pairs: Vec<[u8; 2 * SHA256_OUTPUT_LEN]> = Vec::with_capacity(known.len());
+        let mut parents: Vec<Node> = Vec::with_capacity(known.len());
+        let mut len = self.leaf_count;
+        while len > 1 {
+            pairs.clear();
+            let mut i = 0;
+            while i < known.len() {
+                let (idx, h) = known[i];
+                let sibling = idx ^ 1;
+                let (left, right) = if idx & 1 == 1 {
+                    (next_hash(&mut proof)?, h)
+                } else if sibling >= len {
+                    (h, h)
+                } else if i + 1 < known.len() && known[i + 1].0 == sibling {
+                    i += 1;
+                    (h, known[i].1)
+                } else {
+                    (h, next_hash(&mut proof)?)
+                };
+                let mut pair = [0u8; 2 * SHA256_OUTPUT_LEN];
+                pair[..SHA256_OUTPUT_LEN].copy_from_slice(&left);
+                pair[SHA256_OUTPUT_LEN..].copy_from_slice(&right);
+                // Parents are written back over the already consumed prefix
+                // of `known`.
+                known[pairs.len()].0 = idx >> 1;
+                pairs.push(pair);
+                i += 1;
+            }
+            known.truncate(pairs.len());
+
+            parents.clear();
+            parents.resize(pairs.len(), [0u8; SHA256_OUTPUT_LEN]);
+            {
+                let inputs: Vec<&[u8]> = pairs.iter().map(|p| &p[..]).collect();
+                alg.nodes(&inputs, &mut parents);
+            }
+            for (k, p) in known.iter_mut().zip(parents.iter()) {
+                k.1 = *p;
+            }
+            len = (len + 1) / 2;
+        }
+
+        if proof.next().is_some() || known[0].1 != *root {
+            return Err(Error::from(ErrorKind::CryptoError));
+        }
+        Ok(())
+    }
+}
+
+fn next_hash(proof: &mut core::slice::Iter<Node>) -> Result<Node> {
+    proof
+        .next()
+        .cloned()
+        .ok_or(Error::from(ErrorKind::CryptoError))
+}
+
+/// An append-only tree that keeps only the O(log n) pending left siblings,
+/// so each `push` costs O(log n) hashes and O(1) memory.
+///
+/// This is the incremental form of Bitcoin's `ComputeMerkleRoot`: `inner[l]`
+/// holds the root of a complete subtree of 2^l leaves waiting for its right
+/// neighbour, exactly when bit `l` of `count` is set.
+#[derive(Clone)]
+pub struct IncrementalMerkleTree {
+    alg: MerkleHash,
+    count: u64,
+    inner: [Node; 64],
+}
+
+impl IncrementalMerkleTree {
+    pub fn new(alg: MerkleHash) -> Self {
+        IncrementalMerkleTree {
+            alg,
+            count: 0,
+            inner: [[0u8; SHA256_OUTPUT_LEN]; 64],
+        }
+    }
+
+    pub fn len(&self) -> u64 {
+        self.count
+    }
+
+    pub fn push(&mut self, leaf: &Node) {
+        let mut h = *leaf;
+        let mut level = 0;
+        while self.count & (1 << level) != 0 {
+            h = self.alg.node(&self.inner[level], &h);
+            level += 1;
+        }
+        self.inner[level] = h;
+        self.count += 1;
+    }
+
+    /// The root of the leaves pushed so far, identical to `merkle_root`
+    /// over the same leaves. Fails if no leaf has been pushed.
+    pub fn root(&self) -> Result<Node> {
+        if self.count == 0 {
+            return Err(Error::from(ErrorKind::InvalidInputError));
+        }
+        let mut count = self.count;
+        let mut level = count.trailing_zeros() as usize;
+        let mut h = self.inner[level];
+        while count != (1 << level) {
+            // `h` is the root of a lone subtree on an odd level: pair it with
+            // itself, then fold in the pending left siblings above it.
+            h = self.alg.node(&h, &h);
+            count += 1 << level;
+            level += 1;
+            while count & (1 << level) == 0 {
+                h = self.alg.node(&self.inner[level], &h);
+                level += 1;
+            }
+        }
+        Ok(h)
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn leaves(n: usize) -> Vec<Node> {
+        (0..n).map(|i| sha256_array(&(i as u64).to_le_bytes())).collect()
+    }
+
+    fn naive_root(alg: MerkleHash, leaves: &[Node]) -> Node {
+        let mut level = leaves.to_vec();
+        while level.len() > 1 {
+            if level.len() % 2 == 1 {
+                level.push(level[level.len() - 1]);
+            }
+            level = level.chunks(2).map(|p| alg.node(&p[0], &p[1])).collect();
+        }
+        level[0]
+    }
+
+    #[test]
+    fn test_bitcoin_block_100000() {
+        let txids = [
+            "8c14f0db3df150123e6f3dbbf30f8b955a8249b62ac1d1ff16284aefa3d06d87",
+            "fff2525b8931402dd09222c50775608f75787bd2b87e56995a7bdd30f79702c4",
+            "6359f0868171b1d194cbee1af2f16ea598ae8fad666d9b012c8ed2b79a236ec4",
+            "e9a66845e05d5abc0ad04ec80f774a7e585c6e8db975962d069a522137b80c1d",
+        ];
+        let leaves: Vec<Node> = txids
+            .iter()
+            .map(|t| {
+                let mut h = [0u8; 32];
+                h.copy_from_slice(&hex::decode(t).unwrap());
+                h.reverse();
+                h
+            })
+            .collect();
+        let mut root = merkle_root(MerkleHash::DoubleSha256, &leaves).unwrap();
+        root.reverse();
+        assert_eq!(
+            hex::encode(root),
+            "f3e94742aca4b5ef85488dc37c06c3282295ffec960994b2c0d5ac2a25a95766"
+        );
+    }
+
+    #[test]
+    fn test_roots_agree() {
+        for alg in [MerkleHash::Sha256, MerkleHash::DoubleSha256].iter() {
+            let all = leaves(70);
+            let mut inc = IncrementalMerkleTree::new(*alg);
+            assert!(inc.root().is_err());
+            for n in 1..all.len() {
+                inc.push(&all[n - 1]);
+                let expected = naive_root(*alg, &all[..n]);
+                assert_eq!(merkle_root(*alg, &all[..n]).unwrap(), expected);
+                assert_eq!(MerkleTree::new(*alg, &all[..n]).unwrap().root(), expected);
+                assert_eq!(inc.root().unwrap(), expected);
+                assert_eq!(inc.len(), n as u64);
+            }
+        }
+        assert!(merkle_root(MerkleHash::Sha256, &[]).is_err());
+    }
+
+    #[test]
+    fn test_multi_proof() {
+        let alg = MerkleHash::DoubleSha256;
+        for n in [1usize, 2, 3, 5, 8, 13, 33].iter() {
+            let all = leaves(*n);
+            let tree = MerkleTree::new(alg, &all).unwrap();
+            let root = tree.root();
+            let sets: Vec<Vec<usize>> = vec![
+                vec![0],
+                vec![n - 1],
+                vec![0, n - 1],
+                (0..*n).step_by(3).collect(),
+                (0..*n).collect(),
+            ];
+            for set in sets.iter() {
+                let proof = tree.multi_proof(set).unwrap();
+                let proven: Vec<Node> = proof.indices.iter().map(|i| all[*i]).collect();
+                proof.verify(alg, &root, &proven).unwrap();
+
+                // Every index proven at once needs no sibling at all.
+                if set.len() == *n {
+                    assert!(proof.hashes.is_empty());
+                }
+
+                let mut bad = proven.clone();
+                bad[0][0] ^= 1;
+                assert!(proof.verify(alg, &root, &bad).is_err());
+                if !proof.hashes.is_empty() {
+                    let mut tampered = proof.clone();
+                    tampered.hashes[0][31] ^= 1;
+                    assert!(tampered.verify(alg, &root, &proven).is_err());
+                    let mut short = proof.clone();
+                    short.hashes.pop();
+                    assert!(short.verify(alg, &root, &proven).is_err());
+                }
+            }
+        }
+        let tree = MerkleTree::new(alg, &leaves(4)).unwrap();
+        assert!(tree.multi_proof(&[4]).is_err());
+        assert!(tree.multi_proof(&[]).is_err());
+    }
+}
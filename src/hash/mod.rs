@@ -1 +1,4 @@
 pub mod hash;
+pub mod keccak;
+pub mod merkle;
+pub mod multibuffer;
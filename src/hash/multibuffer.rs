@@ -0,0 +1,525 @@
+// Multi-buffer SHA-256.
+//
+// Hashing many short, independent messages (Merkle leaves, address
+// checksums, transaction ids) is dominated by per-call overhead and by the
+// serial dependency chain inside a single compression. `sha256_many` hides
+// both by hashing several messages side by side:
+//
+//   * `ShaNi`:   one message at a time using the SHA extensions,
+//   * `Avx2X8`:  eight messages per compression in 256-bit registers,
+//   * `Sse41X4`: four messages per compression in 128-bit registers,
+//   * `Scalar`:  `ring::digest`, one message at a time.
+//
+// The backend is picked once at runtime from CPUID, but only `ShaNi` is
+// picked automatically: the SIMD lanes measure slower than ring's scalar
+// code (about 0.3-0.5 vs. 1.0-1.1 Mhash/s for `Sse41X4`), so they are only
+// reachable through `set_backend`. Inside SGX CPUID is not available (and
+// not trustworthy), so those builds always use `Scalar`.
+
+use std::prelude::v1::*;
+
+use super::hash::{sha256_array, SHA256_OUTPUT_LEN};
+use core::sync::atomic::{AtomicU8, Ordering};
+
+#[derive(Clone, Copy, Debug, PartialEq, Eq)]
+pub enum Backend {
+    Scalar = 1,
+    Sse41X4 = 2,
+    Avx2X8 = 3,
+    ShaNi = 4,
+}
+
+impl Backend {
+    /// Number of messages compressed side by side.
+    pub fn lanes(self) -> usize {
+        match self {
+            Backend::Scalar | Backend::ShaNi => 1,
+            Backend::Sse41X4 => 4,
+            Backend::Avx2X8 => 8,
+        }
+    }
+
+    fn from_u8(v: u8) -> Option<Backend> {
+        match v {
+            1 => Some(Backend::Scalar),
+            2 => Some(Backend::Sse41X4),
+            3 => Some(Backend::Avx2X8),
+            4 => Some(Backend::ShaNi),
+            _ => None,
+        }
+    }
+
+    fn is_supported(self) -> bool {
+        match self {
+            Backend::Scalar => true,
+            #[cfg(all(
+                any(target_arch = "x86", target_arch = "x86_64"),
+                not(any(feature = "mesalock_sgx", target_env = "sgx"))
+            ))]
+            Backend::Sse41X4 => is_x86_feature_detected!("sse4.1"),
+            #[cfg(all(
+                any(target_arch = "x86", target_arch = "x86_64"),
+                not(any(feature = "mesalock_sgx", target_env = "sgx"))
+            ))]
+            Backend::Avx2X8 => is_x86_feature_detected!("avx2"),
+            #[cfg(all(
+                any(target_arch = "x86", target_arch = "x86_64"),
+                not(any(feature = "mesalock_sgx", target_env = "sgx"))
+            ))]
+            Backend::ShaNi => {
+                is_x86_feature_detected!("sha")
+                    && is_x86_feature_detected!("sse4.1")
+                    && is_x86_feature_detected!("ssse3")
+            }
+            #[allow(unreachable_patterns)]
+            _ => false,
+        }
+    }
+}
+
+static BACKEND: AtomicU8 = AtomicU8::new(0);
+
+fn detect() -> Backend {
+    // See the module comment for why this doesn't pick the SIMD lanes.
+    if Backend::ShaNi.is_supported() {
+        return Backend::ShaNi;
+    }
+    Backend::Scalar
+}
+
+/// The backend `sha256_many` dispatches to on this machine.
+pub fn backend() -> Backend {
+    if let Some(b) = Backend::from_u8(BACKEND.load(Ordering::Relaxed)) {
+        return b;
+    }
+    let b = detect();
+    BACKEND.store(b as u8, Ordering::Relaxed);
+    b
+}
+
+/// Overrides the detected backend, e.g. to compare implementations or to
+/// pin the portable path. Fails if the CPU does not support `b`.
+pub fn set_backend(b: Backend) -> crate::errors::Result<()> {
+    if !b.is_supported() {
+        return Err(crate::errors::Error::from(
+            crate::errors::ErrorKind::ErrCryptographyNotSupported,
+        ));
+    }
+    BACKEND.store(b as u8, Ordering::Relaxed);
+    Ok(())
+}
+
+/// Computes `outputs[i] = SHA-256(inputs[i])` for every input.
+///
+/// Inputs may have arbitrary and differing lengths. Panics if the slices do
+/// not have the same length.
+pub fn sha256_many(inputs: &[&[u8]], outputs: &mut [[u8; SHA256_OUTPUT_LEN]]) {
+    sha256_many_with(backend(), inputs, outputs)
+}
+
+pub(crate) fn sha256_many_with(
+    backend: Backend,
+    inputs: &[&[u8]],
+    outputs: &mut [[u8; SHA256_OUTPUT_LEN]],
+) {
+    assert_eq!(inputs.len(), outputs.len());
+    match backend {
+        #[cfg(all(
+            any(target_arch = "x86", target_arch = "x86_64"),
+            not(any(feature = "mesalock_sgx", target_env = "sgx"))
+        ))]
+        Backend::ShaNi => {
+            for (input, output) in inputs.iter().zip(outputs.iter_mut()) {
+                let mut state = H0;
+                let full = input.len() / 64;
+                unsafe { x86::compress_shani(&mut state, &input[..(full * 64)]) };
+                let mut block = [0u8; 64];
+                for i in full..num_blocks(input.len()) {
+                    padded_block(input, i, &mut block);
+                    unsafe { x86::compress_shani(&mut state, &block) };
+                }
+                store_state(&state, output);
+            }
+        }
+        #[cfg(all(
+            any(target_arch = "x86", target_arch = "x86_64"),
+            not(any(feature = "mesalock_sgx", target_env = "sgx"))
+        ))]
+        Backend::Avx2X8 => {
+            for (ins, outs) in inputs.chunks(8).zip(outputs.chunks_mut(8)) {
+                let mut lanes = LanesX8::new(ins);
+                lanes.run(|state, w| unsafe { x86::compress_x8_avx2(state, w) });
+                lanes.store(outs);
+            }
+        }
+        #[cfg(all(
+            any(target_arch = "x86", target_arch = "x86_64"),
+            not(any(feature = "mesalock_sgx", target_env = "sgx"))
+        ))]
+        Backend::Sse41X4 => {
+            for (ins, outs) in inputs.chunks(4).zip(outputs.chunks_mut(4)) {
+                let mut lanes = LanesX4::new(ins);
+                lanes.run(|state, w| unsafe { x86::compress_x4_sse41(state, w) });
+                lanes.store(outs);
+            }
+        }
+        _ => {
+            for (input, output) in inputs.iter().zip(outputs.iter_mut()) {
+                *output = sha256_array(input);
+            }
+        }
+    }
+}
+
+const H0: [u32; 8] = [
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+];
+
+const K: [u32; 64] = [
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+];
+
+/// Number of 64-byte blocks of a message of `len` bytes after padding.
+fn num_blocks(len: usize) -> usize {
+    (len + 9 + 63) / 64
+}
+
+/// Writes block `idx` of the padded form of `msg` into `block`, so that no
+/// padded copy of the message is ever materialized.
+fn padded_block(msg: &[u8], idx: usize, block: &mut [u8; 64]) {
+    let start = idx * 64;
+    *block = [0u8; 64];
+    if start < msg.len() {
+        let n = core::cmp::min(64, msg.len() - start);
+        block[..n].copy_from_slice(&msg[start..(start + n)]);
+    }
+    if msg.len() >= start && msg.len() < start + 64 {
+        block[msg.len() - start] = 0x80;
+    }
+    if idx + 1 == num_blocks(msg.len()) {
+        let bit_len = (msg.len() as u64).wrapping_mul(8);
+        block[56..].copy_from_slice(&bit_len.to_be_bytes());
+    }
+}
+
+fn store_state(state: &[u32; 8], out: &mut [u8; SHA256_OUTPUT_LEN]) {
+    for (o, s) in out.chunks_mut(4).zip(state.iter()) {
+        o.copy_from_slice(&s.to_be_bytes());
+    }
+}
+
+// Structure-of-arrays state for `N` messages: `state[j][lane]` is word `j`
+// of the hash state of the message in `lane`, and `w[t][lane]` is message
+// word `t` of the current block, so that one vector register holds the same
+// word of every lane.
+macro_rules! lanes {
+    ( $name:ident, $n:expr ) => {
+        struct $name<'a> {
+            inputs: &'a [&'a [u8]],
+            state: [[u32; $n]; 8],
+            out: [[u32; 8]; $n],
+        }
+
+        impl<'a> $name<'a> {
+            fn new(inputs: &'a [&'a [u8]]) -> Self {
+                let mut state = [[0u32; $n]; 8];
+                for (j, h) in H0.iter().enumerate() {
+                    state[j] = [*h; $n];
+                }
+                $name {
+                    inputs,
+                    state,
+                    out: [[0u32; 8]; $n],
+                }
+            }
+
+            /// Runs the compression function over all blocks of all lanes.
+            /// A lane whose message is shorter than the longest one keeps
+            /// being fed (ignored) blocks; its digest is captured right after
+            /// its own final block.
+            fn run<F: Fn(&mut [[u32; $n]; 8], &[[u32; $n]; 16])>(&mut self, compress: F) {
+                let mut blocks = [0usize; $n];
+                let mut max_blocks = 0;
+                for (lane, input) in self.inputs.iter().enumerate() {
+                    blocks[lane] = num_blocks(input.len());
+                    max_blocks = core::cmp::max(max_blocks, blocks[lane]);
+                }
+                let mut block = [0u8; 64];
+                let mut w = [[0u32; $n]; 16];
+                for i in 0..max_blocks {
+                    for (lane, input) in self.inputs.iter().enumerate() {
+                        if i >= blocks[lane] {
+                            continue;
+                        }
+                        let bytes = if (i + 1) * 64 <= input.len() {
+                            &input[(i * 64)..((i + 1) * 64)]
+                        } else {
+                            padded_block(input, i, &mut block);
+                            &block[..]
+                        };
+                        for t in 0..16 {
+                            let mut word = [0u8; 4];
+                            word.copy_from_slice(&bytes[(4 * t)..(4 * t + 4)]);
+                            w[t][lane] = u32::from_be_bytes(word);
+                        }
+                    }
+                    compress(&mut self.state, &w);
+                    for lane in 0..self.inputs.len() {
+                        if i + 1 == blocks[lane] {
+                            for j in 0..8 {
+                                self.out[lane][j] = self.state[j][lane];
+                            }
+                        }
+                    }
+                }
+            }
+
+            fn store(&self, outputs: &mut [[u8; SHA256_OUTPUT_LEN]]) {
+                for (lane, out) in outputs.iter_mut().enumerate() {
+                    store_state(&self.out[lane], out);
+                }
+            }
+        }
+    };
+}
+
+lanes!(LanesX4, 4);
+lanes!(LanesX8, 8);
+
+#[cfg(all(
+    any(target_arch = "x86", target_arch = "x86_64"),
+    not(any(feature = "mesalock_sgx", target_env = "sgx"))
+))]
+mod x86 {
+    #[cfg(target_arch = "x86")]
+    use core::arch::x86::*;
+    #[cfg(target_arch = "x86_64")]
+    use core::arch::x86_64::*;
+
+    // The SHA-256 compression function over `$n` lanes, one lane per 32-bit
+    // element of `$v`.
+    macro_rules! compress_lanes {
+        ( $name:ident, $feature:expr, $v:ty, $n:expr, $load:ident, $store:ident,
+          $set1:ident, $add:ident, $xor:ident, $and:ident, $andnot:ident, $or:ident,
+          $srli:ident, $slli:ident ) => {
+            #[target_feature(enable = $feature)]
+            pub(super) unsafe fn $name(state: &mut [[u32; $n]; 8], block: &[[u32; $n]; 16]) {
+                macro_rules! rotr {
+                    ( $x:expr, $r:expr ) => {
+                        $or($srli($x, $r), $slli($x, 32 - $r))
+                    };
+                }
+
+                let mut w: [$v; 16] = [$set1(0); 16];
+                for t in 0..16 {
+                    w[t] = $load(block[t].as_ptr() as *const $v);
+                }
+                let mut s: [$v; 8] = [$set1(0); 8];
+                for j in 0..8 {
+                    s[j] = $load(state[j].as_ptr() as *const $v);
+                }
+                let [mut a, mut b, mut c, mut d, mut e, mut f, mut g, mut h] = s;
+
+                for t in 0..64 {
+                    let wt = if t < 16 {
+                        w[t]
+                    } else {
+                        let w15 = w[(t + 1) % 16];
+                        let w2 = w[(t + 14) % 16];
+                        let s0 = $xor($xor(rotr!(w15, 7), rotr!(w15, 18)), $srli(w15, 3));
+                        let s1 = $xor($xor(rotr!(w2, 17), rotr!(w2, 19)), $srli(w2, 10));
+                        let v = $add($add(w[t % 16], s0), $add(w[(t + 9) % 16], s1));
+                        w[t % 16] = v;
+                        v
+                    };
+                    let s1 = $xor($xor(rotr!(e, 6), rotr!(e, 11)), rotr!(e, 25));
+                    let ch = $xor($and(e, f), $andnot(e, g));
+                    let maj = $or($and(a, b), $and(c, $or(a, b)));
+                    let t1 = $add(
+                        $add(h, s1),
+                        $add($add(ch, wt), $set1(super::K[t] as i32)),
+                    );
+                    let s0 = $xor($xor(rotr!(a, 2), rotr!(a, 13)), rotr!(a, 22));
+                    let t2 = $add(s0, maj);
+                    h = g;
+                    g = f;
+                    f = e;
+                    e = $add(d, t1);
+                    d = c;
+                    c = b;
+                    b = a;
+                    a = $add(t1, t2);
+                }
+
+                let new = [a, b, c, d, e, f, g, h];
+                for j in 0..8 {
+                    $store(state[j].as_mut_ptr() as *mut $v, $add(s[j], new[j]));
+                }
+            }
+        };
+    }
+
+    compress_lanes!(
+        compress_x4_sse41, "sse4.1", __m128i, 4, _mm_loadu_si128, _mm_storeu_si128,
+        _mm_set1_epi32, _mm_add_epi32, _mm_xor_si128, _mm_and_si128, _mm_andnot_si128,
+        _mm_or_si128, _mm_srli_epi32, _mm_slli_epi32
+    );
+
+    compress_lanes!(
+        compress_x8_avx2, "avx2", __m256i, 8, _mm256_loadu_si256, _mm256_storeu_si256,
+        _mm256_set1_epi32, _mm256_add_epi32, _mm256_xor_si256, _mm256_and_si256,
+        _mm256_andnot_si256, _mm256_or_si256, _mm256_srli_epi32, _mm256_slli_epi32
+    );
+
+    #[inline(always)]
+    unsafe fn schedule(v0: __m128i, v1: __m128i, v2: __m128i, v3: __m128i) -> __m128i {
+        let t1 = _mm_sha256msg1_epu32(v0, v1);
+        let t2 = _mm_alignr_epi8(v3, v2, 4);
+        _mm_sha256msg2_epu32(_mm_add_epi32(t1, t2), v3)
+    }
+
+    /// Compresses the 64-byte blocks of `blocks` into `state` using the SHA
+    /// extensions, keeping the state in registers across blocks.
+    #[target_feature(enable = "sha,sse2,ssse3,sse4.1")]
+    pub(super) unsafe fn compress_shani(state: &mut [u32; 8], blocks: &[u8]) {
+        debug_assert_eq!(blocks.len() % 64, 0);
+        let bswap = _mm_set_epi64x(
+            0x0c0d_0e0f_0809_0a0bu64 as i64,
+            0x0405_0607_0001_0203u64 as i64,
+        );
+        let state_ptr = state.as_mut_ptr() as *mut __m128i;
+        let dcba = _mm_loadu_si128(state_ptr);
+        let efgh = _mm_loadu_si128(state_ptr.add(1));
+
+        let cdab = _mm_shuffle_epi32(dcba, 0xb1);
+        let efgh = _mm_shuffle_epi32(efgh, 0x1b);
+        let mut abef = _mm_alignr_epi8(cdab, efgh, 8);
+        let mut cdgh = _mm_blend_epi16(efgh, cdab, 0xf0);
+
+        for block in blocks.chunks(64) {
+            let abef_save = abef;
+            let cdgh_save = cdgh;
+
+            let data = block.as_ptr() as *const __m128i;
+            let mut w = [
+                _mm_shuffle_epi8(_mm_loadu_si128(data), bswap),
+                _mm_shuffle_epi8(_mm_loadu_si128(data.add(1)), bswap),
+                _mm_shuffle_epi8(_mm_loadu_si128(data.add(2)), bswap),
+                _mm_shuffle_epi8(_mm_loadu_si128(data.add(3)), bswap),
+            ];
+            for i in 0..16 {
+                if i >= 4 {
+                    w[i % 4] = schedule(
+                        w[i % 4],
+                        w[(i + 1) % 4],
+                        w[(i + 2) % 4],
+                        w[(i + 3) % 4],
+                    );
+                }
+                let k = _mm_loadu_si128(super::K.as_ptr().add(4 * i) as *const __m128i);
+                let t1 = _mm_add_epi32(w[i % 4], k);
+                cdgh = _mm_sha256rnds2_epu32(cdgh, abef, t1);
+                let t2 = _mm_shuffle_epi32(t1, 0x0e);
+                abef = _mm_sha256rnds2_epu32(abef, cdgh, t2);
+            }
+
+            abef = _mm_add_epi32(abef, abef_save);
+            cdgh = _mm_add_epi32(cdgh, cdgh_save);
+        }
+
+        let feba = _mm_shuffle_epi32(abef, 0x1b);
+        let dchg = _mm_shuffle_epi32(cdgh, 0xb1);
+        _mm_storeu_si128(state_ptr, _mm_blend_epi16(feba, dchg, 0xf0));
+        _mm_storeu_si128(state_ptr.add(1), _mm_alignr_epi8(dchg, feba, 8));
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn check_backend(b: Backend) {
+        if !b.is_supported() {
+            println!("skipping unsupported backend {:?}", b);
+            return;
+        }
+        // Lengths straddling every padding boundary, in a mix that makes
+        // lanes finish after different numbers of blocks.
+        let data: Vec<u8> = (0..300u32).map(|i| (i * 7 + 3) as u8).collect();
+        let lens = [0usize, 1, 3, 31, 32, 55, 56, 63, 64, 65, 119, 120, 128, 200, 300, 17, 64];
+        let inputs: Vec<&[u8]> = lens.iter().map(|l| &data[..*l]).collect();
+        let mut outputs = vec![[0u8; 32]; inputs.len()];
+        sha256_many_with(b, &inputs, &mut outputs);
+        for (input, output) in inputs.iter().zip(outputs.iter()) {
+            assert_eq!(*output, sha256_array(input), "{:?} len {}", b, input.len());
+        }
+    }
+
+    #[test]
+    fn test_sha256_many() {
+        for b in [Backend::Scalar, Backend::Sse41X4, Backend::Avx2X8, Backend::ShaNi].iter() {
+            check_backend(*b);
+        }
+        assert!(backend().is_supported());
+        // The SIMD lanes are opt-in.
+        assert!(detect() == Backend::ShaNi || detect() == Backend::Scalar);
+
+        let mut out = [[0u8; 32]; 1];
+        sha256_many(&[b"abc"], &mut out);
+        assert_eq!(
+            hex::encode(out[0]),
+            "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad"
+        );
+    }
+}
+
+#[cfg(feature = "internal_benches")]
+mod internal_benches {
+    use super::*;
+
+    extern crate test;
+
+    fn bench(bencher: &mut test::Bencher, b: Backend, len: usize) {
+        if !b.is_supported() {
+            return;
+        }
+        let data = vec![0xa5u8; len * 64];
+        let inputs: Vec<&[u8]> = data.chunks(len).collect();
+        let mut outputs = vec![[0u8; 32]; inputs.len()];
+        bencher.bytes = (len * inputs.len()) as u64;
+        bencher.iter(|| sha256_many_with(b, &inputs, &mut outputs));
+    }
+
+    macro_rules! bench_sha256_many {
+        ( $( $name:ident => ($backend:expr, $len:expr) ),+ ) => {
+            $(
+                #[bench]
+                fn $name(bencher: &mut test::Bencher) {
+                    bench(bencher, $backend, $len)
+                }
+            )+
+        };
+    }
+
+    bench_sha256_many! {
+        scalar_32 => (Backend::Scalar, 32),
+        scalar_64 => (Backend::Scalar, 64),
+        scalar_1024 => (Backend::Scalar, 1024),
+        sse41_x4_32 => (Backend::Sse41X4, 32),
+        sse41_x4_64 => (Backend::Sse41X4, 64),
+        sse41_x4_1024 => (Backend::Sse41X4, 1024),
+        avx2_x8_32 => (Backend::Avx2X8, 32),
+        avx2_x8_64 => (Backend::Avx2X8, 64),
+        avx2_x8_1024 => (Backend::Avx2X8, 1024),
+        shani_32 => (Backend::ShaNi, 32),
+        shani_64 => (Backend::ShaNi, 64),
+        shani_1024 => (Backend::ShaNi, 1024)
+    }
+}
@@ -0,0 +1,212 @@
+// Ethereum style addresses: the last 20 bytes of Keccak-256 over the
+// uncompressed public key without its SEC1 0x04 prefix, rendered with the
+// EIP-55 mixed-case checksum.
+//
+// The derivation does not depend on the curve, so it applies to the P-256
+// keys produced by this crate as well as to secp256k1 keys.
+
+use std::prelude::v1::*;
+
+use crate::errors::{Error, ErrorKind, Result};
+use crate::hash::keccak::{keccak256, keccak256_many, KECCAK256_OUTPUT_LEN};
+
+pub const ADDRESS_LEN: usize = 20;
+
+/// Length of "0x" followed by 40 hex digits.
+pub const CHECKSUM_ADDRESS_LEN: usize = 2 + 2 * ADDRESS_LEN;
+
+const HEX_LOWER: &[u8; 16] = b"0123456789abcdef";
+
+/// Strips the SEC1 0x04 prefix of an uncompressed point, also accepting the
+/// bare 64-byte x || y form.
+fn point_bytes(public_key: &[u8]) -> Result<&[u8]> {
+    match public_key.len() {
+        65 if public_key[0] == 0x04 => Ok(&public_key[1..]),
+        64 => Ok(public_key),
+        _ => Err(Error::from(ErrorKind::InvalidInputError)),
+    }
+}
+
+fn address_from_hash(h: &[u8; KECCAK256_OUTPUT_LEN]) -> [u8; ADDRESS_LEN] {
+    let mut address = [0u8; ADDRESS_LEN];
+    address.copy_from_slice(&h[(KECCAK256_OUTPUT_LEN - ADDRESS_LEN)..]);
+    address
+}
+
+pub fn address_from_public_key(public_key: &[u8]) -> Result<[u8; ADDRESS_LEN]> {
+    Ok(address_from_hash(&keccak256(point_bytes(public_key)?)))
+}
+
+/// Derives `out[i]` from the `i`th key of `public_keys`, a contiguous buffer
+/// of `key_len`-byte public keys (65 for SEC1 uncompressed, 64 for x || y).
+pub fn addresses_from_public_keys(
+    public_keys: &[u8],
+    key_len: usize,
+    out: &mut [[u8; ADDRESS_LEN]],
+) -> Result<()> {
+    if key_len == 0 || public_keys.len() != key_len * out.len() {
+        return Err(Error::from(ErrorKind::InvalidInputError));
+    }
+    let mut inputs = Vec::with_capacity(out.len());
+    for key in public_keys.chunks(key_len) {
+        inputs.push(point_bytes(key)?);
+    }
+    let mut hashes = vec![[0u8; KECCAK256_OUTPUT_LEN]; out.len()];
+    keccak256_many(&inputs, &mut hashes);
+    for (o, h) in out.iter_mut().zip(hashes.iter()) {
+        *o = address_from_hash(h);
+    }
+    Ok(())
+}
+
+fn lower_hex(address: &[u8; ADDRESS_LEN]) -> [u8; 2 * ADDRESS_LEN] {
+    let mut hex = [0u8; 2 * ADDRESS_LEN];
+    for (i, b) in address.iter().enumerate() {
+        hex[2 * i] = HEX_LOWER[(b >> 4) as usize];
+        hex[2 * i + 1] = HEX_LOWER[(b & 0x0f) as usize];
+    }
+    hex
+}
+
+/// Upper-cases each hex letter whose nibble in Keccak-256(lowercase hex) is
+/// at least 8.
+fn apply_checksum(
+    hex: &[u8; 2 * ADDRESS_LEN],
+    h: &[u8; KECCAK256_OUTPUT_LEN],
+    out: &mut [u8; CHECKSUM_ADDRESS_LEN],
+) {
+    out[0] = b'0';
+    out[1] = b'x';
+    for (i, c) in hex.iter().enumerate() {
+        let nibble = if i % 2 == 0 { h[i / 2] >> 4 } else { h[i / 2] & 0x0f };
+        out[2 + i] = if *c >= b'a' && nibble >= 8 {
+            c.to_ascii_uppercase()
+        } else {
+            *c
+        };
+    }
+}
+
+pub fn write_checksum_address(address: &[u8; ADDRESS_LEN], out: &mut [u8; CHECKSUM_ADDRESS_LEN]) {
+    let hex = lower_hex(address);
+    apply_checksum(&hex, &keccak256(&hex), out);
+}
+
+/// The EIP-55 form of `address`, e.g. "0x5aAeb6053F3E94C9b9A09f33669435E7Ef1BeAed".
+pub fn to_checksum_address(address: &[u8; ADDRESS_LEN]) -> String {
+    let mut out = [0u8; CHECKSUM_ADDRESS_LEN];
+    write_checksum_address(address, &mut out);
+    String::from_utf8(out.to_vec()).unwrap()
+}
+
+/// EIP-55 encodes every address of `addresses` into `out`, hashing four
+/// addresses at a time. Panics if the slices do not have the same length.
+pub fn write_checksum_addresses(
+    addresses: &[[u8; ADDRESS_LEN]],
+    out: &mut [[u8; CHECKSUM_ADDRESS_LEN]],
+) {
+    assert_eq!(addresses.len(), out.len());
+    let hexes: Vec<[u8; 2 * ADDRESS_LEN]> = addresses.iter().map(lower_hex).collect();
+    let inputs: Vec<&[u8]> = hexes.iter().map(|h| &h[..]).collect();
+    let mut hashes = vec![[0u8; KECCAK256_OUTPUT_LEN]; addresses.len()];
+    keccak256_many(&inputs, &mut hashes);
+    for ((hex, h), o) in hexes.iter().zip(hashes.iter()).zip(out.iter_mut()) {
+        apply_checksum(hex, h, o);
+    }
+}
+
+/// Checks the EIP-55 checksum of `s` and returns the address it encodes.
+/// All-lowercase and all-uppercase strings carry no checksum and are
+/// accepted as is.
+pub fn parse_checksum_address(s: &str) -> Result<[u8; ADDRESS_LEN]> {
+    let bytes = s.as_bytes();
+    if bytes.len() != CHECKSUM_ADDRESS_LEN || &bytes[..2] != b"0x" {
+        return Err(Error::from(ErrorKind::InvalidAddressError));
+    }
+    let mut address = [0u8; ADDRESS_LEN];
+    for i in 0..ADDRESS_LEN {
+        let hi = (bytes[2 + 2 * i] as char).to_digit(16);
+        let lo = (bytes[3 + 2 * i] as char).to_digit(16);
+        match (hi, lo) {
+            (Some(hi), Some(lo)) => address[i] = (hi << 4 | lo) as u8,
+            _ => return Err(Error::from(ErrorKind::InvalidAddressError)),
+        }
+    }
+    let digits = &bytes[2..];
+    let has_lower = digits.iter().any(|c| c.is_ascii_lowercase());
+    let has_upper = digits.iter().any(|c| c.is_ascii_uppercase());
+    if has_lower && has_upper {
+        let mut expected = [0u8; CHECKSUM_ADDRESS_LEN];
+        write_checksum_address(&address, &mut expected);
+        if &expected[..] != bytes {
+            return Err(Error::from(ErrorKind::InvalidAddressError));
+        }
+    }
+    Ok(address)
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    const EIP55_VECTORS: [&str; 8] = [
+        "0x52908400098527886E0F7030069857D2E4169EE7",
+        "0x8617E340B3D01FA5F11F306F4090FD50E238070D",
+        "0xde709f2102306220921060314715629080e2fb77",
+        "0x27b1fdb04752bbc536007a920d24acb045561c26",
+        "0x5aAeb6053F3E94C9b9A09f33669435E7Ef1BeAed",
+        "0xfB6916095ca1df60bB79Ce92cE3Ea74c37c5d359",
+        "0xdbF03B407c01E7cD3CBea99509d93f8DDDC8C6FB",
+        "0xD1220A0cf47c7B9Be7A2E6BA89F429762e7b9aDb",
+    ];
+
+    #[test]
+    fn test_eip55() {
+        let mut addresses = vec![];
+        for v in EIP55_VECTORS.iter() {
+            let address = parse_checksum_address(v).unwrap();
+            assert_eq!(to_checksum_address(&address), *v);
+            addresses.push(address);
+        }
+        let mut out = vec![[0u8; CHECKSUM_ADDRESS_LEN]; addresses.len()];
+        write_checksum_addresses(&addresses, &mut out);
+        for (o, v) in out.iter().zip(EIP55_VECTORS.iter()) {
+            assert_eq!(&o[..], v.as_bytes());
+        }
+
+        // Flipping the case of one letter breaks the checksum.
+        assert!(parse_checksum_address("0x5aaeb6053F3E94C9b9A09f33669435E7Ef1BeAed").is_err());
+        assert!(parse_checksum_address("0x5aAeb6053F3E94C9b9A09f33669435E7Ef1BeA").is_err());
+        assert!(parse_checksum_address("0x5aAeb6053F3E94C9b9A09f33669435E7Ef1BeAeg").is_err());
+    }
+
+    #[test]
+    fn test_address_from_public_key() {
+        // The secp256k1 generator, i.e. the public key of private key 1.
+        let g = hex::decode(
+            "0479be667ef9dcbbac55a06295ce870b07029bfcdb2dce28d959f2815b16f81798\
+             483ada7726a3c4655da4fbfc0e1108a8fd17b448a68554199c47d08ffb10d4b8",
+        )
+        .unwrap();
+        let address = address_from_public_key(&g).unwrap();
+        assert_eq!(
+            to_checksum_address(&address),
+            "0x7E5F4552091A69125d5DfCb7b8C2659029395Bdf"
+        );
+        assert_eq!(address_from_public_key(&g[1..]).unwrap(), address);
+        assert!(address_from_public_key(&g[2..]).is_err());
+
+        let mut keys = vec![];
+        for i in 0..9u8 {
+            let mut k = g.clone();
+            k[64] ^= i;
+            keys.extend_from_slice(&k);
+        }
+        let mut out = vec![[0u8; ADDRESS_LEN]; 9];
+        addresses_from_public_keys(&keys, 65, &mut out).unwrap();
+        for (k, a) in keys.chunks(65).zip(out.iter()) {
+            assert_eq!(address_from_public_key(k).unwrap(), *a);
+        }
+        assert!(addresses_from_public_keys(&keys[1..], 65, &mut out).is_err());
+    }
+}
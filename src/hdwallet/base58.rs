@@ -0,0 +1,318 @@
+// Base58 and Base58Check (Bitcoin alphabet).
+//
+// The codec targets the short payloads a wallet exports: 20-byte hashes,
+// 32/33-byte keys and 78-byte extended keys. Instead of converting one digit
+// or byte at a time, it works on big limbs:
+//
+//   * decoding consumes 10 digits at a time, multiplying a base 2^32 number
+//     by 58^10 (< 2^59) with one 64x64->128-bit multiply per limb;
+//   * encoding consumes 32 input bits at a time into a base 58^5 number
+//     (58^5 < 2^30), so every step is a 64-bit division by a constant,
+//     which the compiler turns into a multiplication. A base 58^10
+//     accumulator would need a 128-bit division per step.
+//
+// Everything is done in fixed stack buffers and written into caller
+// provided output; the Base58Check helpers compute the double SHA-256
+// checksum directly into the trailing bytes of that buffer.
+
+use std::prelude::v1::*;
+
+use crate::errors::{Error, ErrorKind, Result};
+use crate::hash::hash::double_sha256_array;
+
+const ALPHABET: &[u8; 58] = b"123456789ABCDEFGHJKLMNPQRSTUVWXYZabcdefghijkmnopqrstuvwxyz";
+
+// Maps an ASCII byte to its digit value, or 0xff.
+const DIGITS: [u8; 128] = digit_table();
+
+const fn digit_table() -> [u8; 128] {
+    let mut t = [0xffu8; 128];
+    let mut i = 0;
+    while i < 58 {
+        t[ALPHABET[i] as usize] = i as u8;
+        i += 1;
+    }
+    t
+}
+
+/// Longest payload accepted by the codec, including a Base58Check
+/// checksum.
+pub const MAX_DECODED_LEN: usize = 128;
+
+/// Longest Base58 string the codec produces or accepts:
+/// ceil(MAX_DECODED_LEN * log(256) / log(58)).
+pub const MAX_ENCODED_LEN: usize = 175;
+
+pub const CHECKSUM_LEN: usize = 4;
+
+const B5: u64 = 58 * 58 * 58 * 58 * 58;
+const B10: u64 = B5 * B5;
+
+const ENC_LIMBS: usize = (MAX_ENCODED_LEN + 4) / 5;
+const DEC_LIMBS: usize = MAX_DECODED_LEN / 4 + 1;
+
+/// Number of Base58 digits of a `len`-byte input, excluding leading '1's
+/// for leading zero bytes (an upper bound, used to size outputs).
+pub fn encoded_len_bound(len: usize) -> usize {
+    (len * 138 + 99) / 100 + 1
+}
+
+/// Base58-encodes `input` into `out` and returns the number of bytes
+/// written.
+pub fn encode_into(input: &[u8], out: &mut [u8]) -> Result<usize> {
+    if input.len() > MAX_DECODED_LEN {
+        return Err(Error::from(ErrorKind::InvalidInputError));
+    }
+    let zeros = input.iter().take_while(|b| **b == 0).count();
+    let rest = &input[zeros..];
+
+    // Little-endian base 58^5 accumulator.
+    let mut limbs = [0u32; ENC_LIMBS];
+    let mut n = 0;
+    let head = rest.len() % 4;
+    let mut words = rest[head..].chunks(4).map(|w| (32, w));
+    let first = if head > 0 { Some((8 * head as u32, &rest[..head])) } else { None };
+    for (bits, w) in first.into_iter().chain(&mut words) {
+        let mut carry = w.iter().fold(0u64, |acc, b| (acc << 8) | u64::from(*b));
+        for limb in limbs[..n].iter_mut() {
+            let x = (u64::from(*limb) << bits) | carry;
+            *limb = (x % B5) as u32;
+            carry = x / B5;
+        }
+        while carry > 0 {
+            limbs[n] = (carry % B5) as u32;
+            carry /= B5;
+            n += 1;
+        }
+    }
+
+    // Five digits per limb, most significant limb first, without the
+    // leading zero digits of the top limb.
+    let mut digits = [0u8; ENC_LIMBS * 5];
+    let mut len = 0;
+    for limb in limbs[..n].iter().rev() {
+        let mut v = *limb;
+        for j in (0..5).rev() {
+            digits[len + j] = ALPHABET[(v % 58) as usize];
+            v /= 58;
+        }
+        len += 5;
+    }
+    let skip = digits[..len].iter().take_while(|d| **d == b'1').count();
+    let digits = &digits[skip..len];
+
+    let total = zeros + digits.len();
+    if out.len() < total {
+        return Err(Error::from(ErrorKind::InvalidInputError));
+    }
+    for o in out[..zeros].iter_mut() {
+        *o = b'1';
+    }
+    out[zeros..total].copy_from_slice(digits);
+    Ok(total)
+}
+
+/// Decodes the Base58 string `input` into `out` and returns the number of
+/// bytes written.
+pub fn decode_into(input: &[u8], out: &mut [u8]) -> Result<usize> {
+    if input.len() > MAX_ENCODED_LEN {
+        return Err(Error::from(ErrorKind::ParseError));
+    }
+    let zeros = input.iter().take_while(|c| **c == b'1').count();
+    let rest = &input[zeros..];
+
+    // Little-endian base 2^32 accumulator.
+    let mut limbs = [0u32; DEC_LIMBS];
+    let mut n = 0;
+    let head = rest.len() % 10;
+    let mut chunks = rest[head..].chunks(10);
+    let first = if head > 0 { Some(&rest[..head]) } else { None };
+    for chunk in first.into_iter().chain(&mut chunks) {
+        let mut v = 0u64;
+        let mut mul = 1u64;
+        for c in chunk {
+            let d = if *c < 128 { DIGITS[*c as usize] } else { 0xff };
+            if d == 0xff {
+                return Err(Error::from(ErrorKind::ParseError));
+            }
+            v = v * 58 + u64::from(d);
+            mul *= 58;
+        }
+        debug_assert!(mul <= B10);
+        let mut carry = u128::from(v);
+        for limb in limbs[..n].iter_mut() {
+            let x = u128::from(*limb) * u128::from(mul) + carry;
+            *limb = x as u32;
+            carry = x >> 32;
+        }
+        while carry > 0 {
+            if n == DEC_LIMBS {
+                return Err(Error::from(ErrorKind::ParseError));
+            }
+            limbs[n] = carry as u32;
+            carry >>= 32;
+            n += 1;
+        }
+    }
+
+    let mut bytes = [0u8; DEC_LIMBS * 4];
+    for (i, limb) in limbs[..n].iter().rev().enumerate() {
+        bytes[(4 * i)..(4 * i + 4)].copy_from_slice(&limb.to_be_bytes());
+    }
+    let skip = bytes[..(4 * n)].iter().take_while(|b| **b == 0).count();
+    let bytes = &bytes[skip..(4 * n)];
+
+    let total = zeros + bytes.len();
+    if total > MAX_DECODED_LEN || out.len() < total {
+        return Err(Error::from(ErrorKind::ParseError));
+    }
+    for o in out[..zeros].iter_mut() {
+        *o = 0;
+    }
+    out[zeros..total].copy_from_slice(bytes);
+    Ok(total)
+}
+
+/// Base58Check-encodes `payload` (e.g. version byte || hash) into `out`.
+pub fn encode_check_into(payload: &[u8], out: &mut [u8]) -> Result<usize> {
+    if payload.len() + CHECKSUM_LEN > MAX_DECODED_LEN {
+        return Err(Error::from(ErrorKind::InvalidInputError));
+    }
+    let mut buf = [0u8; MAX_DECODED_LEN];
+    let (data, checksum) = buf.split_at_mut(payload.len());
+    data.copy_from_slice(payload);
+    checksum[..CHECKSUM_LEN].copy_from_slice(&double_sha256_array(payload)[..CHECKSUM_LEN]);
+    encode_into(&buf[..(payload.len() + CHECKSUM_LEN)], out)
+}
+
+/// Decodes a Base58Check string into `out`, verifying and stripping the
+/// checksum, and returns the payload length.
+pub fn decode_check_into(input: &[u8], out: &mut [u8]) -> Result<usize> {
+    let mut buf = [0u8; MAX_DECODED_LEN];
+    let len = decode_into(input, &mut buf)?;
+    if len < CHECKSUM_LEN {
+        return Err(Error::from(ErrorKind::ParseError));
+    }
+    let (payload, checksum) = buf[..len].split_at(len - CHECKSUM_LEN);
+    if double_sha256_array(payload)[..CHECKSUM_LEN] != *checksum {
+        return Err(Error::from(ErrorKind::InvalidChecksumError));
+    }
+    if out.len() < payload.len() {
+        return Err(Error::from(ErrorKind::InvalidInputError));
+    }
+    out[..payload.len()].copy_from_slice(payload);
+    Ok(payload.len())
+}
+
+fn to_string(f: impl Fn(&mut [u8]) -> Result<usize>) -> Result<String> {
+    let mut out = [0u8; MAX_ENCODED_LEN];
+    let len = f(&mut out)?;
+    // The alphabet is ASCII.
+    Ok(String::from_utf8(out[..len].to_vec()).unwrap())
+}
+
+pub fn encode(input: &[u8]) -> Result<String> {
+    to_string(|out| encode_into(input, out))
+}
+
+pub fn encode_check(payload: &[u8]) -> Result<String> {
+    to_string(|out| encode_check_into(payload, out))
+}
+
+pub fn decode(input: &str) -> Result<Vec<u8>> {
+    let mut out = [0u8; MAX_DECODED_LEN];
+    let len = decode_into(input.as_bytes(), &mut out)?;
+    Ok(out[..len].to_vec())
+}
+
+pub fn decode_check(input: &str) -> Result<Vec<u8>> {
+    let mut out = [0u8; MAX_DECODED_LEN];
+    let len = decode_check_into(input.as_bytes(), &mut out)?;
+    Ok(out[..len].to_vec())
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    // Mostly from Bitcoin Core's base58_encode_decode.json.
+    const VECTORS: [(&str, &str); 14] = [
+        ("", ""),
+        ("61", "2g"),
+        ("626262", "a3gV"),
+        ("636363", "aPEr"),
+        (
+            "73696d706c792061206c6f6e6720737472696e67",
+            "2cFupjhnEsSn59qHXstmK2ffpLv2",
+        ),
+        (
+            "00eb15231dfceb60925886b67d065299925915aeb172c06647",
+            "1NS17iag9jJgTHD1VXjvLCEnZuQ3rJDE9L",
+        ),
+        ("516b6fcd0f", "ABnLTmg"),
+        ("bf4f89001e670274dd", "3SEo3LWLoPntC"),
+        ("572e4794", "3EFU7m"),
+        ("ecac89cad93923c02321", "EJDM8drfXA6uyA"),
+        ("10c8511e", "Rt5zm"),
+        ("00000000000000000000", "1111111111"),
+        (
+            "000111d38e5fc9071ffcd20b4a763cc9ae4f252bb4e48fd66a835e252ada93ff480d6dd43dc62a641155a5",
+            "123456789ABCDEFGHJKLMNPQRSTUVWXYZabcdefghijkmnopqrstuvwxyz",
+        ),
+        (
+            "000102030405060708090a0b0c0d0e0f101112131415161718191a1b1c1d1e1f202122232425262728292a2b2c2d2e2f303132333435363738393a3b3c3d3e3f404142434445464748494a4b4c4d4e4f505152535455565758595a5b5c5d5e5f606162636465666768696a6b6c6d6e6f707172737475767778797a7b7c7d7e7f",
+            "12Mc55eJJSx97JNqXmW7TuJSoE9N3JhfHo9hbKS9Pm2qUNVUH1Tgd6xAdqeP8xAxDhjuR6vmAu7KR9Kt2PqaMEEcD2ThugBHeVLCJtW1V1iMZ13ZJfDH7h8E11Xz9hpEDcPUikMCe5p9EHLv7Y3wNXT2bBNYZarpY7Trn3cm8vvo7t",
+        ),
+    ];
+
+    #[test]
+    fn test_base58() {
+        for (hex_input, expected) in VECTORS.iter() {
+            let input = hex::decode(hex_input).unwrap();
+            assert_eq!(encode(&input).unwrap(), *expected);
+            assert_eq!(decode(expected).unwrap(), input);
+        }
+        assert!(decode("0OIl").is_err());
+        assert!(decode("2g\u{e9}").is_err());
+        assert!(encode(&[0xffu8; MAX_DECODED_LEN + 1]).is_err());
+
+        let mut small = [0u8; 3];
+        assert!(encode_into(b"abc", &mut small).is_err());
+        assert_eq!(encode_into(b"\x00\x00", &mut small).unwrap(), 2);
+    }
+
+    #[test]
+    fn test_base58_round_trip() {
+        for len in [0usize, 1, 4, 20, 21, 25, 32, 33, 37, 78, 82, MAX_DECODED_LEN].iter() {
+            for seed in 0..8u8 {
+                let input: Vec<u8> = (0..*len)
+                    .map(|i| if seed == 0 { 0xff } else { (i as u8).wrapping_mul(seed) ^ seed })
+                    .collect();
+                let s = encode(&input).unwrap();
+                assert!(s.len() <= MAX_ENCODED_LEN);
+                assert!(s.len() <= encoded_len_bound(*len));
+                assert_eq!(decode(&s).unwrap(), input);
+            }
+        }
+    }
+
+    #[test]
+    fn test_base58_check() {
+        let payload = hex::decode("007680adec8eabcabac676be9e83854ade0bd22cdb").unwrap();
+        let address = "1BoatSLRHtKNngkdXEeobR76b53LETtpyT";
+        assert_eq!(encode_check(&payload).unwrap(), address);
+        assert_eq!(decode_check(address).unwrap(), payload);
+
+        // BIP-32 test vector 1, chain m.
+        let xpub = "xpub661MyMwAqRbcFtXgS5sYJABqqG9YLmC4Q1Rdap9gSE8NqtwybGhePY2gZ29ESFjqJoCu1Rupje8YtGqsefD265TMg7usUDFdp6W1EGMcet8";
+        let raw = decode_check(xpub).unwrap();
+        assert_eq!(raw.len(), 78);
+        assert_eq!(encode_check(&raw).unwrap(), xpub);
+
+        assert_eq!(
+            decode_check("1BoatSLRHtKNngkdXEeobR76b53LETtpyU").unwrap_err().kind(),
+            ErrorKind::InvalidChecksumError
+        );
+        assert!(decode_check("1").is_err());
+    }
+}
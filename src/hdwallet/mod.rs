@@ -1,3 +1,5 @@
+pub mod address;
+pub mod base58;
 mod languages;
 pub mod rand;
 pub use languages::Language;
@@ -1,6 +1,7 @@
 use std::prelude::v1::*;
 use super::languages::*;
 use crate::errors::{Error, ErrorKind, Result};
+use crate::metrics;
 use rand::prelude::*;
 
 use num_traits::FromPrimitive;
@@ -104,7 +105,7 @@ pub fn generate_old_entropy(entropy: &[u8], lang: Language) -> Result<String> {
 }
 
 fn add_checksum(entropy: &[u8]) -> num_bigint::BigInt {
-    let hb = crate::hash::hash::sha256(entropy);
+    let hb = crate::hash::hash::sha256_array(entropy);
     let _1st_checksum_byte = hb[1];
     let checksum_bit_len = entropy.len() >> 2;
     let mut data_bigint = num_bigint::BigInt::from_bytes_be(num_bigint::Sign::Plus, entropy);
@@ -118,7 +119,7 @@ fn add_checksum(entropy: &[u8]) -> num_bigint::BigInt {
 }
 
 fn add_old_checksum(entropy: &[u8]) -> num_bigint::BigInt {
-    let hb = crate::hash::hash::sha256(entropy);
+    let hb = crate::hash::hash::sha256_array(entropy);
     let _1st_checksum_byte = hb[0];
     let checksum_bit_len = entropy.len() >> 2;
     let mut data_bigint = num_bigint::BigInt::from_bytes_be(num_bigint::Sign::Plus, entropy);
@@ -225,6 +226,7 @@ pub fn generate_seed_with_error_check(
 }
 
 fn generate_seed(mnimonic: &String, password: &String, keylen: usize) -> Result<Vec<u8>> {
+    let timer = metrics::Timer::start(metrics::Op::SeedDerivation);
     let mut salt = "mnemonic".to_owned();
     salt.push_str(password);
     let mut to_store = vec![0u8; keylen];
@@ -235,6 +237,7 @@ fn generate_seed(mnimonic: &String, password: &String, keylen: usize) -> Result<
         mnimonic.as_bytes(),
         &mut to_store,
     );
+    timer.finish(true);
     Ok(to_store.to_vec())
 }
 
@@ -293,6 +296,7 @@ pub fn generate_seed_with_strength_and_keylen(
 }
 
 fn generate_seed_with_random_password(password: &[u8], keylen: usize) -> Result<Vec<u8>> {
+    let timer = metrics::Timer::start(metrics::Op::SeedDerivation);
     let salt = "jingbo is handsome!";
     let mut to_store = vec![0u8; keylen];
     ring::pbkdf2::derive(
@@ -302,5 +306,6 @@ fn generate_seed_with_random_password(password: &[u8], keylen: usize) -> Result<
         password,
         &mut to_store,
     );
+    timer.finish(true);
     Ok(to_store.to_vec())
 }
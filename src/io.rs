@@ -23,6 +23,8 @@ mod writer;
 #[cfg(feature = "alloc")]
 pub(crate) mod der_writer;
 
+pub(crate) mod der_slice;
+
 pub(crate) mod positive;
 
 pub use self::positive::Positive;
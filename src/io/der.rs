@@ -37,6 +37,7 @@ pub enum Tag {
     UTCTime = 0x17,
     GeneralizedTime = 0x18,
 
+    ContextSpecific1 = CONTEXT_SPECIFIC | 1,
     ContextSpecificConstructed0 = CONTEXT_SPECIFIC | CONSTRUCTED | 0,
     ContextSpecificConstructed1 = CONTEXT_SPECIFIC | CONSTRUCTED | 1,
     ContextSpecificConstructed3 = CONTEXT_SPECIFIC | CONSTRUCTED | 3,
@@ -54,11 +55,17 @@ impl From<Tag> for u8 {
     } // XXX: narrowing conversion.
 }
 
+fn read_byte(input: &mut untrusted::Reader) -> Result<u8> {
+    input
+        .read_byte()
+        .map_err(|_| Error::from(ErrorKind::CryptoError))
+}
+
 pub fn expect_tag_and_get_value<'a>(
     input: &mut untrusted::Reader<'a>,
     tag: Tag,
 ) -> Result<untrusted::Input<'a>> {
-    let (actual_tag, inner) = read_tag_and_get_value(input).unwrap();
+    let (actual_tag, inner) = read_tag_and_get_value(input)?;
     if usize::from(tag) != usize::from(actual_tag) {
         return Err(Error::from(ErrorKind::CryptoError));
     }
@@ -68,25 +75,25 @@ pub fn expect_tag_and_get_value<'a>(
 pub fn read_tag_and_get_value<'a>(
     input: &mut untrusted::Reader<'a>,
 ) -> Result<(u8, untrusted::Input<'a>)> {
-    let tag = input.read_byte().unwrap();
+    let tag = read_byte(input)?;
     if (tag & 0x1F) == 0x1F {
         return Err(Error::from(ErrorKind::CryptoError)); // High tag number form is not allowed.
     }
     // If the high order bit of the first byte is set to zero then the length
     // is encoded in the seven remaining bits of that byte. Otherwise, those
     // seven bits represent the number of bytes used to encode the length.
-    let length = match input.read_byte().unwrap() {
+    let length = match read_byte(input)? {
         n if (n & 0x80) == 0 => usize::from(n),
         0x81 => {
-            let second_byte = input.read_byte().unwrap();
+            let second_byte = read_byte(input)?;
             if second_byte < 128 {
                 return Err(Error::from(ErrorKind::CryptoError)); // Not the canonical encoding.
             }
             usize::from(second_byte)
         }
         0x82 => {
-            let second_byte = usize::from(input.read_byte().unwrap());
-            let third_byte = usize::from(input.read_byte().unwrap());
+            let second_byte = usize::from(read_byte(input)?);
+            let third_byte = usize::from(read_byte(input)?);
             let combined = (second_byte << 8) | third_byte;
             if combined < 256 {
                 return Err(Error::from(ErrorKind::CryptoError)); // Not the canonical encoding.
@@ -98,7 +105,9 @@ pub fn read_tag_and_get_value<'a>(
         }
     };
 
-    let inner = input.read_bytes(length).unwrap();
+    let inner = input
+        .read_bytes(length)
+        .map_err(|_| Error::from(ErrorKind::CryptoError))?;
     Ok((tag, inner))
 }
 
@@ -110,7 +119,7 @@ pub fn bit_string_with_no_unused_bits<'a>(
         Tag::BitString,
         Error::from(ErrorKind::CryptoError),
         |value| {
-            let unused_bits_at_end = value.read_byte().unwrap();
+            let unused_bits_at_end = read_byte(value)?;
             if unused_bits_at_end != 0 {
                 return Err(Error::from(ErrorKind::CryptoError));
             }
@@ -132,8 +141,9 @@ pub fn nested<'a, F, R, E>(
 ) -> std::result::Result<R, E>
 where
     F: FnOnce(&mut untrusted::Reader<'a>) -> std::result::Result<R, E>,
+    E: From<Error>,
 {
-    let inner = expect_tag_and_get_value(input, tag).unwrap();
+    let inner = expect_tag_and_get_value(input, tag)?;
     inner.read_all(error, decoder)
 }
 
@@ -145,7 +155,7 @@ fn nonnegative_integer<'a>(
     // encoding of a value of at least |min_value|.
     fn check_minimum(input: untrusted::Input, min_value: u8) -> Result<()> {
         input.read_all(Error::from(ErrorKind::CryptoError), |input| {
-            let first_byte = input.read_byte().unwrap();
+            let first_byte = read_byte(input)?;
             if input.at_end() && first_byte < min_value {
                 return Err(Error::from(ErrorKind::CryptoError));
             }
@@ -154,11 +164,11 @@ fn nonnegative_integer<'a>(
         })
     }
 
-    let value = expect_tag_and_get_value(input, Tag::Integer).unwrap();
+    let value = expect_tag_and_get_value(input, Tag::Integer)?;
 
     value.read_all(Error::from(ErrorKind::CryptoError), |input| {
         // Empty encodings are not allowed.
-        let first_byte = input.read_byte().unwrap();
+        let first_byte = read_byte(input)?;
 
         if first_byte == 0 {
             if input.at_end() {
@@ -171,7 +181,7 @@ fn nonnegative_integer<'a>(
 
             let r = input.read_bytes_to_end();
             r.read_all(Error::from(ErrorKind::CryptoError), |input| {
-                let second_byte = input.read_byte().unwrap();
+                let second_byte = read_byte(input)?;
                 if (second_byte & 0x80) == 0 {
                     // A leading zero is only allowed when the value's high bit
                     // is set.
@@ -179,9 +189,8 @@ fn nonnegative_integer<'a>(
                 }
                 let _ = input.read_bytes_to_end();
                 Ok(())
-            })
-            .unwrap();
-            check_minimum(r, min_value).unwrap();
+            })?;
+            check_minimum(r, min_value)?;
             return Ok(r);
         }
 
@@ -191,7 +200,7 @@ fn nonnegative_integer<'a>(
         }
 
         let _ = input.read_bytes_to_end();
-        check_minimum(value, min_value).unwrap();
+        check_minimum(value, min_value)?;
         Ok(value)
     })
 }
@@ -200,9 +209,9 @@ fn nonnegative_integer<'a>(
 /// numeric value. This is typically used for parsing version numbers.
 #[inline]
 pub fn small_nonnegative_integer(input: &mut untrusted::Reader) -> Result<u8> {
-    let value = nonnegative_integer(input, 0).unwrap();
+    let value = nonnegative_integer(input, 0)?;
     value.read_all(Error::from(ErrorKind::CryptoError), |input| {
-        let r = input.read_byte().unwrap();
+        let r = read_byte(input)?;
         Ok(r)
     })
 }
@@ -211,6 +220,6 @@ pub fn small_nonnegative_integer(input: &mut untrusted::Reader) -> Result<u8> {
 /// sans any leading zero byte.
 pub fn positive_integer<'a>(input: &mut untrusted::Reader<'a>) -> Result<Positive<'a>> {
     Ok(Positive::new_non_empty_without_leading_zeros(
-        nonnegative_integer(input, 1).unwrap(),
+        nonnegative_integer(input, 1)?,
     ))
 }
@@ -0,0 +1,454 @@
+//! Single-pass DER encoding and decoding over caller-provided buffers.
+//!
+//! `der_writer` measures a structure and then writes it again into a freshly
+//! allocated `Box<[u8]>`. The structures handled here (ECDSA signatures and
+//! EC private keys) have lengths that follow directly from their inputs, so
+//! the length octets are computed arithmetically and every byte is written
+//! exactly once into a `&mut [u8]`. Parsing likewise walks a `&[u8]` without
+//! nesting closures, returning sub-slices of the input.
+
+use std::prelude::v1::*;
+use super::der::Tag;
+use crate::errors::{Error, ErrorKind, Result};
+
+/// Returns the number of bytes used by the length octets of a value that is
+/// `value_len` bytes long. Only lengths below 2^16 are supported.
+pub const fn length_len(value_len: usize) -> usize {
+    if value_len < 0x80 {
+        1
+    } else if value_len < 0x1_00 {
+        2
+    } else {
+        3
+    }
+}
+
+/// Returns the encoded length of a TLV whose value is `value_len` bytes long.
+pub const fn tlv_len(value_len: usize) -> usize {
+    1 + length_len(value_len) + value_len
+}
+
+fn strip_leading_zeros(big_endian: &[u8]) -> &[u8] {
+    let first = big_endian
+        .iter()
+        .position(|b| *b != 0)
+        .unwrap_or(big_endian.len());
+    &big_endian[first..]
+}
+
+/// Returns the length of the contents of the INTEGER encoding the unsigned
+/// big-endian value `big_endian`, which may have leading zeros.
+pub fn positive_integer_value_len(big_endian: &[u8]) -> usize {
+    let value = strip_leading_zeros(big_endian);
+    match value.first() {
+        Some(b) if (b & 0x80) != 0 => value.len() + 1,
+        Some(_) => value.len(),
+        None => 1,
+    }
+}
+
+/// Writes DER into a borrowed buffer, failing rather than growing when the
+/// buffer is too small.
+pub struct Writer<'a> {
+    out: &'a mut [u8],
+    len: usize,
+}
+
+impl<'a> Writer<'a> {
+    pub fn new(out: &'a mut [u8]) -> Self {
+        Self { out, len: 0 }
+    }
+
+    /// The number of bytes written so far.
+    pub fn len(&self) -> usize {
+        self.len
+    }
+
+    pub fn write_byte(&mut self, value: u8) -> Result<()> {
+        self.write_bytes(&[value])
+    }
+
+    pub fn write_bytes(&mut self, value: &[u8]) -> Result<()> {
+        let end = self.len + value.len();
+        if end > self.out.len() {
+            return Err(Error::from(ErrorKind::CryptoError));
+        }
+        self.out[self.len..end].copy_from_slice(value);
+        self.len = end;
+        Ok(())
+    }
+
+    /// Writes the tag and length octets of a TLV; the caller writes exactly
+    /// `value_len` bytes of value afterwards.
+    pub fn write_header(&mut self, tag: Tag, value_len: usize) -> Result<()> {
+        let mut header = [tag as u8, 0, 0, 0];
+        let header_len = match length_len(value_len) {
+            1 => {
+                header[1] = value_len as u8;
+                2
+            }
+            2 => {
+                header[1] = 0x81;
+                header[2] = value_len as u8;
+                3
+            }
+            _ if value_len < 0x1_00_00 => {
+                header[1] = 0x82;
+                header[2] = (value_len >> 8) as u8;
+                header[3] = value_len as u8;
+                4
+            }
+            _ => return Err(Error::from(ErrorKind::CryptoError)),
+        };
+        self.write_bytes(&header[..header_len])
+    }
+
+    pub fn write_tlv(&mut self, tag: Tag, value: &[u8]) -> Result<()> {
+        self.write_header(tag, value.len())?;
+        self.write_bytes(value)
+    }
+
+    /// Writes the unsigned big-endian value `big_endian`, which may have
+    /// leading zeros, as a minimally-encoded INTEGER.
+    pub fn write_positive_integer(&mut self, big_endian: &[u8]) -> Result<()> {
+        let value = strip_leading_zeros(big_endian);
+        self.write_header(Tag::Integer, positive_integer_value_len(value))?;
+        match value.first() {
+            Some(b) if (b & 0x80) == 0 => {}
+            _ => self.write_byte(0)?, // Disambiguate negative number, or zero.
+        }
+        self.write_bytes(value)
+    }
+}
+
+/// Splits a TLV with tag `tag` off the front of `input`, returning its value
+/// and the input that follows it. The length rules match
+/// `der::read_tag_and_get_value`.
+pub fn read_tlv(input: &[u8], tag: Tag) -> Result<(&[u8], &[u8])> {
+    let err = || Error::from(ErrorKind::CryptoError);
+    let (&actual_tag, input) = input.split_first().ok_or_else(err)?;
+    if actual_tag != tag as u8 {
+        return Err(err());
+    }
+    let (&first, input) = input.split_first().ok_or_else(err)?;
+    let (length, input) = match first {
+        n if (n & 0x80) == 0 => (usize::from(n), input),
+        0x81 => match input {
+            [n, rest @ ..] if *n >= 0x80 => (usize::from(*n), rest),
+            _ => return Err(err()), // Truncated or not the canonical encoding.
+        },
+        0x82 => match input {
+            [hi, lo, rest @ ..] if *hi != 0 => ((usize::from(*hi) << 8) | usize::from(*lo), rest),
+            _ => return Err(err()),
+        },
+        _ => return Err(err()), // We don't support longer lengths.
+    };
+    if length > input.len() {
+        return Err(err());
+    }
+    Ok(input.split_at(length))
+}
+
+/// Checks that `value`, the contents of an INTEGER, is a minimal encoding of
+/// a value of at least one, returning it without the leading zero byte.
+pub fn positive_integer_value(value: &[u8]) -> Result<&[u8]> {
+    match value {
+        // A leading zero is only allowed when the value's high bit is set.
+        [0, second, ..] if (second & 0x80) != 0 => Ok(&value[1..]),
+        // Empty, zero, non-minimal and negative encodings are not allowed.
+        [] | [0, ..] => Err(Error::from(ErrorKind::CryptoError)),
+        [first, ..] if (first & 0x80) != 0 => Err(Error::from(ErrorKind::CryptoError)),
+        _ => Ok(value),
+    }
+}
+
+/// Returns the encoded length of an ECDSA-Sig-Value with the given `r` and
+/// `s`, each an unsigned big-endian value.
+pub fn ecdsa_sig_len(r: &[u8], s: &[u8]) -> usize {
+    tlv_len(ecdsa_sig_value_len(r, s))
+}
+
+fn ecdsa_sig_value_len(r: &[u8], s: &[u8]) -> usize {
+    tlv_len(positive_integer_value_len(r)) + tlv_len(positive_integer_value_len(s))
+}
+
+/// Encodes `SEQUENCE { r INTEGER, s INTEGER }` into `out`, returning the
+/// number of bytes written.
+pub fn write_ecdsa_sig(r: &[u8], s: &[u8], out: &mut [u8]) -> Result<usize> {
+    let mut output = Writer::new(out);
+    output.write_header(Tag::Sequence, ecdsa_sig_value_len(r, s))?;
+    output.write_positive_integer(r)?;
+    output.write_positive_integer(s)?;
+    Ok(output.len())
+}
+
+/// Parses an ECDSA-Sig-Value that spans all of `input`, returning `r` and
+/// `s` without leading zeros.
+pub fn read_ecdsa_sig(input: &[u8]) -> Result<(&[u8], &[u8])> {
+    let (sequence, rest) = read_tlv(input, Tag::Sequence)?;
+    if !rest.is_empty() {
+        return Err(Error::from(ErrorKind::CryptoError));
+    }
+    let (r, sequence) = read_tlv(sequence, Tag::Integer)?;
+    let (s, sequence) = read_tlv(sequence, Tag::Integer)?;
+    if !sequence.is_empty() {
+        return Err(Error::from(ErrorKind::CryptoError));
+    }
+    Ok((positive_integer_value(r)?, positive_integer_value(s)?))
+}
+
+fn ec_private_key_value_len(
+    private_key: &[u8],
+    curve_oid: Option<&[u8]>,
+    public_key: &[u8],
+) -> usize {
+    let parameters_len = curve_oid.map_or(0, |oid| tlv_len(tlv_len(oid.len())));
+    tlv_len(1)
+        + tlv_len(private_key.len())
+        + parameters_len
+        + tlv_len(tlv_len(1 + public_key.len()))
+}
+
+/// Returns the encoded length of the `ECPrivateKey` written by
+/// `write_ec_private_key`.
+pub fn ec_private_key_len(
+    private_key: &[u8],
+    curve_oid: Option<&[u8]>,
+    public_key: &[u8],
+) -> usize {
+    tlv_len(ec_private_key_value_len(private_key, curve_oid, public_key))
+}
+
+/// Writes an [RFC 5915] `ECPrivateKey` with version 1, the fixed-length
+/// private key, the named curve `curve_oid` as `parameters` if given, and the
+/// uncompressed public key.
+///
+/// [RFC 5915]: https://tools.ietf.org/html/rfc5915
+pub fn write_ec_private_key(
+    output: &mut Writer,
+    private_key: &[u8],
+    curve_oid: Option<&[u8]>,
+    public_key: &[u8],
+) -> Result<()> {
+    let value_len = ec_private_key_value_len(private_key, curve_oid, public_key);
+    output.write_header(Tag::Sequence, value_len)?;
+    output.write_tlv(Tag::Integer, &[1])?;
+    output.write_tlv(Tag::OctetString, private_key)?;
+    if let Some(oid) = curve_oid {
+        output.write_header(Tag::ContextSpecificConstructed0, tlv_len(oid.len()))?;
+        output.write_tlv(Tag::OID, oid)?;
+    }
+    output.write_header(
+        Tag::ContextSpecificConstructed1,
+        tlv_len(1 + public_key.len()),
+    )?;
+    output.write_header(Tag::BitString, 1 + public_key.len())?;
+    output.write_byte(0)?; // No unused bits.
+    output.write_bytes(public_key)
+}
+
+fn pkcs8_value_len(
+    algorithm_oid: &[u8],
+    curve_oid: &[u8],
+    private_key: &[u8],
+    public_key: &[u8],
+    v2: bool,
+) -> usize {
+    let public_key_len = if v2 { tlv_len(1 + public_key.len()) } else { 0 };
+    tlv_len(1)
+        + tlv_len(tlv_len(algorithm_oid.len()) + tlv_len(curve_oid.len()))
+        + tlv_len(ec_private_key_len(private_key, None, public_key))
+        + public_key_len
+}
+
+/// Returns the encoded length of the document written by `write_pkcs8`.
+pub fn pkcs8_len(
+    algorithm_oid: &[u8],
+    curve_oid: &[u8],
+    private_key: &[u8],
+    public_key: &[u8],
+    v2: bool,
+) -> usize {
+    tlv_len(pkcs8_value_len(
+        algorithm_oid,
+        curve_oid,
+        private_key,
+        public_key,
+        v2,
+    ))
+}
+
+/// Writes a PKCS#8 `OneAsymmetricKey` ([RFC 5958 Section 2]) whose
+/// algorithm identifier names `algorithm_oid` with the named curve
+/// `curve_oid` as its parameters, wrapping an `ECPrivateKey` that carries the
+/// public key but, as in `ring`'s templates, no `parameters` of its own. A
+/// `v2` document also repeats the public key in its `publicKey` field.
+/// Returns the number of bytes written.
+///
+/// [RFC 5958 Section 2]: https://tools.ietf.org/html/rfc5958#section-2
+pub fn write_pkcs8(
+    algorithm_oid: &[u8],
+    curve_oid: &[u8],
+    private_key: &[u8],
+    public_key: &[u8],
+    v2: bool,
+    out: &mut [u8],
+) -> Result<usize> {
+    let mut output = Writer::new(out);
+    let value_len = pkcs8_value_len(algorithm_oid, curve_oid, private_key, public_key, v2);
+    output.write_header(Tag::Sequence, value_len)?;
+    output.write_tlv(Tag::Integer, &[if v2 { 1 } else { 0 }])?;
+    output.write_header(
+        Tag::Sequence,
+        tlv_len(algorithm_oid.len()) + tlv_len(curve_oid.len()),
+    )?;
+    output.write_tlv(Tag::OID, algorithm_oid)?;
+    output.write_tlv(Tag::OID, curve_oid)?;
+    output.write_header(
+        Tag::OctetString,
+        ec_private_key_len(private_key, None, public_key),
+    )?;
+    write_ec_private_key(&mut output, private_key, None, public_key)?;
+    if v2 {
+        // publicKey [1] IMPLICIT BIT STRING
+        output.write_header(Tag::ContextSpecific1, 1 + public_key.len())?;
+        output.write_byte(0)?; // No unused bits.
+        output.write_bytes(public_key)?;
+    }
+    Ok(output.len())
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::io::der;
+
+    // Parses `input` with the closure-based `der` module, for comparison.
+    fn read_ecdsa_sig_nested(input: &[u8]) -> Result<(&[u8], &[u8])> {
+        untrusted::Input::from(input).read_all(Error::from(ErrorKind::CryptoError), |input| {
+            der::nested(
+                input,
+                Tag::Sequence,
+                Error::from(ErrorKind::CryptoError),
+                |input| {
+                    let r = der::positive_integer(input)?.big_endian_without_leading_zero();
+                    let s = der::positive_integer(input)?.big_endian_without_leading_zero();
+                    Ok((r, s))
+                },
+            )
+        })
+    }
+
+    #[test]
+    fn test_write_ecdsa_sig() {
+        let mut r = [0u8; 48];
+        let mut s = [0u8; 48];
+        for &(r_len, high_bit) in &[(1, false), (1, true), (31, true), (32, false), (48, true)] {
+            for i in 0..r_len {
+                r[48 - r_len + i] = 0x11 * (i as u8 % 7 + 1);
+                s[48 - r_len + i] = 0x23 + i as u8;
+            }
+            if high_bit {
+                r[48 - r_len] |= 0x80;
+            }
+            let mut out = [0u8; 2 * (2 + 1 + 48) + 3];
+            let len = write_ecdsa_sig(&r, &s, &mut out).unwrap();
+            assert_eq!(len, ecdsa_sig_len(&r, &s));
+
+            let (r_parsed, s_parsed) = read_ecdsa_sig(&out[..len]).unwrap();
+            assert_eq!(r_parsed, strip_leading_zeros(&r));
+            assert_eq!(s_parsed, strip_leading_zeros(&s));
+            assert_eq!(
+                read_ecdsa_sig_nested(&out[..len]).unwrap(),
+                (r_parsed, s_parsed)
+            );
+
+            // Any buffer that is one byte short must be rejected.
+            assert!(write_ecdsa_sig(&r, &s, &mut out[..len - 1]).is_err());
+        }
+    }
+
+    #[test]
+    fn test_read_ecdsa_sig_malformed() {
+        for input in &[
+            &[][..],
+            &[0x30],
+            &[0x30, 0x00],
+            &[0x30, 0x03, 0x02, 0x01, 0x01],
+            &[0x30, 0x06, 0x02, 0x01, 0x01, 0x02, 0x01, 0x00], // s == 0
+            &[0x30, 0x06, 0x02, 0x01, 0x81, 0x02, 0x01, 0x01], // r < 0
+            &[0x30, 0x07, 0x02, 0x02, 0x00, 0x01, 0x02, 0x01, 0x01], // r not minimal
+            &[0x30, 0x06, 0x02, 0x00, 0x02, 0x02, 0x01, 0x01], // r empty
+            &[0x30, 0x07, 0x02, 0x01, 0x01, 0x02, 0x01, 0x01, 0x00], // trailing byte in sequence
+            &[0x30, 0x06, 0x02, 0x01, 0x01, 0x02, 0x01, 0x01, 0x00], // trailing byte in sequence
+            &[0x30, 0x81, 0x06, 0x02, 0x01, 0x01, 0x02, 0x01, 0x01], // non-canonical length
+            &[0x30, 0x06, 0x04, 0x01, 0x01, 0x02, 0x01, 0x01], // wrong tag
+            &[0x30, 0x09, 0x02, 0x01, 0x01, 0x02, 0x01, 0x01], // truncated
+        ] {
+            assert!(read_ecdsa_sig(*input).is_err(), "{:02x?}", input);
+            assert!(read_ecdsa_sig_nested(*input).is_err(), "{:02x?}", input);
+        }
+    }
+
+    #[test]
+    fn test_write_header_lengths() {
+        for &(value_len, expected) in &[
+            (0usize, &[0x04, 0x00][..]),
+            (0x7f, &[0x04, 0x7f]),
+            (0x80, &[0x04, 0x81, 0x80]),
+            (0xff, &[0x04, 0x81, 0xff]),
+            (0x100, &[0x04, 0x82, 0x01, 0x00]),
+            (0xffff, &[0x04, 0x82, 0xff, 0xff]),
+        ] {
+            let mut out = [0u8; 4];
+            let mut output = Writer::new(&mut out);
+            output.write_header(Tag::OctetString, value_len).unwrap();
+            assert_eq!(output.len(), expected.len());
+            assert_eq!(tlv_len(value_len), expected.len() + value_len);
+            assert_eq!(&out[..expected.len()], expected);
+        }
+        let mut out = [0u8; 4];
+        assert!(Writer::new(&mut out)
+            .write_header(Tag::OctetString, 0x1_00_00)
+            .is_err());
+    }
+
+    #[test]
+    fn test_write_ec_private_key() {
+        const P256_OID: &[u8] = &[0x2a, 0x86, 0x48, 0xce, 0x3d, 0x03, 0x01, 0x07];
+        let private_key = [0x42u8; 32];
+        let public_key = [0x04u8; 65];
+        for &curve_oid in &[None, Some(P256_OID)] {
+            let mut out = [0u8; 128];
+            let mut output = Writer::new(&mut out);
+            write_ec_private_key(&mut output, &private_key, curve_oid, &public_key).unwrap();
+            let len = output.len();
+            assert_eq!(
+                len,
+                ec_private_key_len(&private_key, curve_oid, &public_key)
+            );
+
+            let (value, rest) = read_tlv(&out[..len], Tag::Sequence).unwrap();
+            assert!(rest.is_empty());
+            let (version, value) = read_tlv(value, Tag::Integer).unwrap();
+            assert_eq!(version, &[1]);
+            let (d, value) = read_tlv(value, Tag::OctetString).unwrap();
+            assert_eq!(d, &private_key[..]);
+            let value = match curve_oid {
+                Some(oid) => {
+                    let (parameters, value) =
+                        read_tlv(value, Tag::ContextSpecificConstructed0).unwrap();
+                    assert_eq!(read_tlv(parameters, Tag::OID).unwrap(), (oid, &[][..]));
+                    value
+                }
+                None => value,
+            };
+            let (q, value) = read_tlv(value, Tag::ContextSpecificConstructed1).unwrap();
+            assert!(value.is_empty());
+            let (q, rest) = read_tlv(q, Tag::BitString).unwrap();
+            assert!(rest.is_empty());
+            assert_eq!(q[0], 0);
+            assert_eq!(&q[1..], &public_key[..]);
+        }
+    }
+}
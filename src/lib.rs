@@ -6,6 +6,10 @@
 #![cfg_attr(all(feature = "mesalock_sgx",
                 not(target_env = "sgx")), no_std)]
 #![cfg_attr(target_env = "sgx", feature(rustc_private))]
+// Fixed-width bignums in `arithmetic::bigint`; stable since Rust 1.51.
+#![allow(stable_features)]
+#![feature(min_const_generics)]
+#![cfg_attr(feature = "internal_benches", feature(test))]
 
 #[cfg(all(feature = "mesalock_sgx", not(target_env = "sgx")))]
 #[macro_use]
@@ -29,11 +33,6 @@ extern crate num_bigint_sgx as num_bigint;
 #[cfg(not(any(feature = "mesalock_sgx", target_env = "sgx")))]
 extern crate num_bigint;
 
-#[cfg(any(feature = "mesalock_sgx", target_env = "sgx"))]
-extern crate rust_base58_sgx as rust_base58;
-#[cfg(not(any(feature = "mesalock_sgx", target_env = "sgx")))]
-extern crate rust_base58;
-
 #[cfg(any(feature = "mesalock_sgx", target_env = "sgx"))]
 extern crate rust_crypto_sgx as crypto;
 #[cfg(not(any(feature = "mesalock_sgx", target_env = "sgx")))]
@@ -78,11 +77,16 @@ extern crate regex;
 extern crate lazy_static;
 
 
+pub mod arena;
+#[cfg(feature = "benchmarks")]
+pub mod benchmark;
 pub mod bits;
 pub mod c;
 pub mod hash;
 pub mod hdwallet;
 pub mod limb;
+pub mod metrics;
+pub mod precheck;
 pub mod sign;
 
 #[macro_use]
@@ -97,6 +101,10 @@ pub mod bssl;
 pub mod ec;
 pub mod errors;
 pub mod io;
+pub mod pkcs8;
+
+#[cfg(feature = "alloc")]
+pub mod rsa;
 
 #[macro_use]
 pub mod test;
@@ -140,6 +140,125 @@ pub fn limbs_reduce_once_constant_time(r: &mut [Limb], m: &[Limb]) {
     unsafe { LIMBS_reduce_once(r.as_mut_ptr(), m.as_ptr(), m.len()) };
 }
 
+/// Returns `table[index]`, or all zeros if `index` is out of range, reading
+/// every entry of `table` so that neither the memory access pattern nor the
+/// control flow depends on `index`; only `table.len()` and `N` may leak.
+///
+/// On x86_64 the entries are masked 128 bits (SSE2) or 256 bits (AVX2, when
+/// the CPU has it) at a time. Inside SGX CPUID isn't available, so those
+/// builds stick to SSE2.
+#[inline]
+pub fn limbs_select_consttime<const N: usize>(table: &[[Limb; N]], index: usize) -> [Limb; N] {
+    let mut r = [0; N];
+
+    #[cfg(target_arch = "x86_64")]
+    {
+        #[cfg(not(any(feature = "mesalock_sgx", target_env = "sgx")))]
+        let avx2 = is_x86_feature_detected!("avx2");
+        #[cfg(any(feature = "mesalock_sgx", target_env = "sgx"))]
+        let avx2 = false;
+
+        if avx2 {
+            #[cfg(not(any(feature = "mesalock_sgx", target_env = "sgx")))]
+            unsafe {
+                select_avx2(&mut r, table, index)
+            };
+        } else {
+            unsafe { select_sse2(&mut r, table, index) };
+        }
+    }
+
+    #[cfg(not(target_arch = "x86_64"))]
+    {
+        for (i, entry) in table.iter().enumerate() {
+            // LLVM can tell that a mask computed from `i == index` is either
+            // zero or all ones, and then compiles `e & mask` into a branch.
+            // Reading the mask back through a volatile load hides that.
+            let x = (i ^ index) as Limb;
+            let mask = (x | x.wrapping_neg()) >> (LIMB_BITS - 1);
+            let mask = unsafe { core::ptr::read_volatile(&mask) }.wrapping_sub(1);
+            for (r, e) in r.iter_mut().zip(entry.iter()) {
+                *r |= e & mask;
+            }
+        }
+    }
+
+    r
+}
+
+// The x86_64 kernels compare a vector of `index` against a vector counting
+// the entries, like `GFp_nistz256_select_w7` does, so the masks only exist
+// in vector registers, where the compiler doesn't turn them into branches.
+// `Limb` is `u64` on x86_64, so an entry is `N / 2` (or `N / 4`) vectors
+// followed by a few leftover limbs, which are masked in the low 64 bits of
+// a vector too.
+
+#[cfg(target_arch = "x86_64")]
+#[target_feature(enable = "sse2")]
+unsafe fn select_sse2<const N: usize>(r: &mut [Limb; N], table: &[[Limb; N]], index: usize) {
+    use core::arch::x86_64::*;
+
+    let index = _mm_set1_epi64x(index as i64);
+    let one = _mm_set1_epi64x(1);
+    for j in (0..N).step_by(2) {
+        let mut acc = _mm_setzero_si128();
+        let mut i = _mm_setzero_si128();
+        for entry in table {
+            // SSE2 has no 64-bit compare: AND each 32-bit half's result
+            // with the other half's.
+            let eq = _mm_cmpeq_epi32(i, index);
+            let mask = _mm_and_si128(eq, _mm_shuffle_epi32(eq, 0b10_11_00_01));
+            let e = if j + 1 < N {
+                _mm_loadu_si128(entry.as_ptr().add(j) as *const __m128i)
+            } else {
+                _mm_cvtsi64_si128(entry[j] as i64)
+            };
+            acc = _mm_or_si128(acc, _mm_and_si128(e, mask));
+            i = _mm_add_epi64(i, one);
+        }
+        if j + 1 < N {
+            _mm_storeu_si128(r.as_mut_ptr().add(j) as *mut __m128i, acc);
+        } else {
+            r[j] = _mm_cvtsi128_si64(acc) as Limb;
+        }
+    }
+}
+
+#[cfg(all(
+    target_arch = "x86_64",
+    not(any(feature = "mesalock_sgx", target_env = "sgx"))
+))]
+#[target_feature(enable = "avx2")]
+unsafe fn select_avx2<const N: usize>(r: &mut [Limb; N], table: &[[Limb; N]], index: usize) {
+    use core::arch::x86_64::*;
+
+    let index = _mm256_set1_epi64x(index as i64);
+    let one = _mm256_set1_epi64x(1);
+    for j in (0..N).step_by(4) {
+        let mut acc = _mm256_setzero_si256();
+        let mut i = _mm256_setzero_si256();
+        for entry in table {
+            let mask = _mm256_cmpeq_epi64(i, index);
+            let e = if j + 3 < N {
+                _mm256_loadu_si256(entry.as_ptr().add(j) as *const __m256i)
+            } else {
+                let mut tail = [0; 4];
+                tail[..(N - j)].copy_from_slice(&entry[j..]);
+                _mm256_loadu_si256(tail.as_ptr() as *const __m256i)
+            };
+            acc = _mm256_or_si256(acc, _mm256_and_si256(e, mask));
+            i = _mm256_add_epi64(i, one);
+        }
+        if j + 3 < N {
+            _mm256_storeu_si256(r.as_mut_ptr().add(j) as *mut __m256i, acc);
+        } else {
+            let mut tail: [Limb; 4] = [0; 4];
+            _mm256_storeu_si256(tail.as_mut_ptr() as *mut __m256i, acc);
+            r[j..].copy_from_slice(&tail[..(N - j)]);
+        }
+    }
+}
+
 #[derive(Clone, Copy, PartialEq)]
 pub enum AllowZero {
     No,
@@ -354,6 +473,7 @@ extern "C" {
 #[cfg(test)]
 mod tests {
     use super::*;
+    use crate::test;
     use untrusted;
 
     const MAX: Limb = LimbMask::True as Limb;
@@ -604,4 +724,99 @@ mod tests {
             assert_eq!(limbs_minimal_bits(limbs).as_usize_bits(), *bits);
         }
     }
+
+    #[test]
+    fn test_limbs_select_consttime() {
+        fn check<const N: usize>() {
+            let table: Vec<[Limb; N]> = (0..9)
+                .map(|i| {
+                    let mut entry = [0; N];
+                    for (j, limb) in entry.iter_mut().enumerate() {
+                        *limb = ((i as Limb) << 8) | (j as Limb) | 0x100;
+                    }
+                    entry
+                })
+                .collect();
+            for (i, entry) in table.iter().enumerate() {
+                assert_eq!(&limbs_select_consttime(&table, i)[..], &entry[..]);
+            }
+            for &i in &[table.len(), table.len() + 1, usize::max_value()] {
+                assert_eq!(&limbs_select_consttime(&table, i)[..], &[0; N][..]);
+            }
+            assert_eq!(&limbs_select_consttime(&table[..0], 0)[..], &[0; N][..]);
+        }
+
+        // Every remainder of the SSE2 and AVX2 strides.
+        check::<1>();
+        check::<2>();
+        check::<3>();
+        check::<4>();
+        check::<5>();
+        check::<6>();
+        check::<7>();
+        check::<12>();
+        check::<18>();
+    }
+
+    // The table sizes of the P-384 generator table's windows, with affine
+    // P-384 points as entries. Timing-based, so it depends on the machine
+    // being quiet; run it with
+    // `cargo test --release dudect -- --ignored --test-threads 1`.
+    #[test]
+    #[ignore]
+    fn test_limbs_select_consttime_dudect() {
+        fn t<const N: usize>(entries: usize) -> f64 {
+            let table: Vec<[Limb; N]> = (0..entries).map(|i| [i as Limb; N]).collect();
+            test::dudect::t_statistic(
+                20_000,
+                |class, rng| {
+                    if class {
+                        (rng.next_u64() as usize) % entries
+                    } else {
+                        0
+                    }
+                },
+                |&index| limbs_select_consttime(&table, index),
+            )
+        }
+
+        for &entries in &[8, 16, 32, 64] {
+            let t = t::<{ 768 / LIMB_BITS }>(entries);
+            assert!(
+                t.abs() < test::dudect::LEAK_THRESHOLD,
+                "{} entries: t = {}",
+                entries,
+                t
+            );
+        }
+    }
+
+    // Makes sure the harness notices an obviously leaky lookup. Ignored for
+    // the same reason as the test above.
+    #[test]
+    #[ignore]
+    fn test_dudect_detects_early_exit() {
+        let table: Vec<[Limb; 12]> = (0..64).map(|i| [i as Limb; 12]).collect();
+        let t = test::dudect::t_statistic(
+            20_000,
+            |class, rng| {
+                if class {
+                    (rng.next_u64() as usize) % 64
+                } else {
+                    0
+                }
+            },
+            |&index| {
+                // A linear search on the contents, which the compiler can't
+                // turn into an indexed load.
+                for entry in table.iter() {
+                    if entry[0] == index as Limb {
+                        return *entry;
+                    }
+                }
+                [0; 12]
+            },
+        );
+        assert!(t.abs() > test::dudect::LEAK_THRESHOLD, "t = {}", t);
+    }
 }
@@ -0,0 +1,542 @@
+//! Counters and latency histograms of the crate's expensive operations.
+//!
+//! Recording is compiled in only with the `metrics` feature. Without it
+//! `Timer` is empty and every recording call inlines to nothing, while
+//! `snapshot()` still works and reports zeros, so callers don't need
+//! feature gates of their own.
+//!
+//! Each operation keeps a count of calls and of errors and a histogram of
+//! latencies. The histogram is HDR-style: powers of two split into
+//! `1 << SUB_BITS` linear buckets, so a recorded latency is off by at most
+//! 12.5% whatever its magnitude. Recording is lock-free: every thread adds to
+//! one of `SHARD_COUNT` sets of atomic counters, picked when the thread first
+//! records, and `snapshot()` merges the shards. Inside an enclave reading the
+//! clock leaves the enclave, which adds a couple of microseconds to each
+//! recorded call.
+
+use std::prelude::v1::*;
+
+#[cfg(feature = "metrics")]
+use std::alloc::{alloc_zeroed, handle_alloc_error, Layout};
+use std::fmt::Write;
+use std::sync::atomic::{AtomicU64, AtomicUsize, Ordering};
+use std::time::{Duration, Instant};
+#[cfg(any(feature = "mesalock_sgx", target_env = "sgx"))]
+use std::untrusted::time::InstantEx;
+
+/// Whether the crate was built with the `metrics` feature.
+pub const ENABLED: bool = cfg!(feature = "metrics");
+
+#[derive(Clone, Copy, Debug, Eq, PartialEq)]
+pub enum Op {
+    /// `EcdsaKeyPair::sign`
+    EcdsaSign,
+    /// `UnparsedPublicKey::verify`
+    EcdsaVerify,
+    /// `ecies::encrypt`
+    EciesEncrypt,
+    /// `ecies::decrypt`
+    EciesDecrypt,
+    /// PBKDF2 derivation of a seed from a mnemonic or from entropy.
+    SeedDerivation,
+    /// `PrivateKeyOps::point_mul`, also counted inside ECIES.
+    PointMul,
+}
+
+impl Op {
+    pub const COUNT: usize = 6;
+
+    pub const ALL: [Op; Op::COUNT] = [
+        Op::EcdsaSign,
+        Op::EcdsaVerify,
+        Op::EciesEncrypt,
+        Op::EciesDecrypt,
+        Op::SeedDerivation,
+        Op::PointMul,
+    ];
+
+    pub fn name(self) -> &'static str {
+        match self {
+            Op::EcdsaSign => "ecdsa_sign",
+            Op::EcdsaVerify => "ecdsa_verify",
+            Op::EciesEncrypt => "ecies_encrypt",
+            Op::EciesDecrypt => "ecies_decrypt",
+            Op::SeedDerivation => "seed_derivation",
+            Op::PointMul => "point_mul",
+        }
+    }
+}
+
+/// Why `ecies::decrypt` rejected a ciphertext.
+#[derive(Clone, Copy, Debug, Eq, PartialEq)]
+pub enum EciesFailure {
+    /// The ciphertext is too short, or its ephemeral public key isn't an
+    /// uncompressed encoding, see `ecies::precheck`.
+    Malformed,
+    /// The ephemeral public key isn't a point on the curve.
+    InvalidPoint,
+    /// The HMAC tag doesn't match, i.e. the ciphertext was tampered with or
+    /// encrypted to another key.
+    TagMismatch,
+    /// The AES-GCM part is malformed.
+    Decryption,
+}
+
+impl EciesFailure {
+    pub const COUNT: usize = 4;
+
+    pub const ALL: [EciesFailure; EciesFailure::COUNT] = [
+        EciesFailure::Malformed,
+        EciesFailure::InvalidPoint,
+        EciesFailure::TagMismatch,
+        EciesFailure::Decryption,
+    ];
+
+    pub fn name(self) -> &'static str {
+        match self {
+            EciesFailure::Malformed => "malformed",
+            EciesFailure::InvalidPoint => "invalid_point",
+            EciesFailure::TagMismatch => "tag_mismatch",
+            EciesFailure::Decryption => "decryption",
+        }
+    }
+}
+
+/// Called after each recorded operation with its latency and whether it
+/// succeeded, e.g. to forward it to a tracing system.
+pub type Hook = fn(Op, Duration, bool);
+
+static HOOK: AtomicUsize = AtomicUsize::new(0);
+
+/// Installs `hook`, replacing any previous one. Hooks are only called when
+/// the `metrics` feature is enabled.
+pub fn set_hook(hook: Option<Hook>) {
+    HOOK.store(hook.map_or(0, |hook| hook as usize), Ordering::Release);
+}
+
+/// Times one operation, from `start()` to `finish()`.
+#[must_use]
+pub struct Timer {
+    #[cfg(feature = "metrics")]
+    op: Op,
+    #[cfg(feature = "metrics")]
+    start: Instant,
+}
+
+impl Timer {
+    #[inline(always)]
+    pub fn start(op: Op) -> Self {
+        #[cfg(not(feature = "metrics"))]
+        let _ = op;
+        Self {
+            #[cfg(feature = "metrics")]
+            op,
+            #[cfg(feature = "metrics")]
+            start: Instant::now(),
+        }
+    }
+
+    #[inline(always)]
+    pub fn finish(self, ok: bool) {
+        #[cfg(feature = "metrics")]
+        record(self.op, self.start.elapsed(), ok);
+        #[cfg(not(feature = "metrics"))]
+        let _ = ok;
+    }
+}
+
+/// Runs `f`, recording it as one call of `op`.
+#[inline(always)]
+pub fn observe<T, E>(op: Op, f: impl FnOnce() -> Result<T, E>) -> Result<T, E> {
+    let timer = Timer::start(op);
+    let result = f();
+    timer.finish(result.is_ok());
+    result
+}
+
+#[inline(always)]
+pub fn ecies_failure(reason: EciesFailure) {
+    #[cfg(feature = "metrics")]
+    shard(|shard| shard.ecies_failures[reason as usize].fetch_add(1, Ordering::Relaxed));
+    #[cfg(not(feature = "metrics"))]
+    let _ = reason;
+}
+
+/// Number of linear buckets per power of two is `1 << SUB_BITS`.
+const SUB_BITS: u32 = 3;
+
+/// Latencies from 2^MAX_BITS ns (about a minute) up share the last bucket.
+const MAX_BITS: u32 = 36;
+
+const BUCKETS: usize = ((MAX_BITS - SUB_BITS + 1) << SUB_BITS) as usize;
+
+fn bucket(nanos: u64) -> usize {
+    let nanos = nanos.min((1 << MAX_BITS) - 1);
+    if nanos < 1 << SUB_BITS {
+        return nanos as usize;
+    }
+    let msb = 63 - nanos.leading_zeros();
+    let sub = (nanos >> (msb - SUB_BITS)) & ((1 << SUB_BITS) - 1);
+    (((msb - SUB_BITS + 1) << SUB_BITS) as u64 | sub) as usize
+}
+
+/// The largest latency that falls in bucket `index`.
+fn bucket_high(index: usize) -> u64 {
+    let index = index as u64;
+    if index < 1 << SUB_BITS {
+        return index;
+    }
+    let shift = (index >> SUB_BITS) - 1;
+    let low = ((1 << SUB_BITS) | (index & ((1 << SUB_BITS) - 1))) << shift;
+    low + (1 << shift) - 1
+}
+
+/// Latencies of one operation, merged over all threads.
+#[derive(Clone, Debug)]
+pub struct Histogram {
+    counts: Vec<u64>,
+}
+
+impl Histogram {
+    pub fn count(&self) -> u64 {
+        self.counts.iter().sum()
+    }
+
+    /// An upper bound of the `q`th percentile latency, `q` in [0, 100], in
+    /// nanoseconds, or 0 if nothing was recorded.
+    pub fn percentile(&self, q: f64) -> u64 {
+        let count = self.count();
+        if count == 0 {
+            return 0;
+        }
+        let rank = ((q / 100.0 * count as f64).ceil() as u64).max(1);
+        let mut seen = 0;
+        for (index, &n) in self.counts.iter().enumerate() {
+            seen += n;
+            if seen >= rank {
+                return bucket_high(index);
+            }
+        }
+        bucket_high(BUCKETS - 1)
+    }
+
+    /// An upper bound of the largest latency, in nanoseconds.
+    pub fn max(&self) -> u64 {
+        match self.counts.iter().rposition(|&n| n > 0) {
+            Some(index) => bucket_high(index),
+            None => 0,
+        }
+    }
+}
+
+#[derive(Clone, Debug)]
+pub struct OpStats {
+    pub op: Op,
+    pub calls: u64,
+    pub errors: u64,
+    pub total: Duration,
+    pub latency: Histogram,
+}
+
+impl OpStats {
+    pub fn mean(&self) -> Duration {
+        if self.calls == 0 {
+            return Duration::from_secs(0);
+        }
+        Duration::from_nanos((self.total.as_nanos() / self.calls as u128) as u64)
+    }
+}
+
+#[derive(Clone, Debug)]
+pub struct Snapshot {
+    /// One entry per op, in the order of `Op::ALL`.
+    pub ops: Vec<OpStats>,
+    /// One count per reason, in the order of `EciesFailure::ALL`.
+    pub ecies_failures: Vec<(EciesFailure, u64)>,
+}
+
+impl Snapshot {
+    pub fn op(&self, op: Op) -> &OpStats {
+        &self.ops[op as usize]
+    }
+
+    pub fn ecies_failures(&self, reason: EciesFailure) -> u64 {
+        self.ecies_failures[reason as usize].1
+    }
+
+    /// The snapshot as a JSON object, without pulling a JSON library into the
+    /// enclave.
+    pub fn to_json(&self) -> String {
+        let mut json = String::from("{\n  \"enabled\": ");
+        json.push_str(if ENABLED { "true" } else { "false" });
+        json.push_str(",\n  \"ops\": [");
+        for (i, stats) in self.ops.iter().enumerate() {
+            if i > 0 {
+                json.push(',');
+            }
+            write!(
+                json,
+                "\n    {{\"op\": \"{}\", \"calls\": {}, \"errors\": {}, \"mean_ns\": {}, \
+                 \"p50_ns\": {}, \"p90_ns\": {}, \"p99_ns\": {}, \"max_ns\": {}}}",
+                stats.op.name(),
+                stats.calls,
+                stats.errors,
+                stats.mean().as_nanos(),
+                stats.latency.percentile(50.0),
+                stats.latency.percentile(90.0),
+                stats.latency.percentile(99.0),
+                stats.latency.max()
+            )
+            .unwrap();
+        }
+        json.push_str("\n  ],\n  \"ecies_failures\": {");
+        for (i, (reason, count)) in self.ecies_failures.iter().enumerate() {
+            if i > 0 {
+                json.push(',');
+            }
+            write!(json, "\n    \"{}\": {}", reason.name(), count).unwrap();
+        }
+        json.push_str("\n  }\n}\n");
+        json
+    }
+}
+
+/// Sums up everything recorded so far on all threads. Calls that finish
+/// while the shards are read may or may not be included.
+pub fn snapshot() -> Snapshot {
+    let mut ops = Op::ALL
+        .iter()
+        .map(|&op| OpStats {
+            op,
+            calls: 0,
+            errors: 0,
+            total: Duration::from_secs(0),
+            latency: Histogram {
+                counts: vec![0; BUCKETS],
+            },
+        })
+        .collect::<Vec<_>>();
+    let mut ecies_failures = EciesFailure::ALL
+        .iter()
+        .map(|&reason| (reason, 0))
+        .collect::<Vec<_>>();
+
+    #[cfg(feature = "metrics")]
+    for shard in SHARDS.iter() {
+        for (stats, counters) in ops.iter_mut().zip(shard.ops.iter()) {
+            stats.calls += counters.calls.load(Ordering::Relaxed);
+            stats.errors += counters.errors.load(Ordering::Relaxed);
+            stats.total += Duration::from_nanos(counters.total_nanos.load(Ordering::Relaxed));
+            for (count, bucket) in stats.latency.counts.iter_mut().zip(counters.buckets.iter()) {
+                *count += bucket.load(Ordering::Relaxed);
+            }
+        }
+        for ((_, count), counter) in ecies_failures.iter_mut().zip(shard.ecies_failures.iter()) {
+            *count += counter.load(Ordering::Relaxed);
+        }
+    }
+
+    Snapshot {
+        ops,
+        ecies_failures,
+    }
+}
+
+/// Clears everything recorded so far. Calls finishing meanwhile may be
+/// partly cleared, e.g. counted as calls but missing from the histogram.
+pub fn reset() {
+    #[cfg(feature = "metrics")]
+    for shard in SHARDS.iter() {
+        for counters in shard.ops.iter() {
+            counters.calls.store(0, Ordering::Relaxed);
+            counters.errors.store(0, Ordering::Relaxed);
+            counters.total_nanos.store(0, Ordering::Relaxed);
+            for bucket in counters.buckets.iter() {
+                bucket.store(0, Ordering::Relaxed);
+            }
+        }
+        for counter in shard.ecies_failures.iter() {
+            counter.store(0, Ordering::Relaxed);
+        }
+    }
+}
+
+/// More shards than threads that record at once would only cost memory;
+/// enclaves rarely have more TCSs than this.
+#[cfg(feature = "metrics")]
+const SHARD_COUNT: usize = 8;
+
+// The counters are stored inline and aligned, so that two shards' counters
+// never share a cache line.
+#[cfg(feature = "metrics")]
+#[repr(align(64))]
+struct OpCounters {
+    calls: AtomicU64,
+    errors: AtomicU64,
+    total_nanos: AtomicU64,
+    buckets: [AtomicU64; BUCKETS],
+}
+
+#[cfg(feature = "metrics")]
+#[repr(align(64))]
+struct Shard {
+    ops: [OpCounters; Op::COUNT],
+    ecies_failures: [AtomicU64; EciesFailure::COUNT],
+}
+
+#[cfg(feature = "metrics")]
+lazy_static! {
+    static ref SHARDS: Box<[Shard; SHARD_COUNT]> = zeroed_shards();
+}
+
+/// Allocates the shards directly on the heap, as they are too big for an
+/// enclave's stack; all-zero atomics are counters at zero.
+#[cfg(feature = "metrics")]
+fn zeroed_shards() -> Box<[Shard; SHARD_COUNT]> {
+    let layout = Layout::new::<[Shard; SHARD_COUNT]>();
+    unsafe {
+        let shards = alloc_zeroed(layout) as *mut [Shard; SHARD_COUNT];
+        if shards.is_null() {
+            handle_alloc_error(layout);
+        }
+        Box::from_raw(shards)
+    }
+}
+
+#[cfg(feature = "metrics")]
+static NEXT_SHARD: AtomicUsize = AtomicUsize::new(0);
+
+#[cfg(feature = "metrics")]
+thread_local! {
+    static THREAD_SHARD: usize = NEXT_SHARD.fetch_add(1, Ordering::Relaxed) % SHARD_COUNT;
+}
+
+#[cfg(feature = "metrics")]
+fn shard<R>(f: impl FnOnce(&Shard) -> R) -> R {
+    THREAD_SHARD.with(|&index| f(&SHARDS[index]))
+}
+
+#[cfg(feature = "metrics")]
+fn record(op: Op, elapsed: Duration, ok: bool) {
+    let nanos = elapsed.as_nanos().min(u64::MAX as u128) as u64;
+    shard(|shard| {
+        let counters = &shard.ops[op as usize];
+        counters.calls.fetch_add(1, Ordering::Relaxed);
+        if !ok {
+            counters.errors.fetch_add(1, Ordering::Relaxed);
+        }
+        counters.total_nanos.fetch_add(nanos, Ordering::Relaxed);
+        counters.buckets[bucket(nanos)].fetch_add(1, Ordering::Relaxed);
+    });
+
+    let hook = HOOK.load(Ordering::Acquire);
+    if hook != 0 {
+        let hook: Hook = unsafe { std::mem::transmute(hook) };
+        hook(op, elapsed, ok);
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_buckets() {
+        let mut previous = None;
+        for nanos in (0..4096).chain((12..=MAX_BITS).map(|bits| (1u64 << bits) - 1)) {
+            let index = bucket(nanos);
+            assert!(index < BUCKETS);
+            assert!(nanos <= bucket_high(index));
+            // Within 12.5% of the latency.
+            assert!(bucket_high(index) - nanos <= nanos >> SUB_BITS);
+            if let Some(previous) = previous {
+                assert!(index >= previous);
+            }
+            previous = Some(index);
+        }
+        assert_eq!(bucket(u64::MAX), BUCKETS - 1);
+        for index in 1..BUCKETS {
+            assert_eq!(bucket(bucket_high(index - 1) + 1), index);
+        }
+    }
+
+    #[test]
+    fn test_histogram_percentiles() {
+        let mut counts = vec![0; BUCKETS];
+        for nanos in 1..=100u64 {
+            counts[bucket(nanos * 1000)] += 1;
+        }
+        let histogram = Histogram { counts };
+        assert_eq!(histogram.count(), 100);
+        for &(q, nanos) in &[(50.0, 50_000), (90.0, 90_000), (99.0, 99_000)] {
+            let p = histogram.percentile(q);
+            assert!(
+                p >= nanos && p - nanos <= nanos >> SUB_BITS,
+                "p{} = {}",
+                q,
+                p
+            );
+        }
+        assert!(histogram.max() >= 100_000);
+        assert_eq!(
+            Histogram {
+                counts: vec![0; BUCKETS]
+            }
+            .percentile(50.0),
+            0
+        );
+    }
+
+    #[cfg(feature = "metrics")]
+    #[test]
+    fn test_shard_layout() {
+        // Every shard starts a cache line, and its counters fill whole lines.
+        assert_eq!(std::mem::size_of::<OpCounters>() % 64, 0);
+        assert_eq!(std::mem::size_of::<Shard>() % 64, 0);
+        for shard in SHARDS.iter() {
+            assert_eq!(shard as *const Shard as usize % 64, 0);
+        }
+    }
+
+    #[cfg(feature = "metrics")]
+    #[test]
+    fn test_recording() {
+        use crate::sign::ecdsa::{
+            EcdsaKeyPair, KeyPair, UnparsedPublicKey, ECDSA_P256_SHA256_ASN1,
+            ECDSA_P256_SHA256_ASN1_SIGNING,
+        };
+
+        // Other tests record too, so only look at how the counts grow.
+        let before = snapshot();
+        let key_pair = EcdsaKeyPair::from_seed_unchecked(
+            &ECDSA_P256_SHA256_ASN1_SIGNING,
+            untrusted::Input::from(&[7u8; 32]),
+        )
+        .unwrap();
+        let signature = key_pair.sign(b"metrics").unwrap();
+        let threads = (0..4)
+            .map(|_| {
+                let public_key = key_pair.public_key().as_ref().to_vec();
+                let signature = signature.as_ref().to_vec();
+                std::thread::spawn(move || {
+                    let public_key = UnparsedPublicKey::new(&ECDSA_P256_SHA256_ASN1, public_key);
+                    assert!(public_key.verify(b"metrics", &signature).is_ok());
+                    assert!(public_key.verify(b"tampered", &signature).is_err());
+                })
+            })
+            .collect::<Vec<_>>();
+        for thread in threads {
+            thread.join().unwrap();
+        }
+        let after = snapshot();
+
+        let sign = after.op(Op::EcdsaSign);
+        assert!(sign.calls > before.op(Op::EcdsaSign).calls);
+        assert!(sign.latency.count() >= sign.calls - sign.errors);
+        let verify = after.op(Op::EcdsaVerify);
+        assert!(verify.calls >= before.op(Op::EcdsaVerify).calls + 8);
+        assert!(verify.errors >= before.op(Op::EcdsaVerify).errors + 4);
+        assert!(verify.latency.percentile(50.0) > 0);
+        assert!(after.to_json().contains("\"op\": \"ecdsa_verify\""));
+    }
+}
@@ -0,0 +1,131 @@
+//! PKCS#8 is specified in [RFC 5958].
+//!
+//! [RFC 5958]: https://tools.ietf.org/html/rfc5958
+
+use std::prelude::v1::*;
+use crate::{
+    ec,
+    errors::{Error, ErrorKind, Result},
+    io::der,
+};
+
+/// The PKCS#8 versions a parser accepts.
+#[derive(Clone, Copy, Debug, PartialEq)]
+pub enum Version {
+    /// Only v1 documents, which have no `publicKey` field.
+    V1Only,
+
+    /// v1 documents, or v2 documents, whose `publicKey` field is optional.
+    V1OrV2,
+
+    /// Only v2 documents.
+    V2Only,
+}
+
+/// A generated PKCS#8 document.
+pub struct Document {
+    bytes: [u8; ec::PKCS8_V2_DOCUMENT_MAX_LEN],
+    len: usize,
+}
+
+impl Document {
+    pub(crate) fn new<F>(fill: F) -> Result<Self>
+    where
+        F: FnOnce(&mut [u8]) -> Result<usize>,
+    {
+        let mut r = Self {
+            bytes: [0; ec::PKCS8_V2_DOCUMENT_MAX_LEN],
+            len: 0,
+        };
+        r.len = fill(&mut r.bytes)?;
+        Ok(r)
+    }
+}
+
+impl AsRef<[u8]> for Document {
+    #[inline]
+    fn as_ref(&self) -> &[u8] {
+        &self.bytes[..self.len]
+    }
+}
+
+/// Parses an unencrypted PKCS#8 `OneAsymmetricKey` whose algorithm identifier
+/// is `algorithm_oid` with the parameters `parameters_oid`, returning the
+/// contents of its `privateKey` and, if present, of its `publicKey`.
+/// Attributes are ignored.
+pub(crate) fn unwrap_key<'a>(
+    algorithm_oid: &[u8],
+    parameters_oid: &[u8],
+    version: Version,
+    input: untrusted::Input<'a>,
+) -> Result<(untrusted::Input<'a>, Option<untrusted::Input<'a>>)> {
+    input.read_all(Error::from(ErrorKind::CryptoError), |input| {
+        der::nested(
+            input,
+            der::Tag::Sequence,
+            Error::from(ErrorKind::CryptoError),
+            |input| unwrap_key_(algorithm_oid, parameters_oid, version, input),
+        )
+    })
+}
+
+fn unwrap_key_<'a>(
+    algorithm_oid: &[u8],
+    parameters_oid: &[u8],
+    version: Version,
+    input: &mut untrusted::Reader<'a>,
+) -> Result<(untrusted::Input<'a>, Option<untrusted::Input<'a>>)> {
+    let actual_version = der::small_nonnegative_integer(input)?;
+    match (version, actual_version) {
+        (Version::V1Only, 0)
+        | (Version::V1OrV2, 0)
+        | (Version::V1OrV2, 1)
+        | (Version::V2Only, 1) => {}
+        _ => return Err(Error::from(ErrorKind::CryptoError)),
+    }
+
+    let (actual_algorithm, actual_parameters) = der::nested(
+        input,
+        der::Tag::Sequence,
+        Error::from(ErrorKind::CryptoError),
+        |input| {
+            let algorithm = der::expect_tag_and_get_value(input, der::Tag::OID)?;
+            let parameters = der::expect_tag_and_get_value(input, der::Tag::OID)?;
+            Ok((algorithm, parameters))
+        },
+    )?;
+    if actual_algorithm.as_slice_less_safe() != algorithm_oid
+        || actual_parameters.as_slice_less_safe() != parameters_oid
+    {
+        return Err(Error::from(ErrorKind::CryptoError));
+    }
+
+    let private_key = der::expect_tag_and_get_value(input, der::Tag::OctetString)?;
+
+    // attributes [0] Attributes OPTIONAL
+    if input.peek(u8::from(der::Tag::ContextSpecificConstructed0)) {
+        let _ = der::expect_tag_and_get_value(input, der::Tag::ContextSpecificConstructed0)?;
+    }
+
+    // publicKey [1] IMPLICIT BIT STRING OPTIONAL, only in v2.
+    let public_key = if actual_version == 1 && input.peek(u8::from(der::Tag::ContextSpecific1)) {
+        Some(der::nested(
+            input,
+            der::Tag::ContextSpecific1,
+            Error::from(ErrorKind::CryptoError),
+            |value| {
+                let unused_bits_at_end = value
+                    .read_byte()
+                    .map_err(|_| Error::from(ErrorKind::CryptoError))?;
+                if unused_bits_at_end != 0 {
+                    return Err(Error::from(ErrorKind::CryptoError));
+                }
+                Ok(value.read_bytes_to_end())
+            },
+        )?)
+    } else {
+        None
+    };
+
+    Ok((private_key, public_key))
+}
@@ -0,0 +1,179 @@
+//! Cheap structural checks of signatures and ciphertexts, in bulk.
+//!
+//! Under spam most inputs are garbage: wrong lengths, broken DER, scalars out
+//! of range, keys that aren't uncompressed points. These checks reject them
+//! with a few comparisons and no curve arithmetic, so that a front-end can
+//! drop them before spending scalar multiplications on them or sending them
+//! into an enclave. An input that fails can't verify or decrypt; one that
+//! passes still may not, and must go through `verify()` or `decrypt()`.
+//!
+//! `verify()` and `ecies::decrypt()` run the same checks first, so checking
+//! up front never changes their results.
+
+use std::prelude::v1::*;
+
+use crate::ec::suite_b::ecies;
+use crate::sign::ecdsa::EcdsaVerificationAlgorithm;
+
+/// Checks each `(public_key, signature)` pair of `inputs` for `alg`, see
+/// `EcdsaVerificationAlgorithm::precheck()`, setting `passed[i]` to whether
+/// `inputs[i]` passed. Returns the number that passed. `inputs` and `passed`
+/// must be equally long.
+pub fn signatures<P, S>(
+    alg: &EcdsaVerificationAlgorithm,
+    inputs: &[(P, S)],
+    passed: &mut [bool],
+) -> usize
+where
+    P: AsRef<[u8]>,
+    S: AsRef<[u8]>,
+{
+    assert_eq!(inputs.len(), passed.len());
+    let mut count = 0;
+    for ((public_key, signature), passed) in inputs.iter().zip(passed.iter_mut()) {
+        *passed = alg
+            .precheck(public_key.as_ref(), signature.as_ref())
+            .is_ok();
+        count += *passed as usize;
+    }
+    count
+}
+
+/// Checks each of `ciphertexts`, see `ecies::precheck()`, setting
+/// `passed[i]` to whether `ciphertexts[i]` passed. Returns the number that
+/// passed. `ciphertexts` and `passed` must be equally long.
+pub fn ecies_ciphertexts<C: AsRef<[u8]>>(ciphertexts: &[C], passed: &mut [bool]) -> usize {
+    assert_eq!(ciphertexts.len(), passed.len());
+    let mut count = 0;
+    for (ciphertext, passed) in ciphertexts.iter().zip(passed.iter_mut()) {
+        *passed = ecies::precheck(ciphertext.as_ref()).is_ok();
+        count += *passed as usize;
+    }
+    count
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::sign::ecdsa::{
+        EcdsaKeyPair, EcdsaSigningAlgorithm, KeyPair, UnparsedPublicKey, ECDSA_P256_SHA256_ASN1,
+        ECDSA_P256_SHA256_ASN1_SIGNING, ECDSA_P256_SHA256_FIXED, ECDSA_P384_SHA384_ASN1,
+        ECDSA_P384_SHA384_ASN1_SIGNING,
+    };
+
+    // The order of P-256.
+    const P256_N: &str = "ffffffff00000000ffffffffffffffffbce6faada7179e84f3b9cac2fc632551";
+
+    fn generate(alg: &'static EcdsaSigningAlgorithm) -> EcdsaKeyPair {
+        let pkcs8 = EcdsaKeyPair::generate_pkcs8(alg).unwrap();
+        EcdsaKeyPair::from_pkcs8(alg, pkcs8.as_ref()).unwrap()
+    }
+
+    #[test]
+    fn test_signatures() {
+        let key_pair = generate(&ECDSA_P256_SHA256_ASN1_SIGNING);
+        let public_key = key_pair.public_key().as_ref().to_vec();
+        let sig = key_pair.sign(b"precheck").unwrap().as_ref().to_vec();
+
+        let mut bad_prefix = public_key.clone();
+        bad_prefix[0] = 2;
+        let mut x_out_of_range = public_key.clone();
+        x_out_of_range[1..33].copy_from_slice(&[0xff; 32]);
+        let mut trailing = sig.clone();
+        trailing.push(0);
+        let mut bad_tag = sig.clone();
+        bad_tag[0] = 0x31;
+        let n = hex::decode(P256_N).unwrap();
+        let mut r_is_n = vec![0x30, 0x26, 0x02, 0x21, 0x00];
+        r_is_n.extend_from_slice(&n);
+        r_is_n.extend_from_slice(&[0x02, 0x01, 0x01]);
+
+        let inputs = vec![
+            (public_key.clone(), sig.clone()),
+            (bad_prefix, sig.clone()),
+            (x_out_of_range, sig.clone()),
+            (public_key[..64].to_vec(), sig.clone()),
+            (public_key.clone(), Vec::new()),
+            (public_key.clone(), sig[..sig.len() - 1].to_vec()),
+            (public_key.clone(), trailing),
+            (public_key.clone(), bad_tag),
+            (public_key.clone(), vec![0x30; 200]),
+            // r = 0, then r = n.
+            (
+                public_key.clone(),
+                vec![0x30, 0x06, 0x02, 0x01, 0x00, 0x02, 0x01, 0x01],
+            ),
+            (public_key.clone(), r_is_n),
+        ];
+        let mut passed = vec![false; inputs.len()];
+        assert_eq!(signatures(&ECDSA_P256_SHA256_ASN1, &inputs, &mut passed), 1);
+        assert!(passed[0]);
+
+        // Everything rejected is also rejected by `verify()`.
+        for ((public_key, sig), &passed) in inputs.iter().zip(passed.iter()) {
+            let verified = UnparsedPublicKey::new(&ECDSA_P256_SHA256_ASN1, public_key)
+                .verify(b"precheck", sig)
+                .is_ok();
+            assert_eq!(verified, passed);
+        }
+
+        // Fixed-length signatures: exactly two scalars, each in [1, n-1].
+        let mut s_is_n = vec![0u8; 31];
+        s_is_n.push(1);
+        s_is_n.extend_from_slice(&n);
+        let mut one_one = vec![0u8; 64];
+        one_one[31] = 1;
+        one_one[63] = 1;
+        let inputs = vec![
+            (&public_key, one_one.clone()),
+            (&public_key, s_is_n),
+            (&public_key, one_one[..63].to_vec()),
+            (&public_key, vec![0u8; 64]),
+        ];
+        let mut passed = vec![false; inputs.len()];
+        assert_eq!(
+            signatures(&ECDSA_P256_SHA256_FIXED, &inputs, &mut passed),
+            1
+        );
+        assert_eq!(passed, [true, false, false, false]);
+
+        // The curve's lengths come from the algorithm.
+        let key_pair = generate(&ECDSA_P384_SHA384_ASN1_SIGNING);
+        let sig = key_pair.sign(b"precheck").unwrap();
+        let inputs = [
+            (key_pair.public_key().as_ref(), sig.as_ref()),
+            (&public_key[..], sig.as_ref()),
+        ];
+        let mut passed = [false; 2];
+        assert_eq!(signatures(&ECDSA_P384_SHA384_ASN1, &inputs, &mut passed), 1);
+        assert_eq!(passed, [true, false]);
+    }
+
+    #[test]
+    fn test_ecies_ciphertexts() {
+        let key_pair = generate(&ECDSA_P256_SHA256_ASN1_SIGNING);
+        let public_key = UnparsedPublicKey::new(&ECDSA_P256_SHA256_ASN1, key_pair.public_key());
+        let ciphertext = ecies::encrypt(&public_key, &[], &[], b"x").unwrap();
+        assert_eq!(ciphertext.len(), ecies::MIN_CIPHERTEXT_LEN);
+
+        let mut bad_prefix = ciphertext.clone();
+        bad_prefix[0] = 3;
+        let ciphertexts = vec![
+            ciphertext.clone(),
+            bad_prefix,
+            ciphertext[..ciphertext.len() - 1].to_vec(),
+            ciphertext[..65].to_vec(),
+            Vec::new(),
+        ];
+        let mut passed = vec![false; ciphertexts.len()];
+        assert_eq!(ecies_ciphertexts(&ciphertexts, &mut passed), 1);
+        assert!(passed[0]);
+
+        // `decrypt()` rejects the same inputs, rather than slicing out of
+        // bounds.
+        for (ciphertext, &passed) in ciphertexts.iter().zip(passed.iter()) {
+            let decrypted = ecies::decrypt(&key_pair, ciphertext, &[], &[]);
+            assert_eq!(decrypted.is_ok(), passed);
+        }
+    }
+}
@@ -0,0 +1,99 @@
+// Copyright 2015-2016 Brian Smith.
+//
+// Permission to use, copy, modify, and/or distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHORS DISCLAIM ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY
+// SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION
+// OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+// CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+//! RSA PKCS#1 1.5 and PSS signatures, and RSA-OAEP decryption.
+//!
+//! Public key operations use `bigint::elem_exp_vartime` since the public
+//! exponent is small and not secret. Private key operations use the Chinese
+//! Remainder Theorem with `bigint::elem_exp_consttime` and blind the input
+//! with a random factor.
+//!
+//! Parsing a key computes the Montgomery constants `n0` and `oneRR` of each
+//! of its moduli once; `RsaPublicKey` and `RsaKeyPair` keep them so repeated
+//! operations with the same key don't pay for that again.
+
+use std::prelude::v1::*;
+
+use crate::{
+    arithmetic::bigint::{self, PublicModulus},
+    bits,
+    errors::{Error, ErrorKind, Result},
+    io::der,
+    limb::LIMB_BYTES,
+};
+use untrusted;
+
+mod padding;
+pub mod signing;
+pub mod verification;
+
+pub use self::{
+    padding::{
+        OaepEncoding, RsaEncoding, RSA_OAEP_SHA1_MGF1SHA1, RSA_OAEP_SHA256_MGF1SHA256,
+        RSA_PKCS1_SHA256, RSA_PKCS1_SHA384, RSA_PKCS1_SHA512, RSA_PSS_SHA256, RSA_PSS_SHA384,
+        RSA_PSS_SHA512,
+    },
+    signing::RsaKeyPair,
+    verification::{
+        RsaParameters, RsaPublicKey, RSA_PKCS1_1024_8192_SHA1_FOR_LEGACY_USE_ONLY,
+        RSA_PKCS1_2048_8192_SHA256, RSA_PKCS1_2048_8192_SHA384, RSA_PKCS1_2048_8192_SHA512,
+        RSA_PKCS1_3072_8192_SHA384, RSA_PSS_2048_8192_SHA256, RSA_PSS_2048_8192_SHA384,
+        RSA_PSS_2048_8192_SHA512,
+    },
+};
+
+// Maximum RSA modulus size supported for signature verification (in bytes).
+const PUBLIC_KEY_PUBLIC_MODULUS_MAX_LEN: usize = bigint::MODULUS_MAX_LIMBS * LIMB_BYTES;
+
+// Keep in sync with the documentation comment for `RsaKeyPair`.
+const PRIVATE_KEY_PUBLIC_MODULUS_MAX_BITS: bits::BitLength = bits::BitLength::from_usize_bits(4096);
+
+/// Parses an unencoded DER `RSAPublicKey`, returning the modulus and the
+/// public exponent, both big-endian without leading zeros.
+fn parse_public_key(input: untrusted::Input) -> Result<(untrusted::Input, untrusted::Input)> {
+    input.read_all(Error::from(ErrorKind::ParseError), |input| {
+        der::nested(
+            input,
+            der::Tag::Sequence,
+            Error::from(ErrorKind::ParseError),
+            |input| {
+                let n = der::positive_integer(input)?;
+                let e = der::positive_integer(input)?;
+                Ok((
+                    n.big_endian_without_leading_zero_as_input(),
+                    e.big_endian_without_leading_zero_as_input(),
+                ))
+            },
+        )
+    })
+}
+
+// Type-level representation of an RSA public modulus *n*. See
+// `crate::arithmetic::bigint`'s module-level documentation.
+enum N {}
+
+unsafe impl PublicModulus for N {}
+
+// Writes `elem` to `out`, which is as long as the encoding of `n_bits`. The
+// limbs of `elem` may span a few more bytes; those are zero.
+fn fill_be_bytes_n(elem: bigint::Elem<N>, n_bits: bits::BitLength, out: &mut [u8]) {
+    let n_bytes = n_bits.as_usize_bytes_rounded_up();
+    let n_bytes_padded = ((n_bytes + (LIMB_BYTES - 1)) / LIMB_BYTES) * LIMB_BYTES;
+    let mut padded = [0u8; PUBLIC_KEY_PUBLIC_MODULUS_MAX_LEN];
+    let padded = &mut padded[..n_bytes_padded];
+    elem.fill_be_bytes(padded);
+    let (padding, value) = padded.split_at(n_bytes_padded - n_bytes);
+    assert!(padding.iter().all(|&b| b == 0));
+    out.copy_from_slice(value);
+}
@@ -0,0 +1,654 @@
+// Copyright 2015-2016 Brian Smith.
+//
+// Permission to use, copy, modify, and/or distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHORS DISCLAIM ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY
+// SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION
+// OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+// CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+use std::prelude::v1::*;
+
+use super::PUBLIC_KEY_PUBLIC_MODULUS_MAX_LEN;
+use crate::{
+    bits,
+    errors::{Error, ErrorKind, Result},
+};
+use rand::Rng;
+use ring::digest;
+use untrusted;
+
+/// Common features of both RSA padding encoding and RSA padding verification.
+pub trait Padding: 'static + Sync + core::fmt::Debug {
+    // The digest algorithm used for digesting the message (and maybe for
+    // other things).
+    fn digest_alg(&self) -> &'static digest::Algorithm;
+}
+
+/// An RSA signature encoding as described in [RFC 3447 Section 8].
+///
+/// [RFC 3447 Section 8]: https://tools.ietf.org/html/rfc3447#section-8
+pub trait RsaEncoding: Padding {
+    /// Encodes `m_hash` into `m_out`, which is as long as the modulus.
+    fn encode(
+        &self,
+        m_hash: &digest::Digest,
+        m_out: &mut [u8],
+        mod_bits: bits::BitLength,
+    ) -> Result<()>;
+}
+
+/// Verification of an RSA signature encoding as described in
+/// [RFC 3447 Section 8].
+///
+/// [RFC 3447 Section 8]: https://tools.ietf.org/html/rfc3447#section-8
+pub trait Verification: Padding {
+    fn verify(
+        &self,
+        m_hash: &digest::Digest,
+        m: &mut untrusted::Reader,
+        mod_bits: bits::BitLength,
+    ) -> Result<()>;
+}
+
+/// PKCS#1 1.5 padding as described in [RFC 3447 Section 8.2].
+///
+/// [RFC 3447 Section 8.2]: https://tools.ietf.org/html/rfc3447#section-8.2
+#[derive(Debug)]
+pub struct PKCS1 {
+    digest_alg: &'static digest::Algorithm,
+    digestinfo_prefix: &'static [u8],
+}
+
+impl Padding for PKCS1 {
+    fn digest_alg(&self) -> &'static digest::Algorithm {
+        self.digest_alg
+    }
+}
+
+impl RsaEncoding for PKCS1 {
+    fn encode(
+        &self,
+        m_hash: &digest::Digest,
+        m_out: &mut [u8],
+        _mod_bits: bits::BitLength,
+    ) -> Result<()> {
+        pkcs1_encode(&self, m_hash, m_out)
+    }
+}
+
+impl Verification for PKCS1 {
+    fn verify(
+        &self,
+        m_hash: &digest::Digest,
+        m: &mut untrusted::Reader,
+        mod_bits: bits::BitLength,
+    ) -> Result<()> {
+        // `mod_bits.as_usize_bytes_rounded_up() <=
+        //      PUBLIC_KEY_PUBLIC_MODULUS_MAX_LEN` is ensured by `verify_rsa_()`.
+        let mut calculated = [0u8; PUBLIC_KEY_PUBLIC_MODULUS_MAX_LEN];
+        let calculated = &mut calculated[..mod_bits.as_usize_bytes_rounded_up()];
+        pkcs1_encode(&self, m_hash, calculated)?;
+        if m.read_bytes_to_end().as_slice_less_safe() != calculated {
+            return Err(Error::from(ErrorKind::CryptoError));
+        }
+        Ok(())
+    }
+}
+
+// Implement padding procedure per EMSA-PKCS1-v1_5,
+// https://tools.ietf.org/html/rfc3447#section-9.2. This is used by both
+// verification and signing so it needs to be able to handle moduli of the
+// minimum and maximum sizes for both operations.
+fn pkcs1_encode(pkcs1: &PKCS1, m_hash: &digest::Digest, m_out: &mut [u8]) -> Result<()> {
+    let em = m_out;
+
+    let digest_len = pkcs1.digestinfo_prefix.len() + pkcs1.digest_alg.output_len;
+
+    // The specification requires at least 8 bytes of padding. Since we
+    // disallow keys smaller than 1024 bits, this should always be true.
+    if em.len() < digest_len + 11 {
+        return Err(Error::from(ErrorKind::CryptoError));
+    }
+    let pad_len = em.len() - digest_len - 3;
+    em[0] = 0;
+    em[1] = 1;
+    for i in 0..pad_len {
+        em[2 + i] = 0xff;
+    }
+    em[2 + pad_len] = 0;
+
+    let (digest_prefix, digest_dst) = em[3 + pad_len..].split_at_mut(pkcs1.digestinfo_prefix.len());
+    digest_prefix.copy_from_slice(pkcs1.digestinfo_prefix);
+    digest_dst.copy_from_slice(m_hash.as_ref());
+    Ok(())
+}
+
+macro_rules! rsa_pkcs1_padding {
+    ( $PADDING_ALGORITHM:ident, $digest_alg:expr, $digestinfo_prefix:expr,
+      $doc_str:expr ) => {
+        #[doc=$doc_str]
+        pub static $PADDING_ALGORITHM: PKCS1 = PKCS1 {
+            digest_alg: $digest_alg,
+            digestinfo_prefix: $digestinfo_prefix,
+        };
+    };
+}
+
+rsa_pkcs1_padding!(
+    RSA_PKCS1_SHA1_FOR_LEGACY_USE_ONLY,
+    &digest::SHA1_FOR_LEGACY_USE_ONLY,
+    &SHA1_PKCS1_DIGESTINFO_PREFIX,
+    "PKCS#1 1.5 padding using SHA-1 for RSA signatures."
+);
+rsa_pkcs1_padding!(
+    RSA_PKCS1_SHA256,
+    &digest::SHA256,
+    &SHA256_PKCS1_DIGESTINFO_PREFIX,
+    "PKCS#1 1.5 padding using SHA-256 for RSA signatures."
+);
+rsa_pkcs1_padding!(
+    RSA_PKCS1_SHA384,
+    &digest::SHA384,
+    &SHA384_PKCS1_DIGESTINFO_PREFIX,
+    "PKCS#1 1.5 padding using SHA-384 for RSA signatures."
+);
+rsa_pkcs1_padding!(
+    RSA_PKCS1_SHA512,
+    &digest::SHA512,
+    &SHA512_PKCS1_DIGESTINFO_PREFIX,
+    "PKCS#1 1.5 padding using SHA-512 for RSA signatures."
+);
+
+macro_rules! pkcs1_digestinfo_prefix {
+    ( $name:ident, $digest_len:expr, $digest_oid_len:expr,
+      [ $( $digest_oid:expr ),* ] ) => {
+        static $name: [u8; 2 + 8 + $digest_oid_len] = [
+            der_type_byte!(Sequence), 8 + $digest_oid_len + $digest_len,
+                der_type_byte!(Sequence), 2 + $digest_oid_len + 2,
+                    der_type_byte!(OID), $digest_oid_len, $( $digest_oid ),*,
+                    der_type_byte!(Null), 0,
+                der_type_byte!(OctetString), $digest_len,
+        ];
+    }
+}
+
+macro_rules! der_type_byte {
+    (Sequence) => {
+        0x30
+    };
+    (OID) => {
+        0x06
+    };
+    (Null) => {
+        0x05
+    };
+    (OctetString) => {
+        0x04
+    };
+}
+
+pkcs1_digestinfo_prefix!(
+    SHA1_PKCS1_DIGESTINFO_PREFIX,
+    20,
+    5,
+    [0x2b, 0x0e, 0x03, 0x02, 0x1a]
+);
+
+pkcs1_digestinfo_prefix!(
+    SHA256_PKCS1_DIGESTINFO_PREFIX,
+    32,
+    9,
+    [0x60, 0x86, 0x48, 0x01, 0x65, 0x03, 0x04, 0x02, 0x01]
+);
+
+pkcs1_digestinfo_prefix!(
+    SHA384_PKCS1_DIGESTINFO_PREFIX,
+    48,
+    9,
+    [0x60, 0x86, 0x48, 0x01, 0x65, 0x03, 0x04, 0x02, 0x02]
+);
+
+pkcs1_digestinfo_prefix!(
+    SHA512_PKCS1_DIGESTINFO_PREFIX,
+    64,
+    9,
+    [0x60, 0x86, 0x48, 0x01, 0x65, 0x03, 0x04, 0x02, 0x03]
+);
+
+/// RSA PSS padding as described in [RFC 3447 Section 8.1].
+///
+/// The salt is as long as the digest, which is what RFC 3447 recommends and
+/// what other implementations generate by default.
+///
+/// [RFC 3447 Section 8.1]: https://tools.ietf.org/html/rfc3447#section-8.1
+#[derive(Debug)]
+pub struct PSS {
+    digest_alg: &'static digest::Algorithm,
+}
+
+impl Padding for PSS {
+    fn digest_alg(&self) -> &'static digest::Algorithm {
+        self.digest_alg
+    }
+}
+
+impl RsaEncoding for PSS {
+    // Implement padding procedure per EMSA-PSS,
+    // https://tools.ietf.org/html/rfc3447#section-9.1.
+    fn encode(
+        &self,
+        m_hash: &digest::Digest,
+        m_out: &mut [u8],
+        mod_bits: bits::BitLength,
+    ) -> Result<()> {
+        let metrics = PSSMetrics::new(self.digest_alg, mod_bits)?;
+
+        // The `m_out` this function fills is the big-endian-encoded value of
+        // `m` from the specification, padded to `k` bytes, where `k` is the
+        // length in bytes of the public modulus. The spec says "Note that
+        // emLen will be one less than k if modBits - 1 is divisible by 8 and
+        // equal to k otherwise." In other words we might need to prefix `em`
+        // with a leading zero byte to form a correct value of `m`.
+        let em = if metrics.top_byte_mask == 0xff {
+            m_out[0] = 0;
+            &mut m_out[1..]
+        } else {
+            m_out
+        };
+        if em.len() != metrics.em_len {
+            return Err(Error::from(ErrorKind::CryptoError));
+        }
+
+        // Steps 1 and 2 are done by the caller to produce `m_hash`.
+
+        // Step 3 is done by `PSSMetrics::new()` above.
+
+        // Step 4.
+        let mut salt = [0u8; digest::MAX_OUTPUT_LEN];
+        let salt = &mut salt[..metrics.s_len];
+        rand::thread_rng().fill(&mut salt[..]);
+
+        // Step 5 and 6.
+        let h_hash = pss_digest(self.digest_alg, m_hash, salt);
+
+        // Step 7, 8 and 9: DB = PS || 0x01 || salt, masked in place.
+        let (db, digest_terminator) = em.split_at_mut(metrics.db_len);
+        for b in db[..metrics.ps_len].iter_mut() {
+            *b = 0;
+        }
+        db[metrics.ps_len] = 0x01;
+        db[(metrics.ps_len + 1)..].copy_from_slice(salt);
+        mgf1(self.digest_alg, h_hash.as_ref(), db);
+
+        // Step 11.
+        db[0] &= metrics.top_byte_mask;
+
+        // Step 12.
+        digest_terminator[..metrics.h_len].copy_from_slice(h_hash.as_ref());
+        digest_terminator[metrics.h_len] = 0xbc;
+
+        Ok(())
+    }
+}
+
+impl Verification for PSS {
+    // RSASSA-PSS-VERIFY from https://tools.ietf.org/html/rfc3447#section-8.1.2
+    // where steps 1, 2(a), and 2(b) have been done for us.
+    fn verify(
+        &self,
+        m_hash: &digest::Digest,
+        m: &mut untrusted::Reader,
+        mod_bits: bits::BitLength,
+    ) -> Result<()> {
+        let metrics = PSSMetrics::new(self.digest_alg, mod_bits)?;
+        let invalid = || Error::from(ErrorKind::CryptoError);
+
+        // RSASSA-PSS-VERIFY Step 2(c). The `m` this function is given is the
+        // big-endian-encoded value of `m` from the specification, padded to
+        // `k` bytes, where `k` is the length in bytes of the public modulus.
+        // The spec. says "Note that emLen will be one less than k if
+        // modBits - 1 is divisible by 8 and equal to k otherwise," where `k`
+        // is the length in octets of the RSA public modulus `n`. In other
+        // words, `em` might have an extra leading zero byte that we need to
+        // strip before we start the PSS decoding steps which is an artifact of
+        // the `Verification` interface.
+        if metrics.top_byte_mask == 0xff {
+            if m.read_byte().map_err(|_| invalid())? != 0 {
+                return Err(invalid());
+            }
+        };
+        let em = m;
+
+        // The rest of this function is EMSA-PSS-VERIFY from
+        // https://tools.ietf.org/html/rfc3447#section-9.1.2.
+
+        // Steps 1 and 2 are done by the caller to produce `m_hash`.
+
+        // Step 3 is done by `PSSMetrics::new()` above.
+
+        // Step 5, reordered with step 4.
+        let masked_db = em.read_bytes(metrics.db_len).map_err(|_| invalid())?;
+        let h_hash = em.read_bytes(metrics.h_len).map_err(|_| invalid())?;
+
+        // Step 4.
+        if em.read_byte().map_err(|_| invalid())? != 0xbc {
+            return Err(invalid());
+        }
+        if !em.at_end() {
+            return Err(invalid());
+        }
+
+        // Step 7.
+        let mut db = [0u8; PUBLIC_KEY_PUBLIC_MODULUS_MAX_LEN];
+        let db = &mut db[..metrics.db_len];
+        db.copy_from_slice(masked_db.as_slice_less_safe());
+
+        // Step 6.
+        if db[0] & !metrics.top_byte_mask != 0 {
+            return Err(invalid());
+        }
+
+        // Step 8.
+        mgf1(self.digest_alg, h_hash.as_slice_less_safe(), db);
+
+        // Step 9.
+        db[0] &= metrics.top_byte_mask;
+
+        // Step 10.
+        if db[..metrics.ps_len].iter().any(|b| *b != 0) || db[metrics.ps_len] != 0x01 {
+            return Err(invalid());
+        }
+
+        // Step 11.
+        let salt = &db[(db.len() - metrics.s_len)..];
+
+        // Step 12 and 13.
+        let h_prime = pss_digest(self.digest_alg, m_hash, salt);
+
+        // Step 14.
+        if h_hash.as_slice_less_safe() != h_prime.as_ref() {
+            return Err(invalid());
+        }
+
+        Ok(())
+    }
+}
+
+struct PSSMetrics {
+    em_len: usize,
+    db_len: usize,
+    ps_len: usize,
+    s_len: usize,
+    h_len: usize,
+    top_byte_mask: u8,
+}
+
+impl PSSMetrics {
+    fn new(digest_alg: &'static digest::Algorithm, mod_bits: bits::BitLength) -> Result<Self> {
+        let em_bits = mod_bits.try_sub_1()?;
+        let em_len = em_bits.as_usize_bytes_rounded_up();
+        let leading_zero_bits = (8 * em_len) - em_bits.as_usize_bits();
+        debug_assert!(leading_zero_bits < 8);
+        let top_byte_mask = 0xffu8 >> leading_zero_bits;
+
+        let h_len = digest_alg.output_len;
+
+        // We require the salt length to be equal to the digest length.
+        let s_len = h_len;
+
+        // Step 3 of both `EMSA-PSS-ENCODE` is `EMSA-PSS-VERIFY` requires that
+        // we reject inputs where "emLen < hLen + sLen + 2". The definition of
+        // `emBits` in RFC 3447 Sections 9.1.1 and 9.1.2 says `emBits` must be
+        // "at least 8hLen + 8sLen + 9". Since 9 bits requires two bytes, these
+        // two conditions are equivalent. 9 bits are required as the 0x01
+        // before the salt requires 1 bit and the 0xbc after the digest
+        // requires 8 bits.
+        let db_len = em_len
+            .checked_sub(1 + h_len)
+            .ok_or(Error::from(ErrorKind::CryptoError))?;
+        let ps_len = db_len
+            .checked_sub(s_len + 1)
+            .ok_or(Error::from(ErrorKind::CryptoError))?;
+
+        debug_assert!(em_bits.as_usize_bits() >= (8 * h_len) + (8 * s_len) + 9);
+
+        Ok(Self {
+            em_len,
+            db_len,
+            ps_len,
+            s_len,
+            h_len,
+            top_byte_mask,
+        })
+    }
+}
+
+// Mask-generating function MGF1 as described in
+// https://tools.ietf.org/html/rfc3447#appendix-B.2.1, XORing the mask into
+// `out` instead of returning it.
+fn mgf1(digest_alg: &'static digest::Algorithm, seed: &[u8], out: &mut [u8]) {
+    let digest_len = digest_alg.output_len;
+
+    // Maximum counter value is the value of (mask_len / digest_len) rounded up.
+    for (i, out) in out.chunks_mut(digest_len).enumerate() {
+        let mut ctx = digest::Context::new(digest_alg);
+        ctx.update(seed);
+        // The counter will always fit in a `u32` because we reject absurdly
+        // long inputs very early.
+        ctx.update(&(i as u32).to_be_bytes());
+        let digest = ctx.finish();
+        for (o, d) in out.iter_mut().zip(digest.as_ref()) {
+            *o ^= *d;
+        }
+    }
+}
+
+fn pss_digest(
+    digest_alg: &'static digest::Algorithm,
+    m_hash: &digest::Digest,
+    salt: &[u8],
+) -> digest::Digest {
+    // Fixed prefix.
+    const PREFIX_ZEROS: [u8; 8] = [0u8; 8];
+
+    // Encoding step 5 and 6, Verification step 12 and 13.
+    let mut ctx = digest::Context::new(digest_alg);
+    ctx.update(&PREFIX_ZEROS);
+    ctx.update(m_hash.as_ref());
+    ctx.update(salt);
+    ctx.finish()
+}
+
+macro_rules! rsa_pss_padding {
+    ( $PADDING_ALGORITHM:ident, $digest_alg:expr, $doc_str:expr ) => {
+        #[doc=$doc_str]
+        pub static $PADDING_ALGORITHM: PSS = PSS {
+            digest_alg: $digest_alg,
+        };
+    };
+}
+
+rsa_pss_padding!(
+    RSA_PSS_SHA256,
+    &digest::SHA256,
+    "RSA PSS padding using SHA-256 for RSA signatures."
+);
+rsa_pss_padding!(
+    RSA_PSS_SHA384,
+    &digest::SHA384,
+    "RSA PSS padding using SHA-384 for RSA signatures."
+);
+rsa_pss_padding!(
+    RSA_PSS_SHA512,
+    &digest::SHA512,
+    "RSA PSS padding using SHA-512 for RSA signatures."
+);
+
+/// RSA-OAEP encryption padding as described in [RFC 3447 Section 7.1], with
+/// MGF1 over the same digest and an empty label.
+///
+/// [RFC 3447 Section 7.1]: https://tools.ietf.org/html/rfc3447#section-7.1
+#[derive(Debug)]
+pub struct OaepEncoding {
+    digest_alg: &'static digest::Algorithm,
+}
+
+impl Padding for OaepEncoding {
+    fn digest_alg(&self) -> &'static digest::Algorithm {
+        self.digest_alg
+    }
+}
+
+impl OaepEncoding {
+    /// The longest message that fits in a `k`-byte modulus.
+    pub fn max_message_len(&self, k: usize) -> Option<usize> {
+        k.checked_sub(2 * self.digest_alg.output_len + 2)
+    }
+
+    // EME-OAEP encoding, RFC 3447 Section 7.1.1 step 2. `em` is `k` bytes.
+    pub(super) fn encode(&self, msg: &[u8], em: &mut [u8]) -> Result<()> {
+        let h_len = self.digest_alg.output_len;
+        match self.max_message_len(em.len()) {
+            Some(max) if msg.len() <= max => (),
+            _ => return Err(Error::from(ErrorKind::InvalidInputError)),
+        }
+
+        let (y, rest) = em.split_at_mut(1);
+        let (seed, db) = rest.split_at_mut(h_len);
+        y[0] = 0;
+
+        // DB = lHash || PS || 0x01 || M.
+        let l_hash = digest::digest(self.digest_alg, b"");
+        let ps_end = db.len() - msg.len() - 1;
+        db[..h_len].copy_from_slice(l_hash.as_ref());
+        for b in db[h_len..ps_end].iter_mut() {
+            *b = 0;
+        }
+        db[ps_end] = 0x01;
+        db[(ps_end + 1)..].copy_from_slice(msg);
+
+        rand::thread_rng().fill(&mut seed[..]);
+        mgf1(self.digest_alg, seed, db);
+        mgf1(self.digest_alg, db, seed);
+        Ok(())
+    }
+
+    // EME-OAEP decoding, RFC 3447 Section 7.1.2 step 3, in place. Returns the
+    // offset of the message within `em`.
+    //
+    // All the checks are combined without branching on secret data so that
+    // a failure doesn't reveal which one failed (see Manger, "A Chosen
+    // Ciphertext Attack on RSA Optimal Asymmetric Encryption Padding (OAEP)
+    // as Standardized in PKCS #1 v2.0", CRYPTO 2001).
+    pub(super) fn decode(&self, em: &mut [u8]) -> Result<usize> {
+        let h_len = self.digest_alg.output_len;
+        if self.max_message_len(em.len()).is_none() {
+            return Err(Error::from(ErrorKind::CryptoError));
+        }
+
+        let (y, rest) = em.split_at_mut(1);
+        let (seed, db) = rest.split_at_mut(h_len);
+        mgf1(self.digest_alg, db, seed);
+        mgf1(self.digest_alg, seed, db);
+
+        let l_hash = digest::digest(self.digest_alg, b"");
+        let mut bad = usize::from(y[0]);
+        for (a, b) in db[..h_len].iter().zip(l_hash.as_ref()) {
+            bad |= usize::from(a ^ b);
+        }
+
+        // Find the 0x01 that ends PS; every byte before it must be zero.
+        let mut looking = !0usize;
+        let mut index = 0usize;
+        for (i, b) in db.iter().enumerate().skip(h_len) {
+            let is_zero = ct_is_zero(usize::from(*b));
+            let is_one = ct_is_zero(usize::from(*b ^ 1));
+            index |= looking & is_one & (i + 1);
+            bad |= looking & !is_one & !is_zero;
+            looking &= !is_one;
+        }
+        bad |= looking;
+
+        if bad != 0 {
+            return Err(Error::from(ErrorKind::CryptoError));
+        }
+        Ok(1 + h_len + index)
+    }
+}
+
+// Returns all ones if `a == 0` and zero otherwise, without branching.
+#[inline]
+fn ct_is_zero(a: usize) -> usize {
+    let msb = (!a & a.wrapping_sub(1)) >> (usize::max_value().count_ones() - 1);
+    msb.wrapping_neg()
+}
+
+/// RSA-OAEP with SHA-1, for compatibility with existing senders.
+pub static RSA_OAEP_SHA1_MGF1SHA1: OaepEncoding = OaepEncoding {
+    digest_alg: &digest::SHA1_FOR_LEGACY_USE_ONLY,
+};
+
+/// RSA-OAEP with SHA-256.
+pub static RSA_OAEP_SHA256_MGF1SHA256: OaepEncoding = OaepEncoding {
+    digest_alg: &digest::SHA256,
+};
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_pss_round_trip() {
+        // Both the "emLen == k" and the "emLen == k - 1" cases.
+        for &mod_bits in [2048usize, 2049].iter() {
+            let mod_bits = bits::BitLength::from_usize_bits(mod_bits);
+            let k = mod_bits.as_usize_bytes_rounded_up();
+            for alg in [&RSA_PSS_SHA256, &RSA_PSS_SHA384, &RSA_PSS_SHA512].iter() {
+                let m_hash = digest::digest(alg.digest_alg, b"eigen");
+                let mut em = vec![0u8; k];
+                alg.encode(&m_hash, &mut em, mod_bits).unwrap();
+                alg.verify(
+                    &m_hash,
+                    &mut untrusted::Reader::new(untrusted::Input::from(&em)),
+                    mod_bits,
+                )
+                .unwrap();
+
+                let other = digest::digest(alg.digest_alg, b"eigen!");
+                assert!(alg
+                    .verify(
+                        &other,
+                        &mut untrusted::Reader::new(untrusted::Input::from(&em)),
+                        mod_bits
+                    )
+                    .is_err());
+            }
+        }
+    }
+
+    #[test]
+    fn test_oaep_round_trip() {
+        for alg in [&RSA_OAEP_SHA1_MGF1SHA1, &RSA_OAEP_SHA256_MGF1SHA256].iter() {
+            let k = 256;
+            let max = alg.max_message_len(k).unwrap();
+            for len in [0, 1, max].iter() {
+                let msg = vec![0xa5u8; *len];
+                let mut em = vec![0u8; k];
+                alg.encode(&msg, &mut em).unwrap();
+                let mut decoded = em.clone();
+                let offset = alg.decode(&mut decoded).unwrap();
+                assert_eq!(&decoded[offset..], &msg[..]);
+
+                em[k / 2] ^= 1;
+                assert!(alg.decode(&mut em).is_err());
+            }
+            assert!(alg.encode(&vec![0u8; max + 1], &mut vec![0u8; k]).is_err());
+        }
+    }
+}
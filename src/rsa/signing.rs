@@ -0,0 +1,536 @@
+// Copyright 2015-2016 Brian Smith.
+//
+// Permission to use, copy, modify, and/or distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHORS DISCLAIM ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY
+// SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION
+// OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+// CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+//! RSA private key operations: signing and RSA-OAEP decryption.
+
+use std::prelude::v1::*;
+
+use super::{
+    fill_be_bytes_n, OaepEncoding, RsaEncoding, RsaPublicKey, N,
+    PRIVATE_KEY_PUBLIC_MODULUS_MAX_BITS, PUBLIC_KEY_PUBLIC_MODULUS_MAX_LEN,
+};
+use crate::{
+    arithmetic::{
+        bigint::{self, Prime},
+        montgomery::R,
+    },
+    bits,
+    errors::{Error, ErrorKind, Result},
+    io::der,
+};
+use rand::Rng;
+use ring::digest;
+#[cfg(not(any(feature = "mesalock_sgx", target_env = "sgx")))]
+use std::sync::Mutex;
+#[cfg(any(feature = "mesalock_sgx", target_env = "sgx"))]
+use std::sync::SgxMutex as Mutex;
+use untrusted;
+
+// How many private key operations reuse one blinding value, squaring it in
+// between, before a new one is generated. OpenSSL uses the same value.
+const BLINDING_MAX_USES: usize = 32;
+
+/// An RSA key pair, used for signing and for RSA-OAEP decryption.
+///
+/// Private key operations use the Chinese Remainder Theorem with the
+/// constant-time `bigint::elem_exp_consttime`, blind their input with a
+/// random factor, and verify their result with the public key to protect
+/// against fault attacks.
+pub struct RsaKeyPair {
+    p: PrivatePrime<P>,
+    q: PrivatePrime<Q>,
+    qInv: bigint::Elem<P, R>,
+    qq: bigint::Modulus<QQ>,
+    q_mod_n: bigint::Elem<N, R>,
+    public: RsaPublicKey,
+    blinding: Mutex<Option<Blinding>>,
+}
+
+derive_debug_via_field!(RsaKeyPair, stringify!(RsaKeyPair), public);
+
+impl RsaKeyPair {
+    /// Parses an unencrypted DER-encoded `RSAPrivateKey` ([RFC 8017 Appendix
+    /// A.1.2]).
+    ///
+    /// Only two-prime (version 0) keys are supported. The modulus must be
+    /// 2048 to 4096 bits, the public exponent at least 65537, and the two
+    /// primes must have the same bit length, with `p > q`, as `openssl genrsa`
+    /// generates them.
+    ///
+    /// The consistency of the components is checked as in NIST SP-800-56B
+    /// Section 6.4.1.4.3, except that `d` is only checked to be odd and in
+    /// the range (2**(n_bits/2), n), and that `dP` and `dQ` are only checked
+    /// to be odd and in range; the fault check in each private key operation
+    /// makes up for the rest.
+    ///
+    /// [RFC 8017 Appendix A.1.2]: https://tools.ietf.org/html/rfc8017#appendix-A.1.2
+    pub fn from_der(input: &[u8]) -> Result<Self> {
+        untrusted::Input::from(input).read_all(Error::from(ErrorKind::ParseError), |input| {
+            der::nested(
+                input,
+                der::Tag::Sequence,
+                Error::from(ErrorKind::ParseError),
+                Self::from_der_reader,
+            )
+        })
+    }
+
+    fn from_der_reader(input: &mut untrusted::Reader) -> Result<Self> {
+        let version = der::small_nonnegative_integer(input)?;
+        if version != 0 {
+            return Err(Error::from(ErrorKind::InvalidPrivaiteKeyError));
+        }
+
+        fn positive_integer<'a>(input: &mut untrusted::Reader<'a>) -> Result<untrusted::Input<'a>> {
+            Ok(der::positive_integer(input)?.big_endian_without_leading_zero_as_input())
+        }
+
+        let n = positive_integer(input)?;
+        let e = positive_integer(input)?;
+        let d = positive_integer(input)?;
+        let p = positive_integer(input)?;
+        let q = positive_integer(input)?;
+        let dP = positive_integer(input)?;
+        let dQ = positive_integer(input)?;
+        let qInv = positive_integer(input)?;
+
+        let public =
+            RsaPublicKey::from_components_(n, e, bits::BitLength::from_usize_bits(2048), 65537)?;
+        let n_bits = public.modulus_bits();
+        if n_bits > PRIVATE_KEY_PUBLIC_MODULUS_MAX_BITS {
+            return Err(Error::from(ErrorKind::InvalidPrivaiteKeyError));
+        }
+        let n = public.n();
+
+        let half_n_bits = n_bits.half_rounded_up();
+        let (p, p_bits) = bigint::Nonnegative::from_be_bytes_with_bit_length(p)?;
+        if p_bits != half_n_bits {
+            return Err(Error::from(ErrorKind::KeyParamNotMatchError));
+        }
+        let (q, q_bits) = bigint::Nonnegative::from_be_bytes_with_bit_length(q)?;
+        if q_bits != p_bits {
+            return Err(Error::from(ErrorKind::KeyParamNotMatchError));
+        }
+        // Together with the equal bit lengths this gives `q < p < 2*q`, which
+        // the reductions below rely on.
+        q.verify_less_than(&p)
+            .map_err(|_| Error::from(ErrorKind::KeyParamNotMatchError))?;
+
+        // p * q == n.
+        let q_mod_n_decoded = q.to_elem(n)?;
+        let q_mod_n = bigint::elem_mul(n.oneRR().as_ref(), q_mod_n_decoded.clone(), n);
+        {
+            let p_mod_n = p.to_elem(n)?;
+            let pq_mod_n = bigint::elem_mul(&q_mod_n, p_mod_n, n);
+            if !pq_mod_n.is_zero() {
+                return Err(Error::from(ErrorKind::KeyParamNotMatchError));
+            }
+        }
+
+        // 2**(n_bits/2) < d < n, and d is odd. `d` itself is not used since
+        // the private key operations only need `dP` and `dQ`.
+        let (d, d_bits) = bigint::Nonnegative::from_be_bytes_with_bit_length(d)?;
+        if !(half_n_bits < d_bits) {
+            return Err(Error::from(ErrorKind::KeyParamNotMatchError));
+        }
+        d.verify_less_than_modulus(n)?;
+        if !d.is_odd() {
+            return Err(Error::from(ErrorKind::KeyParamNotMatchError));
+        }
+
+        let p = PrivatePrime::new(p, dP)?;
+        let q = PrivatePrime::new(q, dQ)?;
+
+        // qInv * q == 1 (mod p).
+        let q_mod_p = q.modulus.to_elem(&p.modulus);
+        let qInv = bigint::Elem::from_be_bytes_padded(qInv, &p.modulus)?;
+        let qInv = bigint::elem_mul(p.modulus.oneRR().as_ref(), qInv, &p.modulus);
+        bigint::verify_inverses_consttime(&qInv, q_mod_p, &p.modulus)?;
+
+        let qq = bigint::elem_mul(&q_mod_n, q_mod_n_decoded, n).into_modulus::<QQ>()?;
+
+        Ok(Self {
+            p,
+            q,
+            qInv,
+            qq,
+            q_mod_n,
+            public,
+            blinding: Mutex::new(None),
+        })
+    }
+
+    /// The public key.
+    pub fn public_key(&self) -> &RsaPublicKey {
+        &self.public
+    }
+
+    /// The length in bytes of the public modulus, i.e. of signatures.
+    pub fn public_modulus_len(&self) -> usize {
+        self.public.modulus_len()
+    }
+
+    /// Signs `msg` with RSASSA-PKCS1-v1_5 or RSASSA-PSS ([RFC 8017 Section
+    /// 8]), depending on `padding_alg`. `signature` must be
+    /// `public_modulus_len()` bytes long.
+    ///
+    /// [RFC 8017 Section 8]: https://tools.ietf.org/html/rfc8017#section-8
+    pub fn sign(
+        &self,
+        padding_alg: &'static dyn RsaEncoding,
+        msg: &[u8],
+        signature: &mut [u8],
+    ) -> Result<()> {
+        if signature.len() != self.public_modulus_len() {
+            return Err(Error::from(ErrorKind::InvalidInputError));
+        }
+
+        let m_hash = digest::digest(padding_alg.digest_alg(), msg);
+        padding_alg.encode(&m_hash, signature, self.public.modulus_bits())?;
+
+        // RSASP1 is the same as RSADP.
+        self.private_(signature)
+    }
+
+    /// Decrypts the RSA-OAEP ([RFC 8017 Section 7.1]) ciphertext in `in_out`,
+    /// which must be `public_modulus_len()` bytes long, in place, returning
+    /// the plaintext within it. The label is empty.
+    ///
+    /// [RFC 8017 Section 7.1]: https://tools.ietf.org/html/rfc8017#section-7.1
+    pub fn decrypt<'a>(
+        &self,
+        padding_alg: &OaepEncoding,
+        in_out: &'a mut [u8],
+    ) -> Result<&'a [u8]> {
+        if in_out.len() != self.public_modulus_len() {
+            return Err(Error::from(ErrorKind::CryptoError));
+        }
+        self.private_(in_out)?;
+        let offset = padding_alg.decode(in_out)?;
+        Ok(&in_out[offset..])
+    }
+
+    // RSADP from RFC 8017 Section 5.1.2, in place.
+    fn private_(&self, in_out: &mut [u8]) -> Result<()> {
+        let n = self.public.n();
+
+        // Step 1.
+        let c = bigint::Elem::from_be_bytes_padded(untrusted::Input::from(in_out), n)?;
+
+        // Blind `c` as c * r**e so that the exponentiation works on a value
+        // the attacker doesn't know; its d'th power is m * r.
+        let blinding = self.take_blinding()?;
+        let c_blinded = bigint::elem_mul(&blinding.r_e, c.clone(), n);
+
+        // Step 2.b.i.
+        let m_1 = elem_exp_consttime(&c_blinded, &self.p)?;
+        let c_mod_qq = bigint::elem_reduced_once(&c_blinded, &self.qq);
+        let m_2 = elem_exp_consttime(&c_mod_qq, &self.q)?;
+
+        // Step 2.b.ii isn't needed since there are only two primes.
+
+        // Steps 2.b.iii and 2.b.iv.
+        let m_blinded = self.crt_combine(m_1, m_2);
+        let m = bigint::elem_mul(&blinding.r_inv, m_blinded, n);
+
+        // Verify the result to protect against fault attacks as described
+        // in "On the Importance of Checking Cryptographic Protocols for
+        // Faults" by Dan Boneh, Richard A. DeMillo, and Richard J. Lipton.
+        // This check is cheap assuming `e` is small, which is ensured during
+        // `RsaKeyPair` construction.
+        {
+            let verify = bigint::elem_exp_vartime(m.clone(), self.public.e(), n);
+            let verify = verify.into_unencoded(n);
+            bigint::elem_verify_equal_consttime(&verify, &c)?;
+        }
+
+        // Step 3.
+        fill_be_bytes_n(m, self.public.modulus_bits(), in_out);
+        Ok(())
+    }
+
+    // Garner's formula: the value mod n that is `m_1` mod p and `m_2` mod q.
+    fn crt_combine(&self, m_1: bigint::Elem<P>, m_2: bigint::Elem<Q>) -> bigint::Elem<N> {
+        let n = self.public.n();
+        let p = &self.p.modulus;
+
+        // h = qInv * (m_1 - m_2) (mod p).
+        let m_2_mod_p = bigint::elem_widen(m_2.clone(), p);
+        let m_1_minus_m_2 = bigint::elem_sub(m_1, &m_2_mod_p, p);
+        let h = bigint::elem_mul(&self.qInv, m_1_minus_m_2, p);
+
+        // m = m_2 + h * q. The reduction of `h` modulo `p` above makes this
+        // less than n.
+        let h = bigint::elem_widen(h, n);
+        let q_times_h = bigint::elem_mul(&self.q_mod_n, h, n);
+        let m_2 = bigint::elem_widen(m_2, n);
+        bigint::elem_add(m_2, q_times_h, n)
+    }
+
+    // Returns the blinding factors for the next operation and leaves their
+    // squares, which blind with r**2, for the one after.
+    fn take_blinding(&self) -> Result<Blinding> {
+        let mut cached = self
+            .blinding
+            .lock()
+            .unwrap_or_else(|poisoned| poisoned.into_inner());
+        let current = match cached.take() {
+            Some(blinding) => blinding,
+            None => self.new_blinding()?,
+        };
+        if current.remaining > 1 {
+            let n = self.public.n();
+            *cached = Some(Blinding {
+                r_e: bigint::elem_mul(&current.r_e, current.r_e.clone(), n),
+                r_inv: bigint::elem_mul(&current.r_inv, current.r_inv.clone(), n),
+                remaining: current.remaining - 1,
+            });
+        }
+        Ok(current)
+    }
+
+    fn new_blinding(&self) -> Result<Blinding> {
+        let n = self.public.n();
+        let mut r_bytes = [0u8; PUBLIC_KEY_PUBLIC_MODULUS_MAX_LEN];
+        let r_bytes = &mut r_bytes[..self.public_modulus_len()];
+        // Clearing the bits above the top bit of `n` keeps the candidates
+        // close to the range, so few of them are rejected.
+        let unused_bits = r_bytes.len() * 8 - self.public.modulus_bits().as_usize_bits();
+        loop {
+            rand::thread_rng().fill(&mut r_bytes[..]);
+            r_bytes[0] &= 0xff >> unused_bits;
+            let r = match bigint::Elem::from_be_bytes_padded(untrusted::Input::from(r_bytes), n) {
+                Ok(r) => r,
+                Err(_) => continue,
+            };
+
+            // r**-1 (mod n) as the CRT combination of the Fermat inverses
+            // modulo p and q. Zero, and the negligibly likely multiples of p
+            // or q, fail the check below.
+            let r_inv_mod_p = bigint::elem_inverse_consttime(
+                elem_reduced_encoded(&r, &self.p.modulus)?,
+                &self.p.modulus,
+            )?;
+            let r_mod_qq = bigint::elem_reduced_once(&r, &self.qq);
+            let r_inv_mod_q = bigint::elem_inverse_consttime(
+                elem_reduced_encoded(&r_mod_qq, &self.q.modulus)?,
+                &self.q.modulus,
+            )?;
+            let r_inv = self.crt_combine(r_inv_mod_p, r_inv_mod_q);
+
+            let r_encoded = bigint::elem_mul(n.oneRR().as_ref(), r.clone(), n);
+            if bigint::verify_inverses_consttime(&r_encoded, r_inv.clone(), n).is_err() {
+                continue;
+            }
+
+            return Ok(Blinding {
+                r_e: bigint::elem_exp_vartime(r, self.public.e(), n),
+                r_inv: bigint::elem_mul(n.oneRR().as_ref(), r_inv, n),
+                remaining: BLINDING_MAX_USES,
+            });
+        }
+    }
+}
+
+// r**e and r**-1 (mod n) for a random r, Montgomery-encoded.
+struct Blinding {
+    r_e: bigint::Elem<N, R>,
+    r_inv: bigint::Elem<N, R>,
+    remaining: usize,
+}
+
+struct PrivatePrime<M: Prime> {
+    modulus: bigint::Modulus<M>,
+    exponent: bigint::PrivateExponent<M>,
+}
+
+impl<M: Prime> PrivatePrime<M> {
+    /// Constructs a `PrivatePrime` from the private prime `p` and `dP` where
+    /// dP == d % (p - 1).
+    fn new(p: bigint::Nonnegative, dP: untrusted::Input) -> Result<Self> {
+        let (p, _p_bits) = bigint::Modulus::from_nonnegative_with_bit_length(p)?;
+        let dP = bigint::PrivateExponent::from_be_bytes_padded(dP, &p)?;
+        Ok(Self {
+            modulus: p,
+            exponent: dP,
+        })
+    }
+}
+
+// `c` reduced modulo `m`, Montgomery-encoded as `elem_exp_consttime` and
+// `elem_inverse_consttime` want it.
+fn elem_reduced_encoded<M, MM>(
+    c: &bigint::Elem<MM>,
+    m: &bigint::Modulus<M>,
+) -> Result<bigint::Elem<M, R>>
+where
+    M: bigint::NotMuchSmallerModulus<MM>,
+{
+    let c_mod_m = bigint::elem_reduced(c, m)?;
+    // We could precompute `oneRRR = elem_squared(&p.oneRR`) as mentioned
+    // in the Smooth CRT-RSA paper.
+    let c_mod_m = bigint::elem_mul(m.oneRR().as_ref(), c_mod_m, m);
+    Ok(bigint::elem_mul(m.oneRR().as_ref(), c_mod_m, m))
+}
+
+fn elem_exp_consttime<M, MM>(c: &bigint::Elem<MM>, p: &PrivatePrime<M>) -> Result<bigint::Elem<M>>
+where
+    M: bigint::NotMuchSmallerModulus<MM>,
+    M: Prime,
+{
+    let c_mod_m = elem_reduced_encoded(c, &p.modulus)?;
+    bigint::elem_exp_consttime(c_mod_m, &p.exponent, &p.modulus)
+}
+
+// Type-level representations of the different moduli used in RSA signing, in
+// addition to `super::N`. See `crate::arithmetic::bigint`'s module-level
+// documentation.
+
+enum P {}
+unsafe impl Prime for P {}
+unsafe impl bigint::SmallerModulus<N> for P {}
+unsafe impl bigint::NotMuchSmallerModulus<N> for P {}
+
+enum QQ {}
+unsafe impl bigint::SmallerModulus<N> for QQ {}
+unsafe impl bigint::NotMuchSmallerModulus<N> for QQ {}
+
+// `q < p < 2*q` since `q` is slightly smaller than `p` (see
+// `RsaKeyPair::from_der_reader`). Thus:
+//
+//                         q <  p  < 2*q
+//                       q*q <  p*q < 2*q*q.
+//                      q**2 <   n  < 2*(q**2).
+unsafe impl bigint::SlightlySmallerModulus<N> for QQ {}
+
+enum Q {}
+unsafe impl Prime for Q {}
+unsafe impl bigint::SmallerModulus<N> for Q {}
+unsafe impl bigint::SmallerModulus<P> for Q {}
+
+// q < p && `p.bit_length() == q.bit_length()` implies `q < p < 2*q`.
+unsafe impl bigint::SlightlySmallerModulus<P> for Q {}
+
+unsafe impl bigint::SmallerModulus<QQ> for Q {}
+unsafe impl bigint::NotMuchSmallerModulus<QQ> for Q {}
+
+#[cfg(test)]
+mod tests {
+    use super::super::*;
+    use crate::{test, test_file};
+
+    const PRIVATE_KEY: &[u8] = include_bytes!("rsa_2048_private_key.der");
+
+    #[test]
+    fn test_signature_rsa_pkcs1_sign() {
+        let key_pair = RsaKeyPair::from_der(PRIVATE_KEY).unwrap();
+        test::run(
+            test_file!("rsa_pkcs1_sign_tests.txt"),
+            |section, test_case| {
+                assert_eq!(section, "");
+
+                let digest_name = test_case.consume_string("Digest");
+                let alg: &'static dyn RsaEncoding = match digest_name.as_ref() {
+                    "SHA256" => &RSA_PKCS1_SHA256,
+                    "SHA384" => &RSA_PKCS1_SHA384,
+                    "SHA512" => &RSA_PKCS1_SHA512,
+                    _ => panic!("Unsupported digest: {}", digest_name),
+                };
+                let msg = test_case.consume_bytes("Msg");
+                let expected = test_case.consume_bytes("Sig");
+
+                // PKCS#1 1.5 signatures are deterministic, so run each case
+                // enough times to cover the squared and the fresh blinding values.
+                for _ in 0..3 {
+                    let mut actual = vec![0u8; key_pair.public_modulus_len()];
+                    key_pair.sign(alg, &msg, &mut actual).unwrap();
+                    assert_eq!(actual, expected);
+                }
+
+                Ok(())
+            },
+        );
+    }
+
+    #[test]
+    fn test_signature_rsa_pss_sign_verify() {
+        let key_pair = RsaKeyPair::from_der(PRIVATE_KEY).unwrap();
+        let public_key = RsaPublicKey::from_der(include_bytes!("rsa_2048_public_key.der")).unwrap();
+        let algs: [(&'static dyn RsaEncoding, &'static RsaParameters); 3] = [
+            (&RSA_PSS_SHA256, &RSA_PSS_2048_8192_SHA256),
+            (&RSA_PSS_SHA384, &RSA_PSS_2048_8192_SHA384),
+            (&RSA_PSS_SHA512, &RSA_PSS_2048_8192_SHA512),
+        ];
+        // More operations than `BLINDING_MAX_USES` so that the blinding value
+        // is regenerated at least once.
+        for i in 0..(2 * super::BLINDING_MAX_USES) {
+            let (sign_alg, verify_alg) = algs[i % algs.len()];
+            let msg = [i as u8; 37];
+            let mut sig = vec![0u8; key_pair.public_modulus_len()];
+            key_pair.sign(sign_alg, &msg, &mut sig).unwrap();
+            public_key.verify(verify_alg, &msg, &sig).unwrap();
+            key_pair
+                .public_key()
+                .verify(verify_alg, &msg, &sig)
+                .unwrap();
+            assert!(public_key.verify(verify_alg, &msg[1..], &sig).is_err());
+        }
+    }
+
+    #[test]
+    fn test_rsa_oaep_decrypt() {
+        let key_pair = RsaKeyPair::from_der(PRIVATE_KEY).unwrap();
+        test::run(
+            test_file!("rsa_oaep_decrypt_tests.txt"),
+            |section, test_case| {
+                assert_eq!(section, "");
+
+                let digest_name = test_case.consume_string("Digest");
+                let alg = match digest_name.as_ref() {
+                    "SHA1" => &RSA_OAEP_SHA1_MGF1SHA1,
+                    "SHA256" => &RSA_OAEP_SHA256_MGF1SHA256,
+                    _ => panic!("Unsupported digest: {}", digest_name),
+                };
+                let msg = test_case.consume_bytes("Msg");
+                let mut ct = test_case.consume_bytes("Ct");
+
+                let mut bad = ct.clone();
+                let last = bad.len() - 1;
+                bad[last] ^= 1;
+                assert!(key_pair.decrypt(alg, &mut bad).is_err());
+
+                assert_eq!(key_pair.decrypt(alg, &mut ct).unwrap(), &msg[..]);
+
+                // Round trip through the public key.
+                let mut ct = vec![0u8; key_pair.public_modulus_len()];
+                key_pair.public_key().encrypt(alg, &msg, &mut ct).unwrap();
+                assert_eq!(key_pair.decrypt(alg, &mut ct).unwrap(), &msg[..]);
+
+                Ok(())
+            },
+        );
+    }
+
+    #[test]
+    fn test_rsa_key_pair_from_der_rejects() {
+        // The primes of this 2049-bit key are 1025 and 1024 bits long.
+        assert!(RsaKeyPair::from_der(include_bytes!("rsa_2049_private_key.der")).is_err());
+
+        // A modified component makes the key inconsistent.
+        let mut der = PRIVATE_KEY.to_vec();
+        let last = der.len() - 1;
+        der[last] ^= 1; // qInv
+        assert!(RsaKeyPair::from_der(&der).is_err());
+    }
+}
@@ -0,0 +1,307 @@
+// Copyright 2015-2016 Brian Smith.
+//
+// Permission to use, copy, modify, and/or distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHORS DISCLAIM ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY
+// SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION
+// OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+// CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+//! Verification of RSA signatures and RSA public key operations.
+
+use std::prelude::v1::*;
+
+use super::{
+    fill_be_bytes_n, padding, parse_public_key, OaepEncoding, N, PUBLIC_KEY_PUBLIC_MODULUS_MAX_LEN,
+};
+use crate::{
+    arithmetic::bigint,
+    bits,
+    errors::{Error, ErrorKind, Result, SimpleResult},
+    sign::ecdsa::VerificationAlgorithm,
+};
+use ring::digest;
+use untrusted;
+
+/// Parameters for RSA verification.
+#[derive(Debug)]
+pub struct RsaParameters {
+    padding_alg: &'static dyn padding::Verification,
+    min_bits: bits::BitLength,
+}
+
+impl VerificationAlgorithm for RsaParameters {
+    /// Parses `public_key` as a DER `RSAPublicKey` and verifies `signature`
+    /// with it. The key's Montgomery constants are computed on every call; use
+    /// `RsaPublicKey::verify` to verify many signatures with the same key.
+    fn verify(
+        &self,
+        public_key: untrusted::Input,
+        msg: untrusted::Input,
+        signature: untrusted::Input,
+    ) -> SimpleResult<()> {
+        let (n, e) = parse_public_key(public_key)?;
+        let key = RsaPublicKey::from_components_(n, e, self.min_bits, 3)?;
+        Ok(key.verify(
+            self,
+            msg.as_slice_less_safe(),
+            signature.as_slice_less_safe(),
+        )?)
+    }
+}
+
+macro_rules! rsa_params {
+    ( $VERIFY_ALGORITHM:ident, $min_bits:expr, $PADDING_ALGORITHM:expr,
+      $doc_str:expr ) => {
+        #[doc=$doc_str]
+        ///
+        /// Only available in `alloc` mode.
+        pub static $VERIFY_ALGORITHM: RsaParameters = RsaParameters {
+            padding_alg: $PADDING_ALGORITHM,
+            min_bits: bits::BitLength::from_usize_bits($min_bits),
+        };
+    };
+}
+
+rsa_params!(
+    RSA_PKCS1_1024_8192_SHA1_FOR_LEGACY_USE_ONLY,
+    1024,
+    &padding::RSA_PKCS1_SHA1_FOR_LEGACY_USE_ONLY,
+    "Verification of signatures using RSA keys of 1024-8192 bits,
+             PKCS#1.5 padding, and SHA-1."
+);
+rsa_params!(
+    RSA_PKCS1_2048_8192_SHA256,
+    2048,
+    &padding::RSA_PKCS1_SHA256,
+    "Verification of signatures using RSA keys of 2048-8192 bits,
+             PKCS#1.5 padding, and SHA-256."
+);
+rsa_params!(
+    RSA_PKCS1_2048_8192_SHA384,
+    2048,
+    &padding::RSA_PKCS1_SHA384,
+    "Verification of signatures using RSA keys of 2048-8192 bits,
+             PKCS#1.5 padding, and SHA-384."
+);
+rsa_params!(
+    RSA_PKCS1_2048_8192_SHA512,
+    2048,
+    &padding::RSA_PKCS1_SHA512,
+    "Verification of signatures using RSA keys of 2048-8192 bits,
+             PKCS#1.5 padding, and SHA-512."
+);
+rsa_params!(
+    RSA_PKCS1_3072_8192_SHA384,
+    3072,
+    &padding::RSA_PKCS1_SHA384,
+    "Verification of signatures using RSA keys of 3072-8192 bits,
+             PKCS#1.5 padding, and SHA-384."
+);
+rsa_params!(
+    RSA_PSS_2048_8192_SHA256,
+    2048,
+    &padding::RSA_PSS_SHA256,
+    "Verification of signatures using RSA keys of 2048-8192 bits,
+             PSS padding, and SHA-256."
+);
+rsa_params!(
+    RSA_PSS_2048_8192_SHA384,
+    2048,
+    &padding::RSA_PSS_SHA384,
+    "Verification of signatures using RSA keys of 2048-8192 bits,
+             PSS padding, and SHA-384."
+);
+rsa_params!(
+    RSA_PSS_2048_8192_SHA512,
+    2048,
+    &padding::RSA_PSS_SHA512,
+    "Verification of signatures using RSA keys of 2048-8192 bits,
+             PSS padding, and SHA-512."
+);
+
+/// A parsed RSA public key.
+///
+/// Parsing computes the Montgomery constants of the modulus, so keeping an
+/// `RsaPublicKey` around makes each following verification cost just the
+/// exponentiation by the (small) public exponent.
+pub struct RsaPublicKey {
+    n: bigint::Modulus<N>,
+    e: bigint::PublicExponent,
+    n_bits: bits::BitLength,
+}
+
+derive_debug_via_field!(RsaPublicKey, stringify!(RsaPublicKey), n);
+
+impl RsaPublicKey {
+    /// Parses a DER-encoded `RSAPublicKey` ([RFC 8017 Appendix A.1.1]) of a
+    /// modulus of 1024 to 8192 bits.
+    ///
+    /// [RFC 8017 Appendix A.1.1]: https://tools.ietf.org/html/rfc8017#appendix-A.1.1
+    pub fn from_der(input: &[u8]) -> Result<Self> {
+        let (n, e) = parse_public_key(untrusted::Input::from(input))?;
+        Self::from_components_(n, e, bits::BitLength::from_usize_bits(1024), 3)
+    }
+
+    /// Constructs a key from the big-endian modulus `n` and public exponent
+    /// `e`, neither of which may have leading zeros.
+    pub fn from_components(n: &[u8], e: &[u8]) -> Result<Self> {
+        Self::from_components_(
+            untrusted::Input::from(n),
+            untrusted::Input::from(e),
+            bits::BitLength::from_usize_bits(1024),
+            3,
+        )
+    }
+
+    pub(super) fn from_components_(
+        n: untrusted::Input,
+        e: untrusted::Input,
+        n_min_bits: bits::BitLength,
+        e_min_value: u64,
+    ) -> Result<Self> {
+        let max_bits = bits::BitLength::from_usize_bytes(PUBLIC_KEY_PUBLIC_MODULUS_MAX_LEN)?;
+
+        // XXX: FIPS 186-4 seems to indicate that the minimum exponent value is
+        // 2**16 + 1, but it isn't clear if this is just for signing or also
+        // for verification. Public keys accept exponents of 3 and larger for
+        // compatibility with other commonly-used crypto libraries; private
+        // keys ask for 65537.
+        let e = bigint::PublicExponent::from_be_bytes(e, e_min_value)?;
+
+        let (n, n_bits) = bigint::Modulus::from_be_bytes_with_bit_length(n)?;
+        if n_bits < n_min_bits || n_bits > max_bits {
+            return Err(Error::from(ErrorKind::CryptoError));
+        }
+
+        Ok(Self { n, e, n_bits })
+    }
+
+    pub(super) fn n(&self) -> &bigint::Modulus<N> {
+        &self.n
+    }
+
+    pub(super) fn e(&self) -> bigint::PublicExponent {
+        self.e
+    }
+
+    /// The length in bytes of the modulus, which is also the length of
+    /// signatures and ciphertexts.
+    pub fn modulus_len(&self) -> usize {
+        self.n_bits.as_usize_bytes_rounded_up()
+    }
+
+    pub fn modulus_bits(&self) -> bits::BitLength {
+        self.n_bits
+    }
+
+    /// Verifies `signature` of `msg` as described in RSASSA-PKCS1-v1_5-VERIFY
+    /// or RSASSA-PSS-VERIFY ([RFC 8017 Section 8]), depending on `params`.
+    ///
+    /// [RFC 8017 Section 8]: https://tools.ietf.org/html/rfc8017#section-8
+    pub fn verify(&self, params: &RsaParameters, msg: &[u8], signature: &[u8]) -> Result<()> {
+        if self.n_bits < params.min_bits {
+            return Err(Error::from(ErrorKind::CryptoError));
+        }
+
+        let mut decoded = [0u8; PUBLIC_KEY_PUBLIC_MODULUS_MAX_LEN];
+        let decoded = &mut decoded[..self.modulus_len()];
+        self.public_(signature, decoded)?;
+
+        // Verify the padded message is correct.
+        let m_hash = digest::digest(params.padding_alg.digest_alg(), msg);
+        untrusted::Input::from(decoded).read_all(Error::from(ErrorKind::CryptoError), |m| {
+            params.padding_alg.verify(&m_hash, m, self.n_bits)
+        })
+    }
+
+    /// Encrypts `msg` with RSAES-OAEP ([RFC 8017 Section 7.1]), writing the
+    /// ciphertext to `out`, which must be `modulus_len()` bytes long.
+    ///
+    /// [RFC 8017 Section 7.1]: https://tools.ietf.org/html/rfc8017#section-7.1
+    pub fn encrypt(&self, padding_alg: &OaepEncoding, msg: &[u8], out: &mut [u8]) -> Result<()> {
+        if out.len() != self.modulus_len() {
+            return Err(Error::from(ErrorKind::InvalidInputError));
+        }
+        let mut em = [0u8; PUBLIC_KEY_PUBLIC_MODULUS_MAX_LEN];
+        let em = &mut em[..out.len()];
+        padding_alg.encode(msg, em)?;
+        self.public_(em, out)
+    }
+
+    // RSAEP/RSAVP1 from RFC 8017 Sections 5.1.1 and 5.2.2: `out` = `input`**e
+    // (mod n), where `input` must be exactly `modulus_len()` bytes.
+    fn public_(&self, input: &[u8], out: &mut [u8]) -> Result<()> {
+        // RFC 8017 Section 8.2.2 Step 1.
+        if input.len() != self.modulus_len() {
+            return Err(Error::from(ErrorKind::CryptoError));
+        }
+
+        // Step 2.a.
+        let s = bigint::Elem::from_be_bytes_padded(untrusted::Input::from(input), &self.n)?;
+
+        // Step 2.b.
+        let m = bigint::elem_exp_vartime(s, self.e, &self.n);
+        let m = m.into_unencoded(&self.n);
+
+        // Step 2.c.
+        fill_be_bytes_n(m, self.n_bits, out);
+        Ok(())
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::super::*;
+    use crate::{sign::ecdsa::UnparsedPublicKey, test, test_file};
+
+    #[test]
+    fn test_signature_rsa_verify() {
+        test::run(
+            test_file!("rsa_signature_verify_tests.txt"),
+            |section, test_case| {
+                assert_eq!(section, "");
+
+                let digest_name = test_case.consume_string("Digest");
+                let padding = test_case.consume_string("Padding");
+                let public_key = test_case.consume_bytes("Key");
+                let msg = test_case.consume_bytes("Msg");
+                let sig = test_case.consume_bytes("Sig");
+                let expected_result = test_case.consume_string("Result");
+
+                let alg: &'static RsaParameters = match (padding.as_str(), digest_name.as_str()) {
+                    ("PKCS1", "SHA1") => &RSA_PKCS1_1024_8192_SHA1_FOR_LEGACY_USE_ONLY,
+                    ("PKCS1", "SHA256") => &RSA_PKCS1_2048_8192_SHA256,
+                    ("PKCS1", "SHA384") => &RSA_PKCS1_2048_8192_SHA384,
+                    ("PKCS1", "SHA512") => &RSA_PKCS1_2048_8192_SHA512,
+                    ("PSS", "SHA256") => &RSA_PSS_2048_8192_SHA256,
+                    ("PSS", "SHA384") => &RSA_PSS_2048_8192_SHA384,
+                    ("PSS", "SHA512") => &RSA_PSS_2048_8192_SHA512,
+                    _ => panic!("Unsupported algorithm: {} {}", padding, digest_name),
+                };
+
+                let key = RsaPublicKey::from_der(&public_key).unwrap();
+                let actual_result = key.verify(alg, &msg, &sig);
+                assert_eq!(actual_result.is_ok(), expected_result == "P");
+
+                let actual_result = UnparsedPublicKey::new(alg, &public_key).verify(&msg, &sig);
+                assert_eq!(actual_result.is_ok(), expected_result == "P");
+
+                Ok(())
+            },
+        )
+    }
+
+    #[test]
+    fn test_rsa_public_key_min_bits() {
+        let key = RsaPublicKey::from_der(include_bytes!("rsa_2048_public_key.der")).unwrap();
+        assert_eq!(key.modulus_len(), 256);
+        let sig = vec![0u8; 256];
+        assert!(key.verify(&RSA_PKCS1_3072_8192_SHA384, b"", &sig).is_err());
+    }
+}
@@ -0,0 +1,381 @@
+//! A cache of successful ECDSA verifications.
+//!
+//! A node verifies most signatures twice: when a transaction is admitted to
+//! the mempool, and again when it is included in a block. A
+//! `VerificationCache` remembers the signatures that verified, so that the
+//! second time costs two digests and a read of one cache line instead of a
+//! twin multiplication. Failures are not cached: a flood of bad signatures
+//! must not evict good ones, and `precheck()` turns most of them away anyway.
+//!
+//! An entry is a 128-bit tag, the truncated SHA-256 of a random per-cache
+//! salt, the algorithm, the public key, the message digest and the
+//! signature. A tag collision would accept a signature that never verified;
+//! the salt keeps anyone from predicting tags, so a collision can only be
+//! found by chance.
+//!
+//! The table is a fixed number of buckets of `WAYS` tags, each bucket in one
+//! cache line. Lookups are lock-free: a bucket is a seqlock, read
+//! optimistically and taken as a miss if a writer got in the way. An
+//! insertion claims its bucket and gives up if another thread holds it, as
+//! the cache is only best effort. Within a bucket, entries are evicted in
+//! CLOCK order: a hit marks its entry as referenced, and an insertion sweeps
+//! past referenced entries, clearing the marks, to the first one that isn't.
+
+use std::prelude::v1::*;
+
+use std::sync::atomic::{fence, AtomicU32, AtomicU64, AtomicU8, AtomicUsize, Ordering};
+
+use rand::Rng;
+use ring::digest;
+use untrusted;
+
+use crate::errors::SimpleResult;
+use crate::metrics::{self, Op};
+use crate::sign::ecdsa::EcdsaVerificationAlgorithm;
+
+/// Tags per bucket: as many as fit in a cache line next to the bucket's
+/// sequence number and CLOCK state.
+const WAYS: usize = 3;
+
+/// Sets of counters, see `Stats`; as with `metrics`, each thread adds to one
+/// of them.
+const SHARD_COUNT: usize = 8;
+
+type Tag = [u64; 2];
+
+#[repr(align(64))]
+#[derive(Default)]
+struct Bucket {
+    /// Odd while a writer holds the bucket.
+    seq: AtomicU32,
+    /// The next way the CLOCK hand looks at.
+    hand: AtomicU8,
+    /// Bit `i` is set if way `i` was inserted or hit since the hand last
+    /// passed it.
+    referenced: AtomicU8,
+    /// An all-zero tag is an empty way; `VerificationCache::tag()` never
+    /// returns one.
+    tags: [[AtomicU64; 2]; WAYS],
+}
+
+impl Bucket {
+    fn find(&self, tag: &Tag) -> Option<usize> {
+        self.tags.iter().position(|t| {
+            t[0].load(Ordering::Relaxed) == tag[0] && t[1].load(Ordering::Relaxed) == tag[1]
+        })
+    }
+
+    fn lookup(&self, tag: &Tag) -> bool {
+        let seq = self.seq.load(Ordering::Acquire);
+        if seq & 1 != 0 {
+            return false;
+        }
+        let way = self.find(tag);
+        fence(Ordering::Acquire);
+        if self.seq.load(Ordering::Relaxed) != seq {
+            return false;
+        }
+        match way {
+            Some(way) => {
+                // Only write if the mark is missing, so that threads hitting
+                // the same entry don't keep taking the line from each other.
+                let bit = 1 << way;
+                if self.referenced.load(Ordering::Relaxed) & bit == 0 {
+                    self.referenced.fetch_or(bit, Ordering::Relaxed);
+                }
+                true
+            }
+            None => false,
+        }
+    }
+
+    /// Returns whether an entry was evicted to make room for `tag`.
+    fn insert(&self, tag: &Tag) -> bool {
+        let seq = self.seq.load(Ordering::Relaxed);
+        if seq & 1 != 0
+            || self
+                .seq
+                .compare_exchange(
+                    seq,
+                    seq.wrapping_add(1),
+                    Ordering::Acquire,
+                    Ordering::Relaxed,
+                )
+                .is_err()
+        {
+            return false;
+        }
+        fence(Ordering::Release);
+
+        let mut evicted = false;
+        if self.find(tag).is_none() {
+            // After a full turn every mark is clear, so the hand stops where
+            // it started at the latest.
+            let mut hand = self.hand.load(Ordering::Relaxed) as usize;
+            for _ in 0..WAYS {
+                let bit = 1 << hand;
+                if self.referenced.fetch_and(!bit, Ordering::Relaxed) & bit == 0 {
+                    break;
+                }
+                hand = (hand + 1) % WAYS;
+            }
+            let way = &self.tags[hand];
+            evicted = way[0].load(Ordering::Relaxed) != 0;
+            way[0].store(tag[0], Ordering::Relaxed);
+            way[1].store(tag[1], Ordering::Relaxed);
+            self.referenced.fetch_or(1 << hand, Ordering::Relaxed);
+            self.hand
+                .store(((hand + 1) % WAYS) as u8, Ordering::Relaxed);
+        }
+
+        self.seq.store(seq.wrapping_add(2), Ordering::Release);
+        evicted
+    }
+}
+
+// Aligned so that two shards' counters never share a cache line.
+#[repr(align(64))]
+#[derive(Default)]
+struct Counters {
+    hits: AtomicU64,
+    misses: AtomicU64,
+    evictions: AtomicU64,
+}
+
+static NEXT_SHARD: AtomicUsize = AtomicUsize::new(0);
+
+thread_local! {
+    static THREAD_SHARD: usize = NEXT_SHARD.fetch_add(1, Ordering::Relaxed) % SHARD_COUNT;
+}
+
+/// Counts of a cache's lookups since it was created. Signatures rejected by
+/// `precheck()` are not looked up.
+#[derive(Clone, Copy, Debug, Default, Eq, PartialEq)]
+pub struct Stats {
+    pub hits: u64,
+    pub misses: u64,
+    pub evictions: u64,
+}
+
+impl Stats {
+    /// The fraction of lookups that hit, or 0 before the first one.
+    pub fn hit_rate(&self) -> f64 {
+        match self.hits + self.misses {
+            0 => 0.0,
+            lookups => self.hits as f64 / lookups as f64,
+        }
+    }
+}
+
+/// A bounded, concurrent cache of successful verifications. See the module
+/// documentation.
+pub struct VerificationCache {
+    salt: [u8; 32],
+    buckets: Box<[Bucket]>,
+    counters: Box<[Counters]>,
+}
+
+impl VerificationCache {
+    /// Creates an empty cache of at least `capacity` entries. Each bucket of
+    /// `WAYS` entries takes 64 bytes, allocated up front; the number of
+    /// buckets is rounded up to a power of two.
+    pub fn new(capacity: usize) -> Self {
+        let buckets = ((capacity + WAYS - 1) / WAYS).max(1).next_power_of_two();
+        let mut salt = [0u8; 32];
+        rand::thread_rng().fill(&mut salt[..]);
+        Self {
+            salt,
+            buckets: (0..buckets).map(|_| Bucket::default()).collect(),
+            counters: (0..SHARD_COUNT).map(|_| Counters::default()).collect(),
+        }
+    }
+
+    /// The number of entries the cache holds when full.
+    pub fn capacity(&self) -> usize {
+        self.buckets.len() * WAYS
+    }
+
+    /// Verifies `signature` of `msg` with `public_key` as
+    /// `UnparsedPublicKey::verify()` does, skipping the arithmetic if the
+    /// same signature of the same message with the same key and algorithm
+    /// was verified through this cache before and hasn't been evicted.
+    pub fn verify(
+        &self,
+        alg: &EcdsaVerificationAlgorithm,
+        public_key: &[u8],
+        msg: &[u8],
+        signature: &[u8],
+    ) -> SimpleResult<()> {
+        alg.precheck(public_key, signature)?;
+        let h = alg.digest(msg);
+        let tag = self.tag(alg, public_key, &h, signature);
+        let bucket = &self.buckets[tag[1] as usize & (self.buckets.len() - 1)];
+        if bucket.lookup(&tag) {
+            self.count(|c| &c.hits);
+            return Ok(());
+        }
+
+        self.count(|c| &c.misses);
+        metrics::observe(Op::EcdsaVerify, || {
+            alg.verify_hash(
+                untrusted::Input::from(public_key),
+                h,
+                untrusted::Input::from(signature),
+            )
+        })?;
+        if bucket.insert(&tag) {
+            self.count(|c| &c.evictions);
+        }
+        Ok(())
+    }
+
+    /// Sums the counters of all threads.
+    pub fn stats(&self) -> Stats {
+        self.counters
+            .iter()
+            .fold(Stats::default(), |stats, c| Stats {
+                hits: stats.hits + c.hits.load(Ordering::Relaxed),
+                misses: stats.misses + c.misses.load(Ordering::Relaxed),
+                evictions: stats.evictions + c.evictions.load(Ordering::Relaxed),
+            })
+    }
+
+    fn tag(
+        &self,
+        alg: &EcdsaVerificationAlgorithm,
+        public_key: &[u8],
+        h: &digest::Digest,
+        signature: &[u8],
+    ) -> Tag {
+        // The algorithm fixes the length of the digest, and the signature
+        // comes last, so only the public key needs its length encoded.
+        let mut ctx = digest::Context::new(&digest::SHA256);
+        ctx.update(&self.salt);
+        ctx.update(&[alg.id()]);
+        ctx.update(&(public_key.len() as u32).to_be_bytes());
+        ctx.update(public_key);
+        ctx.update(h.as_ref());
+        ctx.update(signature);
+        let d = ctx.finish();
+        let word = |i: usize| {
+            let mut bytes = [0u8; 8];
+            bytes.copy_from_slice(&d.as_ref()[8 * i..8 * (i + 1)]);
+            u64::from_le_bytes(bytes)
+        };
+        [word(0) | 1, word(1)]
+    }
+
+    fn count(&self, counter: impl FnOnce(&Counters) -> &AtomicU64) {
+        THREAD_SHARD.with(|&index| counter(&self.counters[index]).fetch_add(1, Ordering::Relaxed));
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::sign::ecdsa::{
+        EcdsaKeyPair, KeyPair, ECDSA_P256_SHA256_ASN1, ECDSA_P256_SHA256_ASN1_SIGNING,
+    };
+    use std::sync::Arc;
+    use std::thread;
+
+    #[test]
+    fn test_hits_and_misses() {
+        let alg = &ECDSA_P256_SHA256_ASN1_SIGNING;
+        let pkcs8 = EcdsaKeyPair::generate_pkcs8(alg).unwrap();
+        let key_pair = EcdsaKeyPair::from_pkcs8(alg, pkcs8.as_ref()).unwrap();
+        let public_key = key_pair.public_key().as_ref();
+        let sig = key_pair.sign(b"cached").unwrap();
+        let cache = VerificationCache::new(100);
+        assert_eq!(cache.capacity(), 3 * 64);
+
+        let verify =
+            |msg: &[u8], sig: &[u8]| cache.verify(&ECDSA_P256_SHA256_ASN1, public_key, msg, sig);
+        assert!(verify(b"cached", sig.as_ref()).is_ok());
+        assert!(verify(b"cached", sig.as_ref()).is_ok());
+        assert_eq!(cache.stats().hits, 1);
+
+        // Failures aren't cached, and a cached signature doesn't verify
+        // another message.
+        assert!(verify(b"other", sig.as_ref()).is_err());
+        assert!(verify(b"other", sig.as_ref()).is_err());
+        // Rejected before the lookup.
+        assert!(verify(b"cached", &sig.as_ref()[1..]).is_err());
+
+        let stats = cache.stats();
+        assert_eq!(
+            stats,
+            Stats {
+                hits: 1,
+                misses: 3,
+                evictions: 0,
+            }
+        );
+        assert_eq!(stats.hit_rate(), 0.25);
+
+        // Another cache has another salt.
+        let other = VerificationCache::new(1);
+        assert_ne!(
+            cache.tag(
+                &ECDSA_P256_SHA256_ASN1,
+                public_key,
+                &ECDSA_P256_SHA256_ASN1.digest(b""),
+                b""
+            ),
+            other.tag(
+                &ECDSA_P256_SHA256_ASN1,
+                public_key,
+                &ECDSA_P256_SHA256_ASN1.digest(b""),
+                b""
+            )
+        );
+    }
+
+    #[test]
+    fn test_clock_eviction() {
+        let bucket = Bucket::default();
+        let tags = (1..=5).map(|i| [2 * i + 1, i]).collect::<Vec<Tag>>();
+        for tag in &tags[..3] {
+            assert!(!bucket.insert(tag));
+        }
+        assert!(!bucket.insert(&tags[0]));
+        assert!(tags[..3].iter().all(|tag| bucket.lookup(tag)));
+
+        // Everything was referenced, so the hand goes round once, clearing
+        // the marks, and evicts the oldest entry.
+        assert!(bucket.insert(&tags[3]));
+        assert!(!bucket.lookup(&tags[0]));
+        // A hit gives an entry a second chance: the next one is evicted
+        // instead.
+        assert!(bucket.lookup(&tags[1]));
+        assert!(bucket.insert(&tags[4]));
+        assert!(bucket.lookup(&tags[1]));
+        assert!(!bucket.lookup(&tags[2]));
+        assert!(bucket.lookup(&tags[3]));
+        assert!(bucket.lookup(&tags[4]));
+    }
+
+    #[test]
+    fn test_concurrent_lookups_never_see_torn_tags() {
+        // Writers store `[i, i]`; without the seqlock a reader could see the
+        // halves of two of them, e.g. `[i, j]`.
+        let bucket = Arc::new(Bucket::default());
+        let threads = (0..4u64)
+            .map(|t| {
+                let bucket = bucket.clone();
+                thread::spawn(move || {
+                    let mut hits = 0;
+                    for n in 0..20_000u64 {
+                        let i = 2 * (t * 20_000 + n) + 1;
+                        bucket.insert(&[i, i]);
+                        assert!(!bucket.lookup(&[i, i + 2]));
+                        hits += bucket.lookup(&[i, i]) as usize;
+                    }
+                    hits
+                })
+            })
+            .collect::<Vec<_>>();
+        let hits: usize = threads.into_iter().map(|t| t.join().unwrap()).sum();
+        assert!(hits > 0);
+    }
+}
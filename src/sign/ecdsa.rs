@@ -1,9 +1,20 @@
 use std::prelude::v1::*;
-use crate::{ec, errors::Result};
+use crate::metrics::{self, Op};
+use crate::{
+    ec,
+    errors::{Result, SimpleResult},
+};
 
 pub use crate::ec::suite_b::ecdsa::{
-    signing::{EcdsaKeyPair, EcdsaSigningAlgorithm, ECDSA_P256_SHA256_ASN1_SIGNING},
-    verification::{EcdsaVerificationAlgorithm, ECDSA_P256_SHA256_ASN1},
+    signing::{
+        EcdsaKeyPair, EcdsaSigningAlgorithm, ECDSA_P256_SHA256_ASN1_SIGNING,
+        ECDSA_P256_SHA256_FIXED_SIGNING, ECDSA_P384_SHA384_ASN1_SIGNING,
+        ECDSA_P384_SHA384_FIXED_SIGNING,
+    },
+    verification::{
+        EcdsaVerificationAlgorithm, ECDSA_P256_SHA256_ASN1, ECDSA_P256_SHA256_FIXED,
+        ECDSA_P384_SHA384_ASN1, ECDSA_P384_SHA384_FIXED,
+    },
 };
 
 use core;
@@ -66,7 +77,7 @@ pub trait VerificationAlgorithm: core::fmt::Debug + Sync {
         public_key: untrusted::Input,
         msg: untrusted::Input,
         signature: untrusted::Input,
-    ) -> Result<()>;
+    ) -> SimpleResult<()>;
 }
 
 /// An unparsed, possibly malformed, public key for signature verification.
@@ -102,12 +113,15 @@ impl<B: AsRef<[u8]>> UnparsedPublicKey<B> {
     /// `message` using it.
     ///
     /// See the [crate::signature] module-level documentation for examples.
-    pub fn verify(&self, message: &[u8], signature: &[u8]) -> Result<()> {
-        self.algorithm.verify(
-            untrusted::Input::from(self.bytes.as_ref()),
-            untrusted::Input::from(message),
-            untrusted::Input::from(signature),
-        )
+    /// A rejected signature is a bare `ErrorKind` and never allocates.
+    pub fn verify(&self, message: &[u8], signature: &[u8]) -> SimpleResult<()> {
+        metrics::observe(Op::EcdsaVerify, || {
+            self.algorithm.verify(
+                untrusted::Input::from(self.bytes.as_ref()),
+                untrusted::Input::from(message),
+                untrusted::Input::from(signature),
+            )
+        })
     }
 
     pub fn xy(&self) -> (&[u8], &[u8]) {
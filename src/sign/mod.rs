@@ -1 +1,3 @@
+pub mod cache;
 pub mod ecdsa;
+pub mod registry;
@@ -0,0 +1,120 @@
+use std::prelude::v1::*;
+use crate::{
+    errors::{Error, ErrorKind, Result},
+    sign::ecdsa::{EcdsaKeyPair, EcdsaSigningAlgorithm, Signature},
+};
+use std::collections::HashMap;
+
+/// Signing keys loaded once, typically at startup, and looked up by id for
+/// each request afterwards.
+///
+/// Loading a key parses it and converts the private key to Montgomery form;
+/// keeping the `EcdsaKeyPair` around avoids paying for that per request. The
+/// registry is filled through `&mut self` and only read through `&self`, so
+/// a loaded registry can be shared between threads behind an `Arc`.
+#[derive(Default)]
+pub struct KeyRegistry {
+    keys: HashMap<String, EcdsaKeyPair>,
+}
+
+impl KeyRegistry {
+    pub fn new() -> Self {
+        Self::default()
+    }
+
+    /// Parses `pkcs8` with `EcdsaKeyPair::from_pkcs8()` and registers it
+    /// under `key_id`. Fails if `key_id` is already registered.
+    pub fn load_pkcs8(
+        &mut self,
+        key_id: &str,
+        alg: &'static EcdsaSigningAlgorithm,
+        pkcs8: &[u8],
+    ) -> Result<()> {
+        if self.keys.contains_key(key_id) {
+            return Err(Error::from(ErrorKind::InvalidInputError));
+        }
+        let key_pair = EcdsaKeyPair::from_pkcs8(alg, pkcs8)?;
+        self.keys.insert(key_id.to_string(), key_pair);
+        Ok(())
+    }
+
+    /// Registers `key_pair` under `key_id`, returning the key pair it
+    /// replaces, if any.
+    pub fn insert(&mut self, key_id: &str, key_pair: EcdsaKeyPair) -> Option<EcdsaKeyPair> {
+        self.keys.insert(key_id.to_string(), key_pair)
+    }
+
+    pub fn remove(&mut self, key_id: &str) -> Option<EcdsaKeyPair> {
+        self.keys.remove(key_id)
+    }
+
+    pub fn get(&self, key_id: &str) -> Option<&EcdsaKeyPair> {
+        self.keys.get(key_id)
+    }
+
+    /// Signs `message` with the key registered under `key_id`.
+    pub fn sign(&self, key_id: &str, message: &[u8]) -> Result<Signature> {
+        self.get(key_id)
+            .ok_or_else(|| Error::from(ErrorKind::InvalidInputError))?
+            .sign(message)
+    }
+
+    pub fn len(&self) -> usize {
+        self.keys.len()
+    }
+
+    pub fn is_empty(&self) -> bool {
+        self.keys.is_empty()
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::sign::ecdsa::{
+        KeyPair, UnparsedPublicKey, ECDSA_P256_SHA256_ASN1, ECDSA_P256_SHA256_ASN1_SIGNING,
+        ECDSA_P384_SHA384_FIXED, ECDSA_P384_SHA384_FIXED_SIGNING,
+    };
+
+    #[test]
+    fn test_key_registry() {
+        let p256 = EcdsaKeyPair::generate_pkcs8(&ECDSA_P256_SHA256_ASN1_SIGNING).unwrap();
+        let p384 = EcdsaKeyPair::generate_pkcs8(&ECDSA_P384_SHA384_FIXED_SIGNING).unwrap();
+
+        let mut registry = KeyRegistry::new();
+        assert!(registry.is_empty());
+        registry
+            .load_pkcs8("p256", &ECDSA_P256_SHA256_ASN1_SIGNING, p256.as_ref())
+            .unwrap();
+        registry
+            .load_pkcs8("p384", &ECDSA_P384_SHA384_FIXED_SIGNING, p384.as_ref())
+            .unwrap();
+        assert_eq!(registry.len(), 2);
+
+        // Ids are unique, and keys must match their algorithm.
+        assert!(registry
+            .load_pkcs8("p256", &ECDSA_P256_SHA256_ASN1_SIGNING, p256.as_ref())
+            .is_err());
+        assert!(registry
+            .load_pkcs8("other", &ECDSA_P256_SHA256_ASN1_SIGNING, p384.as_ref())
+            .is_err());
+        assert_eq!(registry.len(), 2);
+
+        let msg = b"registry";
+        for &(key_id, verify_alg) in &[
+            ("p256", &ECDSA_P256_SHA256_ASN1),
+            ("p384", &ECDSA_P384_SHA384_FIXED),
+        ] {
+            let sig = registry.sign(key_id, msg).unwrap();
+            let public_key = registry.get(key_id).unwrap().public_key();
+            assert!(UnparsedPublicKey::new(verify_alg, public_key)
+                .verify(msg, sig.as_ref())
+                .is_ok());
+        }
+        assert!(registry.sign("missing", msg).is_err());
+
+        assert!(registry.remove("p256").is_some());
+        assert!(registry.get("p256").is_none());
+        assert_eq!(registry.len(), 1);
+    }
+}
@@ -467,6 +467,97 @@ fn parse_test_case(
     }
 }
 
+/// A timing-leak check in the style of dudect ("Dude, is my code constant
+/// time?", Reparaz, Balasch and Verbauwhede, 2017): run a function on two
+/// classes of inputs in random order and test whether the running times of
+/// the two classes differ.
+///
+/// The classes are typically one fixed input against random ones, e.g. table
+/// index 0 against uniformly random indices. The test is statistical, so it
+/// can miss leaks smaller than the measurement noise, but it catches the
+/// usual mistakes (early exits, data-dependent branches or memory accesses)
+/// without re-reading the code for each new table size or input length.
+///
+/// Timings flake on a loaded machine, so tests built on this are `#[ignore]`d
+/// and run on demand with
+/// `cargo test --release dudect -- --ignored --test-threads 1`.
+#[cfg(test)]
+pub mod dudect {
+    use std::{time::Instant, vec::Vec};
+
+    /// |t| above this means the timing depends on the class, with very high
+    /// confidence; dudect uses 4.5 for "probably" and 10 for "definitely".
+    pub const LEAK_THRESHOLD: f64 = 10.0;
+
+    // Number of calls timed together, to rise above the timer's resolution.
+    const CALLS_PER_MEASUREMENT: usize = 8;
+
+    /// A small xorshift generator for choosing classes and inputs; it only
+    /// has to be unpredictable to the code under test.
+    pub struct Rng(u64);
+
+    impl Rng {
+        pub fn new(seed: u64) -> Self {
+            Rng(seed | 1)
+        }
+
+        pub fn next_u64(&mut self) -> u64 {
+            self.0 ^= self.0 << 13;
+            self.0 ^= self.0 >> 7;
+            self.0 ^= self.0 << 17;
+            self.0
+        }
+    }
+
+    /// Returns Welch's t statistic for the difference between the running
+    /// times of `f` on inputs of class 0 and class 1, from `measurements`
+    /// timings. `input(class, rng)` generates an input of the given class;
+    /// inputs are generated before any timing starts. The slowest 10% of all
+    /// timings are discarded as interrupts and the like.
+    pub fn t_statistic<T, R>(
+        measurements: usize,
+        mut input: impl FnMut(bool, &mut Rng) -> T,
+        mut f: impl FnMut(&T) -> R,
+    ) -> f64 {
+        let mut rng = Rng::new(0x2545_f491_4f6c_dd1d);
+        let inputs: Vec<(bool, T)> = (0..measurements)
+            .map(|_| {
+                let class = rng.next_u64() & 1 == 1;
+                (class, input(class, &mut rng))
+            })
+            .collect();
+
+        let mut timings: Vec<(bool, f64)> = Vec::with_capacity(measurements);
+        for (class, input) in &inputs {
+            let start = Instant::now();
+            for _ in 0..CALLS_PER_MEASUREMENT {
+                let r = f(input);
+                // Keep the call from being optimized away.
+                core::mem::forget(unsafe { core::ptr::read_volatile(&r) });
+            }
+            timings.push((*class, start.elapsed().as_nanos() as f64));
+        }
+
+        let mut sorted: Vec<f64> = timings.iter().map(|&(_, t)| t).collect();
+        sorted.sort_by(|a, b| a.partial_cmp(b).unwrap());
+        let cutoff = sorted[(sorted.len() * 9) / 10];
+
+        let mut n = [0f64; 2];
+        let mut mean = [0f64; 2];
+        let mut m2 = [0f64; 2];
+        for &(class, t) in timings.iter().filter(|&&(_, t)| t <= cutoff) {
+            // Welford's online mean and variance.
+            let c = class as usize;
+            n[c] += 1.0;
+            let delta = t - mean[c];
+            mean[c] += delta / n[c];
+            m2[c] += delta * (t - mean[c]);
+        }
+        let var = [m2[0] / (n[0] - 1.0), m2[1] / (n[1] - 1.0)];
+        (mean[0] - mean[1]) / ((var[0] / n[0]) + (var[1] / n[1])).sqrt()
+    }
+}
+
 #[cfg(test)]
 mod tests {
     use crate::{errors::*, test};